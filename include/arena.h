@@ -0,0 +1,28 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Bump allocator for data that lives for one frame. Allocation is a pointer
+// increment; arena_reset releases everything at once. If a frame outgrows
+// the block, extra blocks are chained and then merged into a single larger
+// block on the next reset, so steady-state frames never touch the heap.
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t size;
+    size_t used;
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock* head;
+    size_t peak;            // Largest total usage seen by any frame
+    size_t frame_used;
+} Arena;
+
+int arena_init(Arena* arena, size_t size);
+void arena_free(Arena* arena);
+void* arena_alloc(Arena* arena, size_t size);
+char* arena_printf(Arena* arena, const char* fmt, ...);
+void arena_reset(Arena* arena);
+
+#endif // ARENA_H
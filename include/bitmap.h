@@ -0,0 +1,50 @@
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <SDL2/SDL.h>
+
+// Compressed set of 32-bit values, laid out like a roaring bitmap: values
+// are grouped by their high 16 bits into containers, kept sorted by key.
+// A sparse container is a sorted array of the low 16 bits; once it holds
+// more than BITMAP_ARRAY_MAX values it becomes a 65536-bit bitset, which
+// is smaller from there on. Intersections and differences of two bitmaps
+// walk the containers pairwise and work a word or an array at a time.
+
+#define BITMAP_ARRAY_MAX 4096
+
+typedef struct {
+    Uint16 key;          // High 16 bits of every value in the container
+    int cardinality;
+    int capacity;        // Room in values
+    Uint16* values;      // Sorted low bits, or NULL for a bitset
+    Uint64* bits;        // 1024 words, or NULL for an array
+} BitmapContainer;
+
+typedef struct {
+    BitmapContainer* containers;
+    int count;
+    int capacity;
+} Bitmap;
+
+void bitmap_init(Bitmap* bitmap);
+void bitmap_free(Bitmap* bitmap);
+void bitmap_clear(Bitmap* bitmap);
+
+// Return 1 if memory ran out, leaving the value out
+int bitmap_add(Bitmap* bitmap, Uint32 value);
+void bitmap_remove(Bitmap* bitmap, Uint32 value);
+int bitmap_contains(const Bitmap* bitmap, Uint32 value);
+int bitmap_cardinality(const Bitmap* bitmap);
+
+// Replaces the contents of bitmap with those of from. Returns 1 if
+// memory ran out, leaving bitmap empty.
+int bitmap_copy(Bitmap* bitmap, const Bitmap* from);
+
+// In place: bitmap becomes bitmap AND other, OR other, AND NOT other.
+// Only OR allocates; if memory runs out it returns 1 and bitmap holds
+// part of the union.
+void bitmap_and(Bitmap* bitmap, const Bitmap* other);
+int bitmap_or(Bitmap* bitmap, const Bitmap* other);
+void bitmap_andnot(Bitmap* bitmap, const Bitmap* other);
+
+#endif // BITMAP_H
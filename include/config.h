@@ -0,0 +1,58 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <time.h>
+
+// Tunables read once at startup: defaults, then the INI file, then
+// HEROMAN_* environment variables, which win. The file is heroman.ini
+// unless HEROMAN_CONFIG names another one. Settings marked reloadable in
+// config.c are picked up again while running when the file changes; the
+// rest take effect on the next start.
+
+#define CONFIG_DEFAULT_PATH "heroman.ini"
+#define CONFIG_POLL_MS 1000
+
+typedef struct {
+    // [database]
+    char db_path[256];
+    int cache_size;          // PRAGMA cache_size: pages, or KiB when negative
+    int mmap_mb;             // PRAGMA mmap_size, in MiB
+    char synchronous[8];     // OFF, NORMAL, FULL or EXTRA
+    char journal_mode[16];   // DELETE, TRUNCATE, PERSIST, MEMORY, WAL or OFF
+    int busy_timeout_ms;     // How long to wait for another connection's lock
+    int sync_poll_ms;        // Check for other writers this often when idle; 0 disables
+
+    // [render]
+    int font_size;
+    int fps;                 // -1: 60, or left to vsync when it is on
+    int idle_fps;            // 0 keeps the full rate when idle
+    int vsync;
+    int frame_stats;         // Print allocation counts every few seconds
+
+    // [cache]
+    int text_cache_ways;     // Rendered strings kept per text cache set
+    int frame_arena_kb;
+
+    // [metrics]
+    char metrics_path[256];     // Prometheus text file; empty disables
+    char metrics_socket[108];   // Unix socket answering scrapes; empty disables
+    int metrics_interval_ms;
+
+    // File the settings came from, for reloads
+    char path[256];
+    time_t mtime;
+} Config;
+
+// HEROMAN_CONFIG, or CONFIG_DEFAULT_PATH
+const char* config_default_path(void);
+
+void config_defaults(Config* config);
+
+// A missing file is not an error; bad lines are reported and skipped
+int config_load(Config* config, const char* path);
+
+// Re-reads the file if it changed since it was loaded and copies the
+// reloadable settings. Returns 1 if any of them changed.
+int config_reload(Config* config);
+
+#endif // CONFIG_H
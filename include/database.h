@@ -2,23 +2,148 @@
 #define DATABASE_H
 
 #include <sqlite3.h>
+#include "config.h"
 #include "game.h"
 
 // Database initialization and cleanup
 int db_init(const char* filename, sqlite3** db);
 void db_close(sqlite3* db);
 
+// Applies the [database] settings; call before db_create_schema
+int db_configure(sqlite3* db, const Config* config);
+
+// Copies the whole database to filename, replacing its contents
+int db_backup(sqlite3* db, const char* filename);
+
 // Player operations
 int db_save_player(sqlite3* db, const PlayerStats* player);
 int db_load_player(sqlite3* db, PlayerStats* player);
 
-// Task operations
+// Task operations. Tasks form a tree through parent_id, mirrored in a
+// closure table (task_tree, see migrations.c) that holds a row for every
+// ancestor and descendant pair, so a subtree is one indexed range. A
+// subtree's rows are contiguous in the manual order. Triggers keep each
+// task's subtask counts current and delete subtasks with their parent.
 int db_create_task(sqlite3* db, const Task* task);
+
+// Writes everything but the placement; parent_id, position and the
+// subtask counts are left alone
 int db_update_task(sqlite3* db, const Task* task);
 int db_delete_task(sqlite3* db, int task_id);
+
+// Moves a task and its subtasks under parent_id (0 for the top level),
+// with the task at position, or after the parent's last subtask when
+// position is 0. A parent inside the subtree itself is refused.
+int db_move_task(sqlite3* db, int task_id, int parent_id, double position);
+
+// Tags. A task has up to TASK_MAX_TAGS, read back with the row; names
+// match without regard to case. Replaces the tags of task_id with the
+// comma-separated names, creating tags that do not exist yet. An empty
+// list removes them all; a list task_parse_tags refuses changes nothing
+// and returns 1.
+int db_set_task_tags(sqlite3* db, int task_id, const char* names);
+
+// Every tag, by id. *tags is a heap array owned by the caller.
+int db_get_tags(sqlite3* db, Tag** tags, int* count);
+
+// Ids of the tasks that have a due date, soonest first, read off the due
+// date index. *ids is a heap array owned by the caller.
+int db_get_due_order(sqlite3* db, int** ids, int* count);
+
 int db_get_all_tasks(sqlite3* db, Task** tasks, int* count);
 int db_get_task_by_id(sqlite3* db, int task_id, Task* task);
 
+// Reads many rows with one prepared statement. tasks[i] gets the row with
+// ids[i], or id 0 if there is none.
+int db_get_tasks_by_id(sqlite3* db, const int* ids, int count, Task* tasks);
+
+// Renumbers manual positions to 1, 2, 3... keeping their order, once
+// repeated moves have used up the gaps between neighbours
+int db_rebalance_task_positions(sqlite3* db);
+
+// Actions on a multi-selection
+typedef enum {
+    DB_BULK_COMPLETE,       // Like task_complete, for tasks not yet completed
+    DB_BULK_UNCOMPLETE,
+    DB_BULK_DELETE,
+    DB_BULK_SET_DIFFICULTY  // To value
+} DbBulkAction;
+
+// Applies action to every task in ids with one prepared statement, all or
+// nothing: the rows change under a savepoint, which is its own transaction
+// outside of one. Returns the number of rows changed, or -1.
+int db_apply_bulk_action(sqlite3* db, DbBulkAction action, int value, const int* ids, int count);
+
+// Statistics for the stats screen, read from aggregate tables that
+// triggers keep current (see migrations.c). The cost grows with the
+// number of days of history, not with the number of completions.
+#define DB_STATS_DAYS 14
+#define DB_STATS_TYPES 3
+#define DB_STATS_DIFFICULTIES 5
+
+typedef struct {
+    char days[DB_STATS_DAYS][11];    // YYYY-MM-DD, local time, ending today
+    int completions[DB_STATS_DAYS];
+    int experience[DB_STATS_DAYS];
+    long long experience_before;     // Earned before the first day shown
+    int tasks[DB_STATS_TYPES][DB_STATS_DIFFICULTIES];
+    int completed[DB_STATS_TYPES][DB_STATS_DIFFICULTIES];
+} TaskStats;
+
+int db_get_stats(sqlite3* db, TaskStats* stats);
+
+// Counter bumped by triggers on every change to the tasks table
+int db_get_tasks_revision(sqlite3* db, sqlite3_int64* revision);
+
+// PRAGMA data_version, which changes when another connection commits.
+// Cheap enough to poll; the connection's own writes leave it alone.
+int db_get_data_version(sqlite3* db, int* version);
+
+// Rows changed, and ids deleted, after tasks_revision since. Both arrays
+// are heap-allocated for the caller and may be NULL when empty.
+int db_get_task_changes(sqlite3* db, sqlite3_int64 since, Task** tasks, int* count,
+                        int** deleted, int* deleted_count);
+
+// Bulk import. Rows are bound into one prepared multi-row INSERT that is
+// stepped every DB_BULK_ROWS rows, and committed in chunks of chunk_size.
+// The ids of committed chunks are kept so db_bulk_abort can delete them.
+#define DB_BULK_ROWS 32
+
+typedef struct {
+    sqlite3_int64 first;
+    sqlite3_int64 last;
+} DbBulkRange;
+
+typedef struct {
+    sqlite3* db;
+    sqlite3_stmt* insert;       // DB_BULK_ROWS rows per step
+    sqlite3_stmt* insert_one;   // Flushes the tail
+    int chunk_size;
+    Task rows[DB_BULK_ROWS];    // Staged rows, bound when the batch is full
+    int rows_staged;
+    int pending;                // Rows since the last commit
+    double next_position;       // Manual order key for the next row
+    long long total;
+    DbBulkRange* ranges;        // Ids inserted so far, in insert order
+    int range_count;
+    int range_capacity;
+    int ranges_committed;       // Ranges before this one are committed
+} DbBulkInsert;
+
+int db_bulk_begin(sqlite3* db, DbBulkInsert* bulk, int chunk_size);
+int db_bulk_insert(DbBulkInsert* bulk, const Task* task);
+// Inserts the staged rows and commits. After a failure here, or in
+// db_bulk_insert, call db_bulk_abort instead to undo the whole import.
+int db_bulk_end(DbBulkInsert* bulk);
+// Rolls back the open chunk and deletes the rows of the committed ones.
+// Returns non-zero if some committed rows could not be deleted.
+int db_bulk_abort(DbBulkInsert* bulk);
+
+// Streams every task through callback without materializing the table.
+// Iteration stops early if callback returns non-zero.
+typedef int (*DbTaskCallback)(const Task* task, void* user_data);
+int db_for_each_task(sqlite3* db, DbTaskCallback callback, void* user_data);
+
 // Database schema creation
 int db_create_schema(sqlite3* db);
 
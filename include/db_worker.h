@@ -0,0 +1,91 @@
+#ifndef DB_WORKER_H
+#define DB_WORKER_H
+
+#include <SDL2/SDL.h>
+#include <sqlite3.h>
+#include "database.h"
+#include "game.h"
+#include "snapshot.h"
+#include "task_events.h"
+
+// Moves SQLite work off the render thread. The UI thread submits requests
+// and the worker thread posts one response per request, each through its
+// own lock-free single-producer/single-consumer ring buffer. Responses
+// carry the id of the request they answer. After each commit that changed
+// tasks the worker also posts a CHANGES message, with id 0, holding the
+// deltas. Responses are held until their batch commits; if the commit
+// fails, its writes answer with a non-zero status and a LOAD with id 0
+// follows to replace whatever the batch's reads returned.
+
+#define DB_WORKER_QUEUE_SIZE 256  // Must be a power of two
+
+typedef enum {
+    DB_OP_LOAD,      // Load every task (from the snapshot when it is current)
+    DB_OP_CREATE,
+    DB_OP_UPDATE,
+    DB_OP_DELETE,
+    DB_OP_BACKFILL,  // One batch of a pending migration backfill
+    DB_OP_REBALANCE, // Renumber manual task positions
+    DB_OP_STATS,     // Read the statistics aggregates
+    DB_OP_SYNC,      // Fetch what other connections changed, if anything
+    DB_OP_BULK,      // One action on many tasks, all or nothing
+    DB_OP_MOVE,      // Reorder or reparent a task, with its subtasks
+    DB_OP_TAGS,      // Read the tag names
+    DB_OP_DUE,       // Read the ids of tasks with a due date, soonest first
+    DB_OP_CHANGES    // Posted by the worker, never submitted
+} DbOp;
+
+typedef struct {
+    Uint32 id;
+    DbOp op;
+    int status;              // 0 on success
+    Uint64 submitted;        // Performance counter when the request was queued
+    Task task;               // Request payload; CREATE responses carry the stored row.
+                             // MOVE: id, parent_id and position.
+    Task* tasks;             // LOAD: heap array owned by the receiver...
+    int count;               // BACKFILL: 1 while more batches remain; CHANGES/SYNC: deltas;
+                             // BULK: ids requested, then rows changed
+    TaskSnapshot snapshot;   // ...or a mapped snapshot, when snapshot.mapping is set
+    TaskStats* stats;        // STATS: heap copy owned by the receiver
+    sqlite3_int64 revision;  // LOAD/SYNC: tasks_revision the result is current to;
+                             // SYNC requests pass the last one they applied
+    int data_version;        // LOAD/SYNC: PRAGMA data_version at that point; likewise
+    TaskDelta* deltas;       // CHANGES/SYNC: heap array owned by the receiver. CHANGES
+                             // with a non-zero status lost some; reload.
+    int* ids;                // BULK: heap array, freed by the worker. DUE: heap
+                             // array owned by the receiver, count long
+    DbBulkAction bulk;       // BULK: the action and its value
+    int bulk_value;
+    char* tag_names;         // CREATE/UPDATE: comma-separated tags to set, or NULL to
+                             // leave them; heap string, freed by the worker
+    Tag* tags;               // TAGS: heap array owned by the receiver, count long
+} DbMessage;
+
+typedef struct DbWorker DbWorker;
+typedef void (*DbResponseHandler)(const DbMessage* response, void* user_data);
+
+// The worker takes over db until db_worker_stop returns. LOAD requests
+// try the snapshot at snapshot_path first, unless it is NULL.
+DbWorker* db_worker_start(sqlite3* db, const char* snapshot_path);
+
+// Returns the request id, or 0 if the request queue is full
+Uint32 db_worker_submit(DbWorker* worker, DbOp op, const Task* task);
+
+// Queues a SYNC from the revision and data_version the caller last applied
+Uint32 db_worker_submit_sync(DbWorker* worker, sqlite3_int64 revision, int data_version);
+
+// Queues a CREATE or UPDATE that also sets the task's tags to the
+// comma-separated names, which are copied
+Uint32 db_worker_submit_tagged(DbWorker* worker, DbOp op, const Task* task, const char* tag_names);
+
+// Queues action on the tasks in ids, which are copied
+Uint32 db_worker_submit_bulk(DbWorker* worker, DbBulkAction action, int value, const int* ids, int count);
+
+// Dequeues one response without blocking. Returns 1 if one was available.
+int db_worker_poll(DbWorker* worker, DbMessage* response);
+
+// Finishes outstanding requests, passing their responses to handler, then
+// joins the thread and frees the worker
+void db_worker_stop(DbWorker* worker, DbResponseHandler handler, void* user_data);
+
+#endif // DB_WORKER_H
@@ -0,0 +1,81 @@
+#ifndef FONT_H
+#define FONT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+#define FONT_ATLAS_PATH "assets/font.bin"
+#define FONT_ATLAS_MAGIC "HMFONT\r\n"
+#define FONT_ATLAS_VERSION 1
+#define FONT_ATLAS_HEADER_SIZE 64
+
+// A baked font: glyphs rasterized once at build time (tools/bake_font.c)
+// into one file that is mapped at startup. The file is the header, the
+// glyph table sorted by codepoint, the kerning pairs sorted by glyph
+// index, then the atlas as one coverage byte per pixel.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t size;           // Point size the glyphs were rendered at
+    int32_t height;          // Line height, as TTF_FontHeight
+    int32_t ascent;
+    int32_t line_skip;
+    uint32_t glyph_count;
+    uint32_t kern_count;
+    uint32_t atlas_width;
+    uint32_t atlas_height;
+} FontAtlasHeader;
+
+typedef struct {
+    uint32_t codepoint;
+    uint16_t atlas_x;
+    uint16_t atlas_y;
+    uint16_t width;          // Inked box; may be 0 for blanks
+    uint16_t height;
+    int16_t offset_x;        // Inked box relative to the pen and line top
+    int16_t offset_y;
+    int16_t advance;
+    int16_t reserved;
+} FontAtlasGlyph;
+
+typedef struct {
+    uint16_t left;           // Glyph indices
+    uint16_t right;
+    int16_t amount;
+    int16_t reserved;
+} FontAtlasKern;
+
+// Text drawing font. Strings made only of baked glyphs are rendered from
+// the atlas; anything else, and every size that was not baked, goes
+// through SDL_ttf, which is initialized and opened on first use.
+typedef struct {
+    void* mapping;
+    size_t mapping_size;
+    const FontAtlasHeader* atlas;
+    const FontAtlasGlyph* glyphs;
+    const FontAtlasKern* kerning;
+    const Uint8* pixels;
+
+    TTF_Font* ttf;
+    char ttf_path[256];
+    int size;
+} Font;
+
+// Uses the atlas at atlas_path if it was baked at size, otherwise opens
+// the TrueType font right away. Returns 1 if neither is usable.
+int font_open(Font* font, const char* ttf_path, const char* atlas_path, int size);
+void font_close(Font* font);
+
+// The SDL_ttf font, opened if needed; NULL if it cannot be
+TTF_Font* font_ttf(Font* font);
+
+// As TTF_RenderUTF8_Solid
+SDL_Surface* font_render(Font* font, const char* text, SDL_Color color);
+
+// As TTF_GlyphMetrics and TTF_SizeUTF8; 0 on success
+int font_glyph_advance(Font* font, Uint32 codepoint, int* advance);
+int font_size_utf8(Font* font, const char* text, int* width, int* height);
+
+#endif // FONT_H
@@ -0,0 +1,34 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <SDL2/SDL.h>
+
+// Deadline-based frame scheduling on the performance counter. Each frame
+// is given a deadline one period after the previous one, so the time spent
+// building the frame counts toward the period instead of being added to a
+// fixed delay. With adaptive pacing the rate drops to idle_fps once nothing
+// has happened for FRAME_PACER_IDLE_DELAY_MS, and input wakes the loop
+// immediately.
+
+#define FRAME_PACER_IDLE_DELAY_MS 1000
+
+typedef struct {
+    Uint64 frequency;
+    Uint64 deadline;        // Counter value the current frame should end at
+    Uint64 active_period;   // 0: uncapped (or paced by vsync)
+    Uint64 idle_period;     // 0: adaptive pacing disabled
+    Uint64 last_activity;
+} FramePacer;
+
+// target_fps 0 leaves the rate to vsync; idle_fps 0 disables adaptive pacing
+void frame_pacer_init(FramePacer* pacer, int target_fps, int idle_fps);
+
+// Marks the current frame as doing visible work, keeping the full rate
+void frame_pacer_activity(FramePacer* pacer);
+int frame_pacer_idle(const FramePacer* pacer);
+
+// Sleeps until the current frame's deadline. Returns 1 if a full-rate
+// frame had already missed it.
+int frame_pacer_wait(FramePacer* pacer);
+
+#endif // FRAME_PACER_H
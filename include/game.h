@@ -11,7 +11,9 @@ typedef enum {
     GAME_STATE_PLAYING,
     GAME_STATE_INVENTORY,
     GAME_STATE_QUESTS,
-    GAME_STATE_EXIT
+    GAME_STATE_STATS,
+    GAME_STATE_TASK_DIALOG,
+    GAME_STATE_EXIT     // Also the number of screens
 } GameState;
 
 // Task filter types
@@ -25,7 +27,9 @@ typedef enum {
 typedef enum {
     TASK_SORT_TYPE,
     TASK_SORT_DIFFICULTY,
-    TASK_SORT_COMPLETION
+    TASK_SORT_COMPLETION,
+    TASK_SORT_MANUAL,    // User's drag-and-drop order
+    TASK_SORT_DUE        // Soonest due date first; tasks without one last
 } TaskSort;
 
 // Player stats
@@ -40,6 +44,9 @@ typedef struct {
     int perception;
 } PlayerStats;
 
+#define TASK_MAX_TAGS 8
+#define TAG_NAME_MAX 32
+
 // Task structure
 typedef struct {
     int id;
@@ -50,13 +57,27 @@ typedef struct {
     int completed;
     int streak;
     time_t last_completed;
+    double position; // Manual order key; 0 until the database assigns one
+    int parent_id;   // 0 for a top-level task
+    int subtasks;    // Descendants, at any depth; kept by the database
+    int subtasks_completed;
+    int collapsed;   // Descendants are hidden in the task list
+    int tags[TASK_MAX_TAGS];  // Tag ids, ascending; kept by the database
+    int tag_count;
+    time_t due_at;   // 0 when the task has no due date
 } Task;
 
+typedef struct {
+    int id;
+    char name[TAG_NAME_MAX];
+} Tag;
+
 // Message structure for UI notifications
 typedef struct {
     char text[256];
-    time_t show_time;
+    Uint32 show_time;  // Milliseconds, monotonic
     int visible;
+    Uint32 version;    // Bumped whenever what is shown changes
 } Message;
 
 // Game structure
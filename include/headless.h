@@ -0,0 +1,50 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <SDL2/SDL.h>
+
+// Offscreen rendering for machines without a display. The software
+// renderer draws straight into a surface in memory, so the regular drawing
+// code runs unchanged and its output can be saved, compared against golden
+// images and timed.
+
+#define HEADLESS_FRAMES 100          // Frames timed per scene
+#define HEADLESS_TOLERANCE 8         // Largest per-channel difference that still matches
+#define HEADLESS_MAX_MISMATCH 0.001  // Fraction of pixels allowed outside the tolerance
+
+typedef struct {
+    SDL_Surface* surface;
+    SDL_Renderer* renderer;
+    float* frame_ms;
+    int frame_count;
+    int frame_capacity;
+} HeadlessTarget;
+
+typedef struct {
+    int pixels;       // Pixels compared
+    int mismatched;   // Pixels with a channel off by more than the tolerance
+    int max_delta;    // Largest channel difference seen
+} HeadlessDiff;
+
+int headless_open(HeadlessTarget* target, int width, int height);
+void headless_close(HeadlessTarget* target);
+
+// Frame times are kept per scene; reset before timing the next one
+void headless_note_frame(HeadlessTarget* target, double ms);
+void headless_reset_frames(HeadlessTarget* target);
+
+// Prints p50/p99/max for the frames noted so far and appends them to the
+// CSV at csv_path. Returns 1 if p99 is over budget_ms (0 for no budget).
+int headless_report_frames(HeadlessTarget* target, const char* scene, const char* csv_path,
+                           double budget_ms);
+
+int headless_save_png(HeadlessTarget* target, const char* path);
+
+// Compares the rendered pixels against the golden PNG. Mismatched pixels
+// are painted red over a dimmed copy saved at diff_path. Returns 0 if the
+// images match within tolerance, 1 if they differ and -1 if the golden
+// image is missing or a different size.
+int headless_compare(HeadlessTarget* target, const char* golden_path, const char* diff_path,
+                     HeadlessDiff* diff);
+
+#endif // HEADLESS_H
@@ -0,0 +1,49 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stddef.h>
+
+// Minimal JSON support for line-oriented protocols and files: a parser that
+// splits one object into its top-level fields without allocating, and a
+// growable output buffer with string escaping.
+
+typedef enum {
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_OBJECT,
+    JSON_ARRAY
+} JsonType;
+
+// Field spans point into the parsed text. String values exclude the quotes
+// and are still escaped; objects and arrays include their brackets.
+typedef struct {
+    const char* key;
+    int key_len;
+    JsonType type;
+    const char* value;
+    int value_len;
+} JsonField;
+
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+} JsonBuffer;
+
+// Returns the number of fields parsed, or -1 on malformed input
+int json_parse_object(const char* text, int len, JsonField* fields, int max_fields);
+const JsonField* json_find(const JsonField* fields, int count, const char* key);
+int json_field_int(const JsonField* field, int* out);
+int json_field_string(const JsonField* field, char* out, int out_size);
+
+void json_buffer_init(JsonBuffer* buf);
+void json_buffer_free(JsonBuffer* buf);
+int json_buffer_reserve(JsonBuffer* buf, size_t extra);
+int json_buffer_append(JsonBuffer* buf, const char* data, size_t len);
+int json_buffer_printf(JsonBuffer* buf, const char* fmt, ...);
+int json_buffer_append_string(JsonBuffer* buf, const char* s);
+void json_buffer_consume(JsonBuffer* buf, size_t len);
+
+#endif // JSON_H
@@ -0,0 +1,95 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <SDL2/SDL.h>
+
+// Widget rectangles computed from constraints. Each node is placed
+// relative to its parent; the results are cached in output pixels and
+// shared by drawing and hit-testing. Only nodes marked dirty (and their
+// descendants) are recomputed.
+
+// Logical size the constraints were designed for
+#define LAYOUT_BASE_WIDTH 800
+#define LAYOUT_BASE_HEIGHT 600
+
+typedef enum {
+    LAYOUT_ROOT,
+
+    // Main screen
+    LAYOUT_TITLE,
+    LAYOUT_NEW_TASK_BUTTON,
+    LAYOUT_QUIT_BUTTON,
+    LAYOUT_STATS_BUTTON,
+    LAYOUT_FILTER_ALL_BUTTON,
+    LAYOUT_FILTER_COMPLETED_BUTTON,
+    LAYOUT_FILTER_UNCOMPLETED_BUTTON,
+    LAYOUT_SORT_TYPE_BUTTON,
+    LAYOUT_SORT_DIFFICULTY_BUTTON,
+    LAYOUT_SORT_COMPLETION_BUTTON,
+    LAYOUT_SORT_DUE_BUTTON,
+    LAYOUT_TAG_BAR,
+    LAYOUT_TASK_LIST,
+    LAYOUT_MESSAGE,
+
+    // Actions on the selected tasks, shown while there are any
+    LAYOUT_BULK_COMPLETE_BUTTON,
+    LAYOUT_BULK_UNCOMPLETE_BUTTON,
+    LAYOUT_BULK_DELETE_BUTTON,
+    LAYOUT_BULK_DIFFICULTY_BUTTON,
+
+    // Stats screen, drawn in place of the task list
+    LAYOUT_STATS_CHART,
+    LAYOUT_STATS_TABLE,
+
+    // Task dialog
+    LAYOUT_DIALOG,
+    LAYOUT_DIALOG_HEADING,
+    LAYOUT_DIALOG_TITLE_INPUT,
+    LAYOUT_DIALOG_DESC_INPUT,
+    LAYOUT_DIALOG_TYPE,
+    LAYOUT_DIALOG_DIFFICULTY,
+    LAYOUT_DIALOG_TAGS_INPUT,
+    LAYOUT_DIALOG_DUE_INPUT,
+    LAYOUT_DIALOG_SAVE_BUTTON,
+    LAYOUT_DIALOG_CANCEL_BUTTON,
+
+    LAYOUT_COUNT
+} LayoutId;
+
+// Offsets are measured from an anchor point of the parent, given as a
+// fraction of its size. A positive width/height is a fixed size; zero or
+// less stretches to the parent's far edge, leaving that many pixels free.
+typedef struct {
+    LayoutId parent;
+    float anchor_x;
+    float anchor_y;
+    int x;
+    int y;
+    int width;
+    int height;
+} LayoutConstraint;
+
+typedef struct {
+    SDL_Rect rects[LAYOUT_COUNT];   // Cached results, output pixels
+    Uint8 dirty[LAYOUT_COUNT];
+    int width;                      // Output size
+    int height;
+    float scale;                    // Output pixels per logical pixel
+} Layout;
+
+void layout_init(Layout* layout);
+
+// Marks everything dirty if the output size or scale changed
+void layout_resize(Layout* layout, int width, int height, float scale);
+void layout_mark_dirty(Layout* layout, LayoutId id);
+
+// Recomputes dirty subtrees. Returns the number of nodes updated.
+int layout_update(Layout* layout);
+
+const SDL_Rect* layout_rect(const Layout* layout, LayoutId id);
+int layout_hit(const Layout* layout, LayoutId id, int x, int y);
+
+// Converts a logical length to output pixels
+int layout_px(const Layout* layout, int logical);
+
+#endif // LAYOUT_H
@@ -0,0 +1,48 @@
+#ifndef MEMSTATS_H
+#define MEMSTATS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <SDL2/SDL.h>
+
+// Counts heap allocations made through SDL (and the libraries that allocate
+// through it, such as SDL_ttf). Must be installed before SDL_Init.
+//
+// Built with -DHEROMAN_MEMTRACK=ON, this header is force-included into
+// every game source, so their malloc, calloc, realloc and free go through
+// counting wrappers that note the call site; SDL and SQLite allocations
+// are counted too, per subsystem, with bytes, live and peak usage. Install
+// before anything else then, since SQLite can only be hooked before its
+// first use.
+void memstats_install(void);
+Uint32 memstats_allocations(void);
+
+typedef enum {
+    MEM_HEROMAN,    // The game's own allocations
+    MEM_SDL,
+    MEM_SQLITE,
+    MEM_SUBSYSTEM_COUNT
+} MemSubsystem;
+
+// Closes the current frame's allocation counts. Does nothing unless built
+// with HEROMAN_MEMTRACK.
+void memstats_end_frame(void);
+
+// Per subsystem totals, per frame averages and maxima, live and peak bytes
+// and the busiest call sites. Does nothing unless built with
+// HEROMAN_MEMTRACK.
+void memstats_report(FILE* out);
+
+void* memstats_malloc(size_t size, const char* file, int line);
+void* memstats_calloc(size_t count, size_t size, const char* file, int line);
+void* memstats_realloc(void* mem, size_t size, const char* file, int line);
+void memstats_free(void* mem);
+
+#if defined(HEROMAN_MEMTRACK) && !defined(MEMSTATS_NO_WRAP)
+#define malloc(size) memstats_malloc((size), __FILE__, __LINE__)
+#define calloc(count, size) memstats_calloc((count), (size), __FILE__, __LINE__)
+#define realloc(mem, size) memstats_realloc((mem), (size), __FILE__, __LINE__)
+#define free(mem) memstats_free(mem)
+#endif
+
+#endif // MEMSTATS_H
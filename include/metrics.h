@@ -0,0 +1,53 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <SDL2/SDL.h>
+#include "config.h"
+
+// Process-wide counters and histograms for long-running monitoring. Each
+// thread updates its own cache-line-aligned shard, so hot paths never
+// contend; the exporter sums the shards when it writes them out in the
+// Prometheus text format.
+
+#define METRICS_MAX_SHARDS 8
+
+typedef enum {
+    METRIC_FRAMES_RENDERED,
+    METRIC_FRAMES_DROPPED,
+    METRIC_TEXTURES_CREATED,
+    METRIC_SCENE_REBUILDS,
+    METRIC_COUNTER_COUNT
+} MetricCounter;
+
+// Database operation latency, one histogram per operation type. The
+// _count of each doubles as the operation counter.
+typedef enum {
+    METRIC_DB_LOAD,
+    METRIC_DB_CREATE,
+    METRIC_DB_UPDATE,
+    METRIC_DB_DELETE,
+    METRIC_DB_BACKFILL,
+    METRIC_DB_REBALANCE,
+    METRIC_DB_STATS,
+    METRIC_DB_SYNC,
+    METRIC_DB_BULK,
+    METRIC_DB_MOVE,
+    METRIC_DB_TAGS,
+    METRIC_DB_DUE,
+    METRIC_HISTOGRAM_COUNT
+} MetricHistogram;
+
+void metrics_add(MetricCounter counter, Uint64 value);
+void metrics_observe(MetricHistogram histogram, Uint64 microseconds);
+
+// Appends the current values, summed over all shards, to out. Returns
+// the number of bytes written, truncating at size like snprintf.
+size_t metrics_format(char* out, size_t size);
+
+// Publishes the metrics every [metrics] interval_ms to the file at path
+// (replaced atomically) and, on Linux, answers HTTP scrapes on a Unix
+// socket. Either may be disabled with an empty setting.
+int metrics_exporter_start(const Config* config);
+void metrics_exporter_stop(void);
+
+#endif // METRICS_H
@@ -0,0 +1,26 @@
+#ifndef MIGRATIONS_H
+#define MIGRATIONS_H
+
+#include <sqlite3.h>
+
+// Schema versions are tracked in PRAGMA user_version. Each migration runs
+// in its own transaction together with the version bump, so an upgrade
+// interrupted part way resumes at the first migration that did not commit.
+// When the version is current, startup costs a single PRAGMA read.
+#define DB_SCHEMA_VERSION 8
+
+int db_migrate(sqlite3* db);
+int db_schema_version(sqlite3* db, int* version);
+
+// Data backfills queued by migrations run online, a batch of rows at a
+// time, so upgrading a large database does not stall startup. Progress is
+// kept in the meta table and survives restarts.
+#define DB_BACKFILL_BATCH 500
+
+int db_backfill_pending(sqlite3* db);
+
+// Processes up to max_rows rows of the oldest pending backfill. Returns 1
+// while work remains, 0 when all backfills are done, -1 on error.
+int db_backfill_step(sqlite3* db, int max_rows);
+
+#endif // MIGRATIONS_H
@@ -0,0 +1,52 @@
+#ifndef REMINDERS_H
+#define REMINDERS_H
+
+#include <time.h>
+#include "game.h"
+#include "task_list.h"
+#include "task_events.h"
+
+// Upcoming due times of uncompleted tasks, as a binary min-heap ordered by
+// due time, so the main loop only has to look at the top each frame.
+// Entries are never changed in place: a new or moved due date pushes
+// another entry, and one that no longer matches its task (deleted,
+// completed or moved) is dropped when it reaches the top.
+
+// reminders_stale asks for a rebuild once the heap holds more than two
+// entries per task plus this many, so rebuilds stay rare on small lists
+#define REMINDERS_SLACK 64
+
+typedef struct {
+    time_t due_at;
+    int task_id;
+} Reminder;
+
+typedef struct {
+    Reminder* heap;
+    int count;
+    int capacity;
+    int failed;          // A push ran out of memory; rebuild from the list
+} ReminderQueue;
+
+void reminders_init(ReminderQueue* queue);
+void reminders_free(ReminderQueue* queue);
+
+// Refills the heap with the uncompleted tasks due after now, in O(count).
+// Returns how many uncompleted tasks are already past due.
+int reminders_rebuild(ReminderQueue* queue, const Task* tasks, int count, time_t now);
+
+// Call before task_list_apply with the same deltas, like tag_index_apply:
+// rows whose due time moved, or that were uncompleted, are pushed again
+void reminders_apply(ReminderQueue* queue, const TaskList* list, const TaskDelta* deltas, int count,
+                     time_t now);
+
+// Pops everything due by now and returns the id of the first task that is
+// still due at that time, or 0. *more is set to how many others came due
+// with it. Costs one comparison when nothing is due.
+int reminders_pop_due(ReminderQueue* queue, const TaskList* list, time_t now, int* more);
+
+// Whether stale entries have piled up enough, or a push failed, that the
+// heap should be rebuilt from the task_count tasks in the list
+int reminders_stale(const ReminderQueue* queue, int task_count);
+
+#endif // REMINDERS_H
@@ -0,0 +1,81 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+
+// Session recording and deterministic replay. A recording is a compact
+// binary log of the input events the main loop acts on, grouped by frame.
+// Each frame carries its clock delta and how many database responses were
+// applied before its events, so a replay sees the same task list at every
+// event. The window's output size and scale are logged whenever the
+// layout is recomputed, so clicks are matched against the rects they hit
+// when recorded. A copy of the database taken when recording starts is
+// stored next to the log and replays run against a scratch copy of it.
+
+#define REPLAY_MAGIC "HRPL"
+#define REPLAY_VERSION 3
+
+typedef enum {
+    REPLAY_OFF,
+    REPLAY_RECORD,
+    REPLAY_PLAY
+} ReplayMode;
+
+typedef struct {
+    ReplayMode mode;
+    FILE* file;
+    Uint32 clock_ms;        // Virtual clock; the log's time during replay
+    int in_frame;           // Play: the current frame still has events
+    int quit;               // Play: the window was closed
+    Uint16 mouse_mod;       // Modifier keys held at the last mouse button event
+
+    // Record: the view last logged. Play: the view last read from the log.
+    int has_view;
+    int view_width;
+    int view_height;
+    float view_scale;
+    float view_pixel_ratio;
+
+    // Timings collected during replay
+    float* frame_ms;
+    int frame_count;
+    int frame_capacity;
+    float* db_ms;
+    int db_count;
+    int db_capacity;
+} Replay;
+
+int replay_record_open(Replay* replay, const char* path);
+int replay_play_open(Replay* replay, const char* path);
+void replay_close(Replay* replay);
+
+// Database copy stored alongside a recording
+void replay_db_path(const char* log_path, char* out, size_t out_size);
+
+// Starts a frame. Recording writes now_ms and db_responses; replay reads
+// them into now_ms and db_responses and returns 0 once the log has ended.
+int replay_begin_frame(Replay* replay, Uint32* now_ms, int* db_responses);
+
+// Replaces SDL_PollEvent. Recording logs the events the game handles;
+// replay returns the logged events for the current frame instead.
+int replay_poll_event(Replay* replay, SDL_Event* event);
+
+// Mouse button events carry no modifier state, so the keys held at the
+// last one are logged with it and read back from here
+SDL_Keymod replay_mouse_mod(const Replay* replay);
+
+// Recording logs the output size, UI scale and pixel ratio the layout was
+// just computed for, if they changed. Replay returns them as a window
+// size change event from replay_poll_event.
+void replay_note_view(Replay* replay, int width, int height, float scale, float pixel_ratio);
+
+// Replay: overwrites the arguments with the recorded view and returns 1,
+// or returns 0 if the log has not given one yet
+int replay_view(const Replay* replay, int* width, int* height, float* scale, float* pixel_ratio);
+
+void replay_note_frame(Replay* replay, double ms);
+void replay_note_db(Replay* replay, double ms);
+void replay_report(Replay* replay);
+
+#endif // REPLAY_H
@@ -0,0 +1,100 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <SDL2/SDL.h>
+#include "game.h"
+#include "sprites.h"
+#include "ui.h"
+
+// Retained-mode screens. Each GameState draws an ordered set of nodes, and
+// each node keeps a display list: the draw commands it produced the last
+// time it was built. A frame only replays the lists; a node is rebuilt
+// when it has been invalidated. Nodes are shared between states, so
+// switching screens reuses whatever was already built.
+
+#define SCENE_MAX_NODES 8
+
+typedef enum {
+    DRAW_COLOR,
+    DRAW_FILL_RECT,
+    DRAW_RECT,
+    DRAW_LINE,
+    DRAW_LINES,
+    DRAW_TEXT,
+    DRAW_LABEL,
+    DRAW_SPRITE
+} DrawOp;
+
+typedef struct {
+    DrawOp op;
+    SDL_Rect rect;      // LINE: x, y to w, h; TEXT: x, y
+    int data;           // COLOR: RGB; LINES: point count; SPRITE: SpriteType
+    size_t offset;      // TEXT/LABEL: into strings; LINES: into points
+} DrawCommand;
+
+typedef struct {
+    DrawCommand* commands;
+    int count;
+    int capacity;
+    char* strings;
+    size_t strings_used;
+    size_t strings_capacity;
+    SDL_Point* points;
+    size_t points_used;
+    size_t points_capacity;
+} DisplayList;
+
+// Recording. The calls mirror the SDL and UI calls they replay as; the
+// color set by display_list_color applies to the shapes after it.
+void display_list_clear(DisplayList* list);
+void display_list_free(DisplayList* list);
+void display_list_color(DisplayList* list, Uint8 r, Uint8 g, Uint8 b);
+void display_list_fill_rect(DisplayList* list, const SDL_Rect* rect);
+void display_list_rect(DisplayList* list, const SDL_Rect* rect);
+void display_list_line(DisplayList* list, int x1, int y1, int x2, int y2);
+void display_list_lines(DisplayList* list, const SDL_Point* points, int count);
+void display_list_text(DisplayList* list, const char* text, int x, int y);
+void display_list_label(DisplayList* list, const char* text, const SDL_Rect* rect);
+void display_list_sprite(DisplayList* list, SpriteType sprite, const SDL_Rect* rect);
+
+// Replays the list through the UI's renderer and text cache
+void display_list_draw(const DisplayList* list, UI* ui, SpriteManager* sprites);
+
+typedef void (*SceneBuildFn)(DisplayList* list, void* context);
+
+typedef struct {
+    DisplayList list;
+    SceneBuildFn build;
+    int dirty;
+    int layered;        // Replayed into a cached texture only when rebuilt
+    UILayer layer;
+    Uint64 key;
+} SceneNode;
+
+typedef struct {
+    SceneNode nodes[SCENE_MAX_NODES];
+    int order[GAME_STATE_EXIT][SCENE_MAX_NODES];
+    int order_count[GAME_STATE_EXIT];
+} SceneGraph;
+
+void scene_graph_init(SceneGraph* graph);
+void scene_graph_free(SceneGraph* graph);
+
+void scene_graph_add_node(SceneGraph* graph, int node, SceneBuildFn build, int layered);
+
+// Appends node to what state draws, above the nodes added before it
+void scene_graph_show(SceneGraph* graph, GameState state, int node);
+
+void scene_invalidate(SceneGraph* graph, int node);
+void scene_invalidate_all(SceneGraph* graph);
+
+// Invalidates node when key differs from the last key tracked for it;
+// for nodes whose inputs are cheap to summarize
+void scene_track(SceneGraph* graph, int node, Uint64 key);
+
+// Rebuilds the invalidated nodes state shows, then draws them all.
+// Returns the number of nodes rebuilt.
+int scene_render(SceneGraph* graph, GameState state, UI* ui, SpriteManager* sprites,
+                 int width, int height, void* context);
+
+#endif // SCENE_H
@@ -0,0 +1,13 @@
+#ifndef SERVICE_H
+#define SERVICE_H
+
+#include "config.h"
+
+#define SERVICE_DEFAULT_SOCKET "heroman.sock"
+
+// Headless task service. Owns the database and answers newline-delimited
+// JSON-RPC 2.0 requests (create, update, delete, list, complete) on a Unix
+// domain socket until interrupted. Returns the process exit code.
+int service_run(const Config* config, const char* socket_path);
+
+#endif // SERVICE_H
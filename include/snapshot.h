@@ -0,0 +1,29 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include <sqlite3.h>
+#include "game.h"
+
+#define SNAPSHOT_PATH "heroman.snap"
+#define SNAPSHOT_VERSION 4
+
+// A snapshot is the in-memory Task array written verbatim behind a small
+// header, so a warm start can map the file and use the array in place.
+// The header records the tasks revision it was taken at; a snapshot whose
+// revision no longer matches the database is rejected.
+typedef struct {
+    Task* tasks;
+    int count;
+    void* mapping;
+    size_t mapping_size;
+} TaskSnapshot;
+
+int snapshot_write(const char* path, const Task* tasks, int count, sqlite3_int64 revision);
+
+// Maps and validates a snapshot. Returns 0 and fills snapshot on success;
+// returns 1 if the file is missing, stale, truncated or corrupt.
+int snapshot_map(const char* path, sqlite3_int64 revision, TaskSnapshot* snapshot);
+void snapshot_unmap(TaskSnapshot* snapshot);
+
+#endif // SNAPSHOT_H
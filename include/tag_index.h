@@ -0,0 +1,77 @@
+#ifndef TAG_INDEX_H
+#define TAG_INDEX_H
+
+#include "bitmap.h"
+#include "game.h"
+#include "task_list.h"
+#include "task_events.h"
+
+// Which tasks carry each tag, as a compressed bitmap of task ids, plus
+// bitmaps of every task and of the completed ones. Kept current from the
+// same deltas as the task list, so a change costs a few bitmap updates
+// and a filter is a handful of container-wise ANDs and ORs, however many
+// tasks there are.
+
+typedef struct {
+    Tag tag;             // Name empty until the tag names are loaded
+    Bitmap tasks;
+} TagEntry;
+
+typedef struct {
+    TagEntry* entries;   // By tag id
+    int count;
+    int capacity;
+    Bitmap all;
+    Bitmap completed;
+    int unnamed;         // Entries still waiting for their names
+    int failed;          // An update ran out of memory; rebuild from the list
+    Uint32 version;      // Bumped whenever a bitmap or a name changes
+} TagIndex;
+
+void tag_index_init(TagIndex* index);
+void tag_index_free(TagIndex* index);
+
+// Rebuilds every bitmap from tasks, after a full load
+void tag_index_rebuild(TagIndex* index, const Task* tasks, int count);
+
+// Call before task_list_apply with the same deltas: the rows being
+// replaced are still in list, and their old tags come out of the bitmaps
+void tag_index_apply(TagIndex* index, const TaskList* list, const TaskDelta* deltas, int count);
+
+// Fills in the names of known tags and adds the others, with empty bitmaps
+void tag_index_set_names(TagIndex* index, const Tag* tags, int count);
+
+// The entry for tag_id, or NULL
+const TagEntry* tag_index_find(const TagIndex* index, int tag_id);
+
+// How each tag takes part in a query
+typedef enum {
+    TAG_MATCH_OFF,
+    TAG_MATCH_ALL,       // Tasks must have it
+    TAG_MATCH_ANY,       // Tasks must have at least one of these
+    TAG_MATCH_NONE,      // Tasks must not have it
+    TAG_MATCH_COUNT
+} TagMatch;
+
+#define TAG_QUERY_MAX 16
+
+typedef struct {
+    int tag_ids[TAG_QUERY_MAX];
+    TagMatch matches[TAG_QUERY_MAX];
+    int count;
+    TaskFilter completion;
+} TagQuery;
+
+TagMatch tag_query_match(const TagQuery* query, int tag_id);
+
+// Steps a tag through off, all, any and none. Returns 1 if the query is
+// full and the tag could not be added.
+int tag_query_cycle(TagQuery* query, int tag_id);
+
+// Whether the query leaves anything out at all
+int tag_query_active(const TagQuery* query);
+
+// The ids of the tasks that match query. Returns 1 if memory ran out.
+int tag_index_query(const TagIndex* index, const TagQuery* query, Bitmap* out);
+
+#endif // TAG_INDEX_H
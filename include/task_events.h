@@ -0,0 +1,50 @@
+#ifndef TASK_EVENTS_H
+#define TASK_EVENTS_H
+
+#include <sqlite3.h>
+#include "game.h"
+
+// Change data capture for the tasks table. SQLite's update hook reports
+// every row the connection inserts, updates or deletes, including rows
+// changed by triggers; once the transaction commits, the captured rowids
+// become typed deltas carrying the rows as committed. In-memory views
+// apply the deltas instead of reloading or patching by hand.
+
+typedef enum {
+    TASK_DELTA_INSERT,
+    TASK_DELTA_UPDATE,
+    TASK_DELTA_DELETE
+} TaskDeltaType;
+
+typedef struct {
+    TaskDeltaType type;
+    Task task;           // The committed row; only id is set for DELETE
+} TaskDelta;
+
+typedef struct {
+    int op;              // SQLITE_INSERT, SQLITE_UPDATE or SQLITE_DELETE
+    int seq;             // Order captured, to coalesce repeated changes
+    sqlite3_int64 rowid;
+} TaskChange;
+
+typedef struct {
+    TaskChange* changes;
+    int count;
+    int capacity;
+    int overflow;        // Changes were lost to a failed allocation
+} TaskEventCapture;
+
+// Installs the update and rollback hooks on db. A rollback drops whatever
+// was captured since the last collect.
+void task_events_attach(TaskEventCapture* capture, sqlite3* db);
+void task_events_detach(TaskEventCapture* capture, sqlite3* db);
+
+// Call after COMMIT. Coalesces the captured changes, one delta per row,
+// and reads back the rows that still exist. Returns 1 if changes were
+// lost, in which case views should reload.
+int task_events_collect(TaskEventCapture* capture, sqlite3* db, TaskDelta** deltas, int* count);
+
+// Deltas for what changed after tasks_revision since, from any connection
+int task_events_since(sqlite3* db, sqlite3_int64 since, TaskDelta** deltas, int* count);
+
+#endif // TASK_EVENTS_H
@@ -0,0 +1,73 @@
+#ifndef TASK_LIST_H
+#define TASK_LIST_H
+
+#include "game.h"
+#include "snapshot.h"
+#include "task_events.h"
+
+// The tasks on screen, in the database's manual order (position, then id),
+// kept current by applying change deltas. A table from id to index makes
+// lookups O(1), so edits that keep a row in place cost O(1); inserts and
+// moves find their place by binary search. The manual order keeps each
+// subtree together, after its root, so a task's subtasks are the next
+// task->subtasks rows.
+
+// Larger delta batches are applied in place and re-sorted once
+#define TASK_LIST_RESORT_BATCH 32
+
+typedef struct {
+    Task* tasks;
+    int count;
+    int capacity;
+    TaskSnapshot snapshot;  // Set while tasks point into a mapped snapshot
+    int* slots;             // Index in tasks by task id, -1 if absent
+    int slot_capacity;
+    int completed;          // Completed tasks in the list
+    Uint8* selected;        // Multi-selection flags by task id, like slots
+    int selected_count;
+    Uint32 version;         // Bumped whenever the rows or the selection change
+} TaskList;
+
+void task_list_init(TaskList* list);
+void task_list_free(TaskList* list);
+
+// Takes over a LOAD result: a heap array, or the tasks of a mapped snapshot
+int task_list_replace(TaskList* list, Task* tasks, int count, const TaskSnapshot* snapshot);
+
+// Index of the task with task_id, or -1
+int task_list_find(const TaskList* list, int task_id);
+
+// Returns the number of rows changed, or -1 if the list could not grow
+int task_list_apply(TaskList* list, const TaskDelta* deltas, int count);
+
+// Where the task at from, with its subtasks, lands when dropped on the
+// row at index to: before it when moving up, after its subtasks when
+// moving down, and in either case under the same parent. Returns 1 if the
+// neighbours are too close and a rebalance is due, -1 if to is inside the
+// subtree being moved.
+int task_list_move_position(const TaskList* list, int from, int to, int* parent_id, double* position);
+
+// Index of the next row shown after index, skipping the subtasks of a
+// collapsed task, or list->count at the end
+int task_list_next_visible(const TaskList* list, int index);
+
+// Levels of parents above the task at index
+int task_list_depth(const TaskList* list, int index);
+
+// Multi-selection, by task id. Deleted rows leave the selection; a full
+// replace clears it.
+void task_list_select(TaskList* list, int task_id, int selected);
+int task_list_is_selected(const TaskList* list, int task_id);
+
+// Selects the rows between indices from and to, inclusive
+void task_list_select_range(TaskList* list, int from, int to);
+void task_list_clear_selection(TaskList* list);
+
+// Index of the first selected row in list order, or -1
+int task_list_first_selected(const TaskList* list);
+
+// Writes the selected ids, in list order, to ids, which must have room
+// for selected_count. Returns the number written.
+int task_list_selected_ids(const TaskList* list, int* ids);
+
+#endif // TASK_LIST_H
@@ -2,10 +2,39 @@
 #define TASKS_H
 
 #include "game.h"
+#include "json.h"
 
 void task_init(Task* task, const char* title, const char* description, int difficulty, int type);
 void task_complete(Task* task);
 void task_reset(Task* task);
 int task_get_reward(const Task* task);
 
+// Manual ordering uses fractional positions: a task moved between two
+// neighbours takes the midpoint of theirs, so a move rewrites one row.
+// Repeated moves into the same gap halve it each time; once it drops
+// below TASK_POSITION_MIN_GAP the positions should be renumbered.
+#define TASK_POSITION_MIN_GAP 1e-6
+
+// Either neighbour may be NULL at the ends of the list. Returns 1 if the
+// gap has become too small and a rebalance is due.
+int task_position_between(const Task* before, const Task* after, double* position);
+
+// Due dates as the task dialog shows them, "YYYY-MM-DD HH:MM" in local
+// time. A date alone is due at TASK_DUE_DEFAULT_HOUR and empty text is no
+// due date; parsing returns 1 for anything else.
+#define TASK_DUE_DEFAULT_HOUR 9
+int task_parse_due(const char* text, time_t* due_at);
+
+// Writes "" for a task without a due date
+void task_format_due(time_t due_at, char* out, size_t size);
+
+// Splits the dialog's comma-separated tag list into trimmed names,
+// skipping blanks. Returns the count, or -1 for more than TASK_MAX_TAGS
+// names or a name of TAG_NAME_MAX bytes or more; neither is cut to fit.
+int task_parse_tags(const char* text, char names[][TAG_NAME_MAX]);
+
+// JSON mapping shared by the service and the import/export tool
+int task_apply_json(Task* task, const JsonField* fields, int count);
+int task_append_json(JsonBuffer* out, const Task* task);
+
 #endif // TASKS_H 
\ No newline at end of file
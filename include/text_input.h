@@ -0,0 +1,54 @@
+#ifndef TEXT_INPUT_H
+#define TEXT_INPUT_H
+
+#include <SDL2/SDL.h>
+#include "font.h"
+
+#define TEXT_INPUT_CAPACITY 512
+
+// Single-line editor backed by a gap buffer. The caret always sits at the
+// start of the gap, so typing and deleting at the caret never move the rest
+// of the text. Glyph advances are kept in a second gap buffer aligned with
+// the text, which lets the caret's pixel offset be updated incrementally
+// instead of re-measuring the prefix every frame.
+typedef struct {
+    Font* font;
+    int max_bytes;                     // Content limit, excluding terminator
+
+    char buf[TEXT_INPUT_CAPACITY];     // Text bytes around the gap
+    int gap_start;
+    int gap_end;
+
+    int adv[TEXT_INPUT_CAPACITY];      // Per-glyph advances around the gap
+    int adv_gap_start;
+    int adv_gap_end;
+
+    int caret_x;                       // Sum of advances before the caret
+    int width;                         // Sum of all advances
+
+    char text[TEXT_INPUT_CAPACITY];    // Contiguous copy for rendering
+    int text_dirty;
+} TextInput;
+
+void text_input_init(TextInput* input, Font* font, int max_bytes);
+void text_input_set(TextInput* input, const char* text);
+
+// Re-measures the text with a new font, keeping the caret in place
+void text_input_set_font(TextInput* input, Font* font);
+const char* text_input_get(TextInput* input);
+int text_input_length(const TextInput* input);
+int text_input_caret_x(const TextInput* input);
+
+int text_input_insert(TextInput* input, const char* utf8);
+void text_input_backspace(TextInput* input);
+void text_input_delete(TextInput* input);
+void text_input_move_left(TextInput* input);
+void text_input_move_right(TextInput* input);
+void text_input_move_home(TextInput* input);
+void text_input_move_end(TextInput* input);
+
+// Applies an editing key (arrows, Home/End, Backspace/Delete).
+// Returns 1 if the key was consumed.
+int text_input_handle_key(TextInput* input, SDL_Keycode key);
+
+#endif // TEXT_INPUT_H
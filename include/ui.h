@@ -2,17 +2,63 @@
 #define UI_H
 
 #include <SDL2/SDL.h>
-#include <SDL2/SDL_ttf.h>
+#include "font.h"
+
+// Rendered strings are kept as textures in a small set-associative cache so
+// text that is drawn every frame is rasterized once, not once per frame
+#define UI_TEXT_CACHE_SETS 64
+#define UI_TEXT_CACHE_WAYS 4
+#define UI_TEXT_CACHE_KEY 320
+
+typedef struct {
+    char text[UI_TEXT_CACHE_KEY];
+    Uint32 hash;
+    SDL_Texture* texture;
+    int width;
+    int height;
+    Uint32 last_used;
+} UITextCacheEntry;
 
 typedef struct {
     SDL_Renderer* renderer;
-    TTF_Font* font;
+    Font* font;
     SDL_Color text_color;
+    Uint32 frame;
+    int text_cache_ways;    // Ways in use, at most UI_TEXT_CACHE_WAYS
+    UITextCacheEntry text_cache[UI_TEXT_CACHE_SETS][UI_TEXT_CACHE_WAYS];
 } UI;
 
-void ui_init(UI* ui, SDL_Renderer* renderer, TTF_Font* font);
+// Content that rarely changes, rendered once into a target texture and
+// then composited with a single copy per frame
+typedef struct {
+    SDL_Texture* texture;
+    int width;
+    int height;
+    int dirty;
+    int direct;     // Render targets unavailable; drawn every frame
+} UILayer;
+
+void ui_init(UI* ui, SDL_Renderer* renderer, Font* font);
+void ui_cleanup(UI* ui);
+
+// Switches fonts (e.g. after a DPI change), dropping cached text
+void ui_set_font(UI* ui, Font* font);
+
+// Shrinks or grows the text cache budget, freeing entries that no longer fit
+void ui_set_text_cache_ways(UI* ui, int ways);
+void ui_begin_frame(UI* ui);
 void ui_draw_text(UI* ui, const char* text, int x, int y);
 void ui_draw_button(UI* ui, const char* text, int x, int y, int width, int height);
+void ui_draw_label(UI* ui, const char* text, const SDL_Rect* rect);
 int ui_is_button_clicked(UI* ui, int x, int y, int width, int height, int mouse_x, int mouse_y);
 
-#endif // UI_H 
\ No newline at end of file
+// Returns 1 if the layer's contents must be drawn now; drawing then goes
+// into the layer until ui_layer_end. Without render target support the
+// layer is drawn straight to the screen every frame.
+int ui_layer_begin(UI* ui, UILayer* layer, int width, int height);
+void ui_layer_end(UI* ui, UILayer* layer);
+void ui_layer_draw(UI* ui, UILayer* layer, int x, int y);
+void ui_layer_invalidate(UILayer* layer);
+void ui_layer_destroy(UILayer* layer);
+
+#endif // UI_H
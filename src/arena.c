@@ -0,0 +1,100 @@
+#include "arena.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ARENA_ALIGN 16
+
+static ArenaBlock* arena_new_block(size_t size) {
+    ArenaBlock* block = malloc(sizeof(ArenaBlock) + size);
+    if (!block) return NULL;
+
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+static unsigned char* arena_block_data(ArenaBlock* block) {
+    return (unsigned char*)(block + 1);
+}
+
+int arena_init(Arena* arena, size_t size) {
+    arena->head = arena_new_block(size);
+    arena->peak = 0;
+    arena->frame_used = 0;
+    return arena->head ? 0 : 1;
+}
+
+void arena_free(Arena* arena) {
+    ArenaBlock* block = arena->head;
+    while (block) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    ArenaBlock* block = arena->head;
+    if (!block || block->used + size > block->size) {
+        size_t new_size = block ? block->size * 2 : 4096;
+        while (new_size < size) {
+            new_size *= 2;
+        }
+        ArenaBlock* next = arena_new_block(new_size);
+        if (!next) return NULL;
+        next->next = block;
+        arena->head = next;
+        block = next;
+    }
+
+    void* ptr = arena_block_data(block) + block->used;
+    block->used += size;
+    arena->frame_used += size;
+    return ptr;
+}
+
+char* arena_printf(Arena* arena, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int needed = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+    if (needed < 0) return NULL;
+
+    char* out = arena_alloc(arena, (size_t)needed + 1);
+    if (!out) return NULL;
+
+    va_start(args, fmt);
+    vsnprintf(out, (size_t)needed + 1, fmt, args);
+    va_end(args);
+    return out;
+}
+
+void arena_reset(Arena* arena) {
+    if (arena->frame_used > arena->peak) {
+        arena->peak = arena->frame_used;
+    }
+    arena->frame_used = 0;
+
+    ArenaBlock* block = arena->head;
+    if (!block) return;
+
+    // The frame overflowed: replace the chain with one block that fits it
+    if (block->next) {
+        size_t total = 0;
+        for (ArenaBlock* b = block; b; b = b->next) {
+            total += b->size;
+        }
+        ArenaBlock* merged = arena_new_block(total);
+        if (merged) {
+            arena_free(arena);
+            arena->head = merged;
+            return;
+        }
+    }
+    block->used = 0;
+}
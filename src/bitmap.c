@@ -0,0 +1,421 @@
+#include "bitmap.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BITSET_WORDS (65536 / 64)
+
+static int popcount(Uint64 x) {
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((x * 0x0101010101010101ULL) >> 56);
+}
+
+static void container_free(BitmapContainer* c) {
+    free(c->values);
+    free(c->bits);
+    c->values = NULL;
+    c->bits = NULL;
+}
+
+static int bitset_count(const Uint64* bits) {
+    int count = 0;
+    for (int i = 0; i < BITSET_WORDS; i++) {
+        count += popcount(bits[i]);
+    }
+    return count;
+}
+
+// Index of low in an array container, or where it would be inserted
+static int array_find(const BitmapContainer* c, Uint16 low, int* found) {
+    int lo = 0;
+    int hi = c->cardinality;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (c->values[mid] < low) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    *found = lo < c->cardinality && c->values[lo] == low;
+    return lo;
+}
+
+static int array_reserve(BitmapContainer* c, int needed) {
+    if (needed <= c->capacity) return 0;
+
+    int capacity = c->capacity ? c->capacity : 4;
+    while (capacity < needed) capacity *= 2;
+    Uint16* values = realloc(c->values, capacity * sizeof(Uint16));
+    if (!values) return 1;
+    c->values = values;
+    c->capacity = capacity;
+    return 0;
+}
+
+static int to_bitset(BitmapContainer* c) {
+    Uint64* bits = calloc(BITSET_WORDS, sizeof(Uint64));
+    if (!bits) return 1;
+    for (int i = 0; i < c->cardinality; i++) {
+        bits[c->values[i] >> 6] |= 1ULL << (c->values[i] & 63);
+    }
+    free(c->values);
+    c->values = NULL;
+    c->capacity = 0;
+    c->bits = bits;
+    return 0;
+}
+
+// A bitset that has thinned out goes back to an array. If that fails it
+// simply stays a bitset, which is still correct.
+static void shrink_bitset(BitmapContainer* c) {
+    if (!c->bits || c->cardinality > BITMAP_ARRAY_MAX) return;
+
+    int capacity = c->cardinality > 0 ? c->cardinality : 1;
+    Uint16* values = malloc(capacity * sizeof(Uint16));
+    if (!values) return;
+    int n = 0;
+    for (int w = 0; w < BITSET_WORDS; w++) {
+        for (Uint64 word = c->bits[w]; word; word &= word - 1) {
+            values[n++] = (Uint16)(w * 64 + popcount((word & (0 - word)) - 1));
+        }
+    }
+    free(c->bits);
+    c->bits = NULL;
+    c->values = values;
+    c->capacity = capacity;
+}
+
+static int container_copy(BitmapContainer* out, const BitmapContainer* from) {
+    *out = *from;
+    out->values = NULL;
+    out->bits = NULL;
+    if (from->bits) {
+        out->bits = malloc(BITSET_WORDS * sizeof(Uint64));
+        if (!out->bits) return 1;
+        memcpy(out->bits, from->bits, BITSET_WORDS * sizeof(Uint64));
+        return 0;
+    }
+    out->capacity = 0;
+    if (array_reserve(out, from->cardinality > 0 ? from->cardinality : 1) != 0) return 1;
+    memcpy(out->values, from->values, from->cardinality * sizeof(Uint16));
+    return 0;
+}
+
+// Index of the container for key, or -1 with *at set to where it belongs
+static int find_container(const Bitmap* bitmap, Uint16 key, int* at) {
+    int lo = 0;
+    int hi = bitmap->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (bitmap->containers[mid].key < key) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    if (at) *at = lo;
+    return lo < bitmap->count && bitmap->containers[lo].key == key ? lo : -1;
+}
+
+static void remove_container(Bitmap* bitmap, int index) {
+    container_free(&bitmap->containers[index]);
+    memmove(&bitmap->containers[index], &bitmap->containers[index + 1],
+            (bitmap->count - index - 1) * sizeof(BitmapContainer));
+    bitmap->count--;
+}
+
+void bitmap_init(Bitmap* bitmap) {
+    memset(bitmap, 0, sizeof(Bitmap));
+}
+
+void bitmap_clear(Bitmap* bitmap) {
+    for (int i = 0; i < bitmap->count; i++) {
+        container_free(&bitmap->containers[i]);
+    }
+    bitmap->count = 0;
+}
+
+void bitmap_free(Bitmap* bitmap) {
+    bitmap_clear(bitmap);
+    free(bitmap->containers);
+    memset(bitmap, 0, sizeof(Bitmap));
+}
+
+int bitmap_add(Bitmap* bitmap, Uint32 value) {
+    Uint16 key = (Uint16)(value >> 16);
+    Uint16 low = (Uint16)(value & 0xFFFF);
+
+    int at;
+    int index = find_container(bitmap, key, &at);
+    if (index < 0) {
+        if (bitmap->count == bitmap->capacity) {
+            int capacity = bitmap->capacity ? bitmap->capacity * 2 : 4;
+            BitmapContainer* grown = realloc(bitmap->containers, capacity * sizeof(BitmapContainer));
+            if (!grown) return 1;
+            bitmap->containers = grown;
+            bitmap->capacity = capacity;
+        }
+        BitmapContainer c = {key, 0, 0, NULL, NULL};
+        if (array_reserve(&c, 1) != 0) return 1;
+        memmove(&bitmap->containers[at + 1], &bitmap->containers[at],
+                (bitmap->count - at) * sizeof(BitmapContainer));
+        bitmap->containers[at] = c;
+        bitmap->count++;
+        index = at;
+    }
+
+    BitmapContainer* c = &bitmap->containers[index];
+    if (!c->bits) {
+        int found;
+        int pos = array_find(c, low, &found);
+        if (found) return 0;
+        if (c->cardinality < BITMAP_ARRAY_MAX) {
+            if (array_reserve(c, c->cardinality + 1) != 0) return 1;
+            memmove(&c->values[pos + 1], &c->values[pos], (c->cardinality - pos) * sizeof(Uint16));
+            c->values[pos] = low;
+            c->cardinality++;
+            return 0;
+        }
+        if (to_bitset(c) != 0) return 1;
+    }
+
+    Uint64 mask = 1ULL << (low & 63);
+    if (!(c->bits[low >> 6] & mask)) {
+        c->bits[low >> 6] |= mask;
+        c->cardinality++;
+    }
+    return 0;
+}
+
+void bitmap_remove(Bitmap* bitmap, Uint32 value) {
+    int index = find_container(bitmap, (Uint16)(value >> 16), NULL);
+    if (index < 0) return;
+
+    BitmapContainer* c = &bitmap->containers[index];
+    Uint16 low = (Uint16)(value & 0xFFFF);
+    if (c->bits) {
+        Uint64 mask = 1ULL << (low & 63);
+        if (!(c->bits[low >> 6] & mask)) return;
+        c->bits[low >> 6] &= ~mask;
+        c->cardinality--;
+        shrink_bitset(c);
+    }
+    else {
+        int found;
+        int pos = array_find(c, low, &found);
+        if (!found) return;
+        memmove(&c->values[pos], &c->values[pos + 1], (c->cardinality - pos - 1) * sizeof(Uint16));
+        c->cardinality--;
+    }
+    if (c->cardinality == 0) {
+        remove_container(bitmap, index);
+    }
+}
+
+int bitmap_contains(const Bitmap* bitmap, Uint32 value) {
+    int index = find_container(bitmap, (Uint16)(value >> 16), NULL);
+    if (index < 0) return 0;
+
+    const BitmapContainer* c = &bitmap->containers[index];
+    Uint16 low = (Uint16)(value & 0xFFFF);
+    if (c->bits) {
+        return (c->bits[low >> 6] >> (low & 63)) & 1;
+    }
+    int found;
+    array_find(c, low, &found);
+    return found;
+}
+
+int bitmap_cardinality(const Bitmap* bitmap) {
+    int count = 0;
+    for (int i = 0; i < bitmap->count; i++) {
+        count += bitmap->containers[i].cardinality;
+    }
+    return count;
+}
+
+int bitmap_copy(Bitmap* bitmap, const Bitmap* from) {
+    bitmap_clear(bitmap);
+    if (from->count > bitmap->capacity) {
+        BitmapContainer* grown = realloc(bitmap->containers, from->count * sizeof(BitmapContainer));
+        if (!grown) return 1;
+        bitmap->containers = grown;
+        bitmap->capacity = from->count;
+    }
+    for (int i = 0; i < from->count; i++) {
+        if (container_copy(&bitmap->containers[i], &from->containers[i]) != 0) {
+            container_free(&bitmap->containers[i]);
+            bitmap_clear(bitmap);
+            return 1;
+        }
+        bitmap->count++;
+    }
+    return 0;
+}
+
+// Keeps the values of c that are (keep = 1) or are not (keep = 0) in other
+static void container_filter(BitmapContainer* c, const BitmapContainer* other, int keep) {
+    if (c->bits) {
+        if (other->bits) {
+            for (int w = 0; w < BITSET_WORDS; w++) {
+                c->bits[w] &= keep ? other->bits[w] : ~other->bits[w];
+            }
+        }
+        else if (keep) {
+            // Only the array's values can survive; build the mask one
+            // word at a time from them
+            int i = 0;
+            for (int w = 0; w < BITSET_WORDS; w++) {
+                Uint64 mask = 0;
+                for (; i < other->cardinality && other->values[i] >> 6 == w; i++) {
+                    mask |= 1ULL << (other->values[i] & 63);
+                }
+                c->bits[w] &= mask;
+            }
+        }
+        else {
+            for (int i = 0; i < other->cardinality; i++) {
+                c->bits[other->values[i] >> 6] &= ~(1ULL << (other->values[i] & 63));
+            }
+        }
+        c->cardinality = bitset_count(c->bits);
+        shrink_bitset(c);
+        return;
+    }
+
+    int kept = 0;
+    int j = 0;
+    for (int i = 0; i < c->cardinality; i++) {
+        Uint16 low = c->values[i];
+        int present;
+        if (other->bits) {
+            present = (other->bits[low >> 6] >> (low & 63)) & 1;
+        }
+        else {
+            // Both sorted: a merge walk
+            while (j < other->cardinality && other->values[j] < low) j++;
+            present = j < other->cardinality && other->values[j] == low;
+        }
+        if (present == keep) {
+            c->values[kept++] = low;
+        }
+    }
+    c->cardinality = kept;
+}
+
+static void filter_containers(Bitmap* bitmap, const Bitmap* other, int keep) {
+    int kept = 0;
+    int j = 0;
+    for (int i = 0; i < bitmap->count; i++) {
+        BitmapContainer* c = &bitmap->containers[i];
+        while (j < other->count && other->containers[j].key < c->key) j++;
+        if (j < other->count && other->containers[j].key == c->key) {
+            container_filter(c, &other->containers[j], keep);
+        }
+        else if (keep) {
+            c->cardinality = 0;
+        }
+
+        if (c->cardinality == 0) {
+            container_free(c);
+        }
+        else {
+            bitmap->containers[kept++] = *c;
+        }
+    }
+    bitmap->count = kept;
+}
+
+void bitmap_and(Bitmap* bitmap, const Bitmap* other) {
+    filter_containers(bitmap, other, 1);
+}
+
+void bitmap_andnot(Bitmap* bitmap, const Bitmap* other) {
+    filter_containers(bitmap, other, 0);
+}
+
+static int container_or(BitmapContainer* c, const BitmapContainer* other) {
+    if (!c->bits && !other->bits && c->cardinality + other->cardinality <= BITMAP_ARRAY_MAX) {
+        // Merge from the back, so the array can be extended in place
+        if (array_reserve(c, c->cardinality + other->cardinality) != 0) return 1;
+        int i = c->cardinality - 1;
+        int j = other->cardinality - 1;
+        int out = c->cardinality + other->cardinality - 1;
+        while (j >= 0) {
+            if (i >= 0 && c->values[i] > other->values[j]) {
+                c->values[out--] = c->values[i--];
+            }
+            else {
+                if (i >= 0 && c->values[i] == other->values[j]) i--;
+                c->values[out--] = other->values[j--];
+            }
+        }
+        // What is left of c is already in order; duplicates leave a gap
+        // in front of the merged values, which closes up
+        if (out != i) {
+            memmove(&c->values[out - i], c->values, (i + 1) * sizeof(Uint16));
+        }
+        out -= i + 1;
+        int start = out + 1;
+        c->cardinality = c->cardinality + other->cardinality - start;
+        memmove(c->values, &c->values[start], c->cardinality * sizeof(Uint16));
+        return 0;
+    }
+
+    if (!c->bits && to_bitset(c) != 0) return 1;
+    if (other->bits) {
+        for (int w = 0; w < BITSET_WORDS; w++) {
+            c->bits[w] |= other->bits[w];
+        }
+    }
+    else {
+        for (int i = 0; i < other->cardinality; i++) {
+            c->bits[other->values[i] >> 6] |= 1ULL << (other->values[i] & 63);
+        }
+    }
+    c->cardinality = bitset_count(c->bits);
+    return 0;
+}
+
+int bitmap_or(Bitmap* bitmap, const Bitmap* other) {
+    int capacity = bitmap->count + other->count;
+    if (capacity == 0) return 0;
+    BitmapContainer* merged = malloc(capacity * sizeof(BitmapContainer));
+    if (!merged) return 1;
+
+    int rc = 0;
+    int count = 0;
+    int i = 0;
+    int j = 0;
+    while (i < bitmap->count || j < other->count) {
+        if (j == other->count ||
+            (i < bitmap->count && bitmap->containers[i].key < other->containers[j].key)) {
+            merged[count++] = bitmap->containers[i++];
+        }
+        else if (i == bitmap->count || other->containers[j].key < bitmap->containers[i].key) {
+            if (container_copy(&merged[count], &other->containers[j]) != 0) {
+                container_free(&merged[count]);
+                rc = 1;
+            }
+            else {
+                count++;
+            }
+            j++;
+        }
+        else {
+            rc |= container_or(&bitmap->containers[i], &other->containers[j]);
+            merged[count++] = bitmap->containers[i++];
+            j++;
+        }
+    }
+
+    free(bitmap->containers);
+    bitmap->containers = merged;
+    bitmap->count = count;
+    bitmap->capacity = capacity;
+    return rc;
+}
@@ -0,0 +1,234 @@
+#include "config.h"
+#include <ctype.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+typedef enum {
+    SETTING_INT,
+    SETTING_STRING
+} SettingType;
+
+typedef struct {
+    const char* section;
+    const char* key;
+    const char* env;
+    SettingType type;
+    size_t offset;
+    size_t size;                  // Buffer size of string settings
+    int min;                      // Range of int settings
+    int max;
+    const char* const* choices;   // Allowed string values, NULL-terminated
+    int reloadable;               // Safe to change while running
+} Setting;
+
+// Strings that end up inside PRAGMA statements are limited to these
+static const char* const synchronous_modes[] = {"OFF", "NORMAL", "FULL", "EXTRA", NULL};
+static const char* const journal_modes[] = {"DELETE", "TRUNCATE", "PERSIST", "MEMORY", "WAL", "OFF", NULL};
+
+#define INT_SETTING(section, key, env, field, min, max, reloadable) \
+    {section, key, env, SETTING_INT, offsetof(Config, field), 0, min, max, NULL, reloadable}
+#define STRING_SETTING(section, key, env, field, choices, reloadable) \
+    {section, key, env, SETTING_STRING, offsetof(Config, field), sizeof(((Config*)0)->field), 0, 0, choices, reloadable}
+
+static const Setting settings[] = {
+    STRING_SETTING("database", "path", "HEROMAN_DB_PATH", db_path, NULL, 0),
+    INT_SETTING("database", "cache_size", "HEROMAN_DB_CACHE_SIZE", cache_size, -1048576, 1048576, 0),
+    INT_SETTING("database", "mmap_mb", "HEROMAN_DB_MMAP_MB", mmap_mb, 0, 4096, 0),
+    STRING_SETTING("database", "synchronous", "HEROMAN_DB_SYNCHRONOUS", synchronous, synchronous_modes, 0),
+    STRING_SETTING("database", "journal_mode", "HEROMAN_DB_JOURNAL_MODE", journal_mode, journal_modes, 0),
+    INT_SETTING("database", "busy_timeout_ms", "HEROMAN_DB_BUSY_TIMEOUT_MS", busy_timeout_ms, 0, 600000, 0),
+    INT_SETTING("database", "sync_poll_ms", "HEROMAN_DB_SYNC_POLL_MS", sync_poll_ms, 0, 3600000, 1),
+
+    INT_SETTING("render", "font_size", "HEROMAN_FONT_SIZE", font_size, 6, 72, 1),
+    INT_SETTING("render", "fps", "HEROMAN_FPS", fps, -1, 1000, 1),
+    INT_SETTING("render", "idle_fps", "HEROMAN_IDLE_FPS", idle_fps, 0, 1000, 1),
+    INT_SETTING("render", "vsync", "HEROMAN_VSYNC", vsync, 0, 1, 0),
+    INT_SETTING("render", "frame_stats", "HEROMAN_FRAME_STATS", frame_stats, 0, 1, 1),
+
+    INT_SETTING("cache", "text_cache_ways", "HEROMAN_TEXT_CACHE_WAYS", text_cache_ways, 1, 4, 1),
+    INT_SETTING("cache", "frame_arena_kb", "HEROMAN_FRAME_ARENA_KB", frame_arena_kb, 1, 65536, 0),
+
+    STRING_SETTING("metrics", "path", "HEROMAN_METRICS_PATH", metrics_path, NULL, 0),
+    STRING_SETTING("metrics", "socket", "HEROMAN_METRICS_SOCKET", metrics_socket, NULL, 0),
+    INT_SETTING("metrics", "interval_ms", "HEROMAN_METRICS_INTERVAL_MS", metrics_interval_ms, 100, 3600000, 0),
+};
+
+#define SETTING_COUNT (sizeof(settings) / sizeof(settings[0]))
+
+const char* config_default_path(void) {
+    const char* path = getenv("HEROMAN_CONFIG");
+    return path && *path ? path : CONFIG_DEFAULT_PATH;
+}
+
+void config_defaults(Config* config) {
+    memset(config, 0, sizeof(Config));
+    snprintf(config->db_path, sizeof(config->db_path), "heroman.db");
+    config->cache_size = -2000;
+    config->mmap_mb = 0;
+    snprintf(config->synchronous, sizeof(config->synchronous), "FULL");
+    snprintf(config->journal_mode, sizeof(config->journal_mode), "WAL");
+    config->busy_timeout_ms = 5000;
+    config->sync_poll_ms = 250;
+    config->font_size = 16;
+    config->fps = -1;
+    config->idle_fps = 10;
+    config->vsync = 0;
+    config->frame_stats = 0;
+    config->text_cache_ways = 4;
+    config->frame_arena_kb = 16;
+    config->metrics_interval_ms = 10000;
+}
+
+static const Setting* find_setting(const char* section, const char* key) {
+    for (size_t i = 0; i < SETTING_COUNT; i++) {
+        if (strcmp(settings[i].section, section) == 0 && strcmp(settings[i].key, key) == 0) {
+            return &settings[i];
+        }
+    }
+    return NULL;
+}
+
+static int equals_ignore_case(const char* a, const char* b) {
+    while (*a && toupper((unsigned char)*a) == toupper((unsigned char)*b)) {
+        a++;
+        b++;
+    }
+    return toupper((unsigned char)*a) == toupper((unsigned char)*b);
+}
+
+// Stores value into the setting's field. Returns 0 if it was valid.
+static int set_value(Config* config, const Setting* setting, const char* value) {
+    char* field = (char*)config + setting->offset;
+
+    if (setting->type == SETTING_INT) {
+        char* end;
+        long number = strtol(value, &end, 10);
+        if (end == value || *end != '\0' || number < setting->min || number > setting->max) {
+            return 1;
+        }
+        *(int*)field = (int)number;
+        return 0;
+    }
+
+    if (strlen(value) >= setting->size) return 1;
+    if (setting->choices) {
+        const char* const* choice = setting->choices;
+        while (*choice && !equals_ignore_case(*choice, value)) choice++;
+        if (!*choice) return 1;
+        value = *choice;
+    }
+    memcpy(field, value, strlen(value) + 1);
+    return 0;
+}
+
+static char* trim(char* text) {
+    while (isspace((unsigned char)*text)) text++;
+    char* end = text + strlen(text);
+    while (end > text && isspace((unsigned char)end[-1])) end--;
+    *end = '\0';
+    return text;
+}
+
+static void load_file(Config* config, FILE* file, const char* path) {
+    char line[512];
+    char section[32] = "";
+    int number = 0;
+
+    while (fgets(line, sizeof(line), file)) {
+        number++;
+        char* text = trim(line);
+        if (*text == '\0' || *text == ';' || *text == '#') continue;
+
+        if (*text == '[') {
+            char* close = strchr(text, ']');
+            if (!close) {
+                fprintf(stderr, "%s:%d: unterminated section\n", path, number);
+                continue;
+            }
+            *close = '\0';
+            snprintf(section, sizeof(section), "%s", trim(text + 1));
+            continue;
+        }
+
+        char* equals = strchr(text, '=');
+        if (!equals) {
+            fprintf(stderr, "%s:%d: expected key = value\n", path, number);
+            continue;
+        }
+        *equals = '\0';
+        char* key = trim(text);
+        char* value = trim(equals + 1);
+
+        const Setting* setting = find_setting(section, key);
+        if (!setting) {
+            fprintf(stderr, "%s:%d: unknown setting [%s] %s\n", path, number, section, key);
+        }
+        else if (set_value(config, setting, value) != 0) {
+            fprintf(stderr, "%s:%d: invalid value for %s: %s\n", path, number, key, value);
+        }
+    }
+}
+
+static void load_environment(Config* config) {
+    for (size_t i = 0; i < SETTING_COUNT; i++) {
+        const char* value = getenv(settings[i].env);
+        if (value && *value && set_value(config, &settings[i], value) != 0) {
+            fprintf(stderr, "Ignoring invalid %s: %s\n", settings[i].env, value);
+        }
+    }
+}
+
+int config_load(Config* config, const char* path) {
+    config_defaults(config);
+    snprintf(config->path, sizeof(config->path), "%s", path);
+
+    struct stat info;
+    if (stat(path, &info) == 0) {
+        config->mtime = info.st_mtime;
+    }
+
+    FILE* file = fopen(path, "r");
+    if (file) {
+        load_file(config, file, path);
+        fclose(file);
+    }
+
+    load_environment(config);
+    return 0;
+}
+
+int config_reload(Config* config) {
+    struct stat info;
+    if (stat(config->path, &info) != 0 || info.st_mtime == config->mtime) {
+        return 0;
+    }
+
+    Config fresh;
+    config_load(&fresh, config->path);
+    config->mtime = fresh.mtime;
+
+    int changed = 0;
+    for (size_t i = 0; i < SETTING_COUNT; i++) {
+        const Setting* setting = &settings[i];
+        size_t size = setting->type == SETTING_INT ? sizeof(int) : setting->size;
+        char* current = (char*)config + setting->offset;
+        const char* updated = (const char*)&fresh + setting->offset;
+        if (setting->type == SETTING_INT ? memcmp(current, updated, size) == 0 :
+                                           strcmp(current, updated) == 0) {
+            continue;
+        }
+
+        if (setting->reloadable) {
+            memcpy(current, updated, size);
+            changed = 1;
+        }
+        else {
+            fprintf(stderr, "%s: [%s] %s takes effect after a restart\n",
+                    config->path, setting->section, setting->key);
+        }
+    }
+    return changed;
+}
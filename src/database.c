@@ -1,10 +1,24 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <sqlite3.h>
 #include "database.h"
 #include "game.h"
 #include "tasks.h"
+#include "migrations.h"
+
+// Columns read_task_row expects. The tag ids come from the task_tags
+// primary key, one index range per row.
+#define DB_TASK_COLUMNS \
+    "id, title, description, difficulty, type, completed, streak, last_completed, position, " \
+    "parent_id, subtasks, subtasks_completed, collapsed, " \
+    "(SELECT group_concat(tag_id) FROM (SELECT tag_id FROM task_tags WHERE task_id = tasks.id ORDER BY tag_id)), " \
+    "due_at"
+
+// One past the end of the manual order
+#define DB_NEXT_POSITION_SQL \
+    "(max((SELECT coalesce(max(position), 0) FROM tasks), (SELECT coalesce(max(id), 0) FROM tasks)) + 1)"
 
 int db_init(const char* filename, sqlite3** db) {
     if (sqlite3_open(filename, db) != SQLITE_OK) {
@@ -12,26 +26,29 @@ int db_init(const char* filename, sqlite3** db) {
         return 1;
     }
 
-    // Create tasks table if it doesn't exist
-    const char* create_table_sql = 
-        "CREATE TABLE IF NOT EXISTS tasks ("
-        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "title TEXT NOT NULL,"
-        "description TEXT,"
-        "difficulty INTEGER NOT NULL,"
-        "type INTEGER NOT NULL,"
-        "completed INTEGER DEFAULT 0,"
-        "created_at DATETIME DEFAULT CURRENT_TIMESTAMP"
-        ");";
+    return 0;
+}
+
+int db_configure(sqlite3* db, const Config* config) {
+    // Set first: switching to WAL needs a moment of exclusive access
+    sqlite3_busy_timeout(db, config->busy_timeout_ms);
+
+    // The string settings were checked against a fixed list when loaded
+    char sql[256];
+    snprintf(sql, sizeof(sql),
+             "PRAGMA journal_mode = %s;"
+             "PRAGMA synchronous = %s;"
+             "PRAGMA cache_size = %d;"
+             "PRAGMA mmap_size = %lld;",
+             config->journal_mode, config->synchronous, config->cache_size,
+             (long long)config->mmap_mb * 1024 * 1024);
 
     char* err_msg = NULL;
-    if (sqlite3_exec(*db, create_table_sql, 0, 0, &err_msg) != SQLITE_OK) {
+    if (sqlite3_exec(db, sql, 0, 0, &err_msg) != SQLITE_OK) {
         fprintf(stderr, "SQL error: %s\n", err_msg);
         sqlite3_free(err_msg);
-        sqlite3_close(*db);
         return 1;
     }
-
     return 0;
 }
 
@@ -41,39 +58,32 @@ void db_close(sqlite3* db) {
     }
 }
 
-int db_create_schema(sqlite3* db) {
-    const char* sql = 
-        "CREATE TABLE IF NOT EXISTS player ("
-        "health INTEGER,"
-        "experience INTEGER,"
-        "level INTEGER,"
-        "gold INTEGER,"
-        "strength INTEGER,"
-        "intelligence INTEGER,"
-        "constitution INTEGER,"
-        "perception INTEGER"
-        ");"
-        "CREATE TABLE IF NOT EXISTS tasks ("
-        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "title TEXT NOT NULL,"
-        "description TEXT,"
-        "difficulty INTEGER,"
-        "type INTEGER,"
-        "completed INTEGER,"
-        "streak INTEGER,"
-        "last_completed INTEGER"
-        ");";
-
-    char* err_msg = 0;
-    int rc = sqlite3_exec(db, sql, 0, 0, &err_msg);
-    
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "SQL error: %s\n", err_msg);
-        sqlite3_free(err_msg);
+int db_backup(sqlite3* db, const char* filename) {
+    sqlite3* dest;
+    if (sqlite3_open(filename, &dest) != SQLITE_OK) {
+        fprintf(stderr, "Can't open database: %s\n", sqlite3_errmsg(dest));
+        sqlite3_close(dest);
         return 1;
     }
-    
-    return 0;
+
+    sqlite3_backup* backup = sqlite3_backup_init(dest, "main", db, "main");
+    int rc = SQLITE_ERROR;
+    if (backup) {
+        rc = sqlite3_backup_step(backup, -1);
+        sqlite3_backup_finish(backup);
+    }
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Failed to copy database: %s\n", sqlite3_errmsg(dest));
+    }
+
+    sqlite3_close(dest);
+    return rc == SQLITE_DONE ? 0 : 1;
+}
+
+// The schema itself lives in migrations.c; this brings the database up to
+// date and is nearly free when it already is
+int db_create_schema(sqlite3* db) {
+    return db_migrate(db);
 }
 
 int db_save_player(sqlite3* db, const PlayerStats* player) {
@@ -138,10 +148,100 @@ int db_load_player(sqlite3* db, PlayerStats* player) {
     return 0;
 }
 
+// Reads a row selected as DB_TASK_COLUMNS
+static void read_task_row(sqlite3_stmt* stmt, Task* task) {
+    const char* title = (const char*)sqlite3_column_text(stmt, 1);
+    const char* description = (const char*)sqlite3_column_text(stmt, 2);
+    task_init(task, title ? title : "", description,
+              sqlite3_column_int(stmt, 3), sqlite3_column_int(stmt, 4));
+    task->id = sqlite3_column_int(stmt, 0);
+    task->completed = sqlite3_column_int(stmt, 5);
+    task->streak = sqlite3_column_int(stmt, 6);
+    task->last_completed = (time_t)sqlite3_column_int64(stmt, 7);
+    task->position = sqlite3_column_double(stmt, 8);
+    task->parent_id = sqlite3_column_int(stmt, 9);
+    task->subtasks = sqlite3_column_int(stmt, 10);
+    task->subtasks_completed = sqlite3_column_int(stmt, 11);
+    task->collapsed = sqlite3_column_int(stmt, 12);
+
+    const char* tags = (const char*)sqlite3_column_text(stmt, 13);
+    while (tags && *tags && task->tag_count < TASK_MAX_TAGS) {
+        char* end;
+        task->tags[task->tag_count++] = (int)strtol(tags, &end, 10);
+        tags = *end == ',' ? end + 1 : NULL;
+    }
+    task->due_at = (time_t)sqlite3_column_int64(stmt, 14);
+}
+
+// Position for a new last child of parent_id, or for a new last task when
+// parent_id is 0: between the last row of the parent's subtree and the row
+// after it, leaving out the subtree of moving_id. Renumbers the positions
+// first if that gap has worn too thin.
+static int subtree_end_position(sqlite3* db, int parent_id, int moving_id, double* position) {
+    const char* last_sql = parent_id != 0 ?
+        "SELECT max(t.position) FROM task_tree c JOIN tasks t ON t.id = c.descendant "
+        "WHERE c.ancestor = ?1 AND c.descendant NOT IN (SELECT descendant FROM task_tree WHERE ancestor = ?2);" :
+        "SELECT coalesce(max(position), 0) FROM tasks "
+        "WHERE id NOT IN (SELECT descendant FROM task_tree WHERE ancestor = ?2);";
+    sqlite3_stmt* last;
+    sqlite3_stmt* next;
+    if (sqlite3_prepare_v2(db, last_sql, -1, &last, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+    if (sqlite3_prepare_v2(db, "SELECT min(position) FROM tasks WHERE position > ?1 "
+                           "AND id NOT IN (SELECT descendant FROM task_tree WHERE ancestor = ?2);",
+                           -1, &next, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        sqlite3_finalize(last);
+        return 1;
+    }
+
+    int rc = 1;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        sqlite3_bind_int(last, 1, parent_id);
+        sqlite3_bind_int(last, 2, moving_id);
+        if (sqlite3_step(last) != SQLITE_ROW || sqlite3_column_type(last, 0) == SQLITE_NULL) {
+            fprintf(stderr, "Parent task %d does not exist\n", parent_id);
+            break;
+        }
+        double before = sqlite3_column_double(last, 0);
+        sqlite3_reset(last);
+
+        sqlite3_bind_double(next, 1, before);
+        sqlite3_bind_int(next, 2, moving_id);
+        if (sqlite3_step(next) != SQLITE_ROW) break;
+        int at_end = sqlite3_column_type(next, 0) == SQLITE_NULL;
+        double after = sqlite3_column_double(next, 0);
+        sqlite3_reset(next);
+
+        if (at_end || after - before >= TASK_POSITION_MIN_GAP * 2) {
+            *position = at_end ? before + 1 : before + (after - before) / 2;
+            rc = 0;
+            break;
+        }
+        if (attempt > 0 || db_rebalance_task_positions(db) != 0) break;
+    }
+    sqlite3_finalize(last);
+    sqlite3_finalize(next);
+    return rc;
+}
+
 int db_create_task(sqlite3* db, const Task* task) {
-    const char* sql = "INSERT INTO tasks (title, description, difficulty, type) VALUES (?, ?, ?, ?);";
+    // Without a position the task goes to the end of the manual order, or
+    // a subtask to the end of its parent's subtree. Ids count too, for rows
+    // the position backfill has not reached yet.
+    const char* sql = "INSERT INTO tasks (title, description, difficulty, type, position, parent_id, due_at) "
+                      "VALUES (?, ?, ?, ?, CASE WHEN ?5 != 0 THEN ?5 ELSE " DB_NEXT_POSITION_SQL " END, ?6, "
+                      "nullif(?7, 0));";
     sqlite3_stmt* stmt;
-    
+
+    double position = task->position;
+    if (position == 0 && task->parent_id != 0 &&
+        subtree_end_position(db, task->parent_id, 0, &position) != 0) {
+        return 1;
+    }
+
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
         fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
         return 1;
@@ -151,6 +251,9 @@ int db_create_task(sqlite3* db, const Task* task) {
     sqlite3_bind_text(stmt, 2, task->description, -1, SQLITE_STATIC);
     sqlite3_bind_int(stmt, 3, task->difficulty);
     sqlite3_bind_int(stmt, 4, task->type);
+    sqlite3_bind_double(stmt, 5, position);
+    sqlite3_bind_int(stmt, 6, task->parent_id);
+    sqlite3_bind_int64(stmt, 7, (sqlite3_int64)task->due_at);
 
     if (sqlite3_step(stmt) != SQLITE_DONE) {
         fprintf(stderr, "Failed to execute statement: %s\n", sqlite3_errmsg(db));
@@ -163,8 +266,10 @@ int db_create_task(sqlite3* db, const Task* task) {
 }
 
 int db_update_task(sqlite3* db, const Task* task) {
+    // Placement is left to db_move_task, which keeps subtasks together
     const char* sql = "UPDATE tasks SET title = ?, description = ?, difficulty = ?, "
-                     "type = ?, completed = ? WHERE id = ?;";
+                     "type = ?, completed = ?, streak = ?, last_completed = ?, collapsed = ?, "
+                     "due_at = nullif(?9, 0) WHERE id = ?10;";
     sqlite3_stmt* stmt;
     
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
@@ -177,7 +282,11 @@ int db_update_task(sqlite3* db, const Task* task) {
     sqlite3_bind_int(stmt, 3, task->difficulty);
     sqlite3_bind_int(stmt, 4, task->type);
     sqlite3_bind_int(stmt, 5, task->completed);
-    sqlite3_bind_int(stmt, 6, task->id);
+    sqlite3_bind_int(stmt, 6, task->streak);
+    sqlite3_bind_int64(stmt, 7, (sqlite3_int64)task->last_completed);
+    sqlite3_bind_int(stmt, 8, task->collapsed != 0);
+    sqlite3_bind_int64(stmt, 9, (sqlite3_int64)task->due_at);
+    sqlite3_bind_int(stmt, 10, task->id);
 
     if (sqlite3_step(stmt) != SQLITE_DONE) {
         fprintf(stderr, "Failed to execute statement: %s\n", sqlite3_errmsg(db));
@@ -210,44 +319,883 @@ int db_delete_task(sqlite3* db, int task_id) {
     return 0;
 }
 
-int db_get_all_tasks(sqlite3* db, Task** tasks, int* count) {
-    const char* sql = "SELECT id, title, description, difficulty, type, completed FROM tasks;";
+// Ids of the subtasks of task_id at any depth, in manual order
+static int read_subtree(sqlite3* db, int task_id, int** ids, int* count) {
     sqlite3_stmt* stmt;
-    
+    if (sqlite3_prepare_v2(db, "SELECT c.descendant FROM task_tree c JOIN tasks t ON t.id = c.descendant "
+                           "WHERE c.ancestor = ?1 AND c.depth > 0 ORDER BY t.position, t.id;",
+                           -1, &stmt, NULL) != SQLITE_OK) {
+        return 1;
+    }
+    sqlite3_bind_int(stmt, 1, task_id);
+
+    int capacity = 0;
+    int rc;
+    *ids = NULL;
+    *count = 0;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            int* grown = realloc(*ids, capacity * sizeof(int));
+            if (!grown) {
+                rc = SQLITE_NOMEM;
+                break;
+            }
+            *ids = grown;
+        }
+        (*ids)[(*count)++] = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_DONE ? 0 : 1;
+}
+
+// Takes the row to its new parent, which the triggers refuse if it is
+// missing or inside the subtree, then to its position, and spreads its
+// subtasks, in their current order, across the gap up to the next row
+static int move_subtree(sqlite3* db, int task_id, int parent_id, double position) {
+    sqlite3_stmt* update;
+    if (sqlite3_prepare_v2(db, "UPDATE tasks SET parent_id = ?1 WHERE id = ?2;", -1, &update, NULL) != SQLITE_OK) {
+        return 1;
+    }
+    sqlite3_bind_int(update, 1, parent_id);
+    sqlite3_bind_int(update, 2, task_id);
+    int rc = sqlite3_step(update);
+    sqlite3_finalize(update);
+    if (rc != SQLITE_DONE) return 1;
+
+    if (position == 0 && subtree_end_position(db, parent_id, task_id, &position) != 0) return 1;
+
+    int* ids;
+    int count;
+    if (read_subtree(db, task_id, &ids, &count) != 0) return 1;
+
+    sqlite3_stmt* next;
+    double step = 1;
+    if (sqlite3_prepare_v2(db, "SELECT min(position) FROM tasks WHERE position > ?1 "
+                           "AND id NOT IN (SELECT descendant FROM task_tree WHERE ancestor = ?2);",
+                           -1, &next, NULL) != SQLITE_OK) {
+        free(ids);
+        return 1;
+    }
+    sqlite3_bind_double(next, 1, position);
+    sqlite3_bind_int(next, 2, task_id);
+    if (sqlite3_step(next) == SQLITE_ROW && sqlite3_column_type(next, 0) != SQLITE_NULL) {
+        step = (sqlite3_column_double(next, 0) - position) / (count + 1);
+    }
+    sqlite3_finalize(next);
+
+    if (sqlite3_prepare_v2(db, "UPDATE tasks SET position = ?1 WHERE id = ?2;", -1, &update, NULL) != SQLITE_OK) {
+        free(ids);
+        return 1;
+    }
+    rc = SQLITE_DONE;
+    for (int i = -1; i < count && rc == SQLITE_DONE; i++) {
+        sqlite3_bind_double(update, 1, position + step * (i + 1));
+        sqlite3_bind_int(update, 2, i < 0 ? task_id : ids[i]);
+        rc = sqlite3_step(update);
+        sqlite3_reset(update);
+    }
+    sqlite3_finalize(update);
+    free(ids);
+    return rc == SQLITE_DONE ? 0 : 1;
+}
+
+int db_move_task(sqlite3* db, int task_id, int parent_id, double position) {
+    if (sqlite3_exec(db, "SAVEPOINT move_task;", 0, 0, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to start task move: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+    if (move_subtree(db, task_id, parent_id, position) != 0) {
+        fprintf(stderr, "Failed to move task: %s\n", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK TO move_task; RELEASE move_task;", 0, 0, NULL);
+        return 1;
+    }
+    sqlite3_exec(db, "RELEASE move_task;", 0, 0, NULL);
+    return 0;
+}
+
+// Creates the missing tags and writes their ids to ids, without repeats.
+// Returns the number of ids, or -1.
+static int tag_ids(sqlite3* db, char names[][TAG_NAME_MAX], int count, int* ids) {
+    sqlite3_stmt* insert;
+    sqlite3_stmt* select;
+    if (sqlite3_prepare_v2(db, "INSERT OR IGNORE INTO tags (name) VALUES (?1);", -1, &insert, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+    if (sqlite3_prepare_v2(db, "SELECT id FROM tags WHERE name = ?1;", -1, &select, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        sqlite3_finalize(insert);
+        return -1;
+    }
+
+    int id_count = 0;
+    int rc = SQLITE_DONE;
+    for (int i = 0; i < count && rc == SQLITE_DONE; i++) {
+        sqlite3_bind_text(insert, 1, names[i], -1, SQLITE_STATIC);
+        rc = sqlite3_step(insert);
+        sqlite3_reset(insert);
+        if (rc != SQLITE_DONE) break;
+
+        sqlite3_bind_text(select, 1, names[i], -1, SQLITE_STATIC);
+        if (sqlite3_step(select) == SQLITE_ROW) {
+            int id = sqlite3_column_int(select, 0);
+            int seen = 0;
+            for (int j = 0; j < id_count; j++) {
+                seen |= ids[j] == id;
+            }
+            if (!seen) ids[id_count++] = id;
+        }
+        else {
+            rc = SQLITE_ERROR;
+        }
+        sqlite3_reset(select);
+    }
+    sqlite3_finalize(insert);
+    sqlite3_finalize(select);
+    return rc == SQLITE_DONE ? id_count : -1;
+}
+
+// Tags that stay are left alone, so saving the same tags again does not
+// touch the task
+static int write_task_tags(sqlite3* db, int task_id, char names[][TAG_NAME_MAX], int name_count) {
+    sqlite3_stmt* stmt;
+    int ids[TASK_MAX_TAGS];
+    int count = tag_ids(db, names, name_count, ids);
+    if (count < 0) return 1;
+
+    // Ids are plain integers, so they can go in the statement text
+    char sql[64 + TASK_MAX_TAGS * 12] = "DELETE FROM task_tags WHERE task_id = ?1";
+    for (int i = 0; i < count; i++) {
+        size_t used = strlen(sql);
+        snprintf(sql + used, sizeof(sql) - used, "%s%d", i == 0 ? " AND tag_id NOT IN (" : ",", ids[i]);
+    }
+    strcat(sql, count > 0 ? ");" : ";");
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
         fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
         return 1;
     }
+    sqlite3_bind_int(stmt, 1, task_id);
+    int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) return 1;
 
-    // Count tasks
-    int task_count = 0;
+    if (sqlite3_prepare_v2(db, "INSERT OR IGNORE INTO task_tags (task_id, tag_id) VALUES (?1, ?2);",
+                           -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+    for (int i = 0; i < count && rc == SQLITE_DONE; i++) {
+        sqlite3_bind_int(stmt, 1, task_id);
+        sqlite3_bind_int(stmt, 2, ids[i]);
+        rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_DONE ? 0 : 1;
+}
+
+int db_set_task_tags(sqlite3* db, int task_id, const char* names) {
+    char parsed[TASK_MAX_TAGS][TAG_NAME_MAX];
+    int count = task_parse_tags(names, parsed);
+    if (count < 0) {
+        fprintf(stderr, "Failed to tag task: too many tags or a name too long\n");
+        return 1;
+    }
+    if (sqlite3_exec(db, "SAVEPOINT set_tags;", 0, 0, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to start tagging: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+    if (write_task_tags(db, task_id, parsed, count) != 0) {
+        fprintf(stderr, "Failed to tag task: %s\n", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK TO set_tags; RELEASE set_tags;", 0, 0, NULL);
+        return 1;
+    }
+    sqlite3_exec(db, "RELEASE set_tags;", 0, 0, NULL);
+    return 0;
+}
+
+int db_get_tags(sqlite3* db, Tag** tags, int* count) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT id, name FROM tags ORDER BY id;", -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    int tag_count = 0;
     while (sqlite3_step(stmt) == SQLITE_ROW) {
-        task_count++;
+        tag_count++;
     }
     sqlite3_reset(stmt);
 
-    // Allocate memory for tasks
-    *tasks = malloc(task_count * sizeof(Task));
-    if (!*tasks) {
-        fprintf(stderr, "Failed to allocate memory for tasks\n");
+    *tags = calloc(tag_count > 0 ? tag_count : 1, sizeof(Tag));
+    if (!*tags) {
+        fprintf(stderr, "Failed to allocate memory for tags\n");
         sqlite3_finalize(stmt);
         return 1;
     }
 
-    // Read tasks
     int i = 0;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        Task* task = &(*tasks)[i];
-        task->id = sqlite3_column_int(stmt, 0);
-        strncpy(task->title, (const char*)sqlite3_column_text(stmt, 1), sizeof(task->title) - 1);
-        strncpy(task->description, (const char*)sqlite3_column_text(stmt, 2), sizeof(task->description) - 1);
-        task->difficulty = sqlite3_column_int(stmt, 3);
-        task->type = sqlite3_column_int(stmt, 4);
-        task->completed = sqlite3_column_int(stmt, 5);
+    while (i < tag_count && sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* name = (const char*)sqlite3_column_text(stmt, 1);
+        (*tags)[i].id = sqlite3_column_int(stmt, 0);
+        strncpy((*tags)[i].name, name ? name : "", TAG_NAME_MAX - 1);
         i++;
     }
 
+    *count = i;
+    sqlite3_finalize(stmt);
+    return 0;
+}
+
+int db_get_due_order(sqlite3* db, int** ids, int* count) {
+    // Served by tasks_by_due, which holds the rowid alongside due_at, so
+    // ties come out by id without a sort step
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT id FROM tasks WHERE due_at IS NOT NULL ORDER BY due_at, id;",
+                           -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    int capacity = 0;
+    int rc;
+    *ids = NULL;
+    *count = 0;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            int* grown = realloc(*ids, capacity * sizeof(int));
+            if (!grown) {
+                rc = SQLITE_NOMEM;
+                break;
+            }
+            *ids = grown;
+        }
+        (*ids)[(*count)++] = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Failed to read due dates: %s\n", sqlite3_errmsg(db));
+        free(*ids);
+        *ids = NULL;
+        *count = 0;
+        return 1;
+    }
+    return 0;
+}
+
+int db_get_all_tasks(sqlite3* db, Task** tasks, int* count) {
+    const char* sql = "SELECT " DB_TASK_COLUMNS " FROM tasks "
+                      "ORDER BY position, id;";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    // One pass with a growing array: another connection may commit at
+    // any point, so a separate count could be stale by the time rows are read
+    int capacity = 64;
+    int task_count = 0;
+    int rc;
+    *tasks = malloc(capacity * sizeof(Task));
+    if (!*tasks) {
+        fprintf(stderr, "Failed to allocate memory for tasks\n");
+        sqlite3_finalize(stmt);
+        return 1;
+    }
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (task_count == capacity) {
+            capacity *= 2;
+            Task* grown = realloc(*tasks, capacity * sizeof(Task));
+            if (!grown) {
+                rc = SQLITE_NOMEM;
+                break;
+            }
+            *tasks = grown;
+        }
+        memset(&(*tasks)[task_count], 0, sizeof(Task));
+        read_task_row(stmt, &(*tasks)[task_count++]);
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Failed to read tasks: %s\n", rc == SQLITE_NOMEM ? "out of memory" : sqlite3_errmsg(db));
+        free(*tasks);
+        *tasks = NULL;
+        return 1;
+    }
+
     *count = task_count;
+    return 0;
+}
+
+// ?1 is the action's value (the time, for completion), ?2 the task id.
+// Rows the action would not change are skipped.
+static const char* bulk_sql[] = {
+    [DB_BULK_COMPLETE] = "UPDATE tasks SET completed = 1, "
+                         "streak = CASE WHEN last_completed > 0 AND ?1 - last_completed <= 86400 "
+                         "THEN streak + 1 ELSE 1 END, "
+                         "last_completed = ?1 WHERE id = ?2 AND completed = 0;",
+    [DB_BULK_UNCOMPLETE] = "UPDATE tasks SET completed = 0 WHERE id = ?2 AND completed != 0;",
+    [DB_BULK_DELETE] = "DELETE FROM tasks WHERE id = ?2;",
+    [DB_BULK_SET_DIFFICULTY] = "UPDATE tasks SET difficulty = ?1 WHERE id = ?2 AND difficulty != ?1;",
+};
+
+int db_apply_bulk_action(sqlite3* db, DbBulkAction action, int value, const int* ids, int count) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, bulk_sql[action], -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+    if (sqlite3_exec(db, "SAVEPOINT bulk_action;", 0, 0, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to start bulk action: %s\n", sqlite3_errmsg(db));
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+
+    sqlite3_int64 bound = action == DB_BULK_COMPLETE ? (sqlite3_int64)time(NULL) : value;
+    int changed = 0;
+    int rc = SQLITE_DONE;
+    for (int i = 0; i < count && rc == SQLITE_DONE; i++) {
+        sqlite3_bind_int64(stmt, 1, bound);
+        sqlite3_bind_int(stmt, 2, ids[i]);
+        rc = sqlite3_step(stmt);
+        changed += rc == SQLITE_DONE ? sqlite3_changes(db) : 0;
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Failed to apply bulk action: %s\n", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK TO bulk_action; RELEASE bulk_action;", 0, 0, NULL);
+        return -1;
+    }
+    if (sqlite3_exec(db, "RELEASE bulk_action;", 0, 0, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to commit bulk action: %s\n", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK TO bulk_action; RELEASE bulk_action;", 0, 0, NULL);
+        return -1;
+    }
+    return changed;
+}
+
+static int renumber_positions(sqlite3* db) {
+    sqlite3_stmt* select;
+    sqlite3_stmt* update;
+    if (sqlite3_prepare_v2(db, "SELECT id FROM tasks ORDER BY position, id;", -1, &select, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+    if (sqlite3_prepare_v2(db, "UPDATE tasks SET position = ?1 WHERE id = ?2 AND position != ?1;",
+                           -1, &update, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        sqlite3_finalize(select);
+        return 1;
+    }
+
+    // Read the order first; updating positions while walking the index
+    // on position could visit a row twice
+    int capacity = 256;
+    int count = 0;
+    int* ids = malloc(capacity * sizeof(int));
+    int rc = ids ? SQLITE_ROW : SQLITE_NOMEM;
+    while (rc == SQLITE_ROW && (rc = sqlite3_step(select)) == SQLITE_ROW) {
+        if (count == capacity) {
+            int* grown = realloc(ids, capacity * 2 * sizeof(int));
+            if (!grown) {
+                rc = SQLITE_NOMEM;
+                break;
+            }
+            ids = grown;
+            capacity *= 2;
+        }
+        ids[count++] = sqlite3_column_int(select, 0);
+    }
+    sqlite3_finalize(select);
+
+    // Rows already at their new position are left untouched
+    for (int i = 0; i < count && rc == SQLITE_DONE; i++) {
+        sqlite3_bind_double(update, 1, i + 1);
+        sqlite3_bind_int(update, 2, ids[i]);
+        rc = sqlite3_step(update);
+        sqlite3_reset(update);
+    }
+    sqlite3_finalize(update);
+    free(ids);
+    return rc == SQLITE_DONE ? 0 : 1;
+}
+
+// A rebalance that stops partway would leave some rows renumbered and
+// the rest at their old positions, scrambling the order, so it is all or
+// nothing
+int db_rebalance_task_positions(sqlite3* db) {
+    if (sqlite3_exec(db, "SAVEPOINT rebalance;", 0, 0, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to start rebalance: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+    if (renumber_positions(db) != 0) {
+        fprintf(stderr, "Failed to rebalance task positions: %s\n", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK TO rebalance; RELEASE rebalance;", 0, 0, NULL);
+        return 1;
+    }
+    sqlite3_exec(db, "RELEASE rebalance;", 0, 0, NULL);
+    return 0;
+}
+
+static int read_daily_stats(sqlite3* db, TaskStats* stats) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT day, completions, experience FROM stats_daily "
+                           "WHERE day BETWEEN ?1 AND ?2;", -1, &stmt, NULL) != SQLITE_OK) {
+        return 1;
+    }
+    sqlite3_bind_text(stmt, 1, stats->days[0], -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, stats->days[DB_STATS_DAYS - 1], -1, SQLITE_STATIC);
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const char* day = (const char*)sqlite3_column_text(stmt, 0);
+        for (int i = 0; day && i < DB_STATS_DAYS; i++) {
+            if (strcmp(stats->days[i], day) == 0) {
+                stats->completions[i] = sqlite3_column_int(stmt, 1);
+                stats->experience[i] = sqlite3_column_int(stmt, 2);
+                break;
+            }
+        }
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) return 1;
+
+    if (sqlite3_prepare_v2(db, "SELECT coalesce(sum(experience), 0) FROM stats_daily WHERE day < ?1;",
+                           -1, &stmt, NULL) != SQLITE_OK) {
+        return 1;
+    }
+    sqlite3_bind_text(stmt, 1, stats->days[0], -1, SQLITE_STATIC);
+    rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        stats->experience_before = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_ROW ? 0 : 1;
+}
+
+static int read_breakdown_stats(sqlite3* db, TaskStats* stats) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT type, difficulty, tasks, completed FROM stats_breakdown;",
+                           -1, &stmt, NULL) != SQLITE_OK) {
+        return 1;
+    }
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        int type = sqlite3_column_int(stmt, 0);
+        int difficulty = sqlite3_column_int(stmt, 1);
+        if (type >= 0 && type < DB_STATS_TYPES && difficulty >= 0 && difficulty < DB_STATS_DIFFICULTIES) {
+            stats->tasks[type][difficulty] = sqlite3_column_int(stmt, 2);
+            stats->completed[type][difficulty] = sqlite3_column_int(stmt, 3);
+        }
+    }
     sqlite3_finalize(stmt);
+    return rc == SQLITE_DONE ? 0 : 1;
+}
+
+int db_get_stats(sqlite3* db, TaskStats* stats) {
+    memset(stats, 0, sizeof(TaskStats));
+
+    // Name the days in local time to match the keys the triggers write
+    time_t now = time(NULL);
+    for (int i = 0; i < DB_STATS_DAYS; i++) {
+        struct tm day = *localtime(&now);
+        day.tm_mday -= DB_STATS_DAYS - 1 - i;
+        day.tm_hour = 12;
+        day.tm_isdst = -1;
+        mktime(&day);
+        strftime(stats->days[i], sizeof(stats->days[i]), "%Y-%m-%d", &day);
+    }
+
+    if (read_daily_stats(db, stats) != 0 || read_breakdown_stats(db, stats) != 0) {
+        fprintf(stderr, "Failed to read statistics: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
     return 0;
-} 
\ No newline at end of file
+}
+
+int db_get_tasks_revision(sqlite3* db, sqlite3_int64* revision) {
+    const char* sql = "SELECT value FROM meta WHERE key = 'tasks_revision';";
+    sqlite3_stmt* stmt;
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+        sqlite3_finalize(stmt);
+        return 1;
+    }
+
+    *revision = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    return 0;
+}
+
+int db_get_task_by_id(sqlite3* db, int task_id, Task* task) {
+    const char* sql = "SELECT " DB_TASK_COLUMNS " FROM tasks "
+                      "WHERE id = ?;";
+    sqlite3_stmt* stmt;
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    sqlite3_bind_int(stmt, 1, task_id);
+
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+        sqlite3_finalize(stmt);
+        return 1;
+    }
+
+    read_task_row(stmt, task);
+    sqlite3_finalize(stmt);
+    return 0;
+}
+
+int db_get_tasks_by_id(sqlite3* db, const int* ids, int count, Task* tasks) {
+    const char* sql = "SELECT " DB_TASK_COLUMNS " FROM tasks "
+                      "WHERE id = ?;";
+    sqlite3_stmt* stmt;
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    int rc = SQLITE_DONE;
+    for (int i = 0; i < count; i++) {
+        sqlite3_bind_int(stmt, 1, ids[i]);
+        rc = sqlite3_step(stmt);
+        if (rc == SQLITE_ROW) {
+            read_task_row(stmt, &tasks[i]);
+            rc = SQLITE_DONE;
+        }
+        else {
+            tasks[i].id = 0;
+        }
+        sqlite3_reset(stmt);
+        if (rc != SQLITE_DONE) break;
+    }
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Failed to read tasks: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+    return 0;
+}
+
+int db_get_data_version(sqlite3* db, int* version) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "PRAGMA data_version;", -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        *version = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_ROW ? 0 : 1;
+}
+
+int db_get_task_changes(sqlite3* db, sqlite3_int64 since, Task** tasks, int* count,
+                        int** deleted, int* deleted_count) {
+    *tasks = NULL;
+    *deleted = NULL;
+    *count = 0;
+    *deleted_count = 0;
+
+    sqlite3_stmt* changed;
+    sqlite3_stmt* removed;
+    if (sqlite3_prepare_v2(db, "SELECT " DB_TASK_COLUMNS " FROM tasks WHERE revision > ?1;",
+                           -1, &changed, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+    if (sqlite3_prepare_v2(db, "SELECT id FROM tasks_deleted WHERE revision > ?1;",
+                           -1, &removed, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        sqlite3_finalize(changed);
+        return 1;
+    }
+    sqlite3_bind_int64(changed, 1, since);
+    sqlite3_bind_int64(removed, 1, since);
+
+    int capacity = 0;
+    int rc;
+    while ((rc = sqlite3_step(changed)) == SQLITE_ROW) {
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            Task* grown = realloc(*tasks, capacity * sizeof(Task));
+            if (!grown) {
+                rc = SQLITE_NOMEM;
+                break;
+            }
+            *tasks = grown;
+        }
+        read_task_row(changed, &(*tasks)[(*count)++]);
+    }
+
+    if (rc == SQLITE_DONE) {
+        capacity = 0;
+        while ((rc = sqlite3_step(removed)) == SQLITE_ROW) {
+            if (*deleted_count == capacity) {
+                capacity = capacity ? capacity * 2 : 16;
+                int* grown = realloc(*deleted, capacity * sizeof(int));
+                if (!grown) {
+                    rc = SQLITE_NOMEM;
+                    break;
+                }
+                *deleted = grown;
+            }
+            (*deleted)[(*deleted_count)++] = sqlite3_column_int(removed, 0);
+        }
+    }
+    sqlite3_finalize(changed);
+    sqlite3_finalize(removed);
+
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Failed to read task changes: %s\n", sqlite3_errmsg(db));
+        free(*tasks);
+        free(*deleted);
+        *tasks = NULL;
+        *deleted = NULL;
+        *count = 0;
+        *deleted_count = 0;
+        return 1;
+    }
+    return 0;
+}
+
+static int db_exec(sqlite3* db, const char* sql) {
+    char* err_msg = NULL;
+    if (sqlite3_exec(db, sql, 0, 0, &err_msg) != SQLITE_OK) {
+        fprintf(stderr, "SQL error: %s\n", err_msg);
+        sqlite3_free(err_msg);
+        return 1;
+    }
+    return 0;
+}
+
+int db_bulk_begin(sqlite3* db, DbBulkInsert* bulk, int chunk_size) {
+    const char* prefix = "INSERT INTO tasks (title, description, difficulty, type, completed, position) VALUES ";
+    char sql[1024];
+
+    memset(bulk, 0, sizeof(DbBulkInsert));
+    bulk->db = db;
+    bulk->chunk_size = chunk_size > 0 ? chunk_size : 50000;
+
+    int len = snprintf(sql, sizeof(sql), "%s", prefix);
+    for (int i = 0; i < DB_BULK_ROWS; i++) {
+        len += snprintf(sql + len, sizeof(sql) - len, i == 0 ? "(?, ?, ?, ?, ?, ?)" : ", (?, ?, ?, ?, ?, ?)");
+    }
+
+    if (sqlite3_prepare_v2(db, sql, -1, &bulk->insert, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(db, "INSERT INTO tasks (title, description, difficulty, type, completed, position) "
+                               "VALUES (?, ?, ?, ?, ?, ?);", -1, &bulk->insert_one, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        sqlite3_finalize(bulk->insert);
+        bulk->insert = NULL;
+        return 1;
+    }
+    if (db_exec(db, "BEGIN;") != 0) {
+        sqlite3_finalize(bulk->insert);
+        sqlite3_finalize(bulk->insert_one);
+        bulk->insert = NULL;
+        bulk->insert_one = NULL;
+        return 1;
+    }
+
+    // Imported tasks are appended to the manual order
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT " DB_NEXT_POSITION_SQL ";", -1, &stmt, NULL) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        bulk->next_position = sqlite3_column_double(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return 0;
+}
+
+static void db_bind_task_values(sqlite3_stmt* stmt, int base, const Task* task) {
+    sqlite3_bind_text(stmt, base + 1, task->title, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, base + 2, task->description, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, base + 3, task->difficulty);
+    sqlite3_bind_int(stmt, base + 4, task->type);
+    sqlite3_bind_int(stmt, base + 5, task->completed);
+    sqlite3_bind_double(stmt, base + 6, task->position);
+}
+
+// Records the ids of the rows stepped in. AUTOINCREMENT hands out
+// consecutive ids inside a write transaction, so a chunk is one range
+// unless another writer committed between chunks.
+static int db_bulk_track(DbBulkInsert* bulk, int rows) {
+    sqlite3_int64 last = sqlite3_last_insert_rowid(bulk->db);
+    sqlite3_int64 first = last - rows + 1;
+    if (bulk->range_count > bulk->ranges_committed &&
+        bulk->ranges[bulk->range_count - 1].last + 1 == first) {
+        bulk->ranges[bulk->range_count - 1].last = last;
+        return 0;
+    }
+    if (bulk->range_count == bulk->range_capacity) {
+        int capacity = bulk->range_capacity ? bulk->range_capacity * 2 : 16;
+        DbBulkRange* grown = realloc(bulk->ranges, capacity * sizeof(DbBulkRange));
+        if (!grown) {
+            fprintf(stderr, "Failed to allocate memory for bulk import\n");
+            return 1;
+        }
+        bulk->ranges = grown;
+        bulk->range_capacity = capacity;
+    }
+    bulk->ranges[bulk->range_count++] = (DbBulkRange){first, last};
+    return 0;
+}
+
+static int db_bulk_step(DbBulkInsert* bulk, sqlite3_stmt* stmt, int rows) {
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Failed to execute statement: %s\n", sqlite3_errmsg(bulk->db));
+        return 1;
+    }
+    return db_bulk_track(bulk, rows);
+}
+
+static int db_bulk_commit(DbBulkInsert* bulk) {
+    if (db_exec(bulk->db, "COMMIT;") != 0) {
+        return 1;
+    }
+    bulk->ranges_committed = bulk->range_count;
+    return 0;
+}
+
+static void db_bulk_finish(DbBulkInsert* bulk) {
+    sqlite3_finalize(bulk->insert);
+    sqlite3_finalize(bulk->insert_one);
+    free(bulk->ranges);
+    bulk->insert = NULL;
+    bulk->insert_one = NULL;
+    bulk->ranges = NULL;
+    bulk->range_count = 0;
+    bulk->range_capacity = 0;
+    bulk->ranges_committed = 0;
+}
+
+int db_bulk_insert(DbBulkInsert* bulk, const Task* task) {
+    bulk->rows[bulk->rows_staged] = *task;
+    bulk->rows[bulk->rows_staged++].position = bulk->next_position++;
+    if (bulk->rows_staged < DB_BULK_ROWS) {
+        return 0;
+    }
+
+    for (int i = 0; i < DB_BULK_ROWS; i++) {
+        db_bind_task_values(bulk->insert, i * 6, &bulk->rows[i]);
+    }
+    bulk->rows_staged = 0;
+    if (db_bulk_step(bulk, bulk->insert, DB_BULK_ROWS) != 0) {
+        return 1;
+    }
+    bulk->total += DB_BULK_ROWS;
+    bulk->pending += DB_BULK_ROWS;
+
+    if (bulk->pending >= bulk->chunk_size) {
+        if (db_bulk_commit(bulk) != 0 || db_exec(bulk->db, "BEGIN;") != 0) {
+            return 1;
+        }
+        bulk->pending = 0;
+    }
+    return 0;
+}
+
+int db_bulk_end(DbBulkInsert* bulk) {
+    int rc = 0;
+
+    // Rows left over from the last partial batch go in one at a time
+    for (int i = 0; i < bulk->rows_staged && rc == 0; i++) {
+        db_bind_task_values(bulk->insert_one, 0, &bulk->rows[i]);
+        rc = db_bulk_step(bulk, bulk->insert_one, 1);
+        if (rc == 0) {
+            bulk->total++;
+        }
+    }
+    bulk->rows_staged = 0;
+
+    if (rc != 0 || db_bulk_commit(bulk) != 0) {
+        return 1;
+    }
+    db_bulk_finish(bulk);
+    return 0;
+}
+
+int db_bulk_abort(DbBulkInsert* bulk) {
+    int rc = 0;
+    bulk->rows_staged = 0;
+    if (!sqlite3_get_autocommit(bulk->db)) {
+        db_exec(bulk->db, "ROLLBACK;");
+    }
+
+    // Earlier chunks are already committed, so their rows are deleted in
+    // one transaction of their own
+    if (bulk->ranges_committed > 0) {
+        sqlite3_stmt* stmt = NULL;
+        rc = db_exec(bulk->db, "BEGIN;");
+        if (rc == 0 && sqlite3_prepare_v2(bulk->db, "DELETE FROM tasks WHERE id BETWEEN ? AND ?;", -1,
+                                          &stmt, NULL) != SQLITE_OK) {
+            fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(bulk->db));
+            rc = 1;
+        }
+        for (int i = 0; i < bulk->ranges_committed && rc == 0; i++) {
+            sqlite3_bind_int64(stmt, 1, bulk->ranges[i].first);
+            sqlite3_bind_int64(stmt, 2, bulk->ranges[i].last);
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                fprintf(stderr, "Failed to execute statement: %s\n", sqlite3_errmsg(bulk->db));
+                rc = 1;
+            }
+            sqlite3_reset(stmt);
+        }
+        sqlite3_finalize(stmt);
+        if (rc == 0) {
+            rc = db_exec(bulk->db, "COMMIT;");
+        }
+        if (rc != 0 && !sqlite3_get_autocommit(bulk->db)) {
+            db_exec(bulk->db, "ROLLBACK;");
+        }
+    }
+
+    bulk->total = 0;
+    db_bulk_finish(bulk);
+    return rc;
+}
+
+int db_for_each_task(sqlite3* db, DbTaskCallback callback, void* user_data) {
+    const char* sql = "SELECT " DB_TASK_COLUMNS " FROM tasks "
+                      "ORDER BY id;";
+    sqlite3_stmt* stmt;
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    Task task;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        read_task_row(stmt, &task);
+        if (callback(&task, user_data) != 0) {
+            break;
+        }
+    }
+
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_ROW || rc == SQLITE_DONE ? 0 : 1;
+}
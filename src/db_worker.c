@@ -0,0 +1,428 @@
+#include "db_worker.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "database.h"
+#include "migrations.h"
+#include "metrics.h"
+
+#define CACHE_LINE 64
+
+// Ring buffer with one writer and one reader. Each index is only ever
+// stored by its owning side, so acquire/release ordering is enough. The
+// indices are padded apart so the two threads do not share a cache line.
+typedef struct {
+    atomic_size_t head;   // Next slot to read (consumer)
+    char pad_head[CACHE_LINE - sizeof(atomic_size_t)];
+    atomic_size_t tail;   // Next slot to write (producer)
+    char pad_tail[CACHE_LINE - sizeof(atomic_size_t)];
+    DbMessage slots[DB_WORKER_QUEUE_SIZE];
+} DbQueue;
+
+struct DbWorker {
+    sqlite3* db;
+    const char* snapshot_path;
+    SDL_Thread* thread;
+    SDL_sem* wakeup;
+    atomic_int stopping;
+    atomic_int finished;
+    Uint32 next_id;
+    DbQueue requests;
+    DbQueue responses;
+    TaskEventCapture capture;
+    DbMessage batch[DB_WORKER_QUEUE_SIZE];  // Responses held until the batch commits
+    int batch_count;
+};
+
+static void queue_init(DbQueue* queue) {
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+}
+
+static size_t queue_free(DbQueue* queue) {
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    return DB_WORKER_QUEUE_SIZE - (tail - head);
+}
+
+static int queue_push(DbQueue* queue, const DbMessage* message) {
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (tail - head == DB_WORKER_QUEUE_SIZE) return 1;
+
+    queue->slots[tail & (DB_WORKER_QUEUE_SIZE - 1)] = *message;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return 0;
+}
+
+static int queue_pop(DbQueue* queue, DbMessage* message) {
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    if (head == tail) return 0;
+
+    *message = queue->slots[head & (DB_WORKER_QUEUE_SIZE - 1)];
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return 1;
+}
+
+// Runs inside a transaction like SYNC, so the versions and the rows come
+// from the same view of the database
+static void handle_load(DbWorker* worker, DbMessage* message) {
+    sqlite3_int64 revision;
+    int have_revision = db_get_data_version(worker->db, &message->data_version) == 0 &&
+                        db_get_tasks_revision(worker->db, &revision) == 0;
+    message->revision = have_revision ? revision : 0;
+
+    if (worker->snapshot_path && have_revision &&
+        snapshot_map(worker->snapshot_path, revision, &message->snapshot) == 0) {
+        message->tasks = message->snapshot.tasks;
+        message->count = message->snapshot.count;
+        message->status = 0;
+        return;
+    }
+
+    message->status = db_get_all_tasks(worker->db, &message->tasks, &message->count);
+}
+
+// Runs inside the worker's transaction, so the revision and the changes
+// come from the same view of the database
+static void handle_sync(DbWorker* worker, DbMessage* message) {
+    int version;
+    message->status = db_get_data_version(worker->db, &version);
+    if (message->status != 0 || version == message->data_version) return;
+
+    sqlite3_int64 revision;
+    message->status = db_get_tasks_revision(worker->db, &revision) != 0 ||
+                      task_events_since(worker->db, message->revision, &message->deltas, &message->count) != 0;
+    if (message->status == 0) {
+        message->revision = revision;
+        message->data_version = version;
+    }
+}
+
+static const MetricHistogram op_metrics[] = {
+    [DB_OP_LOAD]      = METRIC_DB_LOAD,
+    [DB_OP_CREATE]    = METRIC_DB_CREATE,
+    [DB_OP_UPDATE]    = METRIC_DB_UPDATE,
+    [DB_OP_DELETE]    = METRIC_DB_DELETE,
+    [DB_OP_BACKFILL]  = METRIC_DB_BACKFILL,
+    [DB_OP_REBALANCE] = METRIC_DB_REBALANCE,
+    [DB_OP_STATS]     = METRIC_DB_STATS,
+    [DB_OP_SYNC]      = METRIC_DB_SYNC,
+    [DB_OP_BULK]      = METRIC_DB_BULK,
+    [DB_OP_MOVE]      = METRIC_DB_MOVE,
+    [DB_OP_TAGS]      = METRIC_DB_TAGS,
+    [DB_OP_DUE]       = METRIC_DB_DUE,
+};
+
+// The row and its tags share a savepoint, so a task whose tags are
+// refused is not saved either
+static void handle_save(DbWorker* worker, DbMessage* message) {
+    if (sqlite3_exec(worker->db, "SAVEPOINT save_task;", 0, 0, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to save task: %s\n", sqlite3_errmsg(worker->db));
+        message->status = 1;
+        return;
+    }
+
+    int creating = message->op == DB_OP_CREATE;
+    message->status = creating ? db_create_task(worker->db, &message->task) :
+                                 db_update_task(worker->db, &message->task);
+    if (message->status == 0 && creating) {
+        message->task.id = (int)sqlite3_last_insert_rowid(worker->db);
+    }
+    if (message->status == 0 && message->tag_names) {
+        message->status = db_set_task_tags(worker->db, message->task.id, message->tag_names);
+    }
+    if (message->status != 0) {
+        sqlite3_exec(worker->db, "ROLLBACK TO save_task; RELEASE save_task;", 0, 0, NULL);
+        return;
+    }
+    sqlite3_exec(worker->db, "RELEASE save_task;", 0, 0, NULL);
+
+    // Read back the position the database assigned
+    if (creating) {
+        db_get_task_by_id(worker->db, message->task.id, &message->task);
+    }
+}
+
+static void handle_request(DbWorker* worker, DbMessage* message) {
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    switch (message->op) {
+        case DB_OP_LOAD:
+            handle_load(worker, message);
+            break;
+        case DB_OP_CREATE:
+        case DB_OP_UPDATE:
+            handle_save(worker, message);
+            break;
+        case DB_OP_DELETE:
+            message->status = db_delete_task(worker->db, message->task.id);
+            break;
+        case DB_OP_BACKFILL: {
+            int rc = db_backfill_step(worker->db, DB_BACKFILL_BATCH);
+            message->status = rc < 0 ? 1 : 0;
+            message->count = rc > 0;
+            break;
+        }
+        case DB_OP_REBALANCE:
+            message->status = db_rebalance_task_positions(worker->db);
+            break;
+        case DB_OP_STATS:
+            message->stats = malloc(sizeof(TaskStats));
+            message->status = !message->stats || db_get_stats(worker->db, message->stats) != 0;
+            if (message->status != 0) {
+                free(message->stats);
+                message->stats = NULL;
+            }
+            break;
+        case DB_OP_SYNC:
+            handle_sync(worker, message);
+            break;
+        case DB_OP_BULK: {
+            int changed = db_apply_bulk_action(worker->db, message->bulk, message->bulk_value,
+                                               message->ids, message->count);
+            message->status = changed < 0;
+            message->count = changed < 0 ? 0 : changed;
+            free(message->ids);
+            message->ids = NULL;
+            break;
+        }
+        case DB_OP_MOVE:
+            message->status = db_move_task(worker->db, message->task.id, message->task.parent_id,
+                                           message->task.position);
+            break;
+        case DB_OP_TAGS:
+            message->status = db_get_tags(worker->db, &message->tags, &message->count);
+            break;
+        case DB_OP_DUE:
+            message->status = db_get_due_order(worker->db, &message->ids, &message->count);
+            break;
+        case DB_OP_CHANGES:
+            break;
+    }
+    free(message->tag_names);
+    message->tag_names = NULL;
+
+    metrics_observe(op_metrics[message->op], (SDL_GetPerformanceCounter() - start) * 1000000 /
+                    SDL_GetPerformanceFrequency());
+}
+
+// Posts the deltas for everything committed since the last call
+static void post_changes(DbWorker* worker) {
+    DbMessage message;
+    memset(&message, 0, sizeof(message));
+    message.op = DB_OP_CHANGES;
+    message.submitted = SDL_GetPerformanceCounter();
+    message.status = task_events_collect(&worker->capture, worker->db, &message.deltas, &message.count);
+    if (message.status != 0 || message.count > 0) {
+        queue_push(&worker->responses, &message);
+    }
+}
+
+static int is_write(DbOp op) {
+    return op == DB_OP_CREATE || op == DB_OP_UPDATE || op == DB_OP_DELETE || op == DB_OP_BACKFILL ||
+           op == DB_OP_REBALANCE || op == DB_OP_BULK || op == DB_OP_MOVE;
+}
+
+// A batch that did not commit: its writes report failure, and a fresh
+// LOAD replaces anything its reads saw of them
+static void fail_batch(DbWorker* worker) {
+    for (int i = 0; i < worker->batch_count; i++) {
+        if (is_write(worker->batch[i].op)) {
+            worker->batch[i].status = 1;
+        }
+    }
+
+    DbMessage load;
+    memset(&load, 0, sizeof(load));
+    load.op = DB_OP_LOAD;
+    load.submitted = SDL_GetPerformanceCounter();
+    int in_transaction = sqlite3_exec(worker->db, "BEGIN;", 0, 0, NULL) == SQLITE_OK;
+    handle_load(worker, &load);
+    if (in_transaction && sqlite3_exec(worker->db, "COMMIT;", 0, 0, NULL) != SQLITE_OK) {
+        sqlite3_exec(worker->db, "ROLLBACK;", 0, 0, NULL);
+    }
+    worker->batch[worker->batch_count++] = load;
+}
+
+static int db_worker_main(void* data) {
+    DbWorker* worker = data;
+    DbMessage message;
+
+    for (;;) {
+        // Requests queued together are committed together, and their
+        // responses only go out once the commit has succeeded. Two
+        // response slots are held back for the batch's CHANGES message
+        // and the reload after a failed commit.
+        int in_transaction = 0;
+        worker->batch_count = 0;
+        while (queue_free(&worker->responses) > (size_t)worker->batch_count + 2 &&
+               queue_pop(&worker->requests, &message)) {
+            if (!in_transaction) {
+                in_transaction = sqlite3_exec(worker->db, "BEGIN;", 0, 0, NULL) == SQLITE_OK;
+            }
+            handle_request(worker, &message);
+            worker->batch[worker->batch_count++] = message;
+        }
+        if (in_transaction && sqlite3_exec(worker->db, "COMMIT;", 0, 0, NULL) != SQLITE_OK) {
+            fprintf(stderr, "Failed to commit: %s\n", sqlite3_errmsg(worker->db));
+            sqlite3_exec(worker->db, "ROLLBACK;", 0, 0, NULL);
+            fail_batch(worker);
+        }
+        for (int i = 0; i < worker->batch_count; i++) {
+            queue_push(&worker->responses, &worker->batch[i]);
+        }
+        if (worker->capture.count > 0 || worker->capture.overflow) {
+            post_changes(worker);
+        }
+
+        if (atomic_load(&worker->stopping) &&
+            atomic_load_explicit(&worker->requests.head, memory_order_relaxed) ==
+            atomic_load_explicit(&worker->requests.tail, memory_order_acquire)) {
+            break;
+        }
+        SDL_SemWaitTimeout(worker->wakeup, 100);
+    }
+
+    atomic_store(&worker->finished, 1);
+    return 0;
+}
+
+DbWorker* db_worker_start(sqlite3* db, const char* snapshot_path) {
+    if (!db) return NULL;
+
+    DbWorker* worker = calloc(1, sizeof(DbWorker));
+    if (!worker) return NULL;
+
+    worker->db = db;
+    worker->snapshot_path = snapshot_path;
+    task_events_attach(&worker->capture, db);
+    worker->next_id = 1;
+    queue_init(&worker->requests);
+    queue_init(&worker->responses);
+    atomic_init(&worker->stopping, 0);
+    atomic_init(&worker->finished, 0);
+
+    worker->wakeup = SDL_CreateSemaphore(0);
+    if (!worker->wakeup) {
+        free(worker);
+        return NULL;
+    }
+
+    worker->thread = SDL_CreateThread(db_worker_main, "db_worker", worker);
+    if (!worker->thread) {
+        fprintf(stderr, "Failed to start database thread: %s\n", SDL_GetError());
+        task_events_detach(&worker->capture, db);
+        SDL_DestroySemaphore(worker->wakeup);
+        free(worker);
+        return NULL;
+    }
+    return worker;
+}
+
+static Uint32 submit(DbWorker* worker, DbMessage* message) {
+    message->id = worker->next_id;
+    message->submitted = SDL_GetPerformanceCounter();
+    if (queue_push(&worker->requests, message) != 0) {
+        return 0;
+    }
+
+    worker->next_id = worker->next_id == 0xFFFFFFFF ? 1 : worker->next_id + 1;
+    SDL_SemPost(worker->wakeup);
+    return message->id;
+}
+
+Uint32 db_worker_submit(DbWorker* worker, DbOp op, const Task* task) {
+    if (!worker) return 0;
+
+    DbMessage message;
+    memset(&message, 0, sizeof(message));
+    message.op = op;
+    if (task) {
+        message.task = *task;
+    }
+    return submit(worker, &message);
+}
+
+Uint32 db_worker_submit_sync(DbWorker* worker, sqlite3_int64 revision, int data_version) {
+    if (!worker) return 0;
+
+    DbMessage message;
+    memset(&message, 0, sizeof(message));
+    message.op = DB_OP_SYNC;
+    message.revision = revision;
+    message.data_version = data_version;
+    return submit(worker, &message);
+}
+
+Uint32 db_worker_submit_tagged(DbWorker* worker, DbOp op, const Task* task, const char* tag_names) {
+    if (!worker || !task || !tag_names) return 0;
+
+    DbMessage message;
+    memset(&message, 0, sizeof(message));
+    message.op = op;
+    message.task = *task;
+    message.tag_names = malloc(strlen(tag_names) + 1);
+    if (!message.tag_names) return 0;
+    strcpy(message.tag_names, tag_names);
+
+    Uint32 id = submit(worker, &message);
+    if (id == 0) {
+        free(message.tag_names);
+    }
+    return id;
+}
+
+Uint32 db_worker_submit_bulk(DbWorker* worker, DbBulkAction action, int value, const int* ids, int count) {
+    if (!worker || count <= 0) return 0;
+
+    DbMessage message;
+    memset(&message, 0, sizeof(message));
+    message.op = DB_OP_BULK;
+    message.bulk = action;
+    message.bulk_value = value;
+    message.count = count;
+    message.ids = malloc(count * sizeof(int));
+    if (!message.ids) return 0;
+    memcpy(message.ids, ids, count * sizeof(int));
+
+    Uint32 id = submit(worker, &message);
+    if (id == 0) {
+        free(message.ids);
+    }
+    return id;
+}
+
+int db_worker_poll(DbWorker* worker, DbMessage* response) {
+    if (!worker || !response) return 0;
+
+    return queue_pop(&worker->responses, response);
+}
+
+void db_worker_stop(DbWorker* worker, DbResponseHandler handler, void* user_data) {
+    if (!worker) return;
+
+    atomic_store(&worker->stopping, 1);
+    SDL_SemPost(worker->wakeup);
+
+    // Keep draining so the worker never stalls on a full response queue
+    DbMessage response;
+    while (!atomic_load(&worker->finished)) {
+        while (queue_pop(&worker->responses, &response)) {
+            if (handler) handler(&response, user_data);
+        }
+        SDL_SemPost(worker->wakeup);
+        SDL_Delay(1);
+    }
+    SDL_WaitThread(worker->thread, NULL);
+    while (queue_pop(&worker->responses, &response)) {
+        if (handler) handler(&response, user_data);
+    }
+
+    // The connection goes back to the caller without the hooks
+    task_events_detach(&worker->capture, worker->db);
+    SDL_DestroySemaphore(worker->wakeup);
+    free(worker);
+}
@@ -0,0 +1,305 @@
+#include "font.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static void* atlas_load_file(const char* path, size_t* size) {
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < FONT_ATLAS_HEADER_SIZE) {
+        close(fd);
+        return NULL;
+    }
+
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+
+    *size = (size_t)st.st_size;
+    return data;
+#else
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (length < FONT_ATLAS_HEADER_SIZE) {
+        fclose(file);
+        return NULL;
+    }
+
+    void* data = malloc((size_t)length);
+    if (!data || fread(data, 1, (size_t)length, file) != (size_t)length) {
+        free(data);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+
+    *size = (size_t)length;
+    return data;
+#endif
+}
+
+static void atlas_release(void* data, size_t size) {
+#ifndef _WIN32
+    munmap(data, size);
+#else
+    (void)size;
+    free(data);
+#endif
+}
+
+// Returns 0 and points font at the atlas if the file is sound and was
+// baked at size
+static int atlas_map(Font* font, const char* path, int size) {
+    size_t length = 0;
+    unsigned char* data = atlas_load_file(path, &length);
+    if (!data) return 1;
+
+    const FontAtlasHeader* header = (const FontAtlasHeader*)data;
+    size_t glyph_bytes = (size_t)header->glyph_count * sizeof(FontAtlasGlyph);
+    size_t kern_bytes = (size_t)header->kern_count * sizeof(FontAtlasKern);
+    size_t pixel_bytes = (size_t)header->atlas_width * header->atlas_height;
+
+    const char* reason = NULL;
+    if (memcmp(header->magic, FONT_ATLAS_MAGIC, sizeof(header->magic)) != 0) {
+        reason = "bad magic";
+    } else if (header->version != FONT_ATLAS_VERSION) {
+        reason = "incompatible version";
+    } else if (header->glyph_count > 0xFFFF || header->atlas_width > 0xFFFF || header->atlas_height > 0xFFFF ||
+               FONT_ATLAS_HEADER_SIZE + glyph_bytes + kern_bytes + pixel_bytes > length) {
+        reason = "truncated";
+    }
+
+    // An atlas baked for another size is expected, not an error
+    if (reason || header->size != (uint32_t)size) {
+        if (reason) printf("Ignoring font atlas %s: %s\n", path, reason);
+        atlas_release(data, length);
+        return 1;
+    }
+
+    font->mapping = data;
+    font->mapping_size = length;
+    font->atlas = header;
+    font->glyphs = (const FontAtlasGlyph*)(data + FONT_ATLAS_HEADER_SIZE);
+    font->kerning = (const FontAtlasKern*)(data + FONT_ATLAS_HEADER_SIZE + glyph_bytes);
+    font->pixels = data + FONT_ATLAS_HEADER_SIZE + glyph_bytes + kern_bytes;
+    return 0;
+}
+
+int font_open(Font* font, const char* ttf_path, const char* atlas_path, int size) {
+    memset(font, 0, sizeof(Font));
+    snprintf(font->ttf_path, sizeof(font->ttf_path), "%s", ttf_path);
+    font->size = size;
+
+    if (atlas_path && atlas_map(font, atlas_path, size) == 0) return 0;
+    return font_ttf(font) ? 0 : 1;
+}
+
+void font_close(Font* font) {
+    if (font->mapping) {
+        atlas_release(font->mapping, font->mapping_size);
+    }
+    if (font->ttf) {
+        TTF_CloseFont(font->ttf);
+    }
+    memset(font, 0, sizeof(Font));
+}
+
+TTF_Font* font_ttf(Font* font) {
+    if (font->ttf) return font->ttf;
+
+    if (!TTF_WasInit() && TTF_Init() < 0) {
+        fprintf(stderr, "SDL_ttf could not initialize: %s\n", TTF_GetError());
+        return NULL;
+    }
+    font->ttf = TTF_OpenFont(font->ttf_path, font->size);
+    if (!font->ttf) {
+        fprintf(stderr, "Failed to load font %s: %s\n", font->ttf_path, TTF_GetError());
+    }
+    return font->ttf;
+}
+
+// Index of the glyph for codepoint, or -1
+static int find_glyph(const Font* font, Uint32 codepoint) {
+    if (!font->atlas) return -1;
+
+    int low = 0;
+    int high = (int)font->atlas->glyph_count - 1;
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+        if (font->glyphs[mid].codepoint == codepoint) return mid;
+        if (font->glyphs[mid].codepoint < codepoint) {
+            low = mid + 1;
+        }
+        else {
+            high = mid - 1;
+        }
+    }
+    return -1;
+}
+
+static int kerning(const Font* font, int left, int right) {
+    Uint32 key = ((Uint32)left << 16) | (Uint32)right;
+    int low = 0;
+    int high = (int)font->atlas->kern_count - 1;
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+        Uint32 probe = ((Uint32)font->kerning[mid].left << 16) | font->kerning[mid].right;
+        if (probe == key) return font->kerning[mid].amount;
+        if (probe < key) {
+            low = mid + 1;
+        }
+        else {
+            high = mid - 1;
+        }
+    }
+    return 0;
+}
+
+// Decodes one UTF-8 sequence; malformed bytes decode as U+FFFD, which is
+// never baked, so such text falls back to SDL_ttf
+static Uint32 next_codepoint(const char** text) {
+    const unsigned char* p = (const unsigned char*)*text;
+    Uint32 codepoint;
+    int length;
+    if (p[0] < 0x80) {
+        codepoint = p[0];
+        length = 1;
+    }
+    else if ((p[0] & 0xE0) == 0xC0) {
+        codepoint = p[0] & 0x1F;
+        length = 2;
+    }
+    else if ((p[0] & 0xF0) == 0xE0) {
+        codepoint = p[0] & 0x0F;
+        length = 3;
+    }
+    else if ((p[0] & 0xF8) == 0xF0) {
+        codepoint = p[0] & 0x07;
+        length = 4;
+    }
+    else {
+        *text += 1;
+        return 0xFFFD;
+    }
+    for (int i = 1; i < length; i++) {
+        if ((p[i] & 0xC0) != 0x80) {
+            *text += i;
+            return 0xFFFD;
+        }
+        codepoint = (codepoint << 6) | (p[i] & 0x3F);
+    }
+    *text += length;
+    return codepoint;
+}
+
+// Width of text from the atlas and, when pens is given, where each glyph
+// goes. Returns 1 if a glyph is missing or text has more than max glyphs,
+// in which case the caller falls back to SDL_ttf.
+static int layout_text(const Font* font, const char* text, int* width, int* pens, int* indices, int max,
+                       int* count) {
+    int pen = 0;
+    int extent = 0;
+    int previous = -1;
+    *count = 0;
+    while (*text) {
+        int index = find_glyph(font, next_codepoint(&text));
+        if (index < 0) return 1;
+
+        if (previous >= 0) pen += kerning(font, previous, index);
+        const FontAtlasGlyph* glyph = &font->glyphs[index];
+        if (pens) {
+            if (*count == max) return 1;
+            pens[*count] = pen;
+            indices[*count] = index;
+        }
+        (*count)++;
+        if (glyph->width > 0 && pen + glyph->offset_x + glyph->width > extent) {
+            extent = pen + glyph->offset_x + glyph->width;
+        }
+        pen += glyph->advance;
+        previous = index;
+    }
+    *width = pen > extent ? pen : extent;
+    return 0;
+}
+
+// Longest string rendered from the atlas, in glyphs
+#define FONT_LAYOUT_MAX 512
+
+SDL_Surface* font_render(Font* font, const char* text, SDL_Color color) {
+    int pens[FONT_LAYOUT_MAX];
+    int indices[FONT_LAYOUT_MAX];
+    int width;
+    int count;
+    if (!font->atlas || layout_text(font, text, &width, pens, indices, FONT_LAYOUT_MAX, &count) != 0) {
+        TTF_Font* ttf = font_ttf(font);
+        return ttf ? TTF_RenderUTF8_Solid(ttf, text, color) : NULL;
+    }
+
+    int height = font->atlas->height;
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, width > 0 ? width : 1, height, 32,
+                                                          SDL_PIXELFORMAT_ARGB8888);
+    if (!surface) return NULL;
+
+    // Transparent background, color with the glyph's coverage as alpha
+    SDL_LockSurface(surface);
+    memset(surface->pixels, 0, (size_t)surface->pitch * surface->h);
+    Uint32 rgb = ((Uint32)color.r << 16) | ((Uint32)color.g << 8) | color.b;
+
+    for (int i = 0; i < count; i++) {
+        const FontAtlasGlyph* glyph = &font->glyphs[indices[i]];
+        for (int y = 0; y < glyph->height; y++) {
+            int dst_y = glyph->offset_y + y;
+            if (dst_y < 0 || dst_y >= surface->h) continue;
+            const Uint8* src = font->pixels + (size_t)(glyph->atlas_y + y) * font->atlas->atlas_width + glyph->atlas_x;
+            Uint32* dst = (Uint32*)((Uint8*)surface->pixels + dst_y * surface->pitch);
+            for (int x = 0; x < glyph->width; x++) {
+                int dst_x = pens[i] + glyph->offset_x + x;
+                if (src[x] == 0 || dst_x < 0 || dst_x >= surface->w) continue;
+                dst[dst_x] = ((Uint32)src[x] << 24) | rgb;
+            }
+        }
+    }
+    SDL_UnlockSurface(surface);
+    return surface;
+}
+
+int font_glyph_advance(Font* font, Uint32 codepoint, int* advance) {
+    int index = find_glyph(font, codepoint);
+    if (index >= 0) {
+        *advance = font->glyphs[index].advance;
+        return 0;
+    }
+
+    TTF_Font* ttf = font_ttf(font);
+    if (!ttf || codepoint > 0xFFFF) return 1;
+    return TTF_GlyphMetrics(ttf, (Uint16)codepoint, NULL, NULL, NULL, NULL, advance) == 0 ? 0 : 1;
+}
+
+int font_size_utf8(Font* font, const char* text, int* width, int* height) {
+    int measured;
+    int count;
+    if (font->atlas && layout_text(font, text, &measured, NULL, NULL, 0, &count) == 0) {
+        if (width) *width = measured;
+        if (height) *height = font->atlas->height;
+        return 0;
+    }
+
+    TTF_Font* ttf = font_ttf(font);
+    if (!ttf) return 1;
+    return TTF_SizeUTF8(ttf, text, width, height) == 0 ? 0 : 1;
+}
@@ -0,0 +1,67 @@
+#include "frame_pacer.h"
+
+// SDL_Delay can oversleep by about a millisecond, so the last stretch
+// before a deadline is spent yielding instead
+#define SPIN_THRESHOLD_MS 2
+
+static Uint64 period_for(Uint64 frequency, int fps) {
+    return fps > 0 ? frequency / (Uint64)fps : 0;
+}
+
+void frame_pacer_init(FramePacer* pacer, int target_fps, int idle_fps) {
+    pacer->frequency = SDL_GetPerformanceFrequency();
+    pacer->active_period = period_for(pacer->frequency, target_fps);
+    pacer->idle_period = period_for(pacer->frequency, idle_fps);
+    pacer->last_activity = SDL_GetPerformanceCounter();
+    pacer->deadline = 0;
+}
+
+void frame_pacer_activity(FramePacer* pacer) {
+    pacer->last_activity = SDL_GetPerformanceCounter();
+}
+
+int frame_pacer_idle(const FramePacer* pacer) {
+    if (!pacer->idle_period) return 0;
+
+    Uint64 quiet = SDL_GetPerformanceCounter() - pacer->last_activity;
+    return quiet * 1000 >= pacer->frequency * FRAME_PACER_IDLE_DELAY_MS;
+}
+
+int frame_pacer_wait(FramePacer* pacer) {
+    int idle = frame_pacer_idle(pacer);
+    Uint64 period = idle ? pacer->idle_period : pacer->active_period;
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (!period) {
+        pacer->deadline = now;
+        return 0;
+    }
+
+    // A frame that overran its deadline by a whole period starts a new
+    // schedule rather than rushing the next frames to catch up
+    int late = 0;
+    if (!pacer->deadline || now - pacer->deadline > period) {
+        late = pacer->deadline != 0;
+        pacer->deadline = now;
+    }
+    pacer->deadline += period;
+    if (now >= pacer->deadline) late = 1;
+    if (late) return !idle;
+
+    Uint32 remaining_ms = (Uint32)((pacer->deadline - now) * 1000 / pacer->frequency);
+    if (idle) {
+        // Sleep in the event queue so input ends the wait at once
+        if (SDL_WaitEventTimeout(NULL, (int)remaining_ms)) {
+            pacer->deadline = SDL_GetPerformanceCounter();
+            frame_pacer_activity(pacer);
+        }
+        return 0;
+    }
+
+    if (remaining_ms > SPIN_THRESHOLD_MS) {
+        SDL_Delay(remaining_ms - SPIN_THRESHOLD_MS);
+    }
+    while (SDL_GetPerformanceCounter() < pacer->deadline) {
+        SDL_Delay(0);
+    }
+    return 0;
+}
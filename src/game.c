@@ -6,7 +6,6 @@
 
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 600
-#define FONT_SIZE 16
 
 Game* game_init(void) {
     Game* game = (Game*)malloc(sizeof(Game));
@@ -33,8 +32,11 @@ Game* game_init(void) {
         return NULL;
     }
 
+    Config config;
+    config_load(&config, config_default_path());
+
     // Initialize font
-    game->font = TTF_OpenFont("assets/font.ttf", FONT_SIZE);
+    game->font = TTF_OpenFont("assets/font.ttf", config.font_size);
     if (!game->font) {
         SDL_DestroyRenderer(game->renderer);
         SDL_DestroyWindow(game->window);
@@ -43,7 +45,7 @@ Game* game_init(void) {
     }
 
     // Initialize database
-    if (db_init("heroman.db", &game->db) != 0) {
+    if (db_init(config.db_path, &game->db) != 0) {
         TTF_CloseFont(game->font);
         SDL_DestroyRenderer(game->renderer);
         SDL_DestroyWindow(game->window);
@@ -52,7 +54,7 @@ Game* game_init(void) {
     }
 
     // Create database schema
-    if (db_create_schema(game->db) != 0) {
+    if (db_configure(game->db, &config) != 0 || db_create_schema(game->db) != 0) {
         db_close(game->db);
         TTF_CloseFont(game->font);
         SDL_DestroyRenderer(game->renderer);
@@ -200,6 +202,9 @@ void game_sort_tasks(Game* game, TaskSort sort) {
                 case TASK_SORT_COMPLETION:
                     should_swap = game->tasks[j].completed && !game->tasks[j + 1].completed;
                     break;
+                default:
+                    // Manual and due order are kept by TaskList and the task filter
+                    break;
             }
             
             if (should_swap) {
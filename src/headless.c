@@ -0,0 +1,160 @@
+#include "headless.h"
+#include <SDL2/SDL_image.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int headless_open(HeadlessTarget* target, int width, int height) {
+    memset(target, 0, sizeof(HeadlessTarget));
+
+    target->surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (!target->surface) {
+        fprintf(stderr, "Failed to create offscreen surface: %s\n", SDL_GetError());
+        return 1;
+    }
+    target->renderer = SDL_CreateSoftwareRenderer(target->surface);
+    if (!target->renderer) {
+        fprintf(stderr, "Failed to create software renderer: %s\n", SDL_GetError());
+        SDL_FreeSurface(target->surface);
+        target->surface = NULL;
+        return 1;
+    }
+    return 0;
+}
+
+void headless_close(HeadlessTarget* target) {
+    if (target->renderer) SDL_DestroyRenderer(target->renderer);
+    if (target->surface) SDL_FreeSurface(target->surface);
+    free(target->frame_ms);
+    memset(target, 0, sizeof(HeadlessTarget));
+}
+
+void headless_note_frame(HeadlessTarget* target, double ms) {
+    if (target->frame_count == target->frame_capacity) {
+        int capacity = target->frame_capacity ? target->frame_capacity * 2 : HEADLESS_FRAMES;
+        float* grown = realloc(target->frame_ms, capacity * sizeof(float));
+        if (!grown) return;
+        target->frame_ms = grown;
+        target->frame_capacity = capacity;
+    }
+    target->frame_ms[target->frame_count++] = (float)ms;
+}
+
+void headless_reset_frames(HeadlessTarget* target) {
+    target->frame_count = 0;
+}
+
+static int compare_float(const void* a, const void* b) {
+    float x = *(const float*)a;
+    float y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+int headless_report_frames(HeadlessTarget* target, const char* scene, const char* csv_path,
+                           double budget_ms) {
+    int count = target->frame_count;
+    if (count == 0) {
+        printf("%s frames: none\n", scene);
+        return 0;
+    }
+
+    // Raw samples in frame order, before sorting for the percentiles
+    FILE* csv = csv_path ? fopen(csv_path, "a") : NULL;
+    if (csv) {
+        for (int i = 0; i < count; i++) {
+            fprintf(csv, "%s,%d,%.4f\n", scene, i, target->frame_ms[i]);
+        }
+        fclose(csv);
+    }
+
+    qsort(target->frame_ms, count, sizeof(float), compare_float);
+    float p99 = target->frame_ms[(int)((count - 1) * 0.99)];
+    printf("%s frames: %d, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n", scene, count,
+           target->frame_ms[count / 2], p99, target->frame_ms[count - 1]);
+    if (budget_ms > 0 && p99 > budget_ms) {
+        printf("%s: p99 over the %.3f ms budget\n", scene, budget_ms);
+        return 1;
+    }
+    return 0;
+}
+
+int headless_save_png(HeadlessTarget* target, const char* path) {
+    if (IMG_SavePNG(target->surface, path) != 0) {
+        fprintf(stderr, "Failed to save %s: %s\n", path, IMG_GetError());
+        return 1;
+    }
+    return 0;
+}
+
+static int channel_delta(Uint32 a, Uint32 b, int shift) {
+    return abs((int)((a >> shift) & 0xFF) - (int)((b >> shift) & 0xFF));
+}
+
+int headless_compare(HeadlessTarget* target, const char* golden_path, const char* diff_path,
+                     HeadlessDiff* diff) {
+    memset(diff, 0, sizeof(HeadlessDiff));
+
+    SDL_Surface* loaded = IMG_Load(golden_path);
+    if (!loaded) {
+        fprintf(stderr, "No golden image %s: %s\n", golden_path, IMG_GetError());
+        return -1;
+    }
+    SDL_Surface* golden = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_ARGB8888, 0);
+    SDL_FreeSurface(loaded);
+    if (!golden) {
+        fprintf(stderr, "Failed to convert %s: %s\n", golden_path, SDL_GetError());
+        return -1;
+    }
+
+    SDL_Surface* actual = target->surface;
+    if (golden->w != actual->w || golden->h != actual->h) {
+        fprintf(stderr, "Golden image %s is %dx%d, rendered %dx%d\n",
+                golden_path, golden->w, golden->h, actual->w, actual->h);
+        SDL_FreeSurface(golden);
+        return -1;
+    }
+
+    SDL_Surface* marked = diff_path ? SDL_CreateRGBSurfaceWithFormat(0, actual->w, actual->h, 32,
+                                                                     SDL_PIXELFORMAT_ARGB8888) : NULL;
+    SDL_LockSurface(actual);
+    SDL_LockSurface(golden);
+    if (marked) SDL_LockSurface(marked);
+
+    // Alpha is ignored; the screen is opaque whatever the renderer leaves there
+    for (int y = 0; y < actual->h; y++) {
+        const Uint32* a = (const Uint32*)((const Uint8*)actual->pixels + y * actual->pitch);
+        const Uint32* g = (const Uint32*)((const Uint8*)golden->pixels + y * golden->pitch);
+        Uint32* m = marked ? (Uint32*)((Uint8*)marked->pixels + y * marked->pitch) : NULL;
+        for (int x = 0; x < actual->w; x++) {
+            int delta = channel_delta(a[x], g[x], 16);
+            int green = channel_delta(a[x], g[x], 8);
+            int blue = channel_delta(a[x], g[x], 0);
+            if (green > delta) delta = green;
+            if (blue > delta) delta = blue;
+            if (delta > diff->max_delta) diff->max_delta = delta;
+
+            if (delta > HEADLESS_TOLERANCE) {
+                diff->mismatched++;
+                if (m) m[x] = 0xFFFF0000;
+            }
+            else if (m) {
+                m[x] = 0xFF000000 | ((a[x] >> 2) & 0x003F3F3F);
+            }
+        }
+    }
+    diff->pixels = actual->w * actual->h;
+
+    if (marked) SDL_UnlockSurface(marked);
+    SDL_UnlockSurface(golden);
+    SDL_UnlockSurface(actual);
+    SDL_FreeSurface(golden);
+
+    int differs = diff->mismatched > diff->pixels * HEADLESS_MAX_MISMATCH;
+    if (marked) {
+        if (differs && IMG_SavePNG(marked, diff_path) != 0) {
+            fprintf(stderr, "Failed to save %s: %s\n", diff_path, IMG_GetError());
+        }
+        SDL_FreeSurface(marked);
+    }
+    return differs;
+}
@@ -0,0 +1,326 @@
+#include "json.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int skip_ws(const char* s, int len, int i) {
+    while (i < len && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r' || s[i] == '\n')) {
+        i++;
+    }
+    return i;
+}
+
+// Returns the index just past the closing quote, or -1
+static int scan_string(const char* s, int len, int i) {
+    i++;  // Opening quote
+    while (i < len) {
+        if (s[i] == '\\') {
+            i += 2;
+        } else if (s[i] == '"') {
+            return i + 1;
+        } else {
+            i++;
+        }
+    }
+    return -1;
+}
+
+// Returns the index just past the matching bracket, or -1
+static int scan_nested(const char* s, int len, int i) {
+    int depth = 0;
+    while (i < len) {
+        char c = s[i];
+        if (c == '"') {
+            i = scan_string(s, len, i);
+            if (i < 0) return -1;
+            continue;
+        }
+        if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            depth--;
+            if (depth == 0) return i + 1;
+        }
+        i++;
+    }
+    return -1;
+}
+
+int json_parse_object(const char* text, int len, JsonField* fields, int max_fields) {
+    if (!text || !fields) return -1;
+
+    int i = skip_ws(text, len, 0);
+    if (i >= len || text[i] != '{') return -1;
+    i = skip_ws(text, len, i + 1);
+
+    int count = 0;
+    if (i < len && text[i] == '}') return 0;
+
+    while (i < len) {
+        if (text[i] != '"') return -1;
+        int key_end = scan_string(text, len, i);
+        if (key_end < 0) return -1;
+
+        JsonField field;
+        field.key = text + i + 1;
+        field.key_len = key_end - i - 2;
+
+        i = skip_ws(text, len, key_end);
+        if (i >= len || text[i] != ':') return -1;
+        i = skip_ws(text, len, i + 1);
+        if (i >= len) return -1;
+
+        int start = i;
+        char c = text[i];
+        if (c == '"') {
+            i = scan_string(text, len, i);
+            if (i < 0) return -1;
+            field.type = JSON_STRING;
+            field.value = text + start + 1;
+            field.value_len = i - start - 2;
+        } else if (c == '{' || c == '[') {
+            i = scan_nested(text, len, i);
+            if (i < 0) return -1;
+            field.type = c == '{' ? JSON_OBJECT : JSON_ARRAY;
+            field.value = text + start;
+            field.value_len = i - start;
+        } else {
+            while (i < len && text[i] != ',' && text[i] != '}' &&
+                   text[i] != ' ' && text[i] != '\t' && text[i] != '\r' && text[i] != '\n') {
+                i++;
+            }
+            field.value = text + start;
+            field.value_len = i - start;
+            if (field.value_len == 4 && strncmp(field.value, "null", 4) == 0) {
+                field.type = JSON_NULL;
+            } else if ((field.value_len == 4 && strncmp(field.value, "true", 4) == 0) ||
+                       (field.value_len == 5 && strncmp(field.value, "false", 5) == 0)) {
+                field.type = JSON_BOOL;
+            } else if (field.value_len > 0 && (c == '-' || (c >= '0' && c <= '9'))) {
+                field.type = JSON_NUMBER;
+            } else {
+                return -1;
+            }
+        }
+
+        if (count < max_fields) {
+            fields[count] = field;
+        }
+        count++;
+
+        i = skip_ws(text, len, i);
+        if (i >= len) return -1;
+        if (text[i] == '}') {
+            return count < max_fields ? count : max_fields;
+        }
+        if (text[i] != ',') return -1;
+        i = skip_ws(text, len, i + 1);
+    }
+
+    return -1;
+}
+
+const JsonField* json_find(const JsonField* fields, int count, const char* key) {
+    int key_len = (int)strlen(key);
+    for (int i = 0; i < count; i++) {
+        if (fields[i].key_len == key_len && strncmp(fields[i].key, key, key_len) == 0) {
+            return &fields[i];
+        }
+    }
+    return NULL;
+}
+
+int json_field_int(const JsonField* field, int* out) {
+    if (!field || !out) return 1;
+
+    if (field->type == JSON_BOOL) {
+        *out = field->value[0] == 't';
+        return 0;
+    }
+    if (field->type != JSON_NUMBER) return 1;
+
+    char temp[32];
+    int n = field->value_len < (int)sizeof(temp) - 1 ? field->value_len : (int)sizeof(temp) - 1;
+    memcpy(temp, field->value, n);
+    temp[n] = '\0';
+    *out = (int)strtol(temp, NULL, 10);
+    return 0;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static int parse_hex4(const char* s, int remaining) {
+    if (remaining < 4) return -1;
+    int value = 0;
+    for (int i = 0; i < 4; i++) {
+        int h = hex_value(s[i]);
+        if (h < 0) return -1;
+        value = (value << 4) | h;
+    }
+    return value;
+}
+
+static int encode_utf8(unsigned int cp, char* out) {
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+int json_field_string(const JsonField* field, char* out, int out_size) {
+    if (!field || !out || out_size <= 0) return 1;
+    if (field->type != JSON_STRING) return 1;
+
+    const char* s = field->value;
+    int len = field->value_len;
+    int o = 0;
+    for (int i = 0; i < len; i++) {
+        char utf8[4];
+        int n = 1;
+        if (s[i] != '\\') {
+            utf8[0] = s[i];
+        } else {
+            if (++i >= len) return 1;
+            switch (s[i]) {
+                case '"': utf8[0] = '"'; break;
+                case '\\': utf8[0] = '\\'; break;
+                case '/': utf8[0] = '/'; break;
+                case 'b': utf8[0] = '\b'; break;
+                case 'f': utf8[0] = '\f'; break;
+                case 'n': utf8[0] = '\n'; break;
+                case 'r': utf8[0] = '\r'; break;
+                case 't': utf8[0] = '\t'; break;
+                case 'u': {
+                    int cp = parse_hex4(s + i + 1, len - i - 1);
+                    if (cp < 0) return 1;
+                    i += 4;
+                    if (cp >= 0xD800 && cp <= 0xDBFF && i + 6 < len && s[i + 1] == '\\' && s[i + 2] == 'u') {
+                        int low = parse_hex4(s + i + 3, len - i - 3);
+                        if (low >= 0xDC00 && low <= 0xDFFF) {
+                            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                            i += 6;
+                        }
+                    }
+                    n = encode_utf8((unsigned int)cp, utf8);
+                    break;
+                }
+                default:
+                    return 1;
+            }
+        }
+        if (o + n >= out_size) break;  // Truncate like strncpy does
+        memcpy(out + o, utf8, n);
+        o += n;
+    }
+    out[o] = '\0';
+    return 0;
+}
+
+void json_buffer_init(JsonBuffer* buf) {
+    buf->data = NULL;
+    buf->len = 0;
+    buf->cap = 0;
+}
+
+void json_buffer_free(JsonBuffer* buf) {
+    free(buf->data);
+    json_buffer_init(buf);
+}
+
+int json_buffer_reserve(JsonBuffer* buf, size_t extra) {
+    if (buf->len + extra + 1 <= buf->cap) return 0;
+
+    size_t new_cap = buf->cap == 0 ? 256 : buf->cap;
+    while (new_cap < buf->len + extra + 1) {
+        new_cap *= 2;
+    }
+    char* data = realloc(buf->data, new_cap);
+    if (!data) return 1;
+
+    buf->data = data;
+    buf->cap = new_cap;
+    return 0;
+}
+
+int json_buffer_append(JsonBuffer* buf, const char* data, size_t len) {
+    if (json_buffer_reserve(buf, len) != 0) return 1;
+
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+    return 0;
+}
+
+int json_buffer_printf(JsonBuffer* buf, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int needed = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+    if (needed < 0 || json_buffer_reserve(buf, (size_t)needed) != 0) return 1;
+
+    va_start(args, fmt);
+    vsnprintf(buf->data + buf->len, (size_t)needed + 1, fmt, args);
+    va_end(args);
+    buf->len += (size_t)needed;
+    return 0;
+}
+
+int json_buffer_append_string(JsonBuffer* buf, const char* s) {
+    if (json_buffer_append(buf, "\"", 1) != 0) return 1;
+
+    const char* run = s;
+    for (const char* p = s; *p; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c != '"' && c != '\\' && c >= 0x20) continue;
+
+        if (json_buffer_append(buf, run, p - run) != 0) return 1;
+        char escaped[8];
+        switch (c) {
+            case '"': strcpy(escaped, "\\\""); break;
+            case '\\': strcpy(escaped, "\\\\"); break;
+            case '\n': strcpy(escaped, "\\n"); break;
+            case '\r': strcpy(escaped, "\\r"); break;
+            case '\t': strcpy(escaped, "\\t"); break;
+            default: snprintf(escaped, sizeof(escaped), "\\u%04x", c); break;
+        }
+        if (json_buffer_append(buf, escaped, strlen(escaped)) != 0) return 1;
+        run = p + 1;
+    }
+
+    if (json_buffer_append(buf, run, strlen(run)) != 0) return 1;
+    return json_buffer_append(buf, "\"", 1);
+}
+
+void json_buffer_consume(JsonBuffer* buf, size_t len) {
+    if (len >= buf->len) {
+        buf->len = 0;
+    } else {
+        memmove(buf->data, buf->data + len, buf->len - len);
+        buf->len -= len;
+    }
+    if (buf->data) {
+        buf->data[buf->len] = '\0';
+    }
+}
@@ -0,0 +1,126 @@
+#include "layout.h"
+#include <string.h>
+
+// Parents come before their children, so one pass in id order sees every
+// parent's rect before it is needed
+static const LayoutConstraint constraints[LAYOUT_COUNT] = {
+    [LAYOUT_ROOT]                     = {LAYOUT_ROOT, 0, 0, 0, 0, 0, 0},
+
+    [LAYOUT_TITLE]                    = {LAYOUT_ROOT, 0, 0, 10, 10, 200, 30},
+    [LAYOUT_NEW_TASK_BUTTON]          = {LAYOUT_ROOT, 0, 0, 10, 50, 100, 30},
+    [LAYOUT_QUIT_BUTTON]              = {LAYOUT_ROOT, 0, 0, 10, 90, 100, 30},
+    [LAYOUT_STATS_BUTTON]             = {LAYOUT_ROOT, 0, 0, 120, 90, 100, 30},
+    [LAYOUT_FILTER_ALL_BUTTON]        = {LAYOUT_ROOT, 0, 0, 120, 50, 100, 30},
+    [LAYOUT_FILTER_COMPLETED_BUTTON]  = {LAYOUT_ROOT, 0, 0, 230, 50, 100, 30},
+    [LAYOUT_FILTER_UNCOMPLETED_BUTTON]= {LAYOUT_ROOT, 0, 0, 340, 50, 100, 30},
+    [LAYOUT_SORT_TYPE_BUTTON]         = {LAYOUT_ROOT, 0, 0, 450, 50, 100, 30},
+    [LAYOUT_SORT_DIFFICULTY_BUTTON]   = {LAYOUT_ROOT, 0, 0, 560, 50, 100, 30},
+    [LAYOUT_SORT_COMPLETION_BUTTON]   = {LAYOUT_ROOT, 0, 0, 670, 50, 100, 30},
+    [LAYOUT_SORT_DUE_BUTTON]          = {LAYOUT_ROOT, 0, 0, 670, 90, 100, 30},
+    [LAYOUT_TAG_BAR]                  = {LAYOUT_ROOT, 0, 0, 10, 128, -10, 24},
+    [LAYOUT_TASK_LIST]                = {LAYOUT_ROOT, 0, 0, 10, 158, -10, -10},
+    [LAYOUT_MESSAGE]                  = {LAYOUT_ROOT, 0, 1, 10, -30, -10, 30},
+    [LAYOUT_BULK_COMPLETE_BUTTON]     = {LAYOUT_ROOT, 0, 0, 230, 90, 100, 30},
+    [LAYOUT_BULK_UNCOMPLETE_BUTTON]   = {LAYOUT_ROOT, 0, 0, 340, 90, 100, 30},
+    [LAYOUT_BULK_DELETE_BUTTON]       = {LAYOUT_ROOT, 0, 0, 450, 90, 100, 30},
+    [LAYOUT_BULK_DIFFICULTY_BUTTON]   = {LAYOUT_ROOT, 0, 0, 560, 90, 100, 30},
+
+    [LAYOUT_STATS_CHART]              = {LAYOUT_TASK_LIST, 0, 0, 10, 35, -10, 120},
+    [LAYOUT_STATS_TABLE]              = {LAYOUT_TASK_LIST, 0, 0, 10, 190, -10, -10},
+
+    [LAYOUT_DIALOG]                   = {LAYOUT_ROOT, 0.5f, 0.5f, -200, -230, 400, 460},
+    [LAYOUT_DIALOG_HEADING]           = {LAYOUT_DIALOG, 0, 0, 10, 10, -10, 30},
+    [LAYOUT_DIALOG_TITLE_INPUT]       = {LAYOUT_DIALOG, 0, 0, 20, 50, -20, 30},
+    [LAYOUT_DIALOG_DESC_INPUT]        = {LAYOUT_DIALOG, 0, 0, 20, 100, -20, 60},
+    [LAYOUT_DIALOG_TYPE]              = {LAYOUT_DIALOG, 0, 0, 20, 180, -20, 30},
+    [LAYOUT_DIALOG_DIFFICULTY]        = {LAYOUT_DIALOG, 0, 0, 20, 230, -20, 30},
+    [LAYOUT_DIALOG_TAGS_INPUT]        = {LAYOUT_DIALOG, 0, 0, 20, 290, -20, 30},
+    [LAYOUT_DIALOG_DUE_INPUT]         = {LAYOUT_DIALOG, 0, 0, 20, 350, -20, 30},
+    [LAYOUT_DIALOG_SAVE_BUTTON]       = {LAYOUT_DIALOG, 0, 0, 20, 400, 100, 30},
+    [LAYOUT_DIALOG_CANCEL_BUTTON]     = {LAYOUT_DIALOG, 1, 0, -120, 400, 100, 30},
+};
+
+void layout_init(Layout* layout) {
+    memset(layout, 0, sizeof(Layout));
+    layout->width = LAYOUT_BASE_WIDTH;
+    layout->height = LAYOUT_BASE_HEIGHT;
+    layout->scale = 1.0f;
+    layout_mark_dirty(layout, LAYOUT_ROOT);
+}
+
+void layout_resize(Layout* layout, int width, int height, float scale) {
+    if (width == layout->width && height == layout->height && scale == layout->scale) return;
+
+    layout->width = width;
+    layout->height = height;
+    layout->scale = scale;
+    layout_mark_dirty(layout, LAYOUT_ROOT);
+}
+
+void layout_mark_dirty(Layout* layout, LayoutId id) {
+    if (id >= 0 && id < LAYOUT_COUNT) {
+        layout->dirty[id] = 1;
+    }
+}
+
+static int round_px(float value) {
+    return (int)(value + (value >= 0 ? 0.5f : -0.5f));
+}
+
+int layout_px(const Layout* layout, int logical) {
+    return round_px(logical * layout->scale);
+}
+
+// Places one axis: start and length of the child within the parent span
+static void place_axis(const Layout* layout, int parent_start, int parent_length,
+                       float anchor, int offset, int size, int* start, int* length) {
+    *start = parent_start + round_px(parent_length * anchor) + layout_px(layout, offset);
+    if (size > 0) {
+        *length = layout_px(layout, size);
+    }
+    else {
+        *length = parent_start + parent_length - layout_px(layout, -size) - *start;
+    }
+    if (*length < 0) *length = 0;
+}
+
+static void compute_node(Layout* layout, LayoutId id) {
+    SDL_Rect* rect = &layout->rects[id];
+    if (id == LAYOUT_ROOT) {
+        rect->x = 0;
+        rect->y = 0;
+        rect->w = layout->width;
+        rect->h = layout->height;
+        return;
+    }
+
+    const LayoutConstraint* c = &constraints[id];
+    const SDL_Rect* parent = &layout->rects[c->parent];
+    place_axis(layout, parent->x, parent->w, c->anchor_x, c->x, c->width, &rect->x, &rect->w);
+    place_axis(layout, parent->y, parent->h, c->anchor_y, c->y, c->height, &rect->y, &rect->h);
+}
+
+int layout_update(Layout* layout) {
+    Uint8 updated[LAYOUT_COUNT];
+    int count = 0;
+
+    for (int id = 0; id < LAYOUT_COUNT; id++) {
+        updated[id] = layout->dirty[id] || (id != LAYOUT_ROOT && updated[constraints[id].parent]);
+        if (updated[id]) {
+            compute_node(layout, (LayoutId)id);
+            layout->dirty[id] = 0;
+            count++;
+        }
+    }
+    return count;
+}
+
+const SDL_Rect* layout_rect(const Layout* layout, LayoutId id) {
+    return &layout->rects[id];
+}
+
+int layout_hit(const Layout* layout, LayoutId id, int x, int y) {
+    const SDL_Rect* rect = &layout->rects[id];
+    return x >= rect->x && x <= rect->x + rect->w &&
+           y >= rect->y && y <= rect->y + rect->h;
+}
@@ -2,104 +2,74 @@
 #include <SDL2/SDL_ttf.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include <time.h>
+#include <limits.h>
 #include "game.h"
 #include "ui.h"
 #include "tasks.h"
 #include "database.h"
 #include "sprites.h"
+#include "text_input.h"
+#include "service.h"
+#include "snapshot.h"
+#include "arena.h"
+#include "memstats.h"
+#include "config.h"
+#include "db_worker.h"
+#include "migrations.h"
+#include "replay.h"
+#include "frame_pacer.h"
+#include "layout.h"
+#include "metrics.h"
+#include "task_list.h"
+#include "headless.h"
+#include "font.h"
+#include "scene.h"
+#include "tag_index.h"
+#include "reminders.h"
 
 // Function declarations
 void show_message(Message* msg, const char* text);
 void update_message(Message* msg);
-void draw_message(UI* ui, Message* msg);
+void draw_message(DisplayList* out, const Message* msg, const Layout* layout);
 
 // Game instance
 Game* game;
 
-#define WINDOW_WIDTH 800
-#define WINDOW_HEIGHT 600
-#define FONT_SIZE 16
+#define WINDOW_MIN_WIDTH 800
+#define WINDOW_MIN_HEIGHT 400
+#define FONT_PATH "assets/font.ttf"
 #define MESSAGE_DURATION 3000  // 3 seconds
+#define CURSOR_BLINK_MS 500
+#define TARGET_FPS 60  // Used when the config leaves the rate to us
+#define FRAME_STATS_INTERVAL 300  // Frames between allocation reports
+#define REPLAY_DB_TIMEOUT_MS 5000  // Longest a replay waits for a recorded response
 
-// Button positions and sizes
-#define NEW_TASK_BUTTON_X 10
-#define NEW_TASK_BUTTON_Y 50
-#define NEW_TASK_BUTTON_WIDTH 100
-#define NEW_TASK_BUTTON_HEIGHT 30
-
-#define QUIT_BUTTON_X 10
-#define QUIT_BUTTON_Y 90
-#define QUIT_BUTTON_WIDTH 100
-#define QUIT_BUTTON_HEIGHT 30
-
-// Task dialog positions and sizes
-#define TASK_DIALOG_X 200
-#define TASK_DIALOG_Y 100
-#define TASK_DIALOG_WIDTH 400
-#define TASK_DIALOG_HEIGHT 400
-
-#define TASK_TITLE_INPUT_X 220
-#define TASK_TITLE_INPUT_Y 150
-#define TASK_TITLE_INPUT_WIDTH 360
-#define TASK_TITLE_INPUT_HEIGHT 30
-
-#define TASK_DESC_INPUT_X 220
-#define TASK_DESC_INPUT_Y 200
-#define TASK_DESC_INPUT_WIDTH 360
-#define TASK_DESC_INPUT_HEIGHT 60
-
-#define TASK_TYPE_X 220
-#define TASK_TYPE_Y 280
-#define TASK_TYPE_WIDTH 360
-#define TASK_TYPE_HEIGHT 30
-
-#define TASK_DIFFICULTY_X 220
-#define TASK_DIFFICULTY_Y 330
-#define TASK_DIFFICULTY_WIDTH 360
-#define TASK_DIFFICULTY_HEIGHT 30
-
-#define TASK_SAVE_BUTTON_X 220
-#define TASK_SAVE_BUTTON_Y 380
-#define TASK_SAVE_BUTTON_WIDTH 100
-#define TASK_SAVE_BUTTON_HEIGHT 30
-
-#define TASK_CANCEL_BUTTON_X 480
-#define TASK_CANCEL_BUTTON_Y 380
-#define TASK_CANCEL_BUTTON_WIDTH 100
-#define TASK_CANCEL_BUTTON_HEIGHT 30
-
-#define TASK_ITEM_WIDTH 700
+// Task list rows, in logical pixels
 #define TASK_ITEM_HEIGHT 40
 #define TASK_ITEM_SPACING 5
 #define TASK_BUTTON_SIZE 30
-
-// Filter and sort button positions
-#define FILTER_ALL_BUTTON_X 120
-#define FILTER_ALL_BUTTON_Y 50
-#define FILTER_COMPLETED_BUTTON_X 230
-#define FILTER_COMPLETED_BUTTON_Y 50
-#define FILTER_UNCOMPLETED_BUTTON_X 340
-#define FILTER_UNCOMPLETED_BUTTON_Y 50
-
-#define SORT_TYPE_BUTTON_X 450
-#define SORT_TYPE_BUTTON_Y 50
-#define SORT_DIFFICULTY_BUTTON_X 560
-#define SORT_DIFFICULTY_BUTTON_Y 50
-#define SORT_COMPLETION_BUTTON_X 670
-#define SORT_COMPLETION_BUTTON_Y 50
+#define TASK_TOGGLE_SIZE 16
+#define TASK_INDENT 20    // Per level of subtasks
+#define TAG_CHIP_WIDTH 100
+#define TAG_CHIP_SPACING 5
 
 typedef struct {
-    char title[256];
-    char description[512];
+    TextInput title;
+    TextInput description;
+    TextInput tags;   // Comma-separated names
+    TextInput due;    // As task_parse_due reads it
     int difficulty;
     int type;
     int editing_title;
     int editing_description;
-    int cursor_position;
-    time_t last_cursor_blink;
+    int editing_tags;
+    int editing_due;
+    Uint32 last_cursor_blink;
     int cursor_visible;
     int task_id;
+    int parent_id;    // New subtasks go under this task
 } TaskDialog;
 
 // Task type names
@@ -118,195 +88,1366 @@ static const char* task_difficulty_names[] = {
     "Very Hard"
 };
 
+// Sprite images, in SpriteType order
+static const char* sprite_files[SPRITE_COUNT] = {
+    "assets/sprites/background.png",
+    "assets/sprites/task_dialog.png",
+    "assets/sprites/button_normal.png",
+    "assets/sprites/button_hover.png",
+    "assets/sprites/button_pressed.png",
+    "assets/sprites/checkbox_unchecked.png",
+    "assets/sprites/checkbox_checked.png",
+    "assets/sprites/icon_habit.png",
+    "assets/sprites/icon_daily.png",
+    "assets/sprites/icon_todo.png",
+    "assets/sprites/icon_difficulty.png",
+    "assets/sprites/icon_edit.png",
+    "assets/sprites/icon_delete.png"
+};
+
+// Scene nodes. The background is cached in a texture as well, since it is
+// mostly one full-screen sprite.
+enum {
+    NODE_BACKGROUND,
+    NODE_TASK_LIST,
+    NODE_STATS,
+    NODE_DIALOG,
+    NODE_MESSAGE
+};
+
+// Ids of the tasks with a due date, in the order the last DUE response
+// had them
 typedef struct {
-    Task* tasks;
+    int* ids;
     int count;
-    int capacity;
-} TaskList;
+    Uint32 version;          // Bumped with every response
+    Uint32 list_version;     // List version the latest request was made at
+    int in_flight;
+} DueOrder;
 
-void init_task_list(TaskList* list) {
-    list->tasks = NULL;
-    list->count = 0;
-    list->capacity = 0;
+// State touched when database responses are applied on the UI thread
+typedef struct {
+    TaskList* list;
+    TagIndex* tags;          // Follows the list through the same deltas
+    ReminderQueue* reminders;  // Likewise
+    DueOrder* due;
+    Message* message;
+    DbWorker* worker;
+    Replay* replay;
+    Uint64 start_counter;
+    int backfill_pending;    // Migration backfill batches still to run
+    int backfill_in_flight;
+    TaskStats* stats;        // Latest statistics for the stats screen, or NULL
+    SceneGraph* scenes;
+    int loaded;              // The list holds a full LOAD that syncs can patch
+    sqlite3_int64 revision;  // tasks_revision the list is current to
+    int data_version;
+    int sync_in_flight;
+    int tags_in_flight;      // A TAGS request is queued
+} DbResponseContext;
+
+// Monotonic millisecond clock for UI timers, sampled once per frame. In a
+// replay it runs on the recording's time.
+static Uint32 frame_clock_ms;
+
+// Applies deltas to the tag index and the reminders, which still need the
+// rows they replace, then to the list. Tags the index has not seen before
+// get their names fetched. Returns what task_list_apply does.
+static int apply_task_deltas(DbResponseContext* ctx, const TaskDelta* deltas, int count) {
+    time_t now = time(NULL);
+    tag_index_apply(ctx->tags, ctx->list, deltas, count);
+    reminders_apply(ctx->reminders, ctx->list, deltas, count, now);
+    int rc = task_list_apply(ctx->list, deltas, count);
+    if (ctx->tags->failed) {
+        tag_index_rebuild(ctx->tags, ctx->list->tasks, ctx->list->count);
+    }
+    if (reminders_stale(ctx->reminders, ctx->list->count)) {
+        reminders_rebuild(ctx->reminders, ctx->list->tasks, ctx->list->count, now);
+    }
+    if (ctx->tags->unnamed > 0 && !ctx->tags_in_flight && ctx->worker) {
+        ctx->tags_in_flight = db_worker_submit(ctx->worker, DB_OP_TAGS, NULL) != 0;
+    }
+    return rc;
 }
 
-void free_task_list(TaskList* list) {
-    if (list->tasks) {
-        free(list->tasks);
-        list->tasks = NULL;
+void apply_db_response(const DbMessage* response, void* user_data) {
+    DbResponseContext* ctx = user_data;
+
+    replay_note_db(ctx->replay, (SDL_GetPerformanceCounter() - response->submitted) * 1000.0 /
+                   SDL_GetPerformanceFrequency());
+
+    switch (response->op) {
+        case DB_OP_LOAD:
+            if (response->status != 0) {
+                show_message(ctx->message, "Failed to load tasks!");
+                break;
+            }
+            if (task_list_replace(ctx->list, response->tasks, response->count,
+                                  response->snapshot.mapping ? &response->snapshot : NULL) != 0) {
+                show_message(ctx->message, "Failed to index tasks!");
+            }
+            tag_index_rebuild(ctx->tags, ctx->list->tasks, ctx->list->count);
+            int overdue = reminders_rebuild(ctx->reminders, ctx->list->tasks, ctx->list->count, time(NULL));
+            if (overdue > 0 && !ctx->loaded) {
+                char text[64];
+                snprintf(text, sizeof(text), "%d task%s past due", overdue, overdue == 1 ? " is" : "s are");
+                show_message(ctx->message, text);
+            }
+            ctx->loaded = 1;
+            ctx->revision = response->revision;
+            ctx->data_version = response->data_version;
+            printf("Tasks loaded after %.1f ms (%d tasks, %s)\n",
+                   (SDL_GetPerformanceCounter() - ctx->start_counter) * 1000.0 / SDL_GetPerformanceFrequency(),
+                   response->count, response->snapshot.mapping ? "snapshot" : "database");
+            break;
+        case DB_OP_CREATE:
+            // The row itself arrives with the commit's CHANGES
+            show_message(ctx->message, response->status != 0 ?
+                         "Failed to save task to database!" : "Task created successfully!");
+            break;
+        case DB_OP_UPDATE:
+        case DB_OP_DELETE:
+        case DB_OP_REBALANCE:
+        case DB_OP_MOVE:
+            // The list only changes once the write commits, so a failed
+            // write leaves nothing to undo
+            if (response->status != 0) {
+                show_message(ctx->message, response->op == DB_OP_DELETE ? "Failed to delete task!" :
+                             response->op == DB_OP_MOVE ? "Failed to move task!" : "Failed to update task!");
+            }
+            break;
+        case DB_OP_STATS:
+            if (response->status != 0) {
+                show_message(ctx->message, "Failed to load statistics!");
+                break;
+            }
+            free(ctx->stats);
+            ctx->stats = response->stats;
+            scene_invalidate(ctx->scenes, NODE_STATS);
+            break;
+        case DB_OP_BULK: {
+            static const char* done[] = {
+                [DB_BULK_COMPLETE] = "Completed",
+                [DB_BULK_UNCOMPLETE] = "Uncompleted",
+                [DB_BULK_DELETE] = "Deleted",
+                [DB_BULK_SET_DIFFICULTY] = "Changed the difficulty of",
+            };
+            char text[64];
+            if (response->status != 0) {
+                snprintf(text, sizeof(text), "Failed to update tasks!");
+            }
+            else {
+                snprintf(text, sizeof(text), "%s %d task%s", done[response->bulk], response->count,
+                         response->count == 1 ? "" : "s");
+            }
+            show_message(ctx->message, text);
+            break;
+        }
+        case DB_OP_SYNC:
+            ctx->sync_in_flight = 0;
+            if (response->status == 0) {
+                if (apply_task_deltas(ctx, response->deltas, response->count) >= 0) {
+                    ctx->revision = response->revision;
+                    ctx->data_version = response->data_version;
+                }
+                else {
+                    show_message(ctx->message, "Failed to add task to list!");
+                }
+            }
+            free(response->deltas);
+            break;
+        case DB_OP_CHANGES:
+            // Rows this connection committed, as the database has them.
+            // Deltas are idempotent, so a later sync that fetches the same
+            // rows again does no harm.
+            if (response->status != 0 || apply_task_deltas(ctx, response->deltas, response->count) < 0) {
+                if (ctx->worker) {
+                    db_worker_submit(ctx->worker, DB_OP_LOAD, NULL);
+                }
+            }
+            free(response->deltas);
+            break;
+        case DB_OP_TAGS:
+            ctx->tags_in_flight = 0;
+            if (response->status == 0) {
+                tag_index_set_names(ctx->tags, response->tags, response->count);
+            }
+            free(response->tags);
+            break;
+        case DB_OP_DUE:
+            ctx->due->in_flight = 0;
+            if (response->status != 0) {
+                show_message(ctx->message, "Failed to sort tasks by due date!");
+                break;
+            }
+            free(ctx->due->ids);
+            ctx->due->ids = response->ids;
+            ctx->due->count = response->count;
+            ctx->due->version++;
+            break;
+        case DB_OP_BACKFILL:
+            ctx->backfill_in_flight = 0;
+            ctx->backfill_pending = response->status == 0 && response->count;
+            // Rows changed underneath the loaded list; pick up the new values
+            if (response->status == 0 && !response->count && ctx->worker) {
+                db_worker_submit(ctx->worker, DB_OP_LOAD, NULL);
+            }
+            break;
+    }
+}
+
+// Whether a response counts as activity: background work does not keep
+// the loop at full rate unless it changed what is on screen. Recordings
+// store this count per frame, so replays must count the same way.
+static int db_response_counts(const DbMessage* response) {
+    return response->op != DB_OP_BACKFILL && (response->op != DB_OP_SYNC || response->count > 0);
+}
+
+// Applies responses until count of them have counted, waiting for the
+// worker if needed
+void apply_db_responses(DbWorker* worker, DbResponseContext* ctx, int count) {
+    Uint32 deadline = SDL_GetTicks() + REPLAY_DB_TIMEOUT_MS;
+    DbMessage response;
+    while (count > 0) {
+        if (db_worker_poll(worker, &response)) {
+            apply_db_response(&response, ctx);
+            count -= db_response_counts(&response);
+        }
+        else if (SDL_GetTicks() > deadline) {
+            fprintf(stderr, "Replay diverged: %d database responses never arrived\n", count);
+            break;
+        }
+        else {
+            SDL_Delay(1);
+        }
     }
-    list->count = 0;
-    list->capacity = 0;
+}
+
+// Replays run against a scratch copy so the recorded database stays
+// pristine for the next run
+int copy_replay_database(const char* log_path, char* scratch, size_t scratch_size) {
+    char seed_path[1024];
+    replay_db_path(log_path, seed_path, sizeof(seed_path));
+    snprintf(scratch, scratch_size, "%s.run", seed_path);
+
+    sqlite3* seed;
+    if (sqlite3_open_v2(seed_path, &seed, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Can't open recorded database %s\n", seed_path);
+        sqlite3_close(seed);
+        return 1;
+    }
+    int rc = db_backup(seed, scratch);
+    sqlite3_close(seed);
+    return rc;
+}
+
+// fps -1 in the config means the default rate, or none with vsync
+int target_fps(const Config* config) {
+    if (config->fps >= 0) return config->fps;
+    return config->vsync ? 0 : TARGET_FPS;
 }
 
 void show_message(Message* msg, const char* text) {
     strncpy(msg->text, text, sizeof(msg->text) - 1);
     msg->text[sizeof(msg->text) - 1] = '\0';
-    msg->show_time = time(NULL);
+    msg->show_time = frame_clock_ms;
     msg->visible = 1;
+    msg->version++;
 }
 
 void update_message(Message* msg) {
-    if (msg->visible && time(NULL) - msg->show_time >= 3) {
+    if (msg->visible && frame_clock_ms - msg->show_time >= MESSAGE_DURATION) {
         msg->visible = 0;
+        msg->version++;
     }
 }
 
-void draw_message(UI* ui, Message* msg) {
+void draw_message(DisplayList* out, const Message* msg, const Layout* layout) {
     if (msg->visible) {
-        ui_draw_text(ui, msg->text, 10, WINDOW_HEIGHT - 30);
+        const SDL_Rect* rect = layout_rect(layout, LAYOUT_MESSAGE);
+        display_list_text(out, msg->text, rect->x, rect->y);
     }
 }
 
-void draw_task_list(UI* ui, TaskList* list) {
-    if (!list || !list->tasks) return;
+// Geometry of one task row, shared by drawing and hit-testing
+typedef struct {
+    SDL_Rect row;
+    SDL_Rect toggle;    // Collapses or expands the subtasks, if any
+    SDL_Rect add;       // New subtask
+    SDL_Rect edit;
+    SDL_Rect remove;
+} TaskRowRects;
+
+// Returns 0 if the row does not fit inside the task list. Subtasks are
+// indented by depth; the buttons stay lined up on the right.
+int task_row_rects(const Layout* layout, int row, int depth, TaskRowRects* rects) {
+    const SDL_Rect* list = layout_rect(layout, LAYOUT_TASK_LIST);
+    int pad = layout_px(layout, 5);
+    int height = layout_px(layout, TASK_ITEM_HEIGHT);
+    int button = layout_px(layout, TASK_BUTTON_SIZE);
+    int toggle = layout_px(layout, TASK_TOGGLE_SIZE);
+    int indent = layout_px(layout, TASK_INDENT) * depth;
+
+    int y = list->y + layout_px(layout, 10) + row * layout_px(layout, TASK_ITEM_HEIGHT + TASK_ITEM_SPACING);
+    if (y + height > list->y + list->h) return 0;
+
+    rects->row = (SDL_Rect){list->x + pad + indent, y, list->w - layout_px(layout, 115) - indent, height};
+    rects->toggle = (SDL_Rect){rects->row.x + pad, y + (height - toggle) / 2, toggle, toggle};
+    rects->add = (SDL_Rect){rects->row.x + rects->row.w + pad, y, button, button};
+    rects->edit = (SDL_Rect){rects->add.x + button + pad, y, button, button};
+    rects->remove = (SDL_Rect){rects->edit.x + button + pad, y, button, button};
+    return 1;
+}
 
-    // Draw task list background
-    SDL_Rect list_rect = {10, 130, 780, 460};
-    SDL_SetRenderDrawColor(ui->renderer, 240, 240, 240, 255);
-    SDL_RenderFillRect(ui->renderer, &list_rect);
-    SDL_SetRenderDrawColor(ui->renderer, 0, 0, 0, 255);
-    SDL_RenderDrawRect(ui->renderer, &list_rect);
+// What the task list shows: the rows matching the tag and completion
+// filter, recomputed from the tag index when the query, the list or the
+// tags change, in manual order or sorted. A sorted list is flat, chained
+// through order_next by row index.
+typedef struct {
+    TagQuery query;
+    Bitmap rows;           // Matching task ids, while the query is active
+    TaskSort sort;
+    int chained;           // order_next follows the sort; until then rows stay in manual order
+    int* order_next;       // Row after each row, or INT_MAX at the end
+    int order_first;
+    int order_capacity;
+    Uint32 list_version;   // Versions rows were computed at
+    Uint32 tags_version;
+    Uint32 due_version;
+    int dirty;             // The query or the sort changed
+    Uint32 version;        // Bumped whenever rows are recomputed
+} TaskFilterView;
+
+// The matching task ids, or NULL when every task is shown
+const Bitmap* filter_rows(const TaskFilterView* filter) {
+    return tag_query_active(&filter->query) ? &filter->rows : NULL;
+}
 
-    // Draw tasks
+static void chain_row(TaskFilterView* filter, int* last, int index) {
+    if (*last < 0) {
+        filter->order_first = index;
+    }
+    else {
+        filter->order_next[*last] = index;
+    }
+    filter->order_next[index] = INT_MAX;
+    *last = index;
+}
+
+// Makes room for a link per row and unlinks them all
+static int reset_chain(TaskFilterView* filter, const TaskList* list) {
+    if (list->count > filter->order_capacity) {
+        int* grown = realloc(filter->order_next, list->count * sizeof(int));
+        if (!grown) return 1;
+        filter->order_next = grown;
+        filter->order_capacity = list->count;
+    }
     for (int i = 0; i < list->count; i++) {
-        Task* task = &list->tasks[i];
-        int y = 140 + (i * (TASK_ITEM_HEIGHT + TASK_ITEM_SPACING));
-        
-        // Draw task background
-        SDL_Rect task_rect = {15, y, TASK_ITEM_WIDTH, TASK_ITEM_HEIGHT};
-        SDL_SetRenderDrawColor(ui->renderer, 255, 255, 255, 255);
-        SDL_RenderFillRect(ui->renderer, &task_rect);
-        SDL_SetRenderDrawColor(ui->renderer, 200, 200, 200, 255);
-        SDL_RenderDrawRect(ui->renderer, &task_rect);
-
-        // Draw task info
-        char task_info[256];
-        snprintf(task_info, sizeof(task_info), "%s%s (%s, %s)", 
-                task->completed ? "[X] " : "[ ] ",
-                task->title,
-                task_type_names[task->type],
-                task_difficulty_names[task->difficulty]);
-        ui_draw_text(ui, task_info, 20, y + 10);
+        filter->order_next[i] = -1;
+    }
+    filter->order_first = list->count;
+    return 0;
+}
 
-        // Draw edit button
-        SDL_Rect edit_rect = {TASK_ITEM_WIDTH + 20, y, TASK_BUTTON_SIZE, TASK_BUTTON_SIZE};
-        SDL_SetRenderDrawColor(ui->renderer, 200, 200, 255, 255);
-        SDL_RenderFillRect(ui->renderer, &edit_rect);
-        SDL_SetRenderDrawColor(ui->renderer, 0, 0, 0, 255);
-        SDL_RenderDrawRect(ui->renderer, &edit_rect);
-        ui_draw_text(ui, "E", TASK_ITEM_WIDTH + 25, y + 10);
+// Chains the tasks with a due date in the order due has them, then the
+// rest in manual order. A task dated since due was read sits with the
+// rest until the next DUE response places it.
+static int chain_due_order(TaskFilterView* filter, const TaskList* list, const DueOrder* due) {
+    if (reset_chain(filter, list) != 0) return 1;
+
+    int last = -1;
+    for (int i = 0; i < due->count; i++) {
+        int index = task_list_find(list, due->ids[i]);
+        if (index >= 0 && filter->order_next[index] < 0 && list->tasks[index].due_at != 0) {
+            chain_row(filter, &last, index);
+        }
+    }
+    for (int i = 0; i < list->count; i++) {
+        if (filter->order_next[i] < 0) {
+            chain_row(filter, &last, i);
+        }
+    }
+    return 0;
+}
 
-        // Draw delete button
-        SDL_Rect delete_rect = {TASK_ITEM_WIDTH + 55, y, TASK_BUTTON_SIZE, TASK_BUTTON_SIZE};
-        SDL_SetRenderDrawColor(ui->renderer, 255, 200, 200, 255);
-        SDL_RenderFillRect(ui->renderer, &delete_rect);
-        SDL_SetRenderDrawColor(ui->renderer, 0, 0, 0, 255);
-        SDL_RenderDrawRect(ui->renderer, &delete_rect);
-        ui_draw_text(ui, "D", TASK_ITEM_WIDTH + 60, y + 10);
+typedef struct {
+    int key;
+    int index;
+} RowKey;
+
+// Ties keep manual order
+static int compare_row_keys(const void* a, const void* b) {
+    const RowKey* x = a;
+    const RowKey* y = b;
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    return x->index - y->index;
+}
+
+// Type, difficulty and completion are sorted in memory; uncompleted
+// tasks come first
+static int chain_sorted_order(TaskFilterView* filter, const TaskList* list) {
+    if (reset_chain(filter, list) != 0) return 1;
+    RowKey* keys = malloc((list->count > 0 ? list->count : 1) * sizeof(RowKey));
+    if (!keys) return 1;
+
+    for (int i = 0; i < list->count; i++) {
+        const Task* task = &list->tasks[i];
+        keys[i].key = filter->sort == TASK_SORT_TYPE ? task->type :
+                      filter->sort == TASK_SORT_DIFFICULTY ? task->difficulty : task->completed != 0;
+        keys[i].index = i;
     }
+    qsort(keys, list->count, sizeof(RowKey), compare_row_keys);
+
+    int last = -1;
+    for (int i = 0; i < list->count; i++) {
+        chain_row(filter, &last, keys[i].index);
+    }
+    free(keys);
+    return 0;
 }
 
-void handle_text_input(TaskDialog* dialog, SDL_Event* event) {
-    if (!dialog || !event) return;
+// Clicking the button of the current sort returns to manual order
+void toggle_sort(TaskFilterView* filter, TaskSort sort) {
+    filter->sort = filter->sort == sort ? TASK_SORT_MANUAL : sort;
+    filter->dirty = 1;
+}
 
-    if (dialog->editing_title) {
-        if (event->key.keysym.sym == SDLK_BACKSPACE && dialog->cursor_position > 0) {
-            dialog->title[--dialog->cursor_position] = '\0';
-        }
-        else if (event->key.keysym.sym == SDLK_DELETE && dialog->cursor_position < strlen(dialog->title)) {
-            memmove(&dialog->title[dialog->cursor_position],
-                   &dialog->title[dialog->cursor_position + 1],
-                   strlen(dialog->title) - dialog->cursor_position);
+void update_filter(TaskFilterView* filter, const TaskList* list, const TagIndex* tags, const DueOrder* due,
+                   Message* message) {
+    if (!filter->dirty && filter->list_version == list->version && filter->tags_version == tags->version &&
+        filter->due_version == due->version) return;
+
+    if (tag_query_active(&filter->query) && tag_index_query(tags, &filter->query, &filter->rows) != 0) {
+        show_message(message, "Failed to filter tasks!");
+        memset(&filter->query, 0, sizeof(TagQuery));
+    }
+    filter->chained = filter->sort != TASK_SORT_MANUAL &&
+                      (filter->sort == TASK_SORT_DUE ? chain_due_order(filter, list, due) :
+                                                       chain_sorted_order(filter, list)) == 0;
+    if (filter->sort != TASK_SORT_MANUAL && !filter->chained) {
+        show_message(message, "Failed to sort tasks!");
+        filter->sort = TASK_SORT_MANUAL;
+    }
+    filter->list_version = list->version;
+    filter->tags_version = tags->version;
+    filter->due_version = due->version;
+    filter->dirty = 0;
+    filter->version++;
+}
+
+// Index of the next row on screen after index, or of the first one for
+// -1, list->count at the end. Rows outside the filter are skipped, and in
+// manual order so are rows under a collapsed task.
+int next_row(const TaskList* list, const TaskFilterView* filter, int index) {
+    const Bitmap* shown = filter_rows(filter);
+    int chained = filter->chained;
+    do {
+        if (chained) {
+            // The last row links past the end, as may rows chained before
+            // the list shrank
+            index = index < 0 ? filter->order_first : filter->order_next[index];
+            if (index > list->count) index = list->count;
         }
-        else if (event->key.keysym.sym == SDLK_LEFT && dialog->cursor_position > 0) {
-            dialog->cursor_position--;
+        else {
+            index = index < 0 ? 0 : task_list_next_visible(list, index);
         }
-        else if (event->key.keysym.sym == SDLK_RIGHT && dialog->cursor_position < strlen(dialog->title)) {
-            dialog->cursor_position++;
+    } while (shown && index < list->count && !bitmap_contains(shown, (Uint32)list->tasks[index].id));
+    return index;
+}
+
+// Subtasks are indented in manual order only
+int row_depth(const TaskList* list, const TaskFilterView* filter, int index) {
+    return filter->chained ? 0 : task_list_depth(list, index);
+}
+
+// Index of the task shown under y, clamped to the first and last rows
+int task_drop_index(const Layout* layout, const TaskList* list, const TaskFilterView* filter, int y) {
+    TaskRowRects rects;
+    int first = next_row(list, filter, -1);
+    int index = first < list->count ? first : 0;
+    for (int i = first, row = 0; i < list->count && task_row_rects(layout, row, 0, &rects);
+         i = next_row(list, filter, i), row++) {
+        if (y >= rects.row.y) index = i;
+    }
+    return index;
+}
+
+// Selects the rows between indices from and to that are shown, whatever
+// order the screen has them in
+void select_index_range(TaskList* list, const Bitmap* shown, int from, int to) {
+    if (!shown) {
+        task_list_select_range(list, from, to);
+        return;
+    }
+    if (from > to) {
+        int swap = from;
+        from = to;
+        to = swap;
+    }
+    for (int i = from < 0 ? 0 : from; i <= to && i < list->count; i++) {
+        if (bitmap_contains(shown, (Uint32)list->tasks[i].id)) {
+            task_list_select(list, list->tasks[i].id, 1);
         }
-        else if (event->key.keysym.sym == SDLK_HOME) {
-            dialog->cursor_position = 0;
+    }
+}
+
+// Selects the rows from and to and those between them on screen
+void select_rows(TaskList* list, const TaskFilterView* filter, int from, int to) {
+    if (!filter->chained) {
+        select_index_range(list, filter_rows(filter), from, to);
+        return;
+    }
+    int inside = 0;
+    for (int i = next_row(list, filter, -1); i < list->count; i = next_row(list, filter, i)) {
+        int end = i == from || i == to;
+        if (inside || end) {
+            task_list_select(list, list->tasks[i].id, 1);
         }
-        else if (event->key.keysym.sym == SDLK_END) {
-            dialog->cursor_position = strlen(dialog->title);
+        if (end && (inside || from == to)) break;
+        inside |= end;
+    }
+}
+
+// Tags get a chip in the bar once they have a name and a task, or while
+// they are part of the query
+int tag_has_chip(const TagEntry* entry, const TagQuery* query) {
+    return entry->tag.name[0] != '\0' &&
+           (bitmap_cardinality(&entry->tasks) > 0 || tag_query_match(query, entry->tag.id) != TAG_MATCH_OFF);
+}
+
+// Returns 0 if chip number slot does not fit in the tag bar
+int tag_chip_rect(const Layout* layout, int slot, SDL_Rect* rect) {
+    const SDL_Rect* bar = layout_rect(layout, LAYOUT_TAG_BAR);
+    int width = layout_px(layout, TAG_CHIP_WIDTH);
+    int x = bar->x + slot * (width + layout_px(layout, TAG_CHIP_SPACING));
+    if (x + width > bar->x + bar->w) return 0;
+    *rect = (SDL_Rect){x, bar->y, width, bar->h};
+    return 1;
+}
+
+// Names of the task's tags, comma-separated, into out
+void format_tags(const TagIndex* tags, const Task* task, char* out, size_t size) {
+    size_t used = 0;
+    out[0] = '\0';
+    for (int i = 0; i < task->tag_count && used < size; i++) {
+        const TagEntry* entry = tag_index_find(tags, task->tags[i]);
+        if (!entry || entry->tag.name[0] == '\0') continue;
+        int n = snprintf(out + used, size - used, "%s%s", used > 0 ? ", " : "", entry->tag.name);
+        if (n < 0) break;
+        used += (size_t)n;
+    }
+}
+
+int rect_hit(const SDL_Rect* rect, int x, int y) {
+    return x >= rect->x && x <= rect->x + rect->w &&
+           y >= rect->y && y <= rect->y + rect->h;
+}
+
+// A filled, outlined box with a centred label
+void draw_box(DisplayList* out, const char* label, const SDL_Rect* rect, Uint8 r, Uint8 g, Uint8 b) {
+    display_list_color(out, r, g, b);
+    display_list_fill_rect(out, rect);
+    display_list_color(out, 0, 0, 0);
+    display_list_rect(out, rect);
+    display_list_label(out, label, rect);
+}
+
+// A frame just outside the button id, marking it as the one in use
+void draw_button_frame(DisplayList* out, const Layout* layout, LayoutId id) {
+    SDL_Rect frame = *layout_rect(layout, id);
+    int inset = layout_px(layout, 1);
+    frame.x -= inset;
+    frame.y -= inset;
+    frame.w += 2 * inset;
+    frame.h += 2 * inset;
+    display_list_color(out, 60, 90, 200);
+    display_list_rect(out, &frame);
+}
+
+// One chip per tag, coloured by how it takes part in the query, and a
+// frame around the completion filter in use and the due date sort
+void draw_tag_bar(DisplayList* out, const TagIndex* tags, const TaskFilterView* filter, Arena* frame_arena,
+                  const Layout* layout) {
+    const TagQuery* query = &filter->query;
+    static const Uint8 colors[TAG_MATCH_COUNT][3] = {
+        [TAG_MATCH_OFF]  = {230, 230, 230},
+        [TAG_MATCH_ALL]  = {170, 220, 170},
+        [TAG_MATCH_ANY]  = {170, 200, 240},
+        [TAG_MATCH_NONE] = {240, 180, 180},
+    };
+    SDL_Rect chip;
+    for (int i = 0, slot = 0; i < tags->count && tag_chip_rect(layout, slot, &chip); i++) {
+        const TagEntry* entry = &tags->entries[i];
+        if (!tag_has_chip(entry, query)) continue;
+        const Uint8* color = colors[tag_query_match(query, entry->tag.id)];
+        draw_box(out, arena_printf(frame_arena, "%s (%d)", entry->tag.name, bitmap_cardinality(&entry->tasks)),
+                 &chip, color[0], color[1], color[2]);
+        slot++;
+    }
+
+    static const LayoutId filter_buttons[] = {
+        [TASK_FILTER_ALL] = LAYOUT_FILTER_ALL_BUTTON,
+        [TASK_FILTER_COMPLETED] = LAYOUT_FILTER_COMPLETED_BUTTON,
+        [TASK_FILTER_UNCOMPLETED] = LAYOUT_FILTER_UNCOMPLETED_BUTTON,
+    };
+    draw_button_frame(out, layout, filter_buttons[query->completion]);
+    static const LayoutId sort_buttons[] = {
+        [TASK_SORT_TYPE] = LAYOUT_SORT_TYPE_BUTTON,
+        [TASK_SORT_DIFFICULTY] = LAYOUT_SORT_DIFFICULTY_BUTTON,
+        [TASK_SORT_COMPLETION] = LAYOUT_SORT_COMPLETION_BUTTON,
+        [TASK_SORT_DUE] = LAYOUT_SORT_DUE_BUTTON,
+    };
+    if (filter->sort != TASK_SORT_MANUAL) {
+        draw_button_frame(out, layout, sort_buttons[filter->sort]);
+    }
+}
+
+// dragged and drop are task indices of a drag in progress, or -1.
+// The subtasks of collapsed tasks are skipped over without being visited;
+// so are tasks outside the filter.
+void draw_task_list(DisplayList* out, const TaskList* list, const TaskFilterView* filter, const TagIndex* tags,
+                    Arena* frame_arena, const Layout* layout, int dragged, int drop) {
+    if (!list || !list->tasks) return;
+
+    // Draw task list background
+    const SDL_Rect* list_rect = layout_rect(layout, LAYOUT_TASK_LIST);
+    display_list_color(out, 240, 240, 240);
+    display_list_fill_rect(out, list_rect);
+    display_list_color(out, 0, 0, 0);
+    display_list_rect(out, list_rect);
+
+    // A dragged task takes its subtasks along, and lands after those of
+    // the row it is dropped on when moving down
+    int show_drop = dragged >= 0 && dragged < list->count && drop >= 0 && drop < list->count;
+    int dragged_end = show_drop ? dragged + 1 + list->tasks[dragged].subtasks : -1;
+    int drop_end = show_drop ? drop + 1 + list->tasks[drop].subtasks : -1;
+    if (drop_end > list->count) drop_end = list->count;
+    show_drop = show_drop && (drop < dragged || drop >= dragged_end);
+
+    // Draw tasks that fit inside the list
+    int text_inset = layout_px(layout, 5);
+    TaskRowRects rects;
+    for (int i = next_row(list, filter, -1), row = 0;
+         i < list->count && task_row_rects(layout, row, row_depth(list, filter, i), &rects);
+         i = next_row(list, filter, i), row++) {
+        const Task* task = &list->tasks[i];
+
+        // Draw task background
+        if (i == dragged) {
+            display_list_color(out, 225, 235, 255);
         }
-        else if (event->text.text[0] >= 32 && event->text.text[0] <= 126 &&
-                 strlen(dialog->title) < 255) {
-            memmove(&dialog->title[dialog->cursor_position + 1],
-                   &dialog->title[dialog->cursor_position],
-                   strlen(dialog->title) - dialog->cursor_position + 1);
-            dialog->title[dialog->cursor_position++] = event->text.text[0];
+        else if (task_list_is_selected(list, task->id)) {
+            display_list_color(out, 255, 240, 190);
         }
-    }
-    else if (dialog->editing_description) {
-        if (event->key.keysym.sym == SDLK_BACKSPACE && dialog->cursor_position > 0) {
-            dialog->description[--dialog->cursor_position] = '\0';
+        else {
+            display_list_color(out, 255, 255, 255);
         }
-        else if (event->key.keysym.sym == SDLK_DELETE && dialog->cursor_position < strlen(dialog->description)) {
-            memmove(&dialog->description[dialog->cursor_position],
-                   &dialog->description[dialog->cursor_position + 1],
-                   strlen(dialog->description) - dialog->cursor_position);
+        display_list_fill_rect(out, &rects.row);
+        display_list_color(out, 200, 200, 200);
+        display_list_rect(out, &rects.row);
+
+        // Mark where a dragged task would land: above the hovered row when
+        // moving up, below its last visible subtask when moving down
+        if (show_drop && (drop < dragged ? i == drop :
+                          i >= drop && next_row(list, filter, i) >= drop_end)) {
+            int bar = layout_px(layout, 2);
+            int y = drop < dragged ? rects.row.y - bar : rects.row.y + rects.row.h;
+            SDL_Rect marker = {rects.row.x, y, rects.row.w, bar};
+            display_list_color(out, 60, 90, 200);
+            display_list_fill_rect(out, &marker);
         }
-        else if (event->key.keysym.sym == SDLK_LEFT && dialog->cursor_position > 0) {
-            dialog->cursor_position--;
+
+        // Draw the subtask toggle and progress, then the task info
+        const char* progress = "";
+        if (task->subtasks > 0) {
+            draw_box(out, task->collapsed ? "+" : "-", &rects.toggle, 230, 230, 230);
+            progress = arena_printf(frame_arena, " %d/%d", task->subtasks_completed, task->subtasks);
         }
-        else if (event->key.keysym.sym == SDLK_RIGHT && dialog->cursor_position < strlen(dialog->description)) {
-            dialog->cursor_position++;
+        char tag_names[TASK_MAX_TAGS * TAG_NAME_MAX];
+        format_tags(tags, task, tag_names, sizeof(tag_names));
+        char due[32];
+        task_format_due(task->due_at, due, sizeof(due));
+        const char* task_info = arena_printf(frame_arena, "%s%s (%s, %s)%s%s%s%s%s%s",
+                task->completed ? "[X] " : "[ ] ",
+                task->title,
+                task_type_names[task->type],
+                task_difficulty_names[task->difficulty],
+                progress,
+                tag_names[0] ? " [" : "", tag_names, tag_names[0] ? "]" : "",
+                due[0] ? " due " : "", due);
+        display_list_text(out, task_info, rects.toggle.x + rects.toggle.w + text_inset,
+                          rects.row.y + layout_px(layout, 10));
+
+        // Draw subtask, edit and delete buttons
+        draw_box(out, "+", &rects.add, 200, 230, 200);
+        draw_box(out, "E", &rects.edit, 200, 200, 255);
+        draw_box(out, "D", &rects.remove, 255, 200, 200);
+    }
+
+    // Actions on the selection
+    if (list->selected_count > 0) {
+        draw_box(out, "Complete", layout_rect(layout, LAYOUT_BULK_COMPLETE_BUTTON), 200, 230, 200);
+        draw_box(out, "Uncomplete", layout_rect(layout, LAYOUT_BULK_UNCOMPLETE_BUTTON), 200, 200, 200);
+        draw_box(out, "Delete", layout_rect(layout, LAYOUT_BULK_DELETE_BUTTON), 255, 200, 200);
+        draw_box(out, "Difficulty", layout_rect(layout, LAYOUT_BULK_DIFFICULTY_BUTTON), 200, 200, 255);
+    }
+}
+
+void draw_sprite_button(DisplayList* out, const char* label, const SDL_Rect* rect) {
+    display_list_sprite(out, SPRITE_BUTTON_NORMAL, rect);
+    display_list_label(out, label, rect);
+}
+
+void draw_rect_button(DisplayList* out, const char* label, const SDL_Rect* rect) {
+    draw_box(out, label, rect, 200, 200, 200);
+}
+
+// Background, title and the fixed buttons of the main screen
+void draw_static_layer(DisplayList* out, const Layout* layout) {
+    // Draw background
+    const SDL_Rect* root = layout_rect(layout, LAYOUT_ROOT);
+    SDL_Rect background = {0, 0, root->w, root->h};
+    display_list_sprite(out, SPRITE_BACKGROUND, &background);
+    const SDL_Rect* title = layout_rect(layout, LAYOUT_TITLE);
+    display_list_text(out, "Heroman project", title->x, title->y);
+
+    // Draw filter buttons
+    draw_sprite_button(out, "All", layout_rect(layout, LAYOUT_FILTER_ALL_BUTTON));
+    draw_sprite_button(out, "Completed", layout_rect(layout, LAYOUT_FILTER_COMPLETED_BUTTON));
+    draw_sprite_button(out, "Uncompleted", layout_rect(layout, LAYOUT_FILTER_UNCOMPLETED_BUTTON));
+
+    // Draw sort buttons
+    draw_sprite_button(out, "Type", layout_rect(layout, LAYOUT_SORT_TYPE_BUTTON));
+    draw_sprite_button(out, "Difficulty", layout_rect(layout, LAYOUT_SORT_DIFFICULTY_BUTTON));
+    draw_sprite_button(out, "Completion", layout_rect(layout, LAYOUT_SORT_COMPLETION_BUTTON));
+    draw_sprite_button(out, "Due date", layout_rect(layout, LAYOUT_SORT_DUE_BUTTON));
+
+    // Draw main menu
+    draw_rect_button(out, "New Task", layout_rect(layout, LAYOUT_NEW_TASK_BUTTON));
+    draw_rect_button(out, "Quit", layout_rect(layout, LAYOUT_QUIT_BUTTON));
+    draw_rect_button(out, "Stats", layout_rect(layout, LAYOUT_STATS_BUTTON));
+}
+
+// Completions per day as bars, with the running experience total drawn
+// over them, and the completion rate by type and difficulty below
+void draw_stats(DisplayList* out, const TaskStats* stats, Arena* frame_arena, const Layout* layout) {
+    const SDL_Rect* panel = layout_rect(layout, LAYOUT_TASK_LIST);
+    display_list_color(out, 240, 240, 240);
+    display_list_fill_rect(out, panel);
+    display_list_color(out, 0, 0, 0);
+    display_list_rect(out, panel);
+
+    int inset = layout_px(layout, 10);
+    if (!stats) {
+        display_list_text(out, "Loading statistics...", panel->x + inset, panel->y + inset);
+        return;
+    }
+
+    int max_completions = 1;
+    int week_completions = 0;
+    long long experience = stats->experience_before;
+    long long max_experience = 1;
+    for (int i = 0; i < DB_STATS_DAYS; i++) {
+        if (stats->completions[i] > max_completions) max_completions = stats->completions[i];
+        if (i >= DB_STATS_DAYS - 7) week_completions += stats->completions[i];
+        experience += stats->experience[i];
+        if (experience > max_experience) max_experience = experience;
+    }
+    display_list_text(out, arena_printf(frame_arena, "Completions per day: %d this week. Experience: %lld",
+                                        week_completions, experience),
+                      panel->x + inset, panel->y + inset);
+
+    const SDL_Rect* chart = layout_rect(layout, LAYOUT_STATS_CHART);
+    display_list_color(out, 255, 255, 255);
+    display_list_fill_rect(out, chart);
+    display_list_color(out, 200, 200, 200);
+    display_list_rect(out, chart);
+
+    int slot = chart->w / DB_STATS_DAYS;
+    int gap = slot / 5;
+    SDL_Point line[DB_STATS_DAYS];
+    experience = stats->experience_before;
+    display_list_color(out, 120, 170, 120);
+    for (int i = 0; i < DB_STATS_DAYS; i++) {
+        int height = (int)((long long)(chart->h - 2) * stats->completions[i] / max_completions);
+        SDL_Rect bar = {chart->x + i * slot + gap, chart->y + chart->h - 1 - height, slot - 2 * gap, height};
+        display_list_fill_rect(out, &bar);
+
+        experience += stats->experience[i];
+        line[i].x = chart->x + i * slot + slot / 2;
+        line[i].y = chart->y + chart->h - 1 - (int)((chart->h - 2) * experience / max_experience);
+    }
+    display_list_color(out, 60, 90, 200);
+    display_list_lines(out, line, DB_STATS_DAYS);
+
+    // Dates under the first and last bars, without the year
+    int label_y = chart->y + chart->h + layout_px(layout, 5);
+    display_list_text(out, stats->days[0] + 5, chart->x, label_y);
+    display_list_text(out, "Today", chart->x + chart->w - slot, label_y);
+
+    // Completed / total, one row per type and one column per difficulty
+    const SDL_Rect* table = layout_rect(layout, LAYOUT_STATS_TABLE);
+    int column = table->w / (DB_STATS_DIFFICULTIES + 1);
+    int row = layout_px(layout, 24);
+    for (int d = 0; d < DB_STATS_DIFFICULTIES; d++) {
+        display_list_text(out, task_difficulty_names[d], table->x + (d + 1) * column, table->y);
+    }
+    for (int t = 0; t < DB_STATS_TYPES; t++) {
+        int y = table->y + (t + 1) * row;
+        if (y + row > table->y + table->h) break;
+        display_list_text(out, task_type_names[t], table->x, y);
+        for (int d = 0; d < DB_STATS_DIFFICULTIES; d++) {
+            int total = stats->tasks[t][d];
+            const char* cell = total == 0 ? "-" :
+                arena_printf(frame_arena, "%d/%d (%d%%)", stats->completed[t][d], total,
+                             stats->completed[t][d] * 100 / total);
+            display_list_text(out, cell, table->x + (d + 1) * column, y);
         }
-        else if (event->key.keysym.sym == SDLK_HOME) {
-            dialog->cursor_position = 0;
+    }
+}
+
+// Draws a labelled input box; the label sits just above it
+void draw_field(DisplayList* out, const Layout* layout, const char* label, const SDL_Rect* rect,
+                const char* text, Uint8 shade) {
+    int inset = layout_px(layout, 5);
+    display_list_text(out, label, rect->x, rect->y - layout_px(layout, 20));
+    display_list_color(out, shade, shade, shade);
+    display_list_fill_rect(out, rect);
+    display_list_color(out, 0, 0, 0);
+    display_list_rect(out, rect);
+    display_list_text(out, text, rect->x + inset, rect->y + inset);
+}
+
+
+// Output pixels per logical pixel. Where window coordinates are points
+// (macOS), the backing store ratio is the scale; elsewhere the window is
+// sized in pixels and the display DPI decides.
+float display_scale(SDL_Window* window, SDL_Renderer* renderer, float* pixel_ratio) {
+    int window_w, window_h, output_w, output_h;
+    SDL_GetWindowSize(window, &window_w, &window_h);
+    if (SDL_GetRendererOutputSize(renderer, &output_w, &output_h) != 0 || window_w <= 0) {
+        output_w = window_w;
+    }
+    *pixel_ratio = window_w > 0 ? (float)output_w / window_w : 1.0f;
+    if (*pixel_ratio > 1.0f) return *pixel_ratio;
+
+    float dpi;
+    if (SDL_GetDisplayDPI(SDL_GetWindowDisplayIndex(window), NULL, &dpi, NULL) != 0 || dpi <= 0) {
+        return 1.0f;
+    }
+    // Quarter steps keep fonts and rects stable across small DPI differences
+    float scale = (int)(dpi / 96.0f * 4 + 0.5f) / 4.0f;
+    return scale < 1.0f ? 1.0f : scale;
+}
+
+void init_task_dialog(TaskDialog* dialog, Font* font) {
+    memset(dialog, 0, sizeof(TaskDialog));
+    text_input_init(&dialog->title, font, 255);
+    text_input_init(&dialog->description, font, 511);
+    text_input_init(&dialog->tags, font, 255);
+    text_input_init(&dialog->due, font, 31);
+    dialog->difficulty = 2; // Default to medium difficulty
+    dialog->type = 0; // Default to habit
+}
+
+// Returns 1 if the event was consumed by the field being edited
+int handle_text_input(TaskDialog* dialog, SDL_Event* event) {
+    if (!dialog || !event) return 0;
+
+    TextInput* input = NULL;
+    if (dialog->editing_title) {
+        input = &dialog->title;
+    }
+    else if (dialog->editing_description) {
+        input = &dialog->description;
+    }
+    else if (dialog->editing_tags) {
+        input = &dialog->tags;
+    }
+    else if (dialog->editing_due) {
+        input = &dialog->due;
+    }
+    if (!input) return 0;
+
+    if (event->type == SDL_TEXTINPUT) {
+        text_input_insert(input, event->text.text);
+        return 1;
+    }
+    if (event->type == SDL_KEYDOWN) {
+        return text_input_handle_key(input, event->key.keysym.sym);
+    }
+    return 0;
+}
+
+void draw_cursor(DisplayList* out, int x, int y, int height, int visible) {
+    if (!visible) return;
+
+    display_list_color(out, 0, 0, 0);
+    display_list_line(out, x, y, x, y + height);
+}
+
+// The task dialog over the title; the rest of the screen stays black
+void draw_task_dialog(DisplayList* out, TaskDialog* dialog, const Layout* layout) {
+    const SDL_Rect* title = layout_rect(layout, LAYOUT_TITLE);
+    display_list_text(out, "Heroman project", title->x, title->y);
+
+    // Draw task dialog
+    const SDL_Rect* dialog_rect = layout_rect(layout, LAYOUT_DIALOG);
+    display_list_color(out, 50, 50, 50);
+    display_list_fill_rect(out, dialog_rect);
+    display_list_color(out, 200, 200, 200);
+    display_list_rect(out, dialog_rect);
+
+    const SDL_Rect* heading = layout_rect(layout, LAYOUT_DIALOG_HEADING);
+    display_list_text(out, dialog->parent_id != 0 ? "New Subtask" : "New Task", heading->x, heading->y);
+
+    // Draw text inputs, with the caret in the one being edited
+    int inset = layout_px(layout, 5);
+    const SDL_Rect* title_rect = layout_rect(layout, LAYOUT_DIALOG_TITLE_INPUT);
+    draw_field(out, layout, "Title:", title_rect, text_input_get(&dialog->title), 255);
+    if (dialog->editing_title) {
+        int cursor_x = title_rect->x + inset + text_input_caret_x(&dialog->title);
+        draw_cursor(out, cursor_x, title_rect->y + inset, title_rect->h - 2 * inset,
+                    dialog->cursor_visible);
+    }
+
+    const SDL_Rect* desc_rect = layout_rect(layout, LAYOUT_DIALOG_DESC_INPUT);
+    draw_field(out, layout, "Description:", desc_rect, text_input_get(&dialog->description), 255);
+    if (dialog->editing_description) {
+        int cursor_x = desc_rect->x + inset + text_input_caret_x(&dialog->description);
+        draw_cursor(out, cursor_x, desc_rect->y + inset, desc_rect->h - 2 * inset,
+                    dialog->cursor_visible);
+    }
+
+    // Draw type and difficulty selection
+    draw_field(out, layout, "Type:", layout_rect(layout, LAYOUT_DIALOG_TYPE),
+               task_type_names[dialog->type], 200);
+    draw_field(out, layout, "Difficulty:", layout_rect(layout, LAYOUT_DIALOG_DIFFICULTY),
+               task_difficulty_names[dialog->difficulty], 200);
+
+    const SDL_Rect* tags_rect = layout_rect(layout, LAYOUT_DIALOG_TAGS_INPUT);
+    draw_field(out, layout, "Tags, comma-separated:", tags_rect, text_input_get(&dialog->tags), 255);
+    if (dialog->editing_tags) {
+        int cursor_x = tags_rect->x + inset + text_input_caret_x(&dialog->tags);
+        draw_cursor(out, cursor_x, tags_rect->y + inset, tags_rect->h - 2 * inset,
+                    dialog->cursor_visible);
+    }
+
+    const SDL_Rect* due_rect = layout_rect(layout, LAYOUT_DIALOG_DUE_INPUT);
+    draw_field(out, layout, "Due (YYYY-MM-DD HH:MM):", due_rect, text_input_get(&dialog->due), 255);
+    if (dialog->editing_due) {
+        int cursor_x = due_rect->x + inset + text_input_caret_x(&dialog->due);
+        draw_cursor(out, cursor_x, due_rect->y + inset, due_rect->h - 2 * inset,
+                    dialog->cursor_visible);
+    }
+
+    // Draw buttons
+    draw_rect_button(out, "Save", layout_rect(layout, LAYOUT_DIALOG_SAVE_BUTTON));
+    draw_rect_button(out, "Cancel", layout_rect(layout, LAYOUT_DIALOG_CANCEL_BUTTON));
+}
+
+// What the node builders read
+typedef struct {
+    const Layout* layout;
+    Arena* frame_arena;
+    const TaskList* tasks;
+    const TagIndex* tags;
+    const TaskFilterView* filter;
+    TaskStats* const* stats;
+    TaskDialog* dialog;
+    const Message* message;
+    int pressed_task;
+    int drop_index;
+} Screen;
+
+static void build_background(DisplayList* out, void* context) {
+    const Screen* screen = context;
+    draw_static_layer(out, screen->layout);
+}
+
+static void build_task_list(DisplayList* out, void* context) {
+    const Screen* screen = context;
+    draw_tag_bar(out, screen->tags, screen->filter, screen->frame_arena, screen->layout);
+    draw_task_list(out, screen->tasks, screen->filter, screen->tags, screen->frame_arena,
+                   screen->layout, screen->pressed_task, screen->drop_index);
+}
+
+static void build_stats(DisplayList* out, void* context) {
+    const Screen* screen = context;
+    draw_stats(out, screen->stats ? *screen->stats : NULL, screen->frame_arena, screen->layout);
+}
+
+static void build_dialog(DisplayList* out, void* context) {
+    const Screen* screen = context;
+    draw_task_dialog(out, screen->dialog, screen->layout);
+}
+
+static void build_message(DisplayList* out, void* context) {
+    const Screen* screen = context;
+    draw_message(out, screen->message, screen->layout);
+}
+
+// The menu, inventory and quest screens have nothing of their own yet
+void init_scenes(SceneGraph* scenes) {
+    scene_graph_init(scenes);
+    scene_graph_add_node(scenes, NODE_BACKGROUND, build_background, 1);
+    scene_graph_add_node(scenes, NODE_TASK_LIST, build_task_list, 0);
+    scene_graph_add_node(scenes, NODE_STATS, build_stats, 0);
+    scene_graph_add_node(scenes, NODE_DIALOG, build_dialog, 0);
+    scene_graph_add_node(scenes, NODE_MESSAGE, build_message, 0);
+
+    scene_graph_show(scenes, GAME_STATE_PLAYING, NODE_BACKGROUND);
+    scene_graph_show(scenes, GAME_STATE_PLAYING, NODE_TASK_LIST);
+    scene_graph_show(scenes, GAME_STATE_PLAYING, NODE_MESSAGE);
+
+    scene_graph_show(scenes, GAME_STATE_STATS, NODE_BACKGROUND);
+    scene_graph_show(scenes, GAME_STATE_STATS, NODE_STATS);
+    scene_graph_show(scenes, GAME_STATE_STATS, NODE_MESSAGE);
+
+    scene_graph_show(scenes, GAME_STATE_TASK_DIALOG, NODE_DIALOG);
+    scene_graph_show(scenes, GAME_STATE_TASK_DIALOG, NODE_MESSAGE);
+}
+
+// Invalidates the nodes whose inputs can be summarized as a key
+void track_scenes(SceneGraph* scenes, const Screen* screen) {
+    Uint64 drag = ((Uint64)(screen->pressed_task + 1) & 0xFFFF) << 16 |
+                  ((Uint64)(screen->drop_index + 1) & 0xFFFF);
+    // Both versions only grow, so their sum moves whenever either does.
+    // The filter's also follows the tag names.
+    Uint32 rows = screen->tasks->version + screen->filter->version;
+    scene_track(scenes, NODE_TASK_LIST, (Uint64)rows << 32 | drag);
+    scene_track(scenes, NODE_MESSAGE, screen->message->version);
+}
+
+// Queues action on every selected task as one request, which the worker
+// runs as one transaction, and clears the selection. The rows change once
+// it commits.
+void submit_bulk_action(DbWorker* worker, TaskList* list, Message* message, DbBulkAction action, int value) {
+    int* ids = malloc(list->selected_count * sizeof(int));
+    int count = ids ? task_list_selected_ids(list, ids) : 0;
+    if (count > 0 && db_worker_submit_bulk(worker, action, value, ids, count) != 0) {
+        task_list_clear_selection(list);
+    }
+    else {
+        show_message(message, "Failed to update tasks!");
+    }
+    free(ids);
+}
+
+// Screens rendered by --headless, each saved as <name>.png
+typedef struct {
+    const char* name;
+    float scale;
+    GameState state;
+} HeadlessScene;
+
+static const HeadlessScene headless_scenes[] = {
+    {"main", 1.0f, GAME_STATE_PLAYING},
+    {"dialog", 1.0f, GAME_STATE_TASK_DIALOG},
+    {"main_2x", 2.0f, GAME_STATE_PLAYING},
+};
+
+// Fixed tasks, so the output only changes when drawing does
+static int headless_fixture(TaskList* list, TagIndex* tag_index) {
+    static const Tag tags[] = {{1, "home"}, {2, "work"}};
+    static const struct {
+        const char* title;
+        int difficulty;
+        int type;
+        int completed;
+        int parent_id;
+        int tag_id;
+    } rows[] = {
+        {"Morning run", 2, 0, 1, 0, 0},
+        {"Read 20 pages", 1, 1, 0, 0, 1},
+        {"File taxes", 4, 2, 0, 0, 1},
+        {"Water the plants", 0, 1, 1, 0, 1},
+        {"Write the report", 3, 2, 0, 0, 2},
+        {"Outline", 1, 2, 1, 5, 2},
+        {"Draft", 2, 2, 0, 5, 0},
+    };
+    int count = (int)(sizeof(rows) / sizeof(rows[0]));
+    Task* tasks = malloc(count * sizeof(Task));
+    if (!tasks) return 1;
+    for (int i = 0; i < count; i++) {
+        task_init(&tasks[i], rows[i].title, "", rows[i].difficulty, rows[i].type);
+        tasks[i].id = i + 1;
+        tasks[i].position = i + 1;
+        tasks[i].completed = rows[i].completed;
+        tasks[i].parent_id = rows[i].parent_id;
+        if (rows[i].tag_id != 0) {
+            tasks[i].tags[tasks[i].tag_count++] = rows[i].tag_id;
         }
-        else if (event->key.keysym.sym == SDLK_END) {
-            dialog->cursor_position = strlen(dialog->description);
+        for (int parent = rows[i].parent_id; parent != 0; parent = rows[parent - 1].parent_id) {
+            tasks[parent - 1].subtasks++;
+            tasks[parent - 1].subtasks_completed += rows[i].completed;
         }
-        else if (event->text.text[0] >= 32 && event->text.text[0] <= 126 &&
-                 strlen(dialog->description) < 511) {
-            memmove(&dialog->description[dialog->cursor_position + 1],
-                   &dialog->description[dialog->cursor_position],
-                   strlen(dialog->description) - dialog->cursor_position + 1);
-            dialog->description[dialog->cursor_position++] = event->text.text[0];
+    }
+    if (task_list_replace(list, tasks, count, NULL) != 0) return 1;
+    tag_index_set_names(tag_index, tags, (int)(sizeof(tags) / sizeof(tags[0])));
+    tag_index_rebuild(tag_index, list->tasks, list->count);
+    return tag_index->failed;
+}
+
+// Renders one scene HEADLESS_FRAMES times with the regular drawing code,
+// then saves the last frame and checks it against its golden image.
+// Returns the number of failed checks, or 1 if the scene could not run.
+static int run_headless_scene(const HeadlessScene* scene, const Config* config, const char* out_dir,
+                              const char* golden_dir, double budget_ms) {
+    int width = (int)(LAYOUT_BASE_WIDTH * scene->scale + 0.5f);
+    int height = (int)(LAYOUT_BASE_HEIGHT * scene->scale + 0.5f);
+    HeadlessTarget target;
+    if (headless_open(&target, width, height) != 0) return 1;
+
+    Font font;
+    if (font_open(&font, FONT_PATH, FONT_ATLAS_PATH, (int)(config->font_size * scene->scale + 0.5f)) != 0) {
+        headless_close(&target);
+        return 1;
+    }
+    UI ui;
+    ui_init(&ui, target.renderer, &font);
+    SceneGraph scenes;
+    init_scenes(&scenes);
+    SpriteManager sprite_manager;
+    sprite_manager_init(&sprite_manager, target.renderer);
+    Arena frame_arena;
+    TaskList task_list;
+    task_list_init(&task_list);
+    TagIndex tag_index;
+    tag_index_init(&tag_index);
+    TaskFilterView task_filter;
+    memset(&task_filter, 0, sizeof(task_filter));
+    bitmap_init(&task_filter.rows);
+    task_filter.sort = TASK_SORT_MANUAL;
+    TaskDialog task_dialog;
+    init_task_dialog(&task_dialog, &font);
+
+    int ready = 1;
+    for (int i = 0; i < SPRITE_COUNT && ready; i++) {
+        ready = sprite_manager_load_sprite(&sprite_manager, i, sprite_files[i]) == 0;
+    }
+    int arena_ready = ready && arena_init(&frame_arena, (size_t)config->frame_arena_kb * 1024) == 0;
+    ready = arena_ready && headless_fixture(&task_list, &tag_index) == 0;
+    if (!ready) {
+        if (arena_ready) arena_free(&frame_arena);
+        task_list_free(&task_list);
+        tag_index_free(&tag_index);
+        scene_graph_free(&scenes);
+        sprite_manager_cleanup(&sprite_manager);
+        ui_cleanup(&ui);
+        font_close(&font);
+        headless_close(&target);
+        return 1;
+    }
+
+    Layout layout;
+    layout_init(&layout);
+    layout_resize(&layout, width, height, scene->scale);
+    layout_update(&layout);
+
+    Message message = {0};
+    show_message(&message, "Task created successfully!");
+    text_input_set(&task_dialog.title, "Slay the dragon");
+    text_input_set(&task_dialog.description, "Before lunch");
+    text_input_set(&task_dialog.tags, "quest, home");
+    text_input_set(&task_dialog.due, "2026-11-02 09:00");
+    task_dialog.editing_title = 1;
+    task_dialog.cursor_visible = 1;
+    DueOrder due_order = {0};
+    update_filter(&task_filter, &task_list, &tag_index, &due_order, &message);
+    Screen screen = {
+        .layout = &layout,
+        .frame_arena = &frame_arena,
+        .tasks = &task_list,
+        .tags = &tag_index,
+        .filter = &task_filter,
+        .dialog = &task_dialog,
+        .message = &message,
+        .pressed_task = -1,
+        .drop_index = -1,
+    };
+
+    // Only the first frame builds the display lists; the rest replay them
+    headless_reset_frames(&target);
+    for (int frame = 0; frame < HEADLESS_FRAMES; frame++) {
+        Uint64 frame_start = SDL_GetPerformanceCounter();
+
+        ui_begin_frame(&ui);
+        SDL_SetRenderDrawColor(target.renderer, 0, 0, 0, 255);
+        SDL_RenderClear(target.renderer);
+        track_scenes(&scenes, &screen);
+        scene_render(&scenes, scene->state, &ui, &sprite_manager, layout.width, layout.height, &screen);
+        SDL_RenderPresent(target.renderer);
+
+        headless_note_frame(&target, (SDL_GetPerformanceCounter() - frame_start) * 1000.0 /
+                            SDL_GetPerformanceFrequency());
+        arena_reset(&frame_arena);
+    }
+    arena_free(&frame_arena);
+
+    char path[1024];
+    char golden[1024];
+    snprintf(path, sizeof(path), "%s/timings.csv", out_dir);
+    int failed = headless_report_frames(&target, scene->name, path, budget_ms);
+
+    snprintf(path, sizeof(path), "%s/%s.png", out_dir, scene->name);
+    failed += headless_save_png(&target, path);
+    if (golden_dir) {
+        HeadlessDiff diff;
+        snprintf(golden, sizeof(golden), "%s/%s.png", golden_dir, scene->name);
+        snprintf(path, sizeof(path), "%s/%s.diff.png", out_dir, scene->name);
+        int rc = headless_compare(&target, golden, path, &diff);
+        if (rc >= 0) {
+            printf("%s: %d of %d pixels differ (largest channel difference %d)%s\n", scene->name,
+                   diff.mismatched, diff.pixels, diff.max_delta, rc ? ", see " : "");
+            if (rc) printf("  %s\n", path);
         }
+        failed += rc != 0;
     }
+
+    task_list_free(&task_list);
+    tag_index_free(&tag_index);
+    bitmap_free(&task_filter.rows);
+    free(task_filter.order_next);
+    scene_graph_free(&scenes);
+    sprite_manager_cleanup(&sprite_manager);
+    ui_cleanup(&ui);
+    font_close(&font);
+    headless_close(&target);
+    return failed;
 }
 
-void draw_cursor(UI* ui, int x, int y, int height, int visible) {
-    if (!ui || !visible) return;
-    
-    SDL_SetRenderDrawColor(ui->renderer, 0, 0, 0, 255);
-    SDL_RenderDrawLine(ui->renderer, x, y, x, y + height);
+// --headless out_dir [golden_dir [budget_ms]]. Renders every scene into
+// out_dir without a window; exits non-zero if an image differs from its
+// golden copy or frame times go over budget. Settings are the defaults,
+// so the local config file cannot change the output.
+int run_headless(const char* out_dir, const char* golden_dir, double budget_ms) {
+    Config config;
+    config_defaults(&config);
+
+    if (SDL_Init(0) < 0) {
+        fprintf(stderr, "SDL could not initialize: %s\n", SDL_GetError());
+        SDL_Quit();
+        return 1;
+    }
+
+    char csv_path[1024];
+    snprintf(csv_path, sizeof(csv_path), "%s/timings.csv", out_dir);
+    FILE* csv = fopen(csv_path, "w");
+    if (!csv) {
+        fprintf(stderr, "Can't write to %s\n", out_dir);
+        TTF_Quit();
+        SDL_Quit();
+        return 1;
+    }
+    fprintf(csv, "scene,frame,ms\n");
+    fclose(csv);
+
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(headless_scenes) / sizeof(headless_scenes[0]); i++) {
+        failed += run_headless_scene(&headless_scenes[i], &config, out_dir, golden_dir, budget_ms);
+    }
+    printf("Headless render: %s\n", failed ? "FAILED" : "ok");
+
+    TTF_Quit();
+    SDL_Quit();
+    return failed != 0;
 }
 
 int main(int argc, char* argv[]) {
+    // Count heap allocations so steady-state frames can be checked. Comes
+    // first: with allocation tracking built in, SQLite cannot be hooked
+    // once used and SDL must not free blocks it allocated before.
+    memstats_install();
+
+    Uint64 start_counter = SDL_GetPerformanceCounter();
+
+    // Settings file and environment overrides
+    Config config;
+    config_load(&config, config_default_path());
+
+    // Headless service mode: own the database and serve local clients
+    if (argc > 1 && strcmp(argv[1], "--serve") == 0) {
+        return service_run(&config, argc > 2 ? argv[2] : SERVICE_DEFAULT_SOCKET);
+    }
+
+    // Offscreen rendering for checks on machines without a display
+    if (argc > 2 && strcmp(argv[1], "--headless") == 0) {
+        return run_headless(argv[2], argc > 3 ? argv[3] : NULL, argc > 4 ? atof(argv[4]) : 0);
+    }
+
+    // Session recording (--record log) and replay (--replay log)
+    const char* record_path = NULL;
+    const char* replay_path = NULL;
+    if (argc > 2 && strcmp(argv[1], "--record") == 0) {
+        record_path = argv[2];
+    }
+    else if (argc > 2 && strcmp(argv[1], "--replay") == 0) {
+        replay_path = argv[2];
+    }
+
+    // Ask Windows for real pixels instead of bitmap-stretching the window
+    SDL_SetHint("SDL_WINDOWS_DPI_AWARENESS", "permonitorv2");
+
     // Initialize SDL
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         SDL_Log("SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
         return 1;
     }
 
-    // Initialize SDL_ttf
-    if (TTF_Init() < 0) {
-        SDL_Log("SDL_ttf could not initialize! TTF_Error: %s\n", TTF_GetError());
+    // Open the recording; a replay also gets its own copy of the database
+    // and skips the snapshot, which belongs to the real one
+    Replay replay;
+    memset(&replay, 0, sizeof(replay));
+    const char* db_path = config.db_path;
+    const char* snapshot_path = SNAPSHOT_PATH;
+    char replay_db[1024];
+    if ((record_path && replay_record_open(&replay, record_path) != 0) ||
+        (replay_path && (replay_play_open(&replay, replay_path) != 0 ||
+                         copy_replay_database(replay_path, replay_db, sizeof(replay_db)) != 0))) {
+        SDL_Log("Failed to set up recording\n");
+        replay_close(&replay);
+        TTF_Quit();
         SDL_Quit();
         return 1;
     }
+    if (replay_path) {
+        db_path = replay_db;
+        snapshot_path = NULL;
+    }
 
     // Initialize database
     sqlite3* db;
-    if (db_init("heroman.db", &db) != 0) {
+    if (db_init(db_path, &db) != 0 || db_configure(db, &config) != 0 || db_create_schema(db) != 0) {
         SDL_Log("Failed to initialize database\n");
+        db_close(db);
         TTF_Quit();
         SDL_Quit();
         return 1;
     }
 
+    // A recording starts from a copy of the database as it is now
+    if (record_path) {
+        char seed_path[1024];
+        replay_db_path(record_path, seed_path, sizeof(seed_path));
+        if (db_backup(db, seed_path) != 0) {
+            SDL_Log("Failed to copy database for recording\n");
+            replay_close(&replay);
+            db_close(db);
+            TTF_Quit();
+            SDL_Quit();
+            return 1;
+        }
+    }
+
     // Create window
     SDL_Window* window = SDL_CreateWindow("Heroman project",
                                          SDL_WINDOWPOS_CENTERED,
                                          SDL_WINDOWPOS_CENTERED,
-                                         WINDOW_WIDTH,
-                                         WINDOW_HEIGHT,
-                                         SDL_WINDOW_SHOWN);
+                                         LAYOUT_BASE_WIDTH,
+                                         LAYOUT_BASE_HEIGHT,
+                                         SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE |
+                                         SDL_WINDOW_ALLOW_HIGHDPI);
     if (!window) {
         SDL_Log("Window could not be created! SDL_Error: %s\n", SDL_GetError());
         db_close(db);
@@ -315,8 +1456,11 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    // Create renderer
-    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    // Create renderer. With vsync the display paces frames unless a
+    // target rate is also set.
+    Uint32 renderer_flags = SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE |
+                            (config.vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
+    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, renderer_flags);
     if (!renderer) {
         SDL_Log("Renderer could not be created! SDL_Error: %s\n", SDL_GetError());
         SDL_DestroyWindow(window);
@@ -326,10 +1470,27 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    // Load font
-    TTF_Font* font = TTF_OpenFont("assets/font.ttf", FONT_SIZE);
-    if (!font) {
-        SDL_Log("Failed to load font! TTF_Error: %s\n", TTF_GetError());
+    // Size the window for the display. pixel_ratio converts window
+    // coordinates (mouse events) to output pixels, which the layout uses.
+    float pixel_ratio;
+    float ui_scale = display_scale(window, renderer, &pixel_ratio);
+    float window_scale = ui_scale / pixel_ratio;
+    SDL_SetWindowMinimumSize(window, (int)(WINDOW_MIN_WIDTH * window_scale),
+                             (int)(WINDOW_MIN_HEIGHT * window_scale));
+    if (window_scale > 1.0f) {
+        SDL_SetWindowSize(window, (int)(LAYOUT_BASE_WIDTH * window_scale),
+                          (int)(LAYOUT_BASE_HEIGHT * window_scale));
+    }
+    Layout layout;
+    layout_init(&layout);
+    int metrics_dirty = 1;
+
+    // Load font at the display's scale. At the size baked at build time
+    // this maps the atlas and SDL_ttf is not even initialized.
+    int font_size = config.font_size;
+    Font font;
+    if (font_open(&font, FONT_PATH, FONT_ATLAS_PATH, (int)(font_size * ui_scale + 0.5f)) != 0) {
+        SDL_Log("Failed to load font!\n");
         SDL_DestroyRenderer(renderer);
         SDL_DestroyWindow(window);
         db_close(db);
@@ -340,25 +1501,77 @@ int main(int argc, char* argv[]) {
 
     // Initialize UI
     UI ui;
-    ui_init(&ui, renderer, font);
+    ui_init(&ui, renderer, &font);
+
+    // Each screen replays display lists kept from earlier frames
+    SceneGraph scenes;
+    init_scenes(&scenes);
+    GameState state = GAME_STATE_PLAYING;
+    GameState dialog_parent = GAME_STATE_PLAYING;  // Where closing the dialog returns to
 
     // Initialize task dialog
-    TaskDialog task_dialog = {0};
-    task_dialog.difficulty = 2; // Default to medium difficulty
-    task_dialog.type = 0; // Default to habit
-    int showing_task_dialog = 0;
+    TaskDialog task_dialog;
+    init_task_dialog(&task_dialog, &font);
+
+    // A press on a task row becomes a click (toggle completion) if it is
+    // released on the same row, or a move if released on another
+    int pressed_task = -1;
+    int drop_index = -1;
+
+    // Ctrl-click toggles a row in the selection, shift-click selects the
+    // rows from the last row clicked
+    int select_anchor = -1;
 
     // Initialize message system
     Message message = {0};
     
     // Initialize task list
     TaskList task_list;
-    init_task_list(&task_list);
-
-    // Load existing tasks
-    if (db_get_all_tasks(db, &task_list.tasks, &task_list.count) == 0) {
-        task_list.capacity = task_list.count;
+    task_list_init(&task_list);
+
+    // Tag bitmaps, and the tag and completion filter over the list
+    TagIndex tag_index;
+    tag_index_init(&tag_index);
+    TaskFilterView task_filter;
+    memset(&task_filter, 0, sizeof(task_filter));
+    bitmap_init(&task_filter.rows);
+    task_filter.sort = TASK_SORT_MANUAL;
+    DueOrder due_order = {0};
+
+    // Upcoming due times, soonest on top
+    ReminderQueue reminders;
+    reminders_init(&reminders);
+
+    // Hand the database to its own thread; the render thread only talks
+    // to it through request/response queues from here on
+    // Backfills are left alone while recording or replaying, since when they
+    // run depends on idle time rather than on the recorded input
+    int backfill_pending = replay.mode == REPLAY_OFF && db_backfill_pending(db);
+    DbWorker* db_worker = db_worker_start(db, snapshot_path);
+    if (!db_worker) {
+        SDL_Log("Failed to start database thread\n");
+        return 1;
     }
+    DbResponseContext db_context = {
+        .list = &task_list,
+        .tags = &tag_index,
+        .reminders = &reminders,
+        .due = &due_order,
+        .message = &message,
+        .scenes = &scenes,
+        .worker = db_worker,
+        .replay = &replay,
+        .start_counter = start_counter,
+        .backfill_pending = backfill_pending,
+    };
+
+    // Counters for the node agent; a failure here is not fatal
+    metrics_exporter_start(&config);
+
+    // Load existing tasks in the background. The worker uses the snapshot
+    // from the last clean exit when the database has not changed since.
+    db_worker_submit(db_worker, DB_OP_LOAD, NULL);
+    db_context.tags_in_flight = db_worker_submit(db_worker, DB_OP_TAGS, NULL) != 0;
 
     // Initialize sprite manager
     SpriteManager sprite_manager;
@@ -368,22 +1581,6 @@ int main(int argc, char* argv[]) {
     }
 
     // Load sprites
-    const char* sprite_files[] = {
-        "assets/sprites/background.png",
-        "assets/sprites/task_dialog.png",
-        "assets/sprites/button_normal.png",
-        "assets/sprites/button_hover.png",
-        "assets/sprites/button_pressed.png",
-        "assets/sprites/checkbox_unchecked.png",
-        "assets/sprites/checkbox_checked.png",
-        "assets/sprites/icon_habit.png",
-        "assets/sprites/icon_daily.png",
-        "assets/sprites/icon_todo.png",
-        "assets/sprites/icon_difficulty.png",
-        "assets/sprites/icon_edit.png",
-        "assets/sprites/icon_delete.png"
-    };
-
     for (int i = 0; i < SPRITE_COUNT; i++) {
         if (sprite_manager_load_sprite(&sprite_manager, i, sprite_files[i]) != 0) {
             fprintf(stderr, "Failed to load sprite: %s\n", sprite_files[i]);
@@ -391,79 +1588,204 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    // Transient per-frame data (formatted strings, layout scratch)
+    Arena frame_arena;
+    if (arena_init(&frame_arena, (size_t)config.frame_arena_kb * 1024) != 0) {
+        fprintf(stderr, "Failed to allocate frame arena\n");
+        return 1;
+    }
+    Uint32 frame_alloc_total = 0;
+    Uint32 frame_alloc_max = 0;
+    int frame_stats_count = 0;
+
+    // Frame scheduling; idle_fps 0 keeps the full rate when idle
+    FramePacer frame_pacer;
+    frame_pacer_init(&frame_pacer, target_fps(&config), config.idle_fps);
+    ui_set_text_cache_ways(&ui, config.text_cache_ways);
+    Uint32 config_checked_ms = SDL_GetTicks();
+    Uint32 sync_checked_ms = config_checked_ms;
+
     // Main game loop
     SDL_Event event;
     int running = 1;
+    int first_frame = 1;
     while (running) {
+        Uint64 frame_start = SDL_GetPerformanceCounter();
+        Uint32 frame_alloc_start = memstats_allocations();
+
+        // Apply finished database work. A replay waits for as many
+        // responses as the recorded frame saw, so each event meets the
+        // same task list it did when recorded.
+        Uint32 now_ms = SDL_GetTicks();
+        int db_responses = 0;
+        if (replay.mode == REPLAY_PLAY) {
+            if (!replay_begin_frame(&replay, &now_ms, &db_responses)) break;
+            apply_db_responses(db_worker, &db_context, db_responses);
+        }
+        else {
+            DbMessage db_response;
+            while (db_worker_poll(db_worker, &db_response)) {
+                apply_db_response(&db_response, &db_context);
+                db_responses += db_response_counts(&db_response);
+            }
+            replay_begin_frame(&replay, &now_ms, &db_responses);
+        }
+        frame_clock_ms = now_ms;
+        if (db_responses > 0) {
+            frame_pacer_activity(&frame_pacer);
+        }
+
+        // Rows may have moved; a sorted order is chained by row index, so
+        // it has to follow before input is matched against it
+        update_filter(&task_filter, &task_list, &tag_index, &due_order, &message);
+
+        // Remind of tasks coming due, looking only at the soonest. The
+        // wall clock is not part of a recording, so replays skip this.
+        if (replay.mode != REPLAY_PLAY) {
+            int more;
+            int due_id = reminders_pop_due(&reminders, &task_list, time(NULL), &more);
+            if (due_id != 0) {
+                char text[256];
+                snprintf(text, sizeof(text), more > 0 ? "Due now: %s, and %d more" : "Due now: %s",
+                         task_list.tasks[task_list_find(&task_list, due_id)].title, more);
+                show_message(&message, text);
+            }
+        }
+
         // Handle events
-        while (SDL_PollEvent(&event)) {
+        while (replay_poll_event(&replay, &event)) {
+            frame_pacer_activity(&frame_pacer);
             if (event.type == SDL_QUIT) {
                 running = 0;
             }
+            else if (event.type == SDL_WINDOWEVENT &&
+                     (event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED ||
+                      event.window.event == SDL_WINDOWEVENT_MOVED)) {
+                // The size, or the display and with it the DPI, may have changed
+                metrics_dirty = 1;
+            }
+            else if (event.type == SDL_RENDER_TARGETS_RESET || event.type == SDL_RENDER_DEVICE_RESET) {
+                // Render target contents were lost
+                scene_invalidate(&scenes, NODE_BACKGROUND);
+            }
             else if (event.type == SDL_MOUSEBUTTONDOWN) {
-                int mouse_x, mouse_y;
-                SDL_GetMouseState(&mouse_x, &mouse_y);
+                int mouse_x = (int)(event.button.x * pixel_ratio);
+                int mouse_y = (int)(event.button.y * pixel_ratio);
 
-                if (!showing_task_dialog) {
+                if (state != GAME_STATE_TASK_DIALOG) {
                     // Check main menu buttons
-                    if (ui_is_button_clicked(&ui, NEW_TASK_BUTTON_X, NEW_TASK_BUTTON_Y,
-                                           NEW_TASK_BUTTON_WIDTH, NEW_TASK_BUTTON_HEIGHT,
-                                           mouse_x, mouse_y)) {
-                        showing_task_dialog = 1;
-                        memset(&task_dialog, 0, sizeof(TaskDialog));
-                        task_dialog.difficulty = 2;
-                        task_dialog.type = 0;
-                    }
-                    else if (ui_is_button_clicked(&ui, QUIT_BUTTON_X, QUIT_BUTTON_Y,
-                                                QUIT_BUTTON_WIDTH, QUIT_BUTTON_HEIGHT,
-                                                mouse_x, mouse_y)) {
+                    if (layout_hit(&layout, LAYOUT_NEW_TASK_BUTTON, mouse_x, mouse_y)) {
+                        dialog_parent = state;
+                        state = GAME_STATE_TASK_DIALOG;
+                        init_task_dialog(&task_dialog, &font);
+                    }
+                    else if (layout_hit(&layout, LAYOUT_QUIT_BUTTON, mouse_x, mouse_y)) {
                         running = 0;
                     }
+                    else if (layout_hit(&layout, LAYOUT_STATS_BUTTON, mouse_x, mouse_y)) {
+                        // The aggregates are read fresh each time the screen opens
+                        state = state == GAME_STATE_STATS ? GAME_STATE_PLAYING : GAME_STATE_STATS;
+                        if (state == GAME_STATE_STATS) {
+                            db_worker_submit(db_worker, DB_OP_STATS, NULL);
+                        }
+                    }
+
+                    // Handle actions on the selected tasks
+                    else if (state == GAME_STATE_PLAYING && task_list.selected_count > 0 &&
+                             layout_hit(&layout, LAYOUT_BULK_COMPLETE_BUTTON, mouse_x, mouse_y)) {
+                        submit_bulk_action(db_worker, &task_list, &message, DB_BULK_COMPLETE, 0);
+                    }
+                    else if (state == GAME_STATE_PLAYING && task_list.selected_count > 0 &&
+                             layout_hit(&layout, LAYOUT_BULK_UNCOMPLETE_BUTTON, mouse_x, mouse_y)) {
+                        submit_bulk_action(db_worker, &task_list, &message, DB_BULK_UNCOMPLETE, 0);
+                    }
+                    else if (state == GAME_STATE_PLAYING && task_list.selected_count > 0 &&
+                             layout_hit(&layout, LAYOUT_BULK_DELETE_BUTTON, mouse_x, mouse_y)) {
+                        submit_bulk_action(db_worker, &task_list, &message, DB_BULK_DELETE, 0);
+                    }
+                    else if (state == GAME_STATE_PLAYING && task_list.selected_count > 0 &&
+                             layout_hit(&layout, LAYOUT_BULK_DIFFICULTY_BUTTON, mouse_x, mouse_y)) {
+                        // Everything selected moves to the level after the first one's
+                        int first = task_list_first_selected(&task_list);
+                        int difficulty = first >= 0 ? (task_list.tasks[first].difficulty + 1) % 5 : 0;
+                        submit_bulk_action(db_worker, &task_list, &message, DB_BULK_SET_DIFFICULTY, difficulty);
+                    }
 
                     // Handle filter buttons
-                    else if (ui_is_button_clicked(&ui, FILTER_ALL_BUTTON_X, FILTER_ALL_BUTTON_Y, 100, 30, mouse_x, mouse_y)) {
-                        game_filter_tasks(game, TASK_FILTER_ALL);
+                    else if (layout_hit(&layout, LAYOUT_FILTER_ALL_BUTTON, mouse_x, mouse_y)) {
+                        task_filter.query.completion = TASK_FILTER_ALL;
+                        task_filter.dirty = 1;
                     }
-                    else if (ui_is_button_clicked(&ui, FILTER_COMPLETED_BUTTON_X, FILTER_COMPLETED_BUTTON_Y, 100, 30, mouse_x, mouse_y)) {
-                        game_filter_tasks(game, TASK_FILTER_COMPLETED);
+                    else if (layout_hit(&layout, LAYOUT_FILTER_COMPLETED_BUTTON, mouse_x, mouse_y)) {
+                        task_filter.query.completion = TASK_FILTER_COMPLETED;
+                        task_filter.dirty = 1;
                     }
-                    else if (ui_is_button_clicked(&ui, FILTER_UNCOMPLETED_BUTTON_X, FILTER_UNCOMPLETED_BUTTON_Y, 100, 30, mouse_x, mouse_y)) {
-                        game_filter_tasks(game, TASK_FILTER_UNCOMPLETED);
+                    else if (layout_hit(&layout, LAYOUT_FILTER_UNCOMPLETED_BUTTON, mouse_x, mouse_y)) {
+                        task_filter.query.completion = TASK_FILTER_UNCOMPLETED;
+                        task_filter.dirty = 1;
                     }
 
-                    // Handle sort buttons
-                    else if (ui_is_button_clicked(&ui, SORT_TYPE_BUTTON_X, SORT_TYPE_BUTTON_Y, 100, 30, mouse_x, mouse_y)) {
-                        game_sort_tasks(game, TASK_SORT_TYPE);
+                    // A tag chip steps through must have, any of, must not
+                    // have and off
+                    else if (state == GAME_STATE_PLAYING && layout_hit(&layout, LAYOUT_TAG_BAR, mouse_x, mouse_y)) {
+                        SDL_Rect chip;
+                        for (int i = 0, slot = 0; i < tag_index.count && tag_chip_rect(&layout, slot, &chip); i++) {
+                            if (!tag_has_chip(&tag_index.entries[i], &task_filter.query)) continue;
+                            if (rect_hit(&chip, mouse_x, mouse_y)) {
+                                if (tag_query_cycle(&task_filter.query, tag_index.entries[i].tag.id) != 0) {
+                                    show_message(&message, "Too many tags in the filter!");
+                                }
+                                task_filter.dirty = 1;
+                                break;
+                            }
+                            slot++;
+                        }
+                    }
+
+                    // Handle sort buttons. Each toggles back to manual
+                    // order; the due date sort is served by the
+                    // database's index.
+                    else if (state == GAME_STATE_PLAYING && layout_hit(&layout, LAYOUT_SORT_TYPE_BUTTON, mouse_x, mouse_y)) {
+                        toggle_sort(&task_filter, TASK_SORT_TYPE);
+                    }
+                    else if (state == GAME_STATE_PLAYING && layout_hit(&layout, LAYOUT_SORT_DIFFICULTY_BUTTON, mouse_x, mouse_y)) {
+                        toggle_sort(&task_filter, TASK_SORT_DIFFICULTY);
                     }
-                    else if (ui_is_button_clicked(&ui, SORT_DIFFICULTY_BUTTON_X, SORT_DIFFICULTY_BUTTON_Y, 100, 30, mouse_x, mouse_y)) {
-                        game_sort_tasks(game, TASK_SORT_DIFFICULTY);
+                    else if (state == GAME_STATE_PLAYING && layout_hit(&layout, LAYOUT_SORT_COMPLETION_BUTTON, mouse_x, mouse_y)) {
+                        toggle_sort(&task_filter, TASK_SORT_COMPLETION);
                     }
-                    else if (ui_is_button_clicked(&ui, SORT_COMPLETION_BUTTON_X, SORT_COMPLETION_BUTTON_Y, 100, 30, mouse_x, mouse_y)) {
-                        game_sort_tasks(game, TASK_SORT_COMPLETION);
+                    else if (state == GAME_STATE_PLAYING && layout_hit(&layout, LAYOUT_SORT_DUE_BUTTON, mouse_x, mouse_y)) {
+                        toggle_sort(&task_filter, TASK_SORT_DUE);
                     }
                 }
                 else {
-                    // Check task dialog buttons and input fields
-                    if (ui_is_button_clicked(&ui, TASK_SAVE_BUTTON_X, TASK_SAVE_BUTTON_Y,
-                                           TASK_SAVE_BUTTON_WIDTH, TASK_SAVE_BUTTON_HEIGHT,
-                                           mouse_x, mouse_y)) {
+                    // Check task dialog buttons and input fields. A due
+                    // date that does not parse, or tags the database
+                    // would refuse, keep the dialog open.
+                    time_t due_at = 0;
+                    char tag_check[TASK_MAX_TAGS][TAG_NAME_MAX];
+                    if (layout_hit(&layout, LAYOUT_DIALOG_SAVE_BUTTON, mouse_x, mouse_y) &&
+                        task_parse_due(text_input_get(&task_dialog.due), &due_at) != 0) {
+                        show_message(&message, "Invalid due date! Use YYYY-MM-DD HH:MM");
+                    }
+                    else if (layout_hit(&layout, LAYOUT_DIALOG_SAVE_BUTTON, mouse_x, mouse_y) &&
+                             task_parse_tags(text_input_get(&task_dialog.tags), tag_check) < 0) {
+                        show_message(&message, "Too many tags! Use up to 8, each under 32 bytes");
+                    }
+                    else if (layout_hit(&layout, LAYOUT_DIALOG_SAVE_BUTTON, mouse_x, mouse_y)) {
                         // Save the task
                         Task task;
-                        task_init(&task, task_dialog.title, task_dialog.description,
+                        task_init(&task, text_input_get(&task_dialog.title),
+                                text_input_get(&task_dialog.description),
                                 task_dialog.difficulty, task_dialog.type);
+                        task.due_at = due_at;
                         
                         if (task_dialog.task_id != 0) {
                             // We're editing an existing task
                             task.id = task_dialog.task_id;
                             
                             // Find the task in the list
-                            int task_index = -1;
-                            for (int i = 0; i < task_list.count; i++) {
-                                if (task_list.tasks[i].id == task_dialog.task_id) {
-                                    task_index = i;
-                                    break;
-                                }
-                            }
+                            int task_index = task_list_find(&task_list, task_dialog.task_id);
                             
                             if (task_index != -1) {
                                 // Preserve completion status and streak
@@ -471,157 +1793,221 @@ int main(int argc, char* argv[]) {
                                 task.streak = task_list.tasks[task_index].streak;
                                 task.last_completed = task_list.tasks[task_index].last_completed;
                                 
-                                if (db_update_task(db, &task) == 0) {
-                                    task_list.tasks[task_index] = task;
+                                task.collapsed = task_list.tasks[task_index].collapsed;
+                                if (db_worker_submit_tagged(db_worker, DB_OP_UPDATE, &task,
+                                                            text_input_get(&task_dialog.tags)) != 0) {
                                     show_message(&message, "Task updated successfully!");
                                 } else {
                                     show_message(&message, "Failed to update task!");
                                 }
                             }
                         } else {
-                            // Create new task
-                            if (db_create_task(db, &task) == 0) {
-                                // Add task to list
-                                if (task_list.count >= task_list.capacity) {
-                                    int new_capacity = task_list.capacity == 0 ? 10 : task_list.capacity * 2;
-                                    Task* new_tasks = realloc(task_list.tasks, new_capacity * sizeof(Task));
-                                    if (new_tasks) {
-                                        task_list.tasks = new_tasks;
-                                        task_list.capacity = new_capacity;
-                                    }
-                                }
-                                
-                                if (task_list.count < task_list.capacity) {
-                                    task_list.tasks[task_list.count++] = task;
-                                    show_message(&message, "Task created successfully!");
-                                } else {
-                                    show_message(&message, "Failed to add task to list!");
-                                }
-                            } else {
+                            // Create new task; it joins the list once the
+                            // database has assigned its id
+                            task.parent_id = task_dialog.parent_id;
+                            const char* tag_names = text_input_get(&task_dialog.tags);
+                            if ((tag_names[0] ? db_worker_submit_tagged(db_worker, DB_OP_CREATE, &task, tag_names) :
+                                 db_worker_submit(db_worker, DB_OP_CREATE, &task)) == 0) {
                                 show_message(&message, "Failed to save task to database!");
                             }
                         }
                         
-                        showing_task_dialog = 0;
+                        state = dialog_parent;
                     }
-                    else if (ui_is_button_clicked(&ui, TASK_CANCEL_BUTTON_X, TASK_CANCEL_BUTTON_Y,
-                                                TASK_CANCEL_BUTTON_WIDTH, TASK_CANCEL_BUTTON_HEIGHT,
-                                                mouse_x, mouse_y)) {
-                        showing_task_dialog = 0;
+                    else if (layout_hit(&layout, LAYOUT_DIALOG_CANCEL_BUTTON, mouse_x, mouse_y)) {
+                        state = dialog_parent;
                     }
-                    else if (mouse_x >= TASK_TITLE_INPUT_X && mouse_x <= TASK_TITLE_INPUT_X + TASK_TITLE_INPUT_WIDTH &&
-                             mouse_y >= TASK_TITLE_INPUT_Y && mouse_y <= TASK_TITLE_INPUT_Y + TASK_TITLE_INPUT_HEIGHT) {
+                    else if (layout_hit(&layout, LAYOUT_DIALOG_TITLE_INPUT, mouse_x, mouse_y)) {
                         task_dialog.editing_title = 1;
                         task_dialog.editing_description = 0;
-                        task_dialog.cursor_position = strlen(task_dialog.title);
+                        task_dialog.editing_tags = 0;
+                        task_dialog.editing_due = 0;
+                        text_input_move_end(&task_dialog.title);
                     }
-                    else if (mouse_x >= TASK_DESC_INPUT_X && mouse_x <= TASK_DESC_INPUT_X + TASK_DESC_INPUT_WIDTH &&
-                             mouse_y >= TASK_DESC_INPUT_Y && mouse_y <= TASK_DESC_INPUT_Y + TASK_DESC_INPUT_HEIGHT) {
+                    else if (layout_hit(&layout, LAYOUT_DIALOG_DESC_INPUT, mouse_x, mouse_y)) {
                         task_dialog.editing_title = 0;
                         task_dialog.editing_description = 1;
-                        task_dialog.cursor_position = strlen(task_dialog.description);
+                        task_dialog.editing_tags = 0;
+                        task_dialog.editing_due = 0;
+                        text_input_move_end(&task_dialog.description);
+                    }
+                    else if (layout_hit(&layout, LAYOUT_DIALOG_TAGS_INPUT, mouse_x, mouse_y)) {
+                        task_dialog.editing_title = 0;
+                        task_dialog.editing_description = 0;
+                        task_dialog.editing_tags = 1;
+                        task_dialog.editing_due = 0;
+                        text_input_move_end(&task_dialog.tags);
                     }
-                    else if (mouse_x >= TASK_TYPE_X && mouse_x <= TASK_TYPE_X + TASK_TYPE_WIDTH &&
-                             mouse_y >= TASK_TYPE_Y && mouse_y <= TASK_TYPE_Y + TASK_TYPE_HEIGHT) {
+                    else if (layout_hit(&layout, LAYOUT_DIALOG_DUE_INPUT, mouse_x, mouse_y)) {
+                        task_dialog.editing_title = 0;
+                        task_dialog.editing_description = 0;
+                        task_dialog.editing_tags = 0;
+                        task_dialog.editing_due = 1;
+                        text_input_move_end(&task_dialog.due);
+                    }
+                    else if (layout_hit(&layout, LAYOUT_DIALOG_TYPE, mouse_x, mouse_y)) {
                         task_dialog.type = (task_dialog.type + 1) % 3;
                     }
-                    else if (mouse_x >= TASK_DIFFICULTY_X && mouse_x <= TASK_DIFFICULTY_X + TASK_DIFFICULTY_WIDTH &&
-                             mouse_y >= TASK_DIFFICULTY_Y && mouse_y <= TASK_DIFFICULTY_Y + TASK_DIFFICULTY_HEIGHT) {
+                    else if (layout_hit(&layout, LAYOUT_DIALOG_DIFFICULTY, mouse_x, mouse_y)) {
                         task_dialog.difficulty = (task_dialog.difficulty + 1) % 5;
                     }
                     else {
                         task_dialog.editing_title = 0;
                         task_dialog.editing_description = 0;
+                        task_dialog.editing_tags = 0;
+                        task_dialog.editing_due = 0;
                     }
                 }
             }
-            else if (event.type == SDL_TEXTINPUT && (task_dialog.editing_title || task_dialog.editing_description)) {
+            else if (event.type == SDL_TEXTINPUT &&
+                     (task_dialog.editing_title || task_dialog.editing_description || task_dialog.editing_tags ||
+                      task_dialog.editing_due)) {
                 handle_text_input(&task_dialog, &event);
             }
+            else if (event.type == SDL_KEYDOWN && handle_text_input(&task_dialog, &event)) {
+                // Editing key consumed by the active field
+            }
             else if (event.type == SDL_KEYDOWN) {
                 if (event.key.keysym.sym == SDLK_TAB) {
                     if (task_dialog.editing_title) {
                         task_dialog.editing_title = 0;
                         task_dialog.editing_description = 1;
-                        task_dialog.cursor_position = strlen(task_dialog.description);
+                        text_input_move_end(&task_dialog.description);
                     }
                     else if (task_dialog.editing_description) {
-                        task_dialog.editing_title = 1;
                         task_dialog.editing_description = 0;
-                        task_dialog.cursor_position = strlen(task_dialog.title);
+                        task_dialog.editing_tags = 1;
+                        text_input_move_end(&task_dialog.tags);
+                    }
+                    else if (task_dialog.editing_tags) {
+                        task_dialog.editing_tags = 0;
+                        task_dialog.editing_due = 1;
+                        text_input_move_end(&task_dialog.due);
+                    }
+                    else if (task_dialog.editing_due) {
+                        task_dialog.editing_title = 1;
+                        task_dialog.editing_due = 0;
+                        text_input_move_end(&task_dialog.title);
                     }
                 }
                 else if (event.key.keysym.sym == SDLK_RETURN) {
                     if (task_dialog.editing_title) {
                         task_dialog.editing_title = 0;
                         task_dialog.editing_description = 1;
-                        task_dialog.cursor_position = strlen(task_dialog.description);
+                        text_input_move_end(&task_dialog.description);
                     }
                     else if (task_dialog.editing_description) {
                         task_dialog.editing_description = 0;
+                        task_dialog.editing_tags = 1;
+                        text_input_move_end(&task_dialog.tags);
+                    }
+                    else if (task_dialog.editing_tags) {
+                        task_dialog.editing_tags = 0;
+                        task_dialog.editing_due = 1;
+                        text_input_move_end(&task_dialog.due);
+                    }
+                    else if (task_dialog.editing_due) {
+                        task_dialog.editing_due = 0;
                     }
                 }
+                else if (event.key.keysym.sym == SDLK_a && (event.key.keysym.mod & (KMOD_CTRL | KMOD_GUI)) &&
+                         state == GAME_STATE_PLAYING) {
+                    select_index_range(&task_list, filter_rows(&task_filter), 0, task_list.count - 1);
+                }
+                else if (event.key.keysym.sym == SDLK_DELETE && state == GAME_STATE_PLAYING &&
+                         task_list.selected_count > 0) {
+                    submit_bulk_action(db_worker, &task_list, &message, DB_BULK_DELETE, 0);
+                }
                 else if (event.key.keysym.sym == SDLK_ESCAPE) {
-                    if (task_dialog.editing_title || task_dialog.editing_description) {
+                    if (state == GAME_STATE_PLAYING && task_list.selected_count > 0) {
+                        task_list_clear_selection(&task_list);
+                    }
+                    else if (state != GAME_STATE_TASK_DIALOG) {
+                        state = GAME_STATE_PLAYING;
+                    }
+                    else if (task_dialog.editing_title || task_dialog.editing_description || task_dialog.editing_tags ||
+                             task_dialog.editing_due) {
                         task_dialog.editing_title = 0;
                         task_dialog.editing_description = 0;
+                        task_dialog.editing_tags = 0;
+                        task_dialog.editing_due = 0;
                     }
                     else {
-                        showing_task_dialog = 0;
+                        state = dialog_parent;
                     }
                 }
             }
 
-            if (!showing_task_dialog) {
+            if (state == GAME_STATE_PLAYING) {
                 // Check task list interactions
                 if (event.type == SDL_MOUSEBUTTONDOWN) {
-                    int mouse_x, mouse_y;
-                    SDL_GetMouseState(&mouse_x, &mouse_y);
-
-                    // Check if clicking on a task
-                    for (int i = 0; i < task_list.count; i++) {
-                        int y = 140 + (i * (TASK_ITEM_HEIGHT + TASK_ITEM_SPACING));
-                        SDL_Rect task_rect = {15, y, TASK_ITEM_WIDTH, TASK_ITEM_HEIGHT};
-                        
-                        if (mouse_x >= task_rect.x && mouse_x <= task_rect.x + task_rect.w &&
-                            mouse_y >= task_rect.y && mouse_y <= task_rect.y + task_rect.h) {
-                            // Toggle task completion
-                            task_list.tasks[i].completed = !task_list.tasks[i].completed;
-                            if (db_update_task(db, &task_list.tasks[i]) == 0) {
-                                show_message(&message, task_list.tasks[i].completed ? 
-                                           "Task completed!" : "Task uncompleted!");
+                    int mouse_x = (int)(event.button.x * pixel_ratio);
+                    int mouse_y = (int)(event.button.y * pixel_ratio);
+
+                    // Check if clicking on a visible task
+                    SDL_Keymod mod = replay_mouse_mod(&replay);
+                    TaskRowRects rects;
+                    for (int i = next_row(&task_list, &task_filter, -1), row = 0;
+                         i < task_list.count && task_row_rects(&layout, row, row_depth(&task_list, &task_filter, i), &rects);
+                         i = next_row(&task_list, &task_filter, i), row++) {
+                        if (task_list.tasks[i].subtasks > 0 && rect_hit(&rects.toggle, mouse_x, mouse_y)) {
+                            // Collapse or expand; the rows follow once it commits
+                            Task task = task_list.tasks[i];
+                            task.collapsed = !task.collapsed;
+                            if (db_worker_submit(db_worker, DB_OP_UPDATE, &task) == 0) {
+                                show_message(&message, "Failed to update task!");
+                            }
+                        }
+                        else if (rect_hit(&rects.row, mouse_x, mouse_y)) {
+                            int task_id = task_list.tasks[i].id;
+                            if (mod & (KMOD_CTRL | KMOD_GUI)) {
+                                task_list_select(&task_list, task_id, !task_list_is_selected(&task_list, task_id));
+                            }
+                            else if (mod & KMOD_SHIFT) {
+                                select_rows(&task_list, &task_filter, select_anchor >= 0 ? select_anchor : i, i);
                             }
                             else {
-                                show_message(&message, "Failed to update task!");
+                                task_list_clear_selection(&task_list);
+                                pressed_task = i;
+                                drop_index = i;
+                            }
+                            if (!(mod & KMOD_SHIFT) || select_anchor < 0) {
+                                select_anchor = i;
                             }
                         }
 
+                        // Check subtask button
+                        if (rect_hit(&rects.add, mouse_x, mouse_y)) {
+                            dialog_parent = state;
+                            state = GAME_STATE_TASK_DIALOG;
+                            init_task_dialog(&task_dialog, &font);
+                            task_dialog.parent_id = task_list.tasks[i].id;
+                        }
+
                         // Check edit button
-                        SDL_Rect edit_rect = {TASK_ITEM_WIDTH + 20, y, TASK_BUTTON_SIZE, TASK_BUTTON_SIZE};
-                        if (mouse_x >= edit_rect.x && mouse_x <= edit_rect.x + edit_rect.w &&
-                            mouse_y >= edit_rect.y && mouse_y <= edit_rect.y + edit_rect.h) {
+                        if (rect_hit(&rects.edit, mouse_x, mouse_y)) {
                             // Open edit dialog
-                            showing_task_dialog = 1;
-                            strncpy(task_dialog.title, task_list.tasks[i].title, sizeof(task_dialog.title) - 1);
-                            strncpy(task_dialog.description, task_list.tasks[i].description, sizeof(task_dialog.description) - 1);
+                            dialog_parent = state;
+                            state = GAME_STATE_TASK_DIALOG;
+                            init_task_dialog(&task_dialog, &font);
+                            text_input_set(&task_dialog.title, task_list.tasks[i].title);
+                            text_input_set(&task_dialog.description, task_list.tasks[i].description);
                             task_dialog.difficulty = task_list.tasks[i].difficulty;
                             task_dialog.type = task_list.tasks[i].type;
                             task_dialog.task_id = task_list.tasks[i].id;
-                            task_dialog.editing_title = 0;
-                            task_dialog.editing_description = 0;
-                            task_dialog.cursor_position = 0;
+                            char tag_names[TASK_MAX_TAGS * TAG_NAME_MAX];
+                            format_tags(&tag_index, &task_list.tasks[i], tag_names, sizeof(tag_names));
+                            text_input_set(&task_dialog.tags, tag_names);
+                            char due[32];
+                            task_format_due(task_list.tasks[i].due_at, due, sizeof(due));
+                            text_input_set(&task_dialog.due, due);
                         }
 
                         // Check delete button
-                        SDL_Rect delete_rect = {TASK_ITEM_WIDTH + 55, y, TASK_BUTTON_SIZE, TASK_BUTTON_SIZE};
-                        if (mouse_x >= delete_rect.x && mouse_x <= delete_rect.x + delete_rect.w &&
-                            mouse_y >= delete_rect.y && mouse_y <= delete_rect.y + delete_rect.h) {
-                            // Delete task
-                            if (db_delete_task(db, task_list.tasks[i].id) == 0) {
-                                // Remove from list
-                                memmove(&task_list.tasks[i], &task_list.tasks[i + 1],
-                                       (task_list.count - i - 1) * sizeof(Task));
-                                task_list.count--;
+                        if (rect_hit(&rects.remove, mouse_x, mouse_y)) {
+                            // Delete task; the row leaves the list once
+                            // the delete commits
+                            if (db_worker_submit(db_worker, DB_OP_DELETE, &task_list.tasks[i]) != 0) {
                                 show_message(&message, "Task deleted!");
                             }
                             else {
@@ -630,169 +2016,244 @@ int main(int argc, char* argv[]) {
                         }
                     }
                 }
+                else if (event.type == SDL_MOUSEMOTION && pressed_task >= 0 && task_filter.sort == TASK_SORT_MANUAL) {
+                    drop_index = task_drop_index(&layout, &task_list, &task_filter,
+                                                 (int)(event.motion.y * pixel_ratio));
+                }
+                else if (event.type == SDL_MOUSEBUTTONUP && pressed_task >= 0) {
+                    int i = pressed_task;
+                    int target = task_drop_index(&layout, &task_list, &task_filter,
+                                                 (int)(event.button.y * pixel_ratio));
+                    pressed_task = -1;
+                    drop_index = -1;
+
+                    // The list may have shrunk if it was reloaded while the
+                    // button was down
+                    if (i < task_list.count && target == i) {
+                        // Toggle task completion. Completing also updates the
+                        // streak and the completion time the stats count by.
+                        Task task = task_list.tasks[i];
+                        if (task.completed) {
+                            task_reset(&task);
+                        }
+                        else {
+                            task_complete(&task);
+                        }
+                        if (db_worker_submit(db_worker, DB_OP_UPDATE, &task) != 0) {
+                            show_message(&message, task.completed ?
+                                       "Task completed!" : "Task uncompleted!");
+                        }
+                        else {
+                            show_message(&message, "Failed to update task!");
+                        }
+                    }
+                    else if (i < task_list.count && task_filter.sort == TASK_SORT_MANUAL) {
+                        // Reorder, next to the target and under its parent;
+                        // a rebalance is queued behind the move so the
+                        // worker applies both in the same order. A drop
+                        // inside the task's own subtasks does nothing.
+                        Task task = task_list.tasks[i];
+                        int crowded = task_list_move_position(&task_list, i, target, &task.parent_id, &task.position);
+                        if (crowded >= 0 && db_worker_submit(db_worker, DB_OP_MOVE, &task) == 0) {
+                            show_message(&message, "Failed to move task!");
+                        }
+                        else if (crowded > 0) {
+                            db_worker_submit(db_worker, DB_OP_REBALANCE, NULL);
+                        }
+                    }
+                }
+            }
+
+            // Nearly any input can change the dialog, and it is cheap to build
+            if (state == GAME_STATE_TASK_DIALOG && event.type != SDL_MOUSEMOTION) {
+                scene_invalidate(&scenes, NODE_DIALOG);
             }
         }
 
         // Update cursor blink
-        time_t now = time(NULL);
-        if (now - task_dialog.last_cursor_blink >= 500) {
+        if (frame_clock_ms - task_dialog.last_cursor_blink >= CURSOR_BLINK_MS) {
             task_dialog.cursor_visible = !task_dialog.cursor_visible;
-            task_dialog.last_cursor_blink = now;
+            task_dialog.last_cursor_blink = frame_clock_ms;
+            if (state == GAME_STATE_TASK_DIALOG) {
+                scene_invalidate(&scenes, NODE_DIALOG);
+            }
         }
 
         // Update message visibility
         update_message(&message);
 
+        // Pick up edits to the settings file
+        if (frame_clock_ms - config_checked_ms >= CONFIG_POLL_MS) {
+            config_checked_ms = frame_clock_ms;
+            if (config_reload(&config)) {
+                frame_pacer_init(&frame_pacer, target_fps(&config), config.idle_fps);
+                ui_set_text_cache_ways(&ui, config.text_cache_ways);
+                metrics_dirty = 1;
+            }
+        }
+
+        // Recompute the layout after the window or font size changed. Text
+        // is re-rendered from a font opened at the new scale. A replay lays
+        // out for the window as it was recorded, not for this one.
+        if (metrics_dirty) {
+            float scale = display_scale(window, renderer, &pixel_ratio);
+            int output_w, output_h;
+            int have_output = SDL_GetRendererOutputSize(renderer, &output_w, &output_h) == 0;
+            have_output |= replay_view(&replay, &output_w, &output_h, &scale, &pixel_ratio);
+            if (scale != ui_scale || font_size != config.font_size) {
+                Font scaled_font;
+                if (font_open(&scaled_font, FONT_PATH, FONT_ATLAS_PATH,
+                              (int)(config.font_size * scale + 0.5f)) == 0) {
+                    font_close(&font);
+                    font = scaled_font;
+                    ui_set_font(&ui, &font);
+                    text_input_set_font(&task_dialog.title, &font);
+                    text_input_set_font(&task_dialog.description, &font);
+                    text_input_set_font(&task_dialog.tags, &font);
+                    text_input_set_font(&task_dialog.due, &font);
+                    ui_scale = scale;
+                    font_size = config.font_size;
+                    scene_invalidate_all(&scenes);
+                }
+            }
+            if (have_output) {
+                layout_resize(&layout, output_w, output_h, ui_scale);
+                replay_note_view(&replay, output_w, output_h, scale, pixel_ratio);
+            }
+            metrics_dirty = 0;
+        }
+        if (layout_update(&layout) > 0) {
+            scene_invalidate_all(&scenes);
+        }
+
         // Clear screen
+        ui_begin_frame(&ui);
         SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
         SDL_RenderClear(renderer);
 
-        // Draw UI elements
-        ui_draw_text(&ui, "Heroman project", 10, 10);
-        
-        if (!showing_task_dialog) {
-            // Draw background
-            sprite_manager_draw_sprite_scaled(&sprite_manager, SPRITE_BACKGROUND, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
-
-            // Draw filter buttons
-            sprite_manager_draw_sprite_scaled(&sprite_manager, SPRITE_BUTTON_NORMAL, 
-                FILTER_ALL_BUTTON_X, FILTER_ALL_BUTTON_Y, 100, 30);
-            ui_draw_text(&ui, "All", FILTER_ALL_BUTTON_X + 40, FILTER_ALL_BUTTON_Y + 5);
-
-            sprite_manager_draw_sprite_scaled(&sprite_manager, SPRITE_BUTTON_NORMAL, 
-                FILTER_COMPLETED_BUTTON_X, FILTER_COMPLETED_BUTTON_Y, 100, 30);
-            ui_draw_text(&ui, "Completed", FILTER_COMPLETED_BUTTON_X + 20, FILTER_COMPLETED_BUTTON_Y + 5);
-
-            sprite_manager_draw_sprite_scaled(&sprite_manager, SPRITE_BUTTON_NORMAL, 
-                FILTER_UNCOMPLETED_BUTTON_X, FILTER_UNCOMPLETED_BUTTON_Y, 100, 30);
-            ui_draw_text(&ui, "Uncompleted", FILTER_UNCOMPLETED_BUTTON_X + 10, FILTER_UNCOMPLETED_BUTTON_Y + 5);
+        // Draw the current screen, rebuilding only what was invalidated
+        update_filter(&task_filter, &task_list, &tag_index, &due_order, &message);
+        Screen screen = {
+            .layout = &layout,
+            .frame_arena = &frame_arena,
+            .tasks = &task_list,
+            .tags = &tag_index,
+            .filter = &task_filter,
+            .stats = &db_context.stats,
+            .dialog = &task_dialog,
+            .message = &message,
+            .pressed_task = pressed_task,
+            .drop_index = drop_index,
+        };
+        track_scenes(&scenes, &screen);
+        scene_render(&scenes, state, &ui, &sprite_manager, layout.width, layout.height, &screen);
 
-            // Draw sort buttons
-            sprite_manager_draw_sprite_scaled(&sprite_manager, SPRITE_BUTTON_NORMAL, 
-                SORT_TYPE_BUTTON_X, SORT_TYPE_BUTTON_Y, 100, 30);
-            ui_draw_text(&ui, "Type", SORT_TYPE_BUTTON_X + 35, SORT_TYPE_BUTTON_Y + 5);
+        // Update screen
+        SDL_RenderPresent(renderer);
+        metrics_add(METRIC_FRAMES_RENDERED, 1);
+        replay_note_frame(&replay, (SDL_GetPerformanceCounter() - frame_start) * 1000.0 /
+                          SDL_GetPerformanceFrequency());
+
+        if (first_frame) {
+            double ms = (SDL_GetPerformanceCounter() - start_counter) * 1000.0 / SDL_GetPerformanceFrequency();
+            printf("First frame after %.1f ms\n", ms);
+            first_frame = 0;
+        }
 
-            sprite_manager_draw_sprite_scaled(&sprite_manager, SPRITE_BUTTON_NORMAL, 
-                SORT_DIFFICULTY_BUTTON_X, SORT_DIFFICULTY_BUTTON_Y, 100, 30);
-            ui_draw_text(&ui, "Difficulty", SORT_DIFFICULTY_BUTTON_X + 15, SORT_DIFFICULTY_BUTTON_Y + 5);
+        // Release transient data and account for this frame's allocations
+        arena_reset(&frame_arena);
+        memstats_end_frame();
+        if (config.frame_stats) {
+            Uint32 allocs = memstats_allocations() - frame_alloc_start;
+            frame_alloc_total += allocs;
+            if (allocs > frame_alloc_max) frame_alloc_max = allocs;
+            if (++frame_stats_count == FRAME_STATS_INTERVAL) {
+                printf("Heap allocations/frame: avg %.2f, max %u; frame arena peak %zu bytes\n",
+                       (double)frame_alloc_total / frame_stats_count, frame_alloc_max, frame_arena.peak);
+                frame_alloc_total = 0;
+                frame_alloc_max = 0;
+                frame_stats_count = 0;
+            }
+        }
 
-            sprite_manager_draw_sprite_scaled(&sprite_manager, SPRITE_BUTTON_NORMAL, 
-                SORT_COMPLETION_BUTTON_X, SORT_COMPLETION_BUTTON_Y, 100, 30);
-            ui_draw_text(&ui, "Completion", SORT_COMPLETION_BUTTON_X + 10, SORT_COMPLETION_BUTTON_Y + 5);
+        // Finish schema upgrades one batch at a time while nobody is
+        // interacting. Without adaptive pacing there is no idle state, so
+        // batches simply run back to back. Idle time is not part of a
+        // recording, so recordings and replays never start one.
+        if (replay.mode == REPLAY_OFF && db_context.backfill_pending && !db_context.backfill_in_flight &&
+            (frame_pacer_idle(&frame_pacer) || frame_pacer.idle_period == 0)) {
+            db_context.backfill_in_flight = db_worker_submit(db_worker, DB_OP_BACKFILL, NULL) != 0;
+        }
 
-            // Draw main menu
-            ui_draw_button(&ui, "New Task", NEW_TASK_BUTTON_X, NEW_TASK_BUTTON_Y,
-                          NEW_TASK_BUTTON_WIDTH, NEW_TASK_BUTTON_HEIGHT);
-            ui_draw_button(&ui, "Quit", QUIT_BUTTON_X, QUIT_BUTTON_Y,
-                          QUIT_BUTTON_WIDTH, QUIT_BUTTON_HEIGHT);
+        // Sorted by due date, the order is read from the index again after
+        // the list changes
+        if (task_filter.sort == TASK_SORT_DUE && !due_order.in_flight &&
+            due_order.list_version != task_list.version) {
+            due_order.list_version = task_list.version;
+            due_order.in_flight = db_worker_submit(db_worker, DB_OP_DUE, NULL) != 0;
+        }
 
-            // Draw task list
-            draw_task_list(&ui, &task_list);
+        // Look for commits from other instances or scripts while idle. The
+        // check is one PRAGMA unless something changed. Recordings skip it,
+        // since those writes would not be in the log.
+        if (replay.mode == REPLAY_OFF && config.sync_poll_ms > 0 && db_context.loaded &&
+            !db_context.sync_in_flight && frame_clock_ms - sync_checked_ms >= (Uint32)config.sync_poll_ms &&
+            (frame_pacer_idle(&frame_pacer) || frame_pacer.idle_period == 0)) {
+            sync_checked_ms = frame_clock_ms;
+            db_context.sync_in_flight = db_worker_submit_sync(db_worker, db_context.revision,
+                                                              db_context.data_version) != 0;
         }
-        else {
-            // Draw task dialog
-            SDL_Rect dialog_rect = {TASK_DIALOG_X, TASK_DIALOG_Y,
-                                  TASK_DIALOG_WIDTH, TASK_DIALOG_HEIGHT};
-            SDL_SetRenderDrawColor(renderer, 50, 50, 50, 255);
-            SDL_RenderFillRect(renderer, &dialog_rect);
-            SDL_SetRenderDrawColor(renderer, 200, 200, 200, 255);
-            SDL_RenderDrawRect(renderer, &dialog_rect);
-
-            ui_draw_text(&ui, "New Task", TASK_DIALOG_X + 10, TASK_DIALOG_Y + 10);
-            
-            // Draw title input
-            ui_draw_text(&ui, "Title:", TASK_TITLE_INPUT_X, TASK_TITLE_INPUT_Y - 20);
-            SDL_Rect title_rect = {TASK_TITLE_INPUT_X, TASK_TITLE_INPUT_Y,
-                                 TASK_TITLE_INPUT_WIDTH, TASK_TITLE_INPUT_HEIGHT};
-            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-            SDL_RenderFillRect(renderer, &title_rect);
-            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-            SDL_RenderDrawRect(renderer, &title_rect);
-            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-            ui_draw_text(&ui, task_dialog.title, TASK_TITLE_INPUT_X + 5, TASK_TITLE_INPUT_Y + 5);
-            if (task_dialog.editing_title) {
-                int cursor_x = TASK_TITLE_INPUT_X + 5;
-                if (task_dialog.cursor_position > 0) {
-                    char temp[256] = {0};
-                    strncpy(temp, task_dialog.title, task_dialog.cursor_position);
-                    int w, h;
-                    TTF_SizeText(font, temp, &w, &h);
-                    cursor_x += w;
-                }
-                draw_cursor(&ui, cursor_x, TASK_TITLE_INPUT_Y + 5, TASK_TITLE_INPUT_HEIGHT - 10,
-                           task_dialog.cursor_visible);
-            }
 
-            // Draw description input
-            ui_draw_text(&ui, "Description:", TASK_DESC_INPUT_X, TASK_DESC_INPUT_Y - 20);
-            SDL_Rect desc_rect = {TASK_DESC_INPUT_X, TASK_DESC_INPUT_Y,
-                                TASK_DESC_INPUT_WIDTH, TASK_DESC_INPUT_HEIGHT};
-            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-            SDL_RenderFillRect(renderer, &desc_rect);
-            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-            SDL_RenderDrawRect(renderer, &desc_rect);
-            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-            ui_draw_text(&ui, task_dialog.description, TASK_DESC_INPUT_X + 5, TASK_DESC_INPUT_Y + 5);
-            if (task_dialog.editing_description) {
-                int cursor_x = TASK_DESC_INPUT_X + 5;
-                if (task_dialog.cursor_position > 0) {
-                    char temp[512] = {0};
-                    strncpy(temp, task_dialog.description, task_dialog.cursor_position);
-                    int w, h;
-                    TTF_SizeText(font, temp, &w, &h);
-                    cursor_x += w;
-                }
-                draw_cursor(&ui, cursor_x, TASK_DESC_INPUT_Y + 5, TASK_DESC_INPUT_HEIGHT - 10,
-                           task_dialog.cursor_visible);
+        // Wait out the rest of the frame; replays run as fast as they can
+        if (replay.mode != REPLAY_PLAY) {
+            if (frame_pacer_wait(&frame_pacer)) {
+                metrics_add(METRIC_FRAMES_DROPPED, 1);
             }
-
-            // Draw type selection
-            ui_draw_text(&ui, "Type:", TASK_TYPE_X, TASK_TYPE_Y - 20);
-            SDL_Rect type_rect = {TASK_TYPE_X, TASK_TYPE_Y,
-                                TASK_TYPE_WIDTH, TASK_TYPE_HEIGHT};
-            SDL_SetRenderDrawColor(renderer, 200, 200, 200, 255);
-            SDL_RenderFillRect(renderer, &type_rect);
-            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-            SDL_RenderDrawRect(renderer, &type_rect);
-            ui_draw_text(&ui, task_type_names[task_dialog.type], TASK_TYPE_X + 5, TASK_TYPE_Y + 5);
-
-            // Draw difficulty selection
-            ui_draw_text(&ui, "Difficulty:", TASK_DIFFICULTY_X, TASK_DIFFICULTY_Y - 20);
-            SDL_Rect diff_rect = {TASK_DIFFICULTY_X, TASK_DIFFICULTY_Y,
-                                TASK_DIFFICULTY_WIDTH, TASK_DIFFICULTY_HEIGHT};
-            SDL_SetRenderDrawColor(renderer, 200, 200, 200, 255);
-            SDL_RenderFillRect(renderer, &diff_rect);
-            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-            SDL_RenderDrawRect(renderer, &diff_rect);
-            ui_draw_text(&ui, task_difficulty_names[task_dialog.difficulty],
-                        TASK_DIFFICULTY_X + 5, TASK_DIFFICULTY_Y + 5);
-
-            // Draw buttons
-            ui_draw_button(&ui, "Save", TASK_SAVE_BUTTON_X, TASK_SAVE_BUTTON_Y,
-                          TASK_SAVE_BUTTON_WIDTH, TASK_SAVE_BUTTON_HEIGHT);
-            ui_draw_button(&ui, "Cancel", TASK_CANCEL_BUTTON_X, TASK_CANCEL_BUTTON_Y,
-                          TASK_CANCEL_BUTTON_WIDTH, TASK_CANCEL_BUTTON_HEIGHT);
-        }
-
-        // Draw message
-        draw_message(&ui, &message);
-
-        // Update screen
-        SDL_RenderPresent(renderer);
-
-        // Cap at 60 FPS
-        SDL_Delay(16);
+        }
     }
 
+    // Let the database thread finish queued work, then take the
+    // connection back to record the snapshot
+    db_context.worker = NULL;
+    db_worker_stop(db_worker, apply_db_response, &db_context);
+    metrics_exporter_stop();
+
     // Cleanup
-    free_task_list(&task_list);
+    // Other connections may have committed since the last sync; catch up
+    // so the list matches the revision the snapshot is stamped with
+    if (snapshot_path && db_context.loaded && sqlite3_exec(db, "BEGIN;", 0, 0, NULL) == SQLITE_OK) {
+        sqlite3_int64 tasks_revision;
+        TaskDelta* deltas;
+        int delta_count;
+        if (db_get_tasks_revision(db, &tasks_revision) == 0 &&
+            task_events_since(db, db_context.revision, &deltas, &delta_count) == 0) {
+            if (task_list_apply(&task_list, deltas, delta_count) >= 0) {
+                snapshot_write(snapshot_path, task_list.tasks, task_list.count, tasks_revision);
+            }
+            free(deltas);
+        }
+        sqlite3_exec(db, "COMMIT;", 0, 0, NULL);
+    }
+    replay_report(&replay);
+    replay_close(&replay);
+    task_list_free(&task_list);
+    tag_index_free(&tag_index);
+    bitmap_free(&task_filter.rows);
+    free(task_filter.order_next);
+    free(due_order.ids);
+    reminders_free(&reminders);
+    free(db_context.stats);
+    arena_free(&frame_arena);
     db_close(db);
-    TTF_CloseFont(font);
+    scene_graph_free(&scenes);
+    ui_cleanup(&ui);
+    sprite_manager_cleanup(&sprite_manager);
+    font_close(&font);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
-    sprite_manager_cleanup(&sprite_manager);
-    TTF_Quit();
+    TTF_Quit();  // A no-op if only the baked atlas was used
     SDL_Quit();
+    memstats_report(stdout);
 
     return 0;
 } 
\ No newline at end of file
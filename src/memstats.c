@@ -0,0 +1,357 @@
+#define MEMSTATS_NO_WRAP
+#include "memstats.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// The header may have been force-included already, wrappers and all
+#undef malloc
+#undef calloc
+#undef realloc
+#undef free
+
+static SDL_malloc_func real_malloc;
+static SDL_calloc_func real_calloc;
+static SDL_realloc_func real_realloc;
+static SDL_free_func real_free;
+static SDL_atomic_t allocation_count;
+
+#ifndef HEROMAN_MEMTRACK
+
+static void* counting_malloc(size_t size) {
+    SDL_AtomicAdd(&allocation_count, 1);
+    return real_malloc(size);
+}
+
+static void* counting_calloc(size_t nmemb, size_t size) {
+    SDL_AtomicAdd(&allocation_count, 1);
+    return real_calloc(nmemb, size);
+}
+
+static void* counting_realloc(void* mem, size_t size) {
+    SDL_AtomicAdd(&allocation_count, 1);
+    return real_realloc(mem, size);
+}
+
+static void counting_free(void* mem) {
+    real_free(mem);
+}
+
+void memstats_install(void) {
+    if (real_malloc) return;
+
+    SDL_GetMemoryFunctions(&real_malloc, &real_calloc, &real_realloc, &real_free);
+    if (SDL_SetMemoryFunctions(counting_malloc, counting_calloc, counting_realloc, counting_free) != 0) {
+        real_malloc = NULL;
+    }
+}
+
+void memstats_end_frame(void) {
+}
+
+void memstats_report(FILE* out) {
+    (void)out;
+}
+
+void* memstats_malloc(size_t size, const char* file, int line) {
+    (void)file;
+    (void)line;
+    return malloc(size);
+}
+
+void* memstats_calloc(size_t count, size_t size, const char* file, int line) {
+    (void)file;
+    (void)line;
+    return calloc(count, size);
+}
+
+void* memstats_realloc(void* mem, size_t size, const char* file, int line) {
+    (void)file;
+    (void)line;
+    return realloc(mem, size);
+}
+
+void memstats_free(void* mem) {
+    free(mem);
+}
+
+#else
+
+#include <sqlite3.h>
+
+#define MEMSTATS_SITES 1024   // Power of two
+#define MEMSTATS_TOP_SITES 15
+
+// Blocks from the game and SDL carry their size in front, so frees can be
+// subtracted from the live total. SQLite can report sizes itself.
+typedef union {
+    size_t size;
+    max_align_t align;
+} BlockHeader;
+
+typedef struct {
+    Uint64 allocations;   // malloc, calloc and realloc calls
+    Uint64 bytes;         // Bytes they asked for
+    Sint64 live;
+    Sint64 peak;
+    Uint64 frame_start_allocations;
+    Uint64 frame_start_bytes;
+    Uint64 frame_max_allocations;
+    Uint64 frame_max_bytes;
+} SubsystemStats;
+
+typedef struct {
+    const char* file;     // NULL while the slot is free
+    int line;
+    Uint64 allocations;
+    Uint64 bytes;
+} SiteStats;
+
+// Allocations can come from any thread, and the wrappers cannot allocate
+static SDL_SpinLock lock;
+static SubsystemStats subsystems[MEM_SUBSYSTEM_COUNT];
+static SiteStats sites[MEMSTATS_SITES];
+static Uint64 frames;
+static Uint64 dropped_sites;   // Allocations whose site did not fit the table
+static sqlite3_mem_methods sqlite_methods;
+
+static const char* subsystem_names[MEM_SUBSYSTEM_COUNT] = {
+    [MEM_HEROMAN] = "heroman",
+    [MEM_SDL]     = "SDL",
+    [MEM_SQLITE]  = "SQLite",
+};
+
+// Call with the lock held. size is what the allocation asked for and
+// change how much the live total moved.
+static void note_allocation(MemSubsystem subsystem, size_t size, Sint64 change, const char* file, int line) {
+    SubsystemStats* stats = &subsystems[subsystem];
+    stats->allocations++;
+    stats->bytes += size;
+    stats->live += change;
+    if (stats->live > stats->peak) stats->peak = stats->live;
+    SDL_AtomicAdd(&allocation_count, 1);
+
+    if (!file) return;
+    size_t hash = ((size_t)file >> 4) * 31 + (size_t)line;
+    for (int probe = 0; probe < MEMSTATS_SITES; probe++) {
+        SiteStats* site = &sites[(hash + probe) & (MEMSTATS_SITES - 1)];
+        if (!site->file) {
+            site->file = file;
+            site->line = line;
+        }
+        if (site->file == file && site->line == line) {
+            site->allocations++;
+            site->bytes += size;
+            return;
+        }
+    }
+    dropped_sites++;
+}
+
+static void note_free(MemSubsystem subsystem, size_t size) {
+    SDL_AtomicLock(&lock);
+    subsystems[subsystem].live -= (Sint64)size;
+    SDL_AtomicUnlock(&lock);
+}
+
+static void* block_malloc(MemSubsystem subsystem, size_t size, const char* file, int line) {
+    if (size > SIZE_MAX - sizeof(BlockHeader)) return NULL;
+    BlockHeader* header = malloc(sizeof(BlockHeader) + size);
+    if (!header) return NULL;
+    header->size = size;
+
+    SDL_AtomicLock(&lock);
+    note_allocation(subsystem, size, (Sint64)size, file, line);
+    SDL_AtomicUnlock(&lock);
+    return header + 1;
+}
+
+static void* block_calloc(MemSubsystem subsystem, size_t count, size_t size, const char* file, int line) {
+    if (size != 0 && count > SIZE_MAX / size) return NULL;
+    void* mem = block_malloc(subsystem, count * size, file, line);
+    if (mem) memset(mem, 0, count * size);
+    return mem;
+}
+
+static void* block_realloc(MemSubsystem subsystem, void* mem, size_t size, const char* file, int line) {
+    if (!mem) return block_malloc(subsystem, size, file, line);
+    if (size > SIZE_MAX - sizeof(BlockHeader)) return NULL;
+
+    BlockHeader* header = (BlockHeader*)mem - 1;
+    size_t old_size = header->size;
+    header = realloc(header, sizeof(BlockHeader) + size);
+    if (!header) return NULL;
+    header->size = size;
+
+    SDL_AtomicLock(&lock);
+    note_allocation(subsystem, size, (Sint64)size - (Sint64)old_size, file, line);
+    SDL_AtomicUnlock(&lock);
+    return header + 1;
+}
+
+static void block_free(MemSubsystem subsystem, void* mem) {
+    if (!mem) return;
+    BlockHeader* header = (BlockHeader*)mem - 1;
+    note_free(subsystem, header->size);
+    free(header);
+}
+
+void* memstats_malloc(size_t size, const char* file, int line) {
+    return block_malloc(MEM_HEROMAN, size, file, line);
+}
+
+void* memstats_calloc(size_t count, size_t size, const char* file, int line) {
+    return block_calloc(MEM_HEROMAN, count, size, file, line);
+}
+
+void* memstats_realloc(void* mem, size_t size, const char* file, int line) {
+    return block_realloc(MEM_HEROMAN, mem, size, file, line);
+}
+
+void memstats_free(void* mem) {
+    block_free(MEM_HEROMAN, mem);
+}
+
+// SDL gives no call site; its allocations are counted per subsystem only
+static void* sdl_malloc(size_t size) {
+    return block_malloc(MEM_SDL, size, NULL, 0);
+}
+
+static void* sdl_calloc(size_t count, size_t size) {
+    return block_calloc(MEM_SDL, count, size, NULL, 0);
+}
+
+static void* sdl_realloc(void* mem, size_t size) {
+    return block_realloc(MEM_SDL, mem, size, NULL, 0);
+}
+
+static void sdl_free(void* mem) {
+    block_free(MEM_SDL, mem);
+}
+
+static void* sqlite_malloc(int size) {
+    void* mem = sqlite_methods.xMalloc(size);
+    if (mem) {
+        SDL_AtomicLock(&lock);
+        note_allocation(MEM_SQLITE, (size_t)size, sqlite_methods.xSize(mem), NULL, 0);
+        SDL_AtomicUnlock(&lock);
+    }
+    return mem;
+}
+
+static void sqlite_free(void* mem) {
+    if (!mem) return;
+    note_free(MEM_SQLITE, (size_t)sqlite_methods.xSize(mem));
+    sqlite_methods.xFree(mem);
+}
+
+static void* sqlite_realloc(void* mem, int size) {
+    int old_size = mem ? sqlite_methods.xSize(mem) : 0;
+    void* grown = sqlite_methods.xRealloc(mem, size);
+    if (grown) {
+        SDL_AtomicLock(&lock);
+        note_allocation(MEM_SQLITE, (size_t)size, sqlite_methods.xSize(grown) - old_size, NULL, 0);
+        SDL_AtomicUnlock(&lock);
+    }
+    return grown;
+}
+
+static int sqlite_size(void* mem) {
+    return sqlite_methods.xSize(mem);
+}
+
+static int sqlite_roundup(int size) {
+    return sqlite_methods.xRoundup(size);
+}
+
+static int sqlite_init(void* data) {
+    return sqlite_methods.xInit(data);
+}
+
+static void sqlite_shutdown(void* data) {
+    sqlite_methods.xShutdown(data);
+}
+
+void memstats_install(void) {
+    if (real_malloc) return;
+
+    SDL_GetMemoryFunctions(&real_malloc, &real_calloc, &real_realloc, &real_free);
+    if (SDL_SetMemoryFunctions(sdl_malloc, sdl_calloc, sdl_realloc, sdl_free) != 0) {
+        real_malloc = NULL;
+    }
+
+    // Wraps SQLite's own allocator, which then reports block sizes
+    if (sqlite3_config(SQLITE_CONFIG_GETMALLOC, &sqlite_methods) == SQLITE_OK) {
+        sqlite3_mem_methods counting = {
+            sqlite_malloc, sqlite_free, sqlite_realloc, sqlite_size,
+            sqlite_roundup, sqlite_init, sqlite_shutdown, sqlite_methods.pAppData
+        };
+        if (sqlite3_config(SQLITE_CONFIG_MALLOC, &counting) != SQLITE_OK) {
+            fprintf(stderr, "SQLite allocations are not tracked: SQLite was already in use\n");
+        }
+    }
+}
+
+void memstats_end_frame(void) {
+    SDL_AtomicLock(&lock);
+    for (int i = 0; i < MEM_SUBSYSTEM_COUNT; i++) {
+        SubsystemStats* stats = &subsystems[i];
+        Uint64 allocations = stats->allocations - stats->frame_start_allocations;
+        Uint64 bytes = stats->bytes - stats->frame_start_bytes;
+        if (allocations > stats->frame_max_allocations) stats->frame_max_allocations = allocations;
+        if (bytes > stats->frame_max_bytes) stats->frame_max_bytes = bytes;
+        stats->frame_start_allocations = stats->allocations;
+        stats->frame_start_bytes = stats->bytes;
+    }
+    frames++;
+    SDL_AtomicUnlock(&lock);
+}
+
+static int compare_sites(const void* a, const void* b) {
+    const SiteStats* left = a;
+    const SiteStats* right = b;
+    if (left->allocations != right->allocations) return left->allocations < right->allocations ? 1 : -1;
+    return (left->bytes < right->bytes) - (left->bytes > right->bytes);
+}
+
+void memstats_report(FILE* out) {
+    // Copied out so the sort and the printing happen without the lock
+    static SiteStats sorted[MEMSTATS_SITES];
+    SubsystemStats totals[MEM_SUBSYSTEM_COUNT];
+    SDL_AtomicLock(&lock);
+    memcpy(totals, subsystems, sizeof(totals));
+    memcpy(sorted, sites, sizeof(sorted));
+    Uint64 frame_count = frames;
+    Uint64 dropped = dropped_sites;
+    SDL_AtomicUnlock(&lock);
+
+    fprintf(out, "Allocations over %llu frames:\n", (unsigned long long)frame_count);
+    fprintf(out, "  %-8s %12s %14s %10s %10s %12s %12s %12s\n", "", "allocs", "bytes",
+            "allocs/fr", "max/fr", "max bytes/fr", "live", "peak");
+    for (int i = 0; i < MEM_SUBSYSTEM_COUNT; i++) {
+        const SubsystemStats* stats = &totals[i];
+        fprintf(out, "  %-8s %12llu %14llu %10.2f %10llu %12llu %12lld %12lld\n", subsystem_names[i],
+                (unsigned long long)stats->allocations, (unsigned long long)stats->bytes,
+                frame_count ? (double)stats->allocations / frame_count : 0.0,
+                (unsigned long long)stats->frame_max_allocations,
+                (unsigned long long)stats->frame_max_bytes,
+                (long long)stats->live, (long long)stats->peak);
+    }
+
+    qsort(sorted, MEMSTATS_SITES, sizeof(SiteStats), compare_sites);
+    fprintf(out, "Busiest allocation sites:\n");
+    for (int i = 0; i < MEMSTATS_TOP_SITES && sorted[i].file; i++) {
+        fprintf(out, "  %10llu allocs %12llu bytes  %s:%d\n", (unsigned long long)sorted[i].allocations,
+                (unsigned long long)sorted[i].bytes, sorted[i].file, sorted[i].line);
+    }
+    if (dropped > 0) {
+        fprintf(out, "  %10llu allocs at sites that did not fit the table\n", (unsigned long long)dropped);
+    }
+}
+
+#endif // HEROMAN_MEMTRACK
+
+// Wraps around; callers compare successive readings with unsigned math
+Uint32 memstats_allocations(void) {
+    return (Uint32)SDL_AtomicGet(&allocation_count);
+}
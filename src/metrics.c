@@ -0,0 +1,340 @@
+#include "metrics.h"
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#define CACHE_LINE 64
+#define METRICS_TEXT_SIZE 16384
+#define METRICS_POLL_MS 200     // Longest the exporter sleeps before checking for stop
+#define METRICS_REQUEST_MS 100  // How long a scraper gets to send its request
+
+// Histogram bucket upper bounds in microseconds; the last bucket is +Inf
+#define METRICS_BUCKETS 14
+static const Uint64 bucket_bounds_us[METRICS_BUCKETS - 1] = {
+    50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000
+};
+
+typedef struct {
+    atomic_uint_fast64_t counters[METRIC_COUNTER_COUNT];
+    atomic_uint_fast64_t buckets[METRIC_HISTOGRAM_COUNT][METRICS_BUCKETS];
+    atomic_uint_fast64_t sum_us[METRIC_HISTOGRAM_COUNT];
+} MetricsValues;
+
+// Padded to whole cache lines so neighbouring shards never share one
+typedef struct {
+    MetricsValues values;
+    char pad[CACHE_LINE - sizeof(MetricsValues) % CACHE_LINE];
+} MetricsShard;
+
+// Threads past METRICS_MAX_SHARDS share the last shard; updates are
+// atomic adds, so that stays correct, just slower under contention
+static _Alignas(CACHE_LINE) MetricsShard shards[METRICS_MAX_SHARDS + 1];
+static atomic_int shard_count;
+static _Thread_local MetricsShard* thread_shard;
+
+static const struct {
+    const char* name;
+    const char* help;
+} counter_info[METRIC_COUNTER_COUNT] = {
+    [METRIC_FRAMES_RENDERED]  = {"heroman_frames_rendered_total", "Frames drawn and presented."},
+    [METRIC_FRAMES_DROPPED]   = {"heroman_frames_dropped_total", "Frames that finished after their pacing deadline."},
+    [METRIC_TEXTURES_CREATED] = {"heroman_textures_created_total", "SDL textures created."},
+    [METRIC_SCENE_REBUILDS]   = {"heroman_scene_rebuilds_total", "Screen display lists rebuilt."},
+};
+
+static const char* const histogram_ops[METRIC_HISTOGRAM_COUNT] = {
+    [METRIC_DB_LOAD]      = "load",
+    [METRIC_DB_CREATE]    = "create",
+    [METRIC_DB_UPDATE]    = "update",
+    [METRIC_DB_DELETE]    = "delete",
+    [METRIC_DB_BACKFILL]  = "backfill",
+    [METRIC_DB_REBALANCE] = "rebalance",
+    [METRIC_DB_STATS]     = "stats",
+    [METRIC_DB_SYNC]      = "sync",
+    [METRIC_DB_BULK]      = "bulk",
+    [METRIC_DB_MOVE]      = "move",
+    [METRIC_DB_TAGS]      = "tags",
+    [METRIC_DB_DUE]       = "due",
+};
+
+static MetricsShard* current_shard(void) {
+    MetricsShard* shard = thread_shard;
+    if (!shard) {
+        int index = atomic_fetch_add(&shard_count, 1);
+        shard = &shards[index < METRICS_MAX_SHARDS ? index : METRICS_MAX_SHARDS];
+        thread_shard = shard;
+    }
+    return shard;
+}
+
+void metrics_add(MetricCounter counter, Uint64 value) {
+    atomic_fetch_add_explicit(&current_shard()->values.counters[counter], value, memory_order_relaxed);
+}
+
+void metrics_observe(MetricHistogram histogram, Uint64 microseconds) {
+    int bucket = 0;
+    while (bucket < METRICS_BUCKETS - 1 && microseconds > bucket_bounds_us[bucket]) {
+        bucket++;
+    }
+
+    MetricsValues* values = &current_shard()->values;
+    atomic_fetch_add_explicit(&values->buckets[histogram][bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&values->sum_us[histogram], microseconds, memory_order_relaxed);
+}
+
+static Uint64 sum_shards(const atomic_uint_fast64_t* first_shard_value) {
+    // The same field in every shard, one shard apart
+    size_t offset = (const char*)first_shard_value - (const char*)&shards[0];
+    Uint64 total = 0;
+    for (int i = 0; i <= METRICS_MAX_SHARDS; i++) {
+        const atomic_uint_fast64_t* value = (const atomic_uint_fast64_t*)((const char*)&shards[i] + offset);
+        total += atomic_load_explicit(value, memory_order_relaxed);
+    }
+    return total;
+}
+
+static void append(char* out, size_t size, size_t* length, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int written = vsnprintf(*length < size ? out + *length : NULL,
+                            *length < size ? size - *length : 0, fmt, args);
+    va_end(args);
+    if (written > 0) {
+        *length += (size_t)written;
+    }
+}
+
+// Resident set size, or 0 where it cannot be read
+static Uint64 resident_bytes(void) {
+#ifdef __linux__
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (!file) return 0;
+
+    unsigned long pages_total, pages_resident;
+    int found = fscanf(file, "%lu %lu", &pages_total, &pages_resident) == 2;
+    fclose(file);
+    return found ? (Uint64)pages_resident * (Uint64)sysconf(_SC_PAGESIZE) : 0;
+#else
+    return 0;
+#endif
+}
+
+size_t metrics_format(char* out, size_t size) {
+    size_t length = 0;
+    if (size > 0) out[0] = '\0';
+
+    for (int c = 0; c < METRIC_COUNTER_COUNT; c++) {
+        append(out, size, &length, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n",
+               counter_info[c].name, counter_info[c].help, counter_info[c].name, counter_info[c].name,
+               (unsigned long long)sum_shards(&shards[0].values.counters[c]));
+    }
+
+    const char* name = "heroman_db_op_duration_seconds";
+    append(out, size, &length, "# HELP %s Time the database thread spent on each request.\n"
+                               "# TYPE %s histogram\n", name, name);
+    for (int h = 0; h < METRIC_HISTOGRAM_COUNT; h++) {
+        Uint64 cumulative = 0;
+        for (int b = 0; b < METRICS_BUCKETS; b++) {
+            cumulative += sum_shards(&shards[0].values.buckets[h][b]);
+            if (b < METRICS_BUCKETS - 1) {
+                append(out, size, &length, "%s_bucket{op=\"%s\",le=\"%g\"} %llu\n", name, histogram_ops[h],
+                       bucket_bounds_us[b] / 1e6, (unsigned long long)cumulative);
+            }
+            else {
+                append(out, size, &length, "%s_bucket{op=\"%s\",le=\"+Inf\"} %llu\n", name, histogram_ops[h],
+                       (unsigned long long)cumulative);
+            }
+        }
+        append(out, size, &length, "%s_sum{op=\"%s\"} %.6f\n%s_count{op=\"%s\"} %llu\n",
+               name, histogram_ops[h], sum_shards(&shards[0].values.sum_us[h]) / 1e6,
+               name, histogram_ops[h], (unsigned long long)cumulative);
+    }
+
+    Uint64 rss = resident_bytes();
+    if (rss) {
+        append(out, size, &length, "# HELP process_resident_memory_bytes Resident memory size in bytes.\n"
+                                   "# TYPE process_resident_memory_bytes gauge\n"
+                                   "process_resident_memory_bytes %llu\n", (unsigned long long)rss);
+    }
+    return length;
+}
+
+typedef struct {
+    SDL_Thread* thread;
+    SDL_sem* wakeup;
+    atomic_int stopping;
+    char path[256];
+    char socket_path[108];
+    int listen_fd;
+    Uint32 interval_ms;
+    char text[METRICS_TEXT_SIZE];
+} MetricsExporter;
+
+static MetricsExporter exporter = {.listen_fd = -1};
+
+// Written beside the target and renamed over it, so a scraper never
+// reads a half-written file
+static void write_file(void) {
+    size_t length = metrics_format(exporter.text, sizeof(exporter.text));
+    if (length >= sizeof(exporter.text)) length = sizeof(exporter.text) - 1;
+
+    char temp_path[sizeof(exporter.path) + 8];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", exporter.path);
+    FILE* file = fopen(temp_path, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to write metrics to %s\n", temp_path);
+        return;
+    }
+    int ok = fwrite(exporter.text, 1, length, file) == length;
+    ok = fclose(file) == 0 && ok;
+#ifdef _WIN32
+    remove(exporter.path);
+#endif
+    if (!ok || rename(temp_path, exporter.path) != 0) {
+        fprintf(stderr, "Failed to write metrics to %s\n", exporter.path);
+        remove(temp_path);
+    }
+}
+
+#ifdef __linux__
+static int open_listener(const char* socket_path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", socket_path);
+        return -1;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    unlink(socket_path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0 ||
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK) != 0) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Waits up to timeout_ms for scrapers and answers each with one HTTP
+// response carrying the current metrics
+static void serve_scrapes(int timeout_ms) {
+    struct pollfd pfd = {exporter.listen_fd, POLLIN, 0};
+    if (poll(&pfd, 1, timeout_ms) <= 0) return;
+
+    int client;
+    while ((client = accept(exporter.listen_fd, NULL, NULL)) >= 0) {
+        // The request itself does not matter, but closing before it has
+        // arrived would reset the connection under the scraper
+        struct pollfd request_pfd = {client, POLLIN, 0};
+        char request[1024];
+        if (poll(&request_pfd, 1, METRICS_REQUEST_MS) > 0) {
+            recv(client, request, sizeof(request), MSG_DONTWAIT);
+        }
+
+        size_t length = metrics_format(exporter.text, sizeof(exporter.text));
+        if (length >= sizeof(exporter.text)) length = sizeof(exporter.text) - 1;
+        char header[128];
+        int header_length = snprintf(header, sizeof(header),
+                                     "HTTP/1.0 200 OK\r\n"
+                                     "Content-Type: text/plain; version=0.0.4\r\n"
+                                     "Content-Length: %zu\r\n\r\n", length);
+        if (send(client, header, (size_t)header_length, MSG_NOSIGNAL) == header_length) {
+            send(client, exporter.text, length, MSG_NOSIGNAL);
+        }
+        close(client);
+    }
+}
+#endif
+
+static int exporter_main(void* data) {
+    (void)data;
+    Uint32 next_write = SDL_GetTicks();
+
+    while (!atomic_load(&exporter.stopping)) {
+        Uint32 now = SDL_GetTicks();
+        if (exporter.path[0] && (Sint32)(now - next_write) >= 0) {
+            write_file();
+            next_write = now + exporter.interval_ms;
+        }
+
+        Uint32 wait = exporter.path[0] ? next_write - now : exporter.interval_ms;
+        if (wait > METRICS_POLL_MS) wait = METRICS_POLL_MS;
+#ifdef __linux__
+        if (exporter.listen_fd >= 0) {
+            serve_scrapes((int)wait);
+            continue;
+        }
+#endif
+        SDL_SemWaitTimeout(exporter.wakeup, wait);
+    }
+
+    // Leave the final totals behind
+    if (exporter.path[0]) {
+        write_file();
+    }
+    return 0;
+}
+
+int metrics_exporter_start(const Config* config) {
+    if (!config->metrics_path[0] && !config->metrics_socket[0]) return 0;
+
+    snprintf(exporter.path, sizeof(exporter.path), "%s", config->metrics_path);
+    exporter.interval_ms = (Uint32)config->metrics_interval_ms;
+    atomic_store(&exporter.stopping, 0);
+
+    if (config->metrics_socket[0]) {
+#ifdef __linux__
+        exporter.listen_fd = open_listener(config->metrics_socket);
+        if (exporter.listen_fd < 0) return 1;
+        snprintf(exporter.socket_path, sizeof(exporter.socket_path), "%s", config->metrics_socket);
+#else
+        fprintf(stderr, "Metrics socket is only supported on Linux\n");
+#endif
+    }
+
+    exporter.wakeup = SDL_CreateSemaphore(0);
+    exporter.thread = exporter.wakeup ? SDL_CreateThread(exporter_main, "metrics", NULL) : NULL;
+    if (!exporter.thread) {
+        fprintf(stderr, "Failed to start metrics exporter: %s\n", SDL_GetError());
+        metrics_exporter_stop();
+        return 1;
+    }
+    return 0;
+}
+
+void metrics_exporter_stop(void) {
+    if (exporter.thread) {
+        atomic_store(&exporter.stopping, 1);
+        SDL_SemPost(exporter.wakeup);
+        SDL_WaitThread(exporter.thread, NULL);
+        exporter.thread = NULL;
+    }
+    if (exporter.wakeup) {
+        SDL_DestroySemaphore(exporter.wakeup);
+        exporter.wakeup = NULL;
+    }
+#ifdef __linux__
+    if (exporter.listen_fd >= 0) {
+        close(exporter.listen_fd);
+        unlink(exporter.socket_path);
+        exporter.listen_fd = -1;
+    }
+#endif
+}
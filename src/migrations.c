@@ -0,0 +1,479 @@
+#include "migrations.h"
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+    int version;
+    const char* name;
+    const char* sql;               // May be NULL
+    int (*apply)(sqlite3* db);     // Runs after sql; may be NULL
+} Migration;
+
+typedef struct {
+    const char* name;              // Progress lives in meta as "backfill:<name>"
+    const char* update_sql;        // Binds ?1/?2 to the batch's first/last id
+    const char* finish_sql;        // Runs after the last batch; may be NULL
+} Backfill;
+
+static int column_exists(sqlite3* db, const char* table, const char* column) {
+    char sql[128];
+    snprintf(sql, sizeof(sql), "PRAGMA table_info(%s);", table);
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) return 0;
+
+    int found = 0;
+    while (!found && sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* name = (const char*)sqlite3_column_text(stmt, 1);
+        found = name && strcmp(name, column) == 0;
+    }
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+static int exec_sql(sqlite3* db, const char* sql) {
+    char* err_msg = NULL;
+    if (sqlite3_exec(db, sql, 0, 0, &err_msg) != SQLITE_OK) {
+        fprintf(stderr, "SQL error: %s\n", err_msg);
+        sqlite3_free(err_msg);
+        return 1;
+    }
+    return 0;
+}
+
+// Databases created before versioning got their tasks table from db_init,
+// without the streak columns; the later CREATE TABLE in db_create_schema
+// was skipped because the table already existed.
+static int add_streak_columns(sqlite3* db) {
+    if (!column_exists(db, "tasks", "streak") &&
+        exec_sql(db, "ALTER TABLE tasks ADD COLUMN streak INTEGER NOT NULL DEFAULT 0;") != 0) {
+        return 1;
+    }
+    if (!column_exists(db, "tasks", "last_completed") &&
+        exec_sql(db, "ALTER TABLE tasks ADD COLUMN last_completed INTEGER NOT NULL DEFAULT 0;") != 0) {
+        return 1;
+    }
+
+    // Tasks already completed get their creation time as a best guess
+    if (column_exists(db, "tasks", "created_at")) {
+        return exec_sql(db, "INSERT OR IGNORE INTO meta (key, value) "
+                            "VALUES ('backfill:last_completed', 0);");
+    }
+    return 0;
+}
+
+// Existing tasks keep their creation order: each takes its id as position.
+// Reads order by the index, which is built once the backfill is done.
+static int add_position_column(sqlite3* db) {
+    if (!column_exists(db, "tasks", "position") &&
+        exec_sql(db, "ALTER TABLE tasks ADD COLUMN position REAL NOT NULL DEFAULT 0;") != 0) {
+        return 1;
+    }
+    return exec_sql(db, "INSERT OR IGNORE INTO meta (key, value) VALUES ('backfill:position', 0);");
+}
+
+// Day a task's latest completion counts towards, in local time. Rows
+// completed before last_completed existed fall back to their creation
+// time, as the last_completed backfill does.
+#define STATS_DAY(row) \
+    "date(CASE WHEN " row ".last_completed > 0 THEN " row ".last_completed " \
+    "ELSE CAST(strftime('%s', coalesce(" row ".created_at, 'now')) AS INTEGER) END, 'unixepoch', 'localtime')"
+
+// Experience for completing the row; mirrors task_get_reward
+#define STATS_REWARD(row) "(" row ".difficulty * 10 + " row ".difficulty * 10 * " row ".streak / 10)"
+
+// Adds sign completions of row, and their experience, to its day
+#define STATS_DAILY_ADD(row, sign) \
+    "INSERT OR IGNORE INTO stats_daily (day) VALUES (" STATS_DAY(row) ");" \
+    "UPDATE stats_daily SET completions = completions " sign " 1, " \
+    "experience = experience " sign " " STATS_REWARD(row) " WHERE day = " STATS_DAY(row) ";"
+
+// Adds sign tasks with row's type and difficulty, counting completed ones
+#define STATS_BREAKDOWN_ADD(row, sign) \
+    "INSERT OR IGNORE INTO stats_breakdown (type, difficulty) VALUES (" row ".type, " row ".difficulty);" \
+    "UPDATE stats_breakdown SET tasks = tasks " sign " 1, " \
+    "completed = completed " sign " (" row ".completed != 0) " \
+    "WHERE type = " row ".type AND difficulty = " row ".difficulty;"
+
+// Stamps a row with the tasks_revision its change produced
+#define STAMP_REVISION(row) \
+    "UPDATE tasks SET revision = (SELECT value FROM meta WHERE key = 'tasks_revision') " \
+    "WHERE id = " row ".id;"
+
+// Each row remembers the tasks_revision of its last change, and deleted
+// ids leave a tombstone, so another connection that has seen revision N
+// can fetch just what changed after it. Rows from before this version
+// keep revision 0, which any reader has already loaded.
+static int add_row_revisions(sqlite3* db) {
+    if (!column_exists(db, "tasks", "revision") &&
+        exec_sql(db, "ALTER TABLE tasks ADD COLUMN revision INTEGER NOT NULL DEFAULT 0;") != 0) {
+        return 1;
+    }
+    return exec_sql(db,
+        "CREATE TABLE IF NOT EXISTS tasks_deleted ("
+        "id INTEGER PRIMARY KEY,"
+        "revision INTEGER NOT NULL"
+        ");"
+        "CREATE INDEX IF NOT EXISTS tasks_deleted_revision ON tasks_deleted (revision);"
+        "CREATE INDEX IF NOT EXISTS tasks_by_revision ON tasks (revision);"
+        "DROP TRIGGER IF EXISTS tasks_revision_insert;"
+        "DROP TRIGGER IF EXISTS tasks_revision_update;"
+        "DROP TRIGGER IF EXISTS tasks_revision_delete;"
+        "CREATE TRIGGER tasks_revision_insert AFTER INSERT ON tasks BEGIN "
+        "UPDATE meta SET value = value + 1 WHERE key = 'tasks_revision';"
+        STAMP_REVISION("NEW") " END;"
+        // The stamp is itself an update; the WHEN keeps it from firing
+        // this trigger again where recursive triggers are enabled
+        "CREATE TRIGGER tasks_revision_update AFTER UPDATE ON tasks "
+        "WHEN NEW.revision = OLD.revision BEGIN "
+        "UPDATE meta SET value = value + 1 WHERE key = 'tasks_revision';"
+        STAMP_REVISION("NEW") " END;"
+        "CREATE TRIGGER tasks_revision_delete AFTER DELETE ON tasks BEGIN "
+        "UPDATE meta SET value = value + 1 WHERE key = 'tasks_revision';"
+        "INSERT OR REPLACE INTO tasks_deleted (id, revision) "
+        "SELECT OLD.id, value FROM meta WHERE key = 'tasks_revision'; END;");
+}
+
+// Adds sign times a subtree rooted at row, its own counts included, to the
+// counts of row's ancestors
+#define TREE_ANCESTORS_ADD(row, sign) \
+    "UPDATE tasks SET subtasks = subtasks " sign " (1 + " row ".subtasks), " \
+    "subtasks_completed = subtasks_completed " sign " ((" row ".completed != 0) + " row ".subtasks_completed) " \
+    "WHERE id IN (SELECT ancestor FROM task_tree WHERE descendant = " row ".id AND depth > 0);"
+
+// Subtasks. task_tree is a closure table: one row per ancestor and
+// descendant pair, the task itself included at depth 0, so a subtree or
+// the path to the root is a single index range. Triggers keep it and the
+// per-task subtask counts current on every insert, completion, move and
+// delete; deleting a task deletes its subtree.
+static int add_subtasks(sqlite3* db) {
+    const char* columns[] = {"parent_id", "subtasks", "subtasks_completed", "collapsed"};
+    for (size_t i = 0; i < sizeof(columns) / sizeof(columns[0]); i++) {
+        char sql[128];
+        snprintf(sql, sizeof(sql), "ALTER TABLE tasks ADD COLUMN %s INTEGER NOT NULL DEFAULT 0;", columns[i]);
+        if (!column_exists(db, "tasks", columns[i]) && exec_sql(db, sql) != 0) return 1;
+    }
+    return exec_sql(db,
+        "CREATE TABLE IF NOT EXISTS task_tree ("
+        "ancestor INTEGER NOT NULL,"
+        "descendant INTEGER NOT NULL,"
+        "depth INTEGER NOT NULL,"
+        "PRIMARY KEY (ancestor, descendant)"
+        ") WITHOUT ROWID;"
+        "CREATE INDEX IF NOT EXISTS task_tree_by_descendant ON task_tree (descendant, depth);"
+        "INSERT OR IGNORE INTO task_tree (ancestor, descendant, depth) SELECT id, id, 0 FROM tasks;"
+        "CREATE TRIGGER IF NOT EXISTS task_tree_check_insert BEFORE INSERT ON tasks "
+        "WHEN NEW.parent_id != 0 AND NOT EXISTS (SELECT 1 FROM tasks WHERE id = NEW.parent_id) BEGIN "
+        "SELECT RAISE(ABORT, 'parent task does not exist'); END;"
+        "CREATE TRIGGER IF NOT EXISTS task_tree_check_move BEFORE UPDATE OF parent_id ON tasks "
+        "WHEN NEW.parent_id != OLD.parent_id AND NEW.parent_id != 0 AND "
+        "(NOT EXISTS (SELECT 1 FROM tasks WHERE id = NEW.parent_id) OR "
+        "EXISTS (SELECT 1 FROM task_tree WHERE ancestor = NEW.id AND descendant = NEW.parent_id)) BEGIN "
+        "SELECT RAISE(ABORT, 'a task cannot move under itself or a missing parent'); END;"
+        "CREATE TRIGGER IF NOT EXISTS task_tree_insert AFTER INSERT ON tasks BEGIN "
+        "INSERT INTO task_tree (ancestor, descendant, depth) "
+        "SELECT ancestor, NEW.id, depth + 1 FROM task_tree WHERE descendant = NEW.parent_id;"
+        "INSERT INTO task_tree (ancestor, descendant, depth) VALUES (NEW.id, NEW.id, 0);"
+        TREE_ANCESTORS_ADD("NEW", "+") " END;"
+        "CREATE TRIGGER IF NOT EXISTS task_tree_complete AFTER UPDATE OF completed ON tasks "
+        "WHEN (OLD.completed != 0) != (NEW.completed != 0) AND NEW.parent_id = OLD.parent_id BEGIN "
+        "UPDATE tasks SET subtasks_completed = subtasks_completed + (NEW.completed != 0) - (OLD.completed != 0) "
+        "WHERE id IN (SELECT ancestor FROM task_tree WHERE descendant = NEW.id AND depth > 0); END;"
+        // The subtree leaves its old ancestors and joins the new ones
+        "CREATE TRIGGER IF NOT EXISTS task_tree_move AFTER UPDATE OF parent_id ON tasks "
+        "WHEN NEW.parent_id != OLD.parent_id BEGIN "
+        TREE_ANCESTORS_ADD("OLD", "-")
+        "DELETE FROM task_tree WHERE descendant IN (SELECT descendant FROM task_tree WHERE ancestor = NEW.id) "
+        "AND ancestor NOT IN (SELECT descendant FROM task_tree WHERE ancestor = NEW.id);"
+        "INSERT INTO task_tree (ancestor, descendant, depth) "
+        "SELECT a.ancestor, d.descendant, a.depth + d.depth + 1 FROM task_tree a, task_tree d "
+        "WHERE a.descendant = NEW.parent_id AND d.ancestor = NEW.id;"
+        TREE_ANCESTORS_ADD("NEW", "+") " END;"
+        // Not fired again for the subtasks it deletes, so it settles the
+        // counts and closure rows for the whole subtree at once
+        "CREATE TRIGGER IF NOT EXISTS task_tree_delete AFTER DELETE ON tasks BEGIN "
+        TREE_ANCESTORS_ADD("OLD", "-")
+        "DELETE FROM tasks WHERE id IN (SELECT descendant FROM task_tree WHERE ancestor = OLD.id AND depth > 0);"
+        "DELETE FROM task_tree WHERE descendant IN (SELECT descendant FROM task_tree WHERE ancestor = OLD.id); END;");
+}
+
+// Due dates, NULL for none. The index leaves those rows out, so it only
+// grows with the tasks that have a date, and reading tasks in due order
+// walks it without a sort.
+static int add_due_dates(sqlite3* db) {
+    if (!column_exists(db, "tasks", "due_at") &&
+        exec_sql(db, "ALTER TABLE tasks ADD COLUMN due_at INTEGER;") != 0) {
+        return 1;
+    }
+    return exec_sql(db, "CREATE INDEX IF NOT EXISTS tasks_by_due ON tasks (due_at) WHERE due_at IS NOT NULL;");
+}
+
+static const Migration migrations[] = {
+    {1, "baseline schema",
+        "CREATE TABLE IF NOT EXISTS player ("
+        "health INTEGER,"
+        "experience INTEGER,"
+        "level INTEGER,"
+        "gold INTEGER,"
+        "strength INTEGER,"
+        "intelligence INTEGER,"
+        "constitution INTEGER,"
+        "perception INTEGER"
+        ");"
+        "CREATE TABLE IF NOT EXISTS tasks ("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "title TEXT NOT NULL,"
+        "description TEXT,"
+        "difficulty INTEGER NOT NULL,"
+        "type INTEGER NOT NULL,"
+        "completed INTEGER DEFAULT 0,"
+        "created_at DATETIME DEFAULT CURRENT_TIMESTAMP"
+        ");"
+        // Persistent change counter for the tasks table. Unlike
+        // PRAGMA data_version it survives restarts and sees every writer.
+        "CREATE TABLE IF NOT EXISTS meta ("
+        "key TEXT PRIMARY KEY,"
+        "value INTEGER NOT NULL"
+        ");"
+        "INSERT OR IGNORE INTO meta (key, value) VALUES ('tasks_revision', 0);"
+        "CREATE TRIGGER IF NOT EXISTS tasks_revision_insert AFTER INSERT ON tasks BEGIN "
+        "UPDATE meta SET value = value + 1 WHERE key = 'tasks_revision'; END;"
+        "CREATE TRIGGER IF NOT EXISTS tasks_revision_update AFTER UPDATE ON tasks BEGIN "
+        "UPDATE meta SET value = value + 1 WHERE key = 'tasks_revision'; END;"
+        "CREATE TRIGGER IF NOT EXISTS tasks_revision_delete AFTER DELETE ON tasks BEGIN "
+        "UPDATE meta SET value = value + 1 WHERE key = 'tasks_revision'; END;",
+        NULL},
+    {2, "task streak columns", NULL, add_streak_columns},
+    {3, "manual task order", NULL, add_position_column},
+    // Statistics kept current by triggers, so the stats screen reads a few
+    // pre-summed rows instead of scanning the history. Completing a task,
+    // or completing a habit again, counts on the day of last_completed;
+    // clearing the flag takes the latest completion back. Deleting a task
+    // leaves its completions in the history.
+    {4, "statistics aggregates",
+        "CREATE TABLE IF NOT EXISTS stats_daily ("
+        "day TEXT PRIMARY KEY,"
+        "completions INTEGER NOT NULL DEFAULT 0,"
+        "experience INTEGER NOT NULL DEFAULT 0"
+        ");"
+        "CREATE TABLE IF NOT EXISTS stats_breakdown ("
+        "type INTEGER NOT NULL,"
+        "difficulty INTEGER NOT NULL,"
+        "tasks INTEGER NOT NULL DEFAULT 0,"
+        "completed INTEGER NOT NULL DEFAULT 0,"
+        "PRIMARY KEY (type, difficulty)"
+        ") WITHOUT ROWID;"
+        "CREATE TRIGGER IF NOT EXISTS stats_task_insert AFTER INSERT ON tasks BEGIN "
+        STATS_BREAKDOWN_ADD("NEW", "+") " END;"
+        "CREATE TRIGGER IF NOT EXISTS stats_task_insert_completed AFTER INSERT ON tasks "
+        "WHEN NEW.completed != 0 BEGIN " STATS_DAILY_ADD("NEW", "+") " END;"
+        "CREATE TRIGGER IF NOT EXISTS stats_task_delete AFTER DELETE ON tasks BEGIN "
+        STATS_BREAKDOWN_ADD("OLD", "-") " END;"
+        "CREATE TRIGGER IF NOT EXISTS stats_task_regroup AFTER UPDATE OF type, difficulty, completed ON tasks "
+        "WHEN OLD.type != NEW.type OR OLD.difficulty != NEW.difficulty "
+        "OR (OLD.completed != 0) != (NEW.completed != 0) BEGIN "
+        STATS_BREAKDOWN_ADD("OLD", "-") STATS_BREAKDOWN_ADD("NEW", "+") " END;"
+        // A last_completed set from 0 on a row that stays completed is
+        // the backfill filling in history, not a new completion
+        "CREATE TRIGGER IF NOT EXISTS stats_task_complete AFTER UPDATE OF completed, last_completed ON tasks "
+        "WHEN NEW.completed != 0 AND (OLD.completed = 0 OR "
+        "(OLD.last_completed != 0 AND NEW.last_completed != OLD.last_completed)) BEGIN "
+        STATS_DAILY_ADD("NEW", "+") " END;"
+        "CREATE TRIGGER IF NOT EXISTS stats_task_uncomplete AFTER UPDATE OF completed ON tasks "
+        "WHEN OLD.completed != 0 AND NEW.completed = 0 BEGIN "
+        STATS_DAILY_ADD("OLD", "-") " END;"
+        // Seed from the existing rows: the one full scan the aggregates
+        // ever need, inside the same transaction that adds the triggers
+        "DELETE FROM stats_breakdown;"
+        "INSERT INTO stats_breakdown (type, difficulty, tasks, completed) "
+        "SELECT type, difficulty, count(*), sum(completed != 0) FROM tasks GROUP BY type, difficulty;"
+        "DELETE FROM stats_daily;"
+        "INSERT INTO stats_daily (day, completions, experience) "
+        "SELECT " STATS_DAY("tasks") ", count(*), sum(" STATS_REWARD("tasks") ") "
+        "FROM tasks WHERE completed != 0 GROUP BY 1;",
+        NULL},
+    {5, "row revisions", NULL, add_row_revisions},
+    {6, "subtasks", NULL, add_subtasks},
+    // Tags, matched by name without regard to case. Tagging or untagging
+    // touches the task row, so its revision moves and the new tags reach
+    // every view like any other edit.
+    {7, "task tags",
+        "CREATE TABLE IF NOT EXISTS tags ("
+        "id INTEGER PRIMARY KEY,"
+        "name TEXT NOT NULL UNIQUE COLLATE NOCASE"
+        ");"
+        "CREATE TABLE IF NOT EXISTS task_tags ("
+        "task_id INTEGER NOT NULL,"
+        "tag_id INTEGER NOT NULL,"
+        "PRIMARY KEY (task_id, tag_id)"
+        ") WITHOUT ROWID;"
+        "CREATE INDEX IF NOT EXISTS task_tags_by_tag ON task_tags (tag_id, task_id);"
+        "CREATE TRIGGER IF NOT EXISTS task_tags_check_insert BEFORE INSERT ON task_tags "
+        "WHEN NOT EXISTS (SELECT 1 FROM tasks WHERE id = NEW.task_id) BEGIN "
+        "SELECT RAISE(ABORT, 'tagged task does not exist'); END;"
+        "CREATE TRIGGER IF NOT EXISTS task_tags_insert AFTER INSERT ON task_tags BEGIN "
+        "UPDATE tasks SET revision = revision WHERE id = NEW.task_id; END;"
+        "CREATE TRIGGER IF NOT EXISTS task_tags_delete AFTER DELETE ON task_tags BEGIN "
+        "UPDATE tasks SET revision = revision WHERE id = OLD.task_id; END;"
+        "CREATE TRIGGER IF NOT EXISTS task_tags_task_delete AFTER DELETE ON tasks BEGIN "
+        "DELETE FROM task_tags WHERE task_id = OLD.id; END;",
+        NULL},
+    {8, "due dates", NULL, add_due_dates},
+};
+
+static const Backfill backfills[] = {
+    {"last_completed",
+        "UPDATE tasks SET last_completed = CAST(strftime('%s', created_at) AS INTEGER) "
+        "WHERE id BETWEEN ?1 AND ?2 AND completed != 0 AND last_completed = 0 "
+        "AND created_at IS NOT NULL;",
+        NULL},
+    {"position",
+        "UPDATE tasks SET position = id WHERE id BETWEEN ?1 AND ?2 AND position = 0;",
+        "CREATE INDEX IF NOT EXISTS tasks_position ON tasks (position, id);"},
+};
+
+int db_schema_version(sqlite3* db, int* version) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "PRAGMA user_version;", -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return 1;
+    }
+
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        *version = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_ROW ? 0 : 1;
+}
+
+int db_migrate(sqlite3* db) {
+    int version;
+    if (db_schema_version(db, &version) != 0) return 1;
+    if (version == DB_SCHEMA_VERSION) return 0;
+    if (version > DB_SCHEMA_VERSION) {
+        fprintf(stderr, "Database schema %d is newer than this build (%d)\n",
+                version, DB_SCHEMA_VERSION);
+        return 0;
+    }
+
+    for (size_t i = 0; i < sizeof(migrations) / sizeof(migrations[0]); i++) {
+        const Migration* m = &migrations[i];
+        if (m->version <= version) continue;
+
+        char bump[64];
+        snprintf(bump, sizeof(bump), "PRAGMA user_version = %d;", m->version);
+        if (exec_sql(db, "BEGIN IMMEDIATE;") != 0) return 1;
+        if ((m->sql && exec_sql(db, m->sql) != 0) ||
+            (m->apply && m->apply(db) != 0) ||
+            exec_sql(db, bump) != 0 ||
+            exec_sql(db, "COMMIT;") != 0) {
+            fprintf(stderr, "Migration %d (%s) failed\n", m->version, m->name);
+            sqlite3_exec(db, "ROLLBACK;", 0, 0, NULL);
+            return 1;
+        }
+        printf("Migrated database to version %d (%s)\n", m->version, m->name);
+    }
+    return 0;
+}
+
+int db_backfill_pending(sqlite3* db) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM meta WHERE key LIKE 'backfill:%' LIMIT 1;",
+                           -1, &stmt, NULL) != SQLITE_OK) {
+        return 0;
+    }
+    int pending = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return pending;
+}
+
+static const Backfill* find_backfill(const char* key) {
+    const char* name = key + strlen("backfill:");
+    for (size_t i = 0; i < sizeof(backfills) / sizeof(backfills[0]); i++) {
+        if (strcmp(backfills[i].name, name) == 0) {
+            return &backfills[i];
+        }
+    }
+    return NULL;
+}
+
+// Runs one batch inside the caller's savepoint. Returns 1 if the backfill
+// has more batches, 0 if it finished, -1 on error.
+static int run_batch(sqlite3* db, const Backfill* backfill, const char* key,
+                     sqlite3_int64 after, int max_rows) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT max(id) FROM (SELECT id FROM tasks WHERE id > ?1 "
+                           "ORDER BY id LIMIT ?2);", -1, &stmt, NULL) != SQLITE_OK) {
+        return -1;
+    }
+    sqlite3_bind_int64(stmt, 1, after);
+    sqlite3_bind_int(stmt, 2, max_rows);
+    int has_rows = sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL;
+    sqlite3_int64 last = has_rows ? sqlite3_column_int64(stmt, 0) : after;
+    sqlite3_finalize(stmt);
+
+    if (!has_rows) {
+        if (backfill->finish_sql && exec_sql(db, backfill->finish_sql) != 0) return -1;
+
+        if (sqlite3_prepare_v2(db, "DELETE FROM meta WHERE key = ?1;", -1, &stmt, NULL) != SQLITE_OK) {
+            return -1;
+        }
+        sqlite3_bind_text(stmt, 1, key, -1, SQLITE_TRANSIENT);
+        int rc = sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+        return rc == SQLITE_DONE ? 0 : -1;
+    }
+
+    if (sqlite3_prepare_v2(db, backfill->update_sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    sqlite3_bind_int64(stmt, 1, after + 1);
+    sqlite3_bind_int64(stmt, 2, last);
+    int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) return -1;
+
+    if (sqlite3_prepare_v2(db, "UPDATE meta SET value = ?1 WHERE key = ?2;", -1, &stmt, NULL) != SQLITE_OK) {
+        return -1;
+    }
+    sqlite3_bind_int64(stmt, 1, last);
+    sqlite3_bind_text(stmt, 2, key, -1, SQLITE_TRANSIENT);
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_DONE ? 1 : -1;
+}
+
+int db_backfill_step(sqlite3* db, int max_rows) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT key, value FROM meta WHERE key LIKE 'backfill:%' "
+                           "ORDER BY key LIMIT 1;", -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+        sqlite3_finalize(stmt);
+        return 0;
+    }
+
+    char key[64];
+    snprintf(key, sizeof(key), "%s", (const char*)sqlite3_column_text(stmt, 0));
+    sqlite3_int64 after = sqlite3_column_int64(stmt, 1);
+    sqlite3_finalize(stmt);
+
+    const Backfill* backfill = find_backfill(key);
+    if (!backfill) {
+        fprintf(stderr, "Unknown backfill %s; was the database upgraded by a newer build?\n", key);
+        return -1;
+    }
+
+    // A savepoint nests inside a transaction the caller may already hold
+    if (exec_sql(db, "SAVEPOINT backfill;") != 0) return -1;
+    int rc = run_batch(db, backfill, key, after, max_rows);
+    if (rc < 0) {
+        fprintf(stderr, "Backfill %s failed: %s\n", backfill->name, sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK TO backfill;", 0, 0, NULL);
+    }
+    sqlite3_exec(db, "RELEASE backfill;", 0, 0, NULL);
+
+    if (rc < 0) return -1;
+    return rc == 1 || db_backfill_pending(db) ? 1 : 0;
+}
@@ -0,0 +1,131 @@
+#include "reminders.h"
+#include <stdlib.h>
+#include <string.h>
+
+void reminders_init(ReminderQueue* queue) {
+    memset(queue, 0, sizeof(ReminderQueue));
+}
+
+void reminders_free(ReminderQueue* queue) {
+    free(queue->heap);
+    memset(queue, 0, sizeof(ReminderQueue));
+}
+
+// Ties go by task id, so duplicate entries come off the heap back to back
+static int reminder_before(const Reminder* a, const Reminder* b) {
+    if (a->due_at != b->due_at) return a->due_at < b->due_at;
+    return a->task_id < b->task_id;
+}
+
+static void sift_up(Reminder* heap, int index) {
+    Reminder moving = heap[index];
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (!reminder_before(&moving, &heap[parent])) break;
+        heap[index] = heap[parent];
+        index = parent;
+    }
+    heap[index] = moving;
+}
+
+static void sift_down(Reminder* heap, int count, int index) {
+    Reminder moving = heap[index];
+    for (;;) {
+        int child = 2 * index + 1;
+        if (child >= count) break;
+        if (child + 1 < count && reminder_before(&heap[child + 1], &heap[child])) child++;
+        if (!reminder_before(&heap[child], &moving)) break;
+        heap[index] = heap[child];
+        index = child;
+    }
+    heap[index] = moving;
+}
+
+static int reserve(ReminderQueue* queue, int count) {
+    if (count <= queue->capacity) return 0;
+    int capacity = queue->capacity ? queue->capacity : 64;
+    while (capacity < count) capacity *= 2;
+    Reminder* grown = realloc(queue->heap, capacity * sizeof(Reminder));
+    if (!grown) return 1;
+    queue->heap = grown;
+    queue->capacity = capacity;
+    return 0;
+}
+
+static void push(ReminderQueue* queue, int task_id, time_t due_at) {
+    if (reserve(queue, queue->count + 1) != 0) {
+        queue->failed = 1;
+        return;
+    }
+    queue->heap[queue->count] = (Reminder){due_at, task_id};
+    sift_up(queue->heap, queue->count++);
+}
+
+static int pending(const Task* task, time_t now) {
+    return task->due_at != 0 && !task->completed && task->due_at > now;
+}
+
+int reminders_rebuild(ReminderQueue* queue, const Task* tasks, int count, time_t now) {
+    int upcoming = 0;
+    int overdue = 0;
+    for (int i = 0; i < count; i++) {
+        upcoming += pending(&tasks[i], now);
+        overdue += tasks[i].due_at != 0 && !tasks[i].completed && tasks[i].due_at <= now;
+    }
+
+    queue->count = 0;
+    queue->failed = reserve(queue, upcoming);
+    if (queue->failed) return overdue;
+
+    // Heapify bottom-up rather than pushing one at a time
+    for (int i = 0; i < count; i++) {
+        if (pending(&tasks[i], now)) {
+            queue->heap[queue->count++] = (Reminder){tasks[i].due_at, tasks[i].id};
+        }
+    }
+    for (int i = queue->count / 2 - 1; i >= 0; i--) {
+        sift_down(queue->heap, queue->count, i);
+    }
+    return overdue;
+}
+
+void reminders_apply(ReminderQueue* queue, const TaskList* list, const TaskDelta* deltas, int count,
+                     time_t now) {
+    for (int i = 0; i < count; i++) {
+        const Task* task = &deltas[i].task;
+        if (deltas[i].type == TASK_DELTA_DELETE || !pending(task, now)) continue;
+
+        // Still queued from before, unless the time moved or it was
+        // completed in between
+        int at = task_list_find(list, task->id);
+        if (at >= 0 && list->tasks[at].due_at == task->due_at && !list->tasks[at].completed) continue;
+        push(queue, task->id, task->due_at);
+    }
+}
+
+int reminders_pop_due(ReminderQueue* queue, const TaskList* list, time_t now, int* more) {
+    int task_id = 0;
+    Reminder last = {0, 0};
+    *more = 0;
+    while (queue->count > 0 && queue->heap[0].due_at <= now) {
+        Reminder top = queue->heap[0];
+        queue->heap[0] = queue->heap[--queue->count];
+        if (queue->count > 0) sift_down(queue->heap, queue->count, 0);
+
+        int at = task_list_find(list, top.task_id);
+        if (at < 0 || list->tasks[at].completed || list->tasks[at].due_at != top.due_at) continue;
+        if (top.task_id == last.task_id && top.due_at == last.due_at) continue;
+        if (task_id == 0) {
+            task_id = top.task_id;
+        }
+        else {
+            (*more)++;
+        }
+        last = top;
+    }
+    return task_id;
+}
+
+int reminders_stale(const ReminderQueue* queue, int task_count) {
+    return queue->failed || queue->count > 2 * task_count + REMINDERS_SLACK;
+}
@@ -0,0 +1,369 @@
+#include "replay.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Log records. Numbers are unsigned LEB128 varints, so a typical idle
+// frame costs three bytes.
+enum {
+    REC_FRAME = 1,       // clock delta (ms)
+    REC_DB,              // database responses applied this frame
+    REC_QUIT,
+    REC_MOUSE_DOWN,      // button, x, y, mod
+    REC_KEY_DOWN,        // sym, mod
+    REC_TEXT_INPUT,      // length, UTF-8 bytes
+    REC_END,
+    REC_MOUSE_UP,        // button, x, y, mod
+    REC_VIEW             // width, height, scale bits, pixel ratio bits
+};
+
+static void write_varint(FILE* file, Uint32 value) {
+    while (value >= 0x80) {
+        fputc((int)(value & 0x7F) | 0x80, file);
+        value >>= 7;
+    }
+    fputc((int)value, file);
+}
+
+static int read_varint(FILE* file, Uint32* value) {
+    Uint32 result = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        int c = fgetc(file);
+        if (c == EOF) return 1;
+        result |= (Uint32)(c & 0x7F) << shift;
+        if (!(c & 0x80)) {
+            *value = result;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Floats are logged by their bit pattern, so replays get them exactly
+static Uint32 float_bits(float value) {
+    Uint32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float bits_float(Uint32 bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Zigzag keeps small negative coordinates to one or two bytes
+static Uint32 zigzag(Sint32 value) {
+    return ((Uint32)value << 1) ^ (Uint32)(value >> 31);
+}
+
+static Sint32 unzigzag(Uint32 value) {
+    return (Sint32)(value >> 1) ^ -(Sint32)(value & 1);
+}
+
+int replay_record_open(Replay* replay, const char* path) {
+    memset(replay, 0, sizeof(Replay));
+
+    replay->file = fopen(path, "wb");
+    if (!replay->file) {
+        fprintf(stderr, "Failed to create recording %s\n", path);
+        return 1;
+    }
+    fwrite(REPLAY_MAGIC, 1, 4, replay->file);
+    fputc(REPLAY_VERSION, replay->file);
+    replay->mode = REPLAY_RECORD;
+    replay->clock_ms = SDL_GetTicks();
+    return 0;
+}
+
+int replay_play_open(Replay* replay, const char* path) {
+    memset(replay, 0, sizeof(Replay));
+
+    replay->file = fopen(path, "rb");
+    if (!replay->file) {
+        fprintf(stderr, "Failed to open recording %s\n", path);
+        return 1;
+    }
+
+    char magic[4];
+    if (fread(magic, 1, 4, replay->file) != 4 || memcmp(magic, REPLAY_MAGIC, 4) != 0 ||
+        fgetc(replay->file) != REPLAY_VERSION) {
+        fprintf(stderr, "%s is not a recording this build can replay\n", path);
+        fclose(replay->file);
+        replay->file = NULL;
+        return 1;
+    }
+    replay->mode = REPLAY_PLAY;
+    return 0;
+}
+
+void replay_close(Replay* replay) {
+    if (replay->file) {
+        if (replay->mode == REPLAY_RECORD) {
+            fputc(REC_END, replay->file);
+        }
+        if (ferror(replay->file)) {
+            fprintf(stderr, "Recording I/O error\n");
+        }
+        fclose(replay->file);
+        replay->file = NULL;
+    }
+    free(replay->frame_ms);
+    free(replay->db_ms);
+    replay->frame_ms = NULL;
+    replay->db_ms = NULL;
+    replay->mode = REPLAY_OFF;
+}
+
+void replay_db_path(const char* log_path, char* out, size_t out_size) {
+    snprintf(out, out_size, "%s.db", log_path);
+}
+
+static void record_event(FILE* file, const SDL_Event* event, Uint16 mod) {
+    switch (event->type) {
+        case SDL_QUIT:
+            fputc(REC_QUIT, file);
+            break;
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+            fputc(event->type == SDL_MOUSEBUTTONDOWN ? REC_MOUSE_DOWN : REC_MOUSE_UP, file);
+            fputc(event->button.button, file);
+            write_varint(file, zigzag(event->button.x));
+            write_varint(file, zigzag(event->button.y));
+            write_varint(file, mod);
+            break;
+        case SDL_KEYDOWN:
+            fputc(REC_KEY_DOWN, file);
+            write_varint(file, (Uint32)event->key.keysym.sym);
+            write_varint(file, event->key.keysym.mod);
+            break;
+        case SDL_TEXTINPUT: {
+            size_t length = strnlen(event->text.text, sizeof(event->text.text) - 1);
+            fputc(REC_TEXT_INPUT, file);
+            fputc((int)length, file);
+            fwrite(event->text.text, 1, length, file);
+            break;
+        }
+        default:
+            break;  // Not acted on by the game
+    }
+}
+
+static int read_event(FILE* file, int kind, SDL_Event* event, Uint16* mod) {
+    Uint32 a, b, c;
+    memset(event, 0, sizeof(SDL_Event));
+
+    switch (kind) {
+        case REC_QUIT:
+            event->type = SDL_QUIT;
+            return 0;
+        case REC_MOUSE_DOWN:
+        case REC_MOUSE_UP: {
+            int button = fgetc(file);
+            if (button == EOF || read_varint(file, &a) != 0 || read_varint(file, &b) != 0 ||
+                read_varint(file, &c) != 0) return 1;
+            event->type = kind == REC_MOUSE_DOWN ? SDL_MOUSEBUTTONDOWN : SDL_MOUSEBUTTONUP;
+            event->button.button = (Uint8)button;
+            event->button.state = kind == REC_MOUSE_DOWN ? SDL_PRESSED : SDL_RELEASED;
+            event->button.x = unzigzag(a);
+            event->button.y = unzigzag(b);
+            *mod = (Uint16)c;
+            return 0;
+        }
+        case REC_KEY_DOWN:
+            if (read_varint(file, &a) != 0 || read_varint(file, &b) != 0) return 1;
+            event->type = SDL_KEYDOWN;
+            event->key.state = SDL_PRESSED;
+            event->key.keysym.sym = (SDL_Keycode)a;
+            event->key.keysym.mod = (Uint16)b;
+            return 0;
+        case REC_TEXT_INPUT: {
+            int length = fgetc(file);
+            if (length == EOF || length >= (int)sizeof(event->text.text) ||
+                fread(event->text.text, 1, (size_t)length, file) != (size_t)length) return 1;
+            event->type = SDL_TEXTINPUT;
+            event->text.text[length] = '\0';
+            return 0;
+        }
+        default:
+            return 1;
+    }
+}
+
+// A view becomes a size change event, which makes the game lay out again
+static int read_view(Replay* replay, SDL_Event* event) {
+    Uint32 width, height, scale, pixel_ratio;
+    if (read_varint(replay->file, &width) != 0 || read_varint(replay->file, &height) != 0 ||
+        read_varint(replay->file, &scale) != 0 || read_varint(replay->file, &pixel_ratio) != 0) return 1;
+    replay->has_view = 1;
+    replay->view_width = (int)width;
+    replay->view_height = (int)height;
+    replay->view_scale = bits_float(scale);
+    replay->view_pixel_ratio = bits_float(pixel_ratio);
+
+    memset(event, 0, sizeof(SDL_Event));
+    event->type = SDL_WINDOWEVENT;
+    event->window.event = SDL_WINDOWEVENT_SIZE_CHANGED;
+    event->window.data1 = (Sint32)width;
+    event->window.data2 = (Sint32)height;
+    return 0;
+}
+
+// Returns the next event of the current frame, or 0 at the frame's end
+static int next_logged_event(Replay* replay, SDL_Event* event) {
+    if (!replay->in_frame) return 0;
+
+    int c = fgetc(replay->file);
+    if (c == EOF || c == REC_FRAME || c == REC_END) {
+        if (c != EOF) ungetc(c, replay->file);
+        replay->in_frame = 0;
+        return 0;
+    }
+    int failed = c == REC_VIEW ? read_view(replay, event) :
+                                 read_event(replay->file, c, event, &replay->mouse_mod);
+    if (failed) {
+        fprintf(stderr, "Recording is truncated or corrupt\n");
+        replay->in_frame = 0;
+        return 0;
+    }
+    return 1;
+}
+
+int replay_begin_frame(Replay* replay, Uint32* now_ms, int* db_responses) {
+    if (replay->mode == REPLAY_RECORD) {
+        fputc(REC_FRAME, replay->file);
+        write_varint(replay->file, *now_ms - replay->clock_ms);
+        replay->clock_ms = *now_ms;
+        if (*db_responses > 0) {
+            fputc(REC_DB, replay->file);
+            write_varint(replay->file, (Uint32)*db_responses);
+        }
+        return 1;
+    }
+    if (replay->mode != REPLAY_PLAY) return 1;
+
+    // Skip whatever the previous frame left unread
+    SDL_Event skipped;
+    while (next_logged_event(replay, &skipped)) {
+    }
+
+    int c = fgetc(replay->file);
+    Uint32 delta;
+    if (c != REC_FRAME || read_varint(replay->file, &delta) != 0) {
+        return 0;
+    }
+    replay->clock_ms += delta;
+    *now_ms = replay->clock_ms;
+
+    *db_responses = 0;
+    c = fgetc(replay->file);
+    if (c == REC_DB) {
+        Uint32 count;
+        if (read_varint(replay->file, &count) != 0) return 0;
+        *db_responses = (int)count;
+    }
+    else if (c != EOF) {
+        ungetc(c, replay->file);
+    }
+    replay->in_frame = 1;
+    return 1;
+}
+
+int replay_poll_event(Replay* replay, SDL_Event* event) {
+    if (replay->mode != REPLAY_PLAY) {
+        if (!SDL_PollEvent(event)) return 0;
+        if (event->type == SDL_MOUSEBUTTONDOWN || event->type == SDL_MOUSEBUTTONUP) {
+            replay->mouse_mod = (Uint16)SDL_GetModState();
+        }
+        if (replay->mode == REPLAY_RECORD) {
+            record_event(replay->file, event, replay->mouse_mod);
+        }
+        return 1;
+    }
+
+    // Live input is ignored during replay, except for closing the window
+    SDL_Event live;
+    while (SDL_PollEvent(&live)) {
+        if (live.type == SDL_QUIT) replay->quit = 1;
+    }
+    if (replay->quit) {
+        memset(event, 0, sizeof(SDL_Event));
+        event->type = SDL_QUIT;
+        return 1;
+    }
+
+    return next_logged_event(replay, event);
+}
+
+SDL_Keymod replay_mouse_mod(const Replay* replay) {
+    return (SDL_Keymod)replay->mouse_mod;
+}
+
+void replay_note_view(Replay* replay, int width, int height, float scale, float pixel_ratio) {
+    if (replay->mode != REPLAY_RECORD) return;
+    if (replay->has_view && replay->view_width == width && replay->view_height == height &&
+        replay->view_scale == scale && replay->view_pixel_ratio == pixel_ratio) return;
+
+    replay->has_view = 1;
+    replay->view_width = width;
+    replay->view_height = height;
+    replay->view_scale = scale;
+    replay->view_pixel_ratio = pixel_ratio;
+    fputc(REC_VIEW, replay->file);
+    write_varint(replay->file, (Uint32)width);
+    write_varint(replay->file, (Uint32)height);
+    write_varint(replay->file, float_bits(scale));
+    write_varint(replay->file, float_bits(pixel_ratio));
+}
+
+int replay_view(const Replay* replay, int* width, int* height, float* scale, float* pixel_ratio) {
+    if (replay->mode != REPLAY_PLAY || !replay->has_view) return 0;
+    *width = replay->view_width;
+    *height = replay->view_height;
+    *scale = replay->view_scale;
+    *pixel_ratio = replay->view_pixel_ratio;
+    return 1;
+}
+
+static void append_sample(float** samples, int* count, int* capacity, double value) {
+    if (*count == *capacity) {
+        int new_capacity = *capacity ? *capacity * 2 : 1024;
+        float* grown = realloc(*samples, new_capacity * sizeof(float));
+        if (!grown) return;
+        *samples = grown;
+        *capacity = new_capacity;
+    }
+    (*samples)[(*count)++] = (float)value;
+}
+
+void replay_note_frame(Replay* replay, double ms) {
+    if (replay->mode != REPLAY_PLAY) return;
+    append_sample(&replay->frame_ms, &replay->frame_count, &replay->frame_capacity, ms);
+}
+
+void replay_note_db(Replay* replay, double ms) {
+    if (replay->mode != REPLAY_PLAY) return;
+    append_sample(&replay->db_ms, &replay->db_count, &replay->db_capacity, ms);
+}
+
+static int compare_float(const void* a, const void* b) {
+    float x = *(const float*)a;
+    float y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+static void report_samples(const char* label, float* samples, int count) {
+    if (count == 0) {
+        printf("%s: none\n", label);
+        return;
+    }
+    qsort(samples, count, sizeof(float), compare_float);
+    printf("%s: %d, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n", label, count,
+           samples[count / 2], samples[(int)((count - 1) * 0.99)], samples[count - 1]);
+}
+
+void replay_report(Replay* replay) {
+    if (replay->mode != REPLAY_PLAY) return;
+
+    report_samples("Replay frames", replay->frame_ms, replay->frame_count);
+    report_samples("Replay database requests", replay->db_ms, replay->db_count);
+}
@@ -0,0 +1,219 @@
+#include "scene.h"
+#include <stdlib.h>
+#include <string.h>
+#include "metrics.h"
+
+void display_list_clear(DisplayList* list) {
+    // Storage is kept; a rebuilt list usually needs about as much
+    list->count = 0;
+    list->strings_used = 0;
+    list->points_used = 0;
+}
+
+void display_list_free(DisplayList* list) {
+    free(list->commands);
+    free(list->strings);
+    free(list->points);
+    memset(list, 0, sizeof(DisplayList));
+}
+
+static DrawCommand* push(DisplayList* list, DrawOp op) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 32;
+        DrawCommand* grown = realloc(list->commands, capacity * sizeof(DrawCommand));
+        if (!grown) return NULL;
+        list->commands = grown;
+        list->capacity = capacity;
+    }
+    DrawCommand* command = &list->commands[list->count++];
+    memset(command, 0, sizeof(DrawCommand));
+    command->op = op;
+    return command;
+}
+
+// Copies text into the list's string pool; returns its offset or -1
+static long store_text(DisplayList* list, const char* text) {
+    size_t length = strlen(text) + 1;
+    if (list->strings_used + length > list->strings_capacity) {
+        size_t capacity = list->strings_capacity ? list->strings_capacity : 256;
+        while (capacity < list->strings_used + length) capacity *= 2;
+        char* grown = realloc(list->strings, capacity);
+        if (!grown) return -1;
+        list->strings = grown;
+        list->strings_capacity = capacity;
+    }
+    size_t offset = list->strings_used;
+    memcpy(list->strings + offset, text, length);
+    list->strings_used += length;
+    return (long)offset;
+}
+
+void display_list_color(DisplayList* list, Uint8 r, Uint8 g, Uint8 b) {
+    DrawCommand* command = push(list, DRAW_COLOR);
+    if (command) command->data = (r << 16) | (g << 8) | b;
+}
+
+void display_list_fill_rect(DisplayList* list, const SDL_Rect* rect) {
+    DrawCommand* command = push(list, DRAW_FILL_RECT);
+    if (command) command->rect = *rect;
+}
+
+void display_list_rect(DisplayList* list, const SDL_Rect* rect) {
+    DrawCommand* command = push(list, DRAW_RECT);
+    if (command) command->rect = *rect;
+}
+
+void display_list_line(DisplayList* list, int x1, int y1, int x2, int y2) {
+    DrawCommand* command = push(list, DRAW_LINE);
+    if (command) command->rect = (SDL_Rect){x1, y1, x2, y2};
+}
+
+void display_list_lines(DisplayList* list, const SDL_Point* points, int count) {
+    if (list->points_used + count > list->points_capacity) {
+        size_t capacity = list->points_capacity ? list->points_capacity : 32;
+        while (capacity < list->points_used + count) capacity *= 2;
+        SDL_Point* grown = realloc(list->points, capacity * sizeof(SDL_Point));
+        if (!grown) return;
+        list->points = grown;
+        list->points_capacity = capacity;
+    }
+    DrawCommand* command = push(list, DRAW_LINES);
+    if (!command) return;
+    command->data = count;
+    command->offset = list->points_used;
+    memcpy(list->points + list->points_used, points, count * sizeof(SDL_Point));
+    list->points_used += count;
+}
+
+void display_list_text(DisplayList* list, const char* text, int x, int y) {
+    if (!text || !*text) return;
+    long offset = store_text(list, text);
+    DrawCommand* command = offset >= 0 ? push(list, DRAW_TEXT) : NULL;
+    if (!command) return;
+    command->rect.x = x;
+    command->rect.y = y;
+    command->offset = (size_t)offset;
+}
+
+void display_list_label(DisplayList* list, const char* text, const SDL_Rect* rect) {
+    if (!text || !*text) return;
+    long offset = store_text(list, text);
+    DrawCommand* command = offset >= 0 ? push(list, DRAW_LABEL) : NULL;
+    if (!command) return;
+    command->rect = *rect;
+    command->offset = (size_t)offset;
+}
+
+void display_list_sprite(DisplayList* list, SpriteType sprite, const SDL_Rect* rect) {
+    DrawCommand* command = push(list, DRAW_SPRITE);
+    if (!command) return;
+    command->rect = *rect;
+    command->data = sprite;
+}
+
+void display_list_draw(const DisplayList* list, UI* ui, SpriteManager* sprites) {
+    for (int i = 0; i < list->count; i++) {
+        const DrawCommand* command = &list->commands[i];
+        const SDL_Rect* rect = &command->rect;
+        switch (command->op) {
+            case DRAW_COLOR:
+                SDL_SetRenderDrawColor(ui->renderer, (command->data >> 16) & 0xFF,
+                                       (command->data >> 8) & 0xFF, command->data & 0xFF, 255);
+                break;
+            case DRAW_FILL_RECT:
+                SDL_RenderFillRect(ui->renderer, rect);
+                break;
+            case DRAW_RECT:
+                SDL_RenderDrawRect(ui->renderer, rect);
+                break;
+            case DRAW_LINE:
+                SDL_RenderDrawLine(ui->renderer, rect->x, rect->y, rect->w, rect->h);
+                break;
+            case DRAW_LINES:
+                SDL_RenderDrawLines(ui->renderer, list->points + command->offset, command->data);
+                break;
+            case DRAW_TEXT:
+                ui_draw_text(ui, list->strings + command->offset, rect->x, rect->y);
+                break;
+            case DRAW_LABEL:
+                ui_draw_label(ui, list->strings + command->offset, rect);
+                break;
+            case DRAW_SPRITE:
+                sprite_manager_draw_sprite_scaled(sprites, (SpriteType)command->data,
+                                                  rect->x, rect->y, rect->w, rect->h);
+                break;
+        }
+    }
+}
+
+void scene_graph_init(SceneGraph* graph) {
+    memset(graph, 0, sizeof(SceneGraph));
+}
+
+void scene_graph_free(SceneGraph* graph) {
+    for (int i = 0; i < SCENE_MAX_NODES; i++) {
+        display_list_free(&graph->nodes[i].list);
+        ui_layer_destroy(&graph->nodes[i].layer);
+    }
+    memset(graph, 0, sizeof(SceneGraph));
+}
+
+void scene_graph_add_node(SceneGraph* graph, int node, SceneBuildFn build, int layered) {
+    SceneNode* scene_node = &graph->nodes[node];
+    scene_node->build = build;
+    scene_node->layered = layered;
+    scene_node->dirty = 1;
+}
+
+void scene_graph_show(SceneGraph* graph, GameState state, int node) {
+    if (graph->order_count[state] < SCENE_MAX_NODES) {
+        graph->order[state][graph->order_count[state]++] = node;
+    }
+}
+
+void scene_invalidate(SceneGraph* graph, int node) {
+    graph->nodes[node].dirty = 1;
+}
+
+void scene_invalidate_all(SceneGraph* graph) {
+    for (int i = 0; i < SCENE_MAX_NODES; i++) {
+        graph->nodes[i].dirty = 1;
+    }
+}
+
+void scene_track(SceneGraph* graph, int node, Uint64 key) {
+    if (graph->nodes[node].key != key) {
+        graph->nodes[node].key = key;
+        graph->nodes[node].dirty = 1;
+    }
+}
+
+int scene_render(SceneGraph* graph, GameState state, UI* ui, SpriteManager* sprites,
+                 int width, int height, void* context) {
+    int rebuilt = 0;
+    for (int i = 0; i < graph->order_count[state]; i++) {
+        SceneNode* node = &graph->nodes[graph->order[state][i]];
+        if (node->dirty && node->build) {
+            display_list_clear(&node->list);
+            node->build(&node->list, context);
+            ui_layer_invalidate(&node->layer);
+            node->dirty = 0;
+            rebuilt++;
+        }
+
+        if (!node->layered) {
+            display_list_draw(&node->list, ui, sprites);
+        }
+        else {
+            if (ui_layer_begin(ui, &node->layer, width, height)) {
+                display_list_draw(&node->list, ui, sprites);
+                ui_layer_end(ui, &node->layer);
+            }
+            ui_layer_draw(ui, &node->layer, 0, 0);
+        }
+    }
+    if (rebuilt > 0) {
+        metrics_add(METRIC_SCENE_REBUILDS, rebuilt);
+    }
+    return rebuilt;
+}
@@ -0,0 +1,617 @@
+#include "service.h"
+#include <stdio.h>
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "database.h"
+#include "json.h"
+#include "tasks.h"
+
+#define SERVICE_MAX_EVENTS 64
+#define SERVICE_MAX_LINE (64 * 1024)
+#define SERVICE_MAX_BATCH 256
+#define SERVICE_MAX_ID 64
+#define SERVICE_READ_CHUNK 16384
+
+#define RPC_PARSE_ERROR -32700
+#define RPC_INVALID_REQUEST -32600
+#define RPC_METHOD_NOT_FOUND -32601
+#define RPC_INVALID_PARAMS -32602
+#define RPC_SERVER_ERROR -32000
+
+typedef struct Connection {
+    int fd;
+    JsonBuffer in;
+    JsonBuffer out;
+    size_t batch_mark;          // Length of out when the current batch began
+    int closing;
+    int want_write;
+    struct Connection* next_touched;
+    int touched;
+} Connection;
+
+// One per request in the batch, whatever its outcome, so a failed commit
+// can rewrite the responses of writes and keep every other one in place
+typedef struct {
+    Connection* conn;
+    char id[SERVICE_MAX_ID];
+    size_t start;               // Its response in conn->out
+    size_t end;
+    int write;
+    int notification;           // No id, so no response
+} BatchEntry;
+
+typedef struct {
+    sqlite3* db;
+    int epoll_fd;
+    int listen_fd;
+    Connection* touched;
+    int in_transaction;
+    BatchEntry batch[SERVICE_MAX_BATCH];
+    int batch_count;
+} Service;
+
+static volatile sig_atomic_t service_stop = 0;
+
+static void handle_stop_signal(int sig) {
+    (void)sig;
+    service_stop = 1;
+}
+
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) return 1;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0;
+}
+
+static void touch_connection(Service* svc, Connection* conn) {
+    if (conn->touched) return;
+
+    conn->touched = 1;
+    conn->batch_mark = conn->out.len;
+    conn->next_touched = svc->touched;
+    svc->touched = conn;
+}
+
+static void append_error(Connection* conn, const char* id, int code, const char* message) {
+    json_buffer_printf(&conn->out, "{\"jsonrpc\":\"2.0\",\"id\":%s,\"error\":{\"code\":%d,\"message\":",
+                       id, code);
+    json_buffer_append_string(&conn->out, message);
+    json_buffer_append(&conn->out, "}}\n", 3);
+}
+
+static void append_result_prefix(Connection* conn, const char* id) {
+    json_buffer_printf(&conn->out, "{\"jsonrpc\":\"2.0\",\"id\":%s,\"result\":", id);
+}
+
+static int begin_write(Service* svc) {
+    if (svc->in_transaction) return 0;
+
+    char* err_msg = NULL;
+    if (sqlite3_exec(svc->db, "BEGIN;", 0, 0, &err_msg) != SQLITE_OK) {
+        fprintf(stderr, "SQL error: %s\n", err_msg);
+        sqlite3_free(err_msg);
+        return 1;
+    }
+    svc->in_transaction = 1;
+    return 0;
+}
+
+// Rebuilds each connection's output since the batch began, with the
+// responses to writes replaced by errors and everything else kept
+static void fail_batch(Service* svc) {
+    for (Connection* conn = svc->touched; conn; conn = conn->next_touched) {
+        size_t mark = conn->batch_mark;
+        size_t held_len = conn->out.len - mark;
+        char* held = malloc(held_len > 0 ? held_len : 1);
+        if (!held) {
+            conn->out.len = mark;
+            conn->closing = 1;
+            continue;
+        }
+        memcpy(held, conn->out.data + mark, held_len);
+        conn->out.len = mark;
+
+        size_t copied = 0;
+        for (int i = 0; i < svc->batch_count; i++) {
+            const BatchEntry* entry = &svc->batch[i];
+            if (entry->conn != conn) continue;
+            json_buffer_append(&conn->out, held + copied, entry->start - mark - copied);
+            if (entry->write && !entry->notification) {
+                append_error(conn, entry->id, RPC_SERVER_ERROR, "Commit failed");
+            } else {
+                json_buffer_append(&conn->out, held + entry->start - mark, entry->end - entry->start);
+            }
+            copied = entry->end - mark;
+        }
+        json_buffer_append(&conn->out, held + copied, held_len - copied);
+        free(held);
+    }
+}
+
+// Commits every write made since the batch began. Responses are held in the
+// connections' output buffers until this succeeds; on failure those of
+// writes are replaced with errors so no client is told a rolled-back write
+// succeeded.
+static void commit_batch(Service* svc) {
+    if (svc->in_transaction) {
+        char* err_msg = NULL;
+        if (sqlite3_exec(svc->db, "COMMIT;", 0, 0, &err_msg) != SQLITE_OK) {
+            fprintf(stderr, "SQL error: %s\n", err_msg);
+            sqlite3_free(err_msg);
+            sqlite3_exec(svc->db, "ROLLBACK;", 0, 0, NULL);
+            fail_batch(svc);
+        }
+        svc->in_transaction = 0;
+    }
+    svc->batch_count = 0;
+}
+
+// Commits mid-batch, when it is full or a read must not see its writes
+static void flush_batch(Service* svc) {
+    commit_batch(svc);
+    for (Connection* c = svc->touched; c; c = c->next_touched) {
+        c->batch_mark = c->out.len;
+    }
+}
+
+static void rpc_create(Service* svc, Connection* conn, const char* id, const JsonField* params, int count) {
+    Task task;
+    task_init(&task, "", NULL, 2, 0);
+    if (!json_find(params, count, "title") || task_apply_json(&task, params, count) != 0) {
+        append_error(conn, id, RPC_INVALID_PARAMS, "Invalid task fields");
+        return;
+    }
+
+    if (begin_write(svc) != 0 || db_create_task(svc->db, &task) != 0) {
+        append_error(conn, id, RPC_SERVER_ERROR, "Failed to create task");
+        return;
+    }
+
+    append_result_prefix(conn, id);
+    json_buffer_printf(&conn->out, "{\"id\":%lld}}\n", (long long)sqlite3_last_insert_rowid(svc->db));
+}
+
+static void rpc_update(Service* svc, Connection* conn, const char* id, const JsonField* params, int count) {
+    int task_id;
+    Task task;
+    if (json_field_int(json_find(params, count, "id"), &task_id) != 0) {
+        append_error(conn, id, RPC_INVALID_PARAMS, "Missing task id");
+        return;
+    }
+    if (db_get_task_by_id(svc->db, task_id, &task) != 0) {
+        append_error(conn, id, RPC_SERVER_ERROR, "Task not found");
+        return;
+    }
+    int parent_id = task.parent_id;
+    if (task_apply_json(&task, params, count) != 0) {
+        append_error(conn, id, RPC_INVALID_PARAMS, "Invalid task fields");
+        return;
+    }
+
+    // A new parent_id moves the task, with its subtasks, to the end of
+    // the new parent's. The update and the move share a savepoint, so a
+    // rejected move leaves the other fields unchanged as well.
+    if (begin_write(svc) != 0 || sqlite3_exec(svc->db, "SAVEPOINT rpc_update;", 0, 0, NULL) != SQLITE_OK) {
+        append_error(conn, id, RPC_SERVER_ERROR, "Failed to update task");
+        return;
+    }
+    if (db_update_task(svc->db, &task) != 0 ||
+        (task.parent_id != parent_id && db_move_task(svc->db, task.id, task.parent_id, 0) != 0)) {
+        sqlite3_exec(svc->db, "ROLLBACK TO rpc_update; RELEASE rpc_update;", 0, 0, NULL);
+        append_error(conn, id, RPC_SERVER_ERROR, "Failed to update task");
+        return;
+    }
+    sqlite3_exec(svc->db, "RELEASE rpc_update;", 0, 0, NULL);
+
+    append_result_prefix(conn, id);
+    task_append_json(&conn->out, &task);
+    json_buffer_append(&conn->out, "}\n", 2);
+}
+
+static void rpc_complete(Service* svc, Connection* conn, const char* id, const JsonField* params, int count) {
+    int task_id;
+    Task task;
+    if (json_field_int(json_find(params, count, "id"), &task_id) != 0) {
+        append_error(conn, id, RPC_INVALID_PARAMS, "Missing task id");
+        return;
+    }
+    if (db_get_task_by_id(svc->db, task_id, &task) != 0) {
+        append_error(conn, id, RPC_SERVER_ERROR, "Task not found");
+        return;
+    }
+
+    task_complete(&task);
+    if (begin_write(svc) != 0 || db_update_task(svc->db, &task) != 0) {
+        append_error(conn, id, RPC_SERVER_ERROR, "Failed to complete task");
+        return;
+    }
+
+    append_result_prefix(conn, id);
+    task_append_json(&conn->out, &task);
+    json_buffer_append(&conn->out, "}\n", 2);
+}
+
+static void rpc_delete(Service* svc, Connection* conn, const char* id, const JsonField* params, int count) {
+    int task_id;
+    if (json_field_int(json_find(params, count, "id"), &task_id) != 0) {
+        append_error(conn, id, RPC_INVALID_PARAMS, "Missing task id");
+        return;
+    }
+
+    if (begin_write(svc) != 0 || db_delete_task(svc->db, task_id) != 0) {
+        append_error(conn, id, RPC_SERVER_ERROR, "Failed to delete task");
+        return;
+    }
+
+    append_result_prefix(conn, id);
+    json_buffer_printf(&conn->out, "%s}\n", sqlite3_changes(svc->db) > 0 ? "true" : "false");
+}
+
+static void rpc_list(Service* svc, Connection* conn, const char* id, const JsonField* params, int count) {
+    TaskFilter filter = TASK_FILTER_ALL;
+    const JsonField* f = json_find(params, count, "filter");
+    if (f) {
+        char name[16];
+        if (json_field_string(f, name, sizeof(name)) != 0) {
+            append_error(conn, id, RPC_INVALID_PARAMS, "Invalid filter");
+            return;
+        }
+        if (strcmp(name, "completed") == 0) {
+            filter = TASK_FILTER_COMPLETED;
+        } else if (strcmp(name, "uncompleted") == 0) {
+            filter = TASK_FILTER_UNCOMPLETED;
+        } else if (strcmp(name, "all") != 0) {
+            append_error(conn, id, RPC_INVALID_PARAMS, "Invalid filter");
+            return;
+        }
+    }
+
+    // Runs outside the batch's write transaction (see handle_request), in
+    // a read transaction of its own
+    Task* tasks = NULL;
+    int task_count = 0;
+    int in_transaction = sqlite3_exec(svc->db, "BEGIN;", 0, 0, NULL) == SQLITE_OK;
+    int rc = db_get_all_tasks(svc->db, &tasks, &task_count);
+    if (in_transaction) {
+        sqlite3_exec(svc->db, "COMMIT;", 0, 0, NULL);
+    }
+    if (rc != 0) {
+        append_error(conn, id, RPC_SERVER_ERROR, "Failed to load tasks");
+        return;
+    }
+
+    append_result_prefix(conn, id);
+    json_buffer_append(&conn->out, "[", 1);
+    int first = 1;
+    for (int i = 0; i < task_count; i++) {
+        if ((filter == TASK_FILTER_COMPLETED && !tasks[i].completed) ||
+            (filter == TASK_FILTER_UNCOMPLETED && tasks[i].completed)) {
+            continue;
+        }
+        if (!first) json_buffer_append(&conn->out, ",", 1);
+        task_append_json(&conn->out, &tasks[i]);
+        first = 0;
+    }
+    json_buffer_append(&conn->out, "]}\n", 3);
+    free(tasks);
+}
+
+// Fills in entry, which process_input adds to the batch afterwards
+static void handle_request(Service* svc, Connection* conn, BatchEntry* entry, const char* line, int len) {
+    JsonField fields[8];
+    int count = json_parse_object(line, len, fields, 8);
+    if (count < 0) {
+        append_error(conn, "null", RPC_PARSE_ERROR, "Parse error");
+        return;
+    }
+
+    // Echo the id back verbatim, re-quoting strings
+    char* id = entry->id;
+    const JsonField* id_field = json_find(fields, count, "id");
+    if (id_field && id_field->value_len < SERVICE_MAX_ID - 2) {
+        if (id_field->type == JSON_STRING) {
+            snprintf(id, SERVICE_MAX_ID, "\"%.*s\"", id_field->value_len, id_field->value);
+        } else if (id_field->type == JSON_NUMBER) {
+            snprintf(id, SERVICE_MAX_ID, "%.*s", id_field->value_len, id_field->value);
+        }
+    }
+
+    char method[16];
+    const JsonField* method_field = json_find(fields, count, "method");
+    if (!method_field || json_field_string(method_field, method, sizeof(method)) != 0) {
+        append_error(conn, id, RPC_INVALID_REQUEST, "Invalid request");
+        return;
+    }
+    // A request without an id is a notification and gets no response,
+    // not even an error
+    entry->notification = !id_field;
+
+    JsonField params[16];
+    int param_count = 0;
+    const JsonField* params_field = json_find(fields, count, "params");
+    if (params_field) {
+        if (params_field->type != JSON_OBJECT) {
+            append_error(conn, id, RPC_INVALID_PARAMS, "Params must be an object");
+            return;
+        }
+        param_count = json_parse_object(params_field->value, params_field->value_len, params, 16);
+        if (param_count < 0) {
+            append_error(conn, id, RPC_PARSE_ERROR, "Parse error");
+            return;
+        }
+    }
+
+    if (strcmp(method, "create") == 0) {
+        entry->write = 1;
+        rpc_create(svc, conn, id, params, param_count);
+    } else if (strcmp(method, "update") == 0) {
+        entry->write = 1;
+        rpc_update(svc, conn, id, params, param_count);
+    } else if (strcmp(method, "delete") == 0) {
+        entry->write = 1;
+        rpc_delete(svc, conn, id, params, param_count);
+    } else if (strcmp(method, "list") == 0) {
+        // A list answers from committed rows, so writes pipelined ahead
+        // of it are committed first and a later failed commit cannot
+        // make its answer wrong
+        if (svc->in_transaction) {
+            flush_batch(svc);
+            entry->start = conn->out.len;
+        }
+        rpc_list(svc, conn, id, params, param_count);
+    } else if (strcmp(method, "complete") == 0) {
+        entry->write = 1;
+        rpc_complete(svc, conn, id, params, param_count);
+    } else {
+        append_error(conn, id, RPC_METHOD_NOT_FOUND, "Method not found");
+    }
+}
+
+// Handles every complete line in the input buffer. A client may pipeline
+// any number of requests; responses are appended in request order.
+static void process_input(Service* svc, Connection* conn) {
+    size_t start = 0;
+    for (;;) {
+        char* newline = memchr(conn->in.data + start, '\n', conn->in.len - start);
+        if (!newline) break;
+
+        int len = (int)(newline - (conn->in.data + start));
+        if (len > 0) {
+            touch_connection(svc, conn);
+            BatchEntry entry = {conn, "null", conn->out.len, 0, 0, 0};
+            handle_request(svc, conn, &entry, conn->in.data + start, len);
+            if (entry.notification) {
+                conn->out.len = entry.start;
+            }
+            entry.end = conn->out.len;
+            svc->batch[svc->batch_count++] = entry;
+            if (svc->batch_count >= SERVICE_MAX_BATCH) {
+                flush_batch(svc);
+            }
+        }
+        start += (size_t)len + 1;
+    }
+    json_buffer_consume(&conn->in, start);
+
+    if (conn->in.len > SERVICE_MAX_LINE) {
+        touch_connection(svc, conn);
+        append_error(conn, "null", RPC_INVALID_REQUEST, "Request too large");
+        conn->in.len = 0;
+        conn->closing = 1;
+    }
+}
+
+static void read_connection(Service* svc, Connection* conn) {
+    for (;;) {
+        if (json_buffer_reserve(&conn->in, SERVICE_READ_CHUNK) != 0) {
+            conn->closing = 1;
+            break;
+        }
+        ssize_t n = read(conn->fd, conn->in.data + conn->in.len, SERVICE_READ_CHUNK);
+        if (n > 0) {
+            conn->in.len += (size_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            conn->closing = 1;
+        }
+        break;
+    }
+
+    process_input(svc, conn);
+    touch_connection(svc, conn);
+}
+
+static void close_connection(Service* svc, Connection* conn) {
+    epoll_ctl(svc->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    json_buffer_free(&conn->in);
+    json_buffer_free(&conn->out);
+    free(conn);
+}
+
+// Returns 1 if the connection was closed
+static int flush_connection(Service* svc, Connection* conn) {
+    while (conn->out.len > 0) {
+        ssize_t n = send(conn->fd, conn->out.data, conn->out.len, MSG_NOSIGNAL);
+        if (n > 0) {
+            json_buffer_consume(&conn->out, (size_t)n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        close_connection(svc, conn);
+        return 1;
+    }
+
+    if (conn->out.len == 0 && conn->closing) {
+        close_connection(svc, conn);
+        return 1;
+    }
+
+    int want_write = conn->out.len > 0;
+    if (want_write != conn->want_write) {
+        struct epoll_event ev;
+        ev.events = EPOLLIN | (want_write ? EPOLLOUT : 0);
+        ev.data.ptr = conn;
+        epoll_ctl(svc->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+        conn->want_write = want_write;
+    }
+    return 0;
+}
+
+static void accept_connections(Service* svc) {
+    for (;;) {
+        int fd = accept(svc->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("accept");
+            }
+            return;
+        }
+
+        Connection* conn = calloc(1, sizeof(Connection));
+        if (!conn || set_nonblocking(fd) != 0) {
+            free(conn);
+            close(fd);
+            continue;
+        }
+        conn->fd = fd;
+        json_buffer_init(&conn->in);
+        json_buffer_init(&conn->out);
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = conn;
+        if (epoll_ctl(svc->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            perror("epoll_ctl");
+            close(fd);
+            free(conn);
+        }
+    }
+}
+
+static int open_listener(const char* socket_path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", socket_path);
+        return -1;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    unlink(socket_path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 128) != 0 ||
+        set_nonblocking(fd) != 0) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int service_run(const Config* config, const char* socket_path) {
+    Service svc;
+    memset(&svc, 0, sizeof(svc));
+
+    if (db_init(config->db_path, &svc.db) != 0) {
+        return 1;
+    }
+    if (db_configure(svc.db, config) != 0 || db_create_schema(svc.db) != 0) {
+        db_close(svc.db);
+        return 1;
+    }
+
+    svc.listen_fd = open_listener(socket_path);
+    if (svc.listen_fd < 0) {
+        db_close(svc.db);
+        return 1;
+    }
+
+    svc.epoll_fd = epoll_create1(0);
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (svc.epoll_fd < 0 || epoll_ctl(svc.epoll_fd, EPOLL_CTL_ADD, svc.listen_fd, &ev) != 0) {
+        perror("epoll");
+        close(svc.listen_fd);
+        db_close(svc.db);
+        return 1;
+    }
+
+    signal(SIGINT, handle_stop_signal);
+    signal(SIGTERM, handle_stop_signal);
+    printf("Serving %s on %s\n", config->db_path, socket_path);
+
+    struct epoll_event events[SERVICE_MAX_EVENTS];
+    while (!service_stop) {
+        int n = epoll_wait(svc.epoll_fd, events, SERVICE_MAX_EVENTS, 500);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+
+        // Every request that arrived in this wakeup shares one transaction
+        for (int i = 0; i < n; i++) {
+            Connection* conn = events[i].data.ptr;
+            if (!conn) {
+                accept_connections(&svc);
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                read_connection(&svc, conn);
+            } else if (events[i].events & EPOLLOUT) {
+                touch_connection(&svc, conn);
+            }
+        }
+        commit_batch(&svc);
+
+        Connection* conn = svc.touched;
+        svc.touched = NULL;
+        while (conn) {
+            Connection* next = conn->next_touched;
+            conn->touched = 0;
+            conn->next_touched = NULL;
+            flush_connection(&svc, conn);
+            conn = next;
+        }
+    }
+
+    printf("Service shutting down\n");
+    close(svc.epoll_fd);
+    close(svc.listen_fd);
+    unlink(socket_path);
+    db_close(svc.db);
+    return 0;
+}
+
+#else
+
+int service_run(const Config* config, const char* socket_path) {
+    (void)config;
+    (void)socket_path;
+    fprintf(stderr, "Service mode is only available on Linux\n");
+    return 1;
+}
+
+#endif
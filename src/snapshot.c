@@ -0,0 +1,188 @@
+#include "snapshot.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define SNAPSHOT_MAGIC "HMSNAP\r\n"
+#define SNAPSHOT_HEADER_SIZE 64
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t task_size;      // sizeof(Task), guards against layout changes
+    int64_t revision;
+    uint64_t count;
+    uint64_t checksum;
+} SnapshotHeader;
+
+// Four independent multiply-xor lanes over 64-bit words; fast enough that
+// verifying the mapped array costs far less than reloading it from SQLite
+static uint64_t snapshot_checksum(const void* data, size_t size) {
+    const unsigned char* p = data;
+    uint64_t lanes[4] = {
+        0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL,
+        0x165667B19E3779F9ULL, 0x27D4EB2F165667C5ULL
+    };
+    const uint64_t prime = 0x100000001B3ULL;
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int lane = 0; lane < 4; lane++) {
+            uint64_t word;
+            memcpy(&word, p + i + lane * 8, 8);
+            lanes[lane] = (lanes[lane] ^ word) * prime;
+        }
+    }
+
+    uint64_t hash = lanes[0] ^ (lanes[1] << 1) ^ (lanes[2] << 2) ^ (lanes[3] << 3);
+    for (; i < size; i++) {
+        hash = (hash ^ p[i]) * prime;
+    }
+    return hash ^ size;
+}
+
+int snapshot_write(const char* path, const Task* tasks, int count, sqlite3_int64 revision) {
+    if (!path || (!tasks && count > 0) || count < 0) return 1;
+
+    char temp_path[512];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    FILE* file = fopen(temp_path, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to create snapshot %s\n", temp_path);
+        return 1;
+    }
+
+    unsigned char header_block[SNAPSHOT_HEADER_SIZE] = {0};
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.task_size = sizeof(Task);
+    header.revision = revision;
+    header.count = (uint64_t)count;
+    header.checksum = snapshot_checksum(tasks, sizeof(Task) * (size_t)count);
+    memcpy(header_block, &header, sizeof(header));
+
+    int ok = fwrite(header_block, 1, sizeof(header_block), file) == sizeof(header_block) &&
+             (count == 0 || fwrite(tasks, sizeof(Task), (size_t)count, file) == (size_t)count);
+    ok = (fclose(file) == 0) && ok;
+
+    // Publish atomically so a crash mid-write never leaves a torn snapshot
+    if (ok) {
+        remove(path);
+        ok = rename(temp_path, path) == 0;
+    }
+    if (!ok) {
+        fprintf(stderr, "Failed to write snapshot %s\n", path);
+        remove(temp_path);
+        return 1;
+    }
+    return 0;
+}
+
+static void* snapshot_load_file(const char* path, size_t* size) {
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < SNAPSHOT_HEADER_SIZE) {
+        close(fd);
+        return NULL;
+    }
+
+    // Private writable mapping: edits to the list copy the touched pages
+    // and never reach the file
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+
+    *size = (size_t)st.st_size;
+    return data;
+#else
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (length < SNAPSHOT_HEADER_SIZE) {
+        fclose(file);
+        return NULL;
+    }
+
+    void* data = malloc((size_t)length);
+    if (!data || fread(data, 1, (size_t)length, file) != (size_t)length) {
+        free(data);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+
+    *size = (size_t)length;
+    return data;
+#endif
+}
+
+static void snapshot_release(void* data, size_t size) {
+#ifndef _WIN32
+    munmap(data, size);
+#else
+    (void)size;
+    free(data);
+#endif
+}
+
+int snapshot_map(const char* path, sqlite3_int64 revision, TaskSnapshot* snapshot) {
+    if (!path || !snapshot) return 1;
+    memset(snapshot, 0, sizeof(TaskSnapshot));
+
+    size_t size = 0;
+    unsigned char* data = snapshot_load_file(path, &size);
+    if (!data) return 1;
+
+    SnapshotHeader header;
+    memcpy(&header, data, sizeof(header));
+
+    const char* reason = NULL;
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+        reason = "bad magic";
+    } else if (header.version != SNAPSHOT_VERSION || header.task_size != sizeof(Task)) {
+        reason = "incompatible version";
+    } else if (header.revision != revision) {
+        reason = "database changed since snapshot";
+    } else if (header.count > (uint64_t)(size - SNAPSHOT_HEADER_SIZE) / sizeof(Task) ||
+               header.count > 0x7FFFFFFF) {
+        reason = "truncated";
+    } else if (snapshot_checksum(data + SNAPSHOT_HEADER_SIZE, sizeof(Task) * header.count) != header.checksum) {
+        reason = "checksum mismatch";
+    }
+
+    if (reason) {
+        printf("Ignoring snapshot %s: %s\n", path, reason);
+        snapshot_release(data, size);
+        return 1;
+    }
+
+    snapshot->tasks = (Task*)(data + SNAPSHOT_HEADER_SIZE);
+    snapshot->count = (int)header.count;
+    snapshot->mapping = data;
+    snapshot->mapping_size = size;
+    return 0;
+}
+
+void snapshot_unmap(TaskSnapshot* snapshot) {
+    if (!snapshot || !snapshot->mapping) return;
+
+    snapshot_release(snapshot->mapping, snapshot->mapping_size);
+    memset(snapshot, 0, sizeof(TaskSnapshot));
+}
@@ -2,6 +2,7 @@
 #include <SDL2/SDL_image.h>
 #include <stdio.h>
 #include <string.h>
+#include "metrics.h"
 
 int sprite_manager_init(SpriteManager* manager, SDL_Renderer* renderer) {
     if (!manager || !renderer) return 1;
@@ -37,6 +38,7 @@ int sprite_manager_load_sprite(SpriteManager* manager, SpriteType type, const ch
         SDL_FreeSurface(surface);
         return 1;
     }
+    metrics_add(METRIC_TEXTURES_CREATED, 1);
     
     manager->sprites[type].texture = texture;
     manager->sprites[type].width = surface->w;
@@ -0,0 +1,199 @@
+#include "tag_index.h"
+#include <stdlib.h>
+#include <string.h>
+
+void tag_index_init(TagIndex* index) {
+    memset(index, 0, sizeof(TagIndex));
+    bitmap_init(&index->all);
+    bitmap_init(&index->completed);
+}
+
+void tag_index_free(TagIndex* index) {
+    for (int i = 0; i < index->count; i++) {
+        bitmap_free(&index->entries[i].tasks);
+    }
+    free(index->entries);
+    bitmap_free(&index->all);
+    bitmap_free(&index->completed);
+    memset(index, 0, sizeof(TagIndex));
+}
+
+static int find_entry(const TagIndex* index, int tag_id, int* at) {
+    int lo = 0;
+    int hi = index->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (index->entries[mid].tag.id < tag_id) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    if (at) *at = lo;
+    return lo < index->count && index->entries[lo].tag.id == tag_id ? lo : -1;
+}
+
+// The entry for tag_id, added without a name if it is new
+static TagEntry* entry_for(TagIndex* index, int tag_id) {
+    int at;
+    int found = find_entry(index, tag_id, &at);
+    if (found >= 0) return &index->entries[found];
+
+    if (index->count == index->capacity) {
+        int capacity = index->capacity ? index->capacity * 2 : 16;
+        TagEntry* grown = realloc(index->entries, capacity * sizeof(TagEntry));
+        if (!grown) return NULL;
+        index->entries = grown;
+        index->capacity = capacity;
+    }
+    memmove(&index->entries[at + 1], &index->entries[at], (index->count - at) * sizeof(TagEntry));
+    TagEntry* entry = &index->entries[at];
+    memset(entry, 0, sizeof(TagEntry));
+    entry->tag.id = tag_id;
+    bitmap_init(&entry->tasks);
+    index->count++;
+    index->unnamed++;
+    return entry;
+}
+
+static void add_task(TagIndex* index, const Task* task) {
+    Uint32 id = (Uint32)task->id;
+    int failed = bitmap_add(&index->all, id);
+    if (task->completed) {
+        failed |= bitmap_add(&index->completed, id);
+    }
+    for (int i = 0; i < task->tag_count; i++) {
+        TagEntry* entry = entry_for(index, task->tags[i]);
+        failed |= !entry || bitmap_add(&entry->tasks, id);
+    }
+    index->failed |= failed;
+}
+
+static void remove_task(TagIndex* index, const Task* task) {
+    Uint32 id = (Uint32)task->id;
+    bitmap_remove(&index->all, id);
+    bitmap_remove(&index->completed, id);
+    for (int i = 0; i < task->tag_count; i++) {
+        int found = find_entry(index, task->tags[i], NULL);
+        if (found >= 0) {
+            bitmap_remove(&index->entries[found].tasks, id);
+        }
+    }
+}
+
+void tag_index_rebuild(TagIndex* index, const Task* tasks, int count) {
+    bitmap_clear(&index->all);
+    bitmap_clear(&index->completed);
+    for (int i = 0; i < index->count; i++) {
+        bitmap_clear(&index->entries[i].tasks);
+    }
+    index->failed = 0;
+    for (int i = 0; i < count; i++) {
+        add_task(index, &tasks[i]);
+    }
+    index->version++;
+}
+
+void tag_index_apply(TagIndex* index, const TaskList* list, const TaskDelta* deltas, int count) {
+    for (int i = 0; i < count; i++) {
+        const Task* task = &deltas[i].task;
+        int at = task_list_find(list, task->id);
+        if (at >= 0) {
+            remove_task(index, &list->tasks[at]);
+        }
+        if (deltas[i].type != TASK_DELTA_DELETE) {
+            add_task(index, task);
+        }
+    }
+    if (count > 0) index->version++;
+}
+
+void tag_index_set_names(TagIndex* index, const Tag* tags, int count) {
+    for (int i = 0; i < count; i++) {
+        TagEntry* entry = entry_for(index, tags[i].id);
+        if (entry) {
+            entry->tag = tags[i];
+        }
+        else {
+            index->failed = 1;
+        }
+    }
+    index->unnamed = 0;
+    for (int i = 0; i < index->count; i++) {
+        index->unnamed += index->entries[i].tag.name[0] == '\0';
+    }
+    index->version++;
+}
+
+const TagEntry* tag_index_find(const TagIndex* index, int tag_id) {
+    int found = find_entry(index, tag_id, NULL);
+    return found >= 0 ? &index->entries[found] : NULL;
+}
+
+TagMatch tag_query_match(const TagQuery* query, int tag_id) {
+    for (int i = 0; i < query->count; i++) {
+        if (query->tag_ids[i] == tag_id) return query->matches[i];
+    }
+    return TAG_MATCH_OFF;
+}
+
+int tag_query_cycle(TagQuery* query, int tag_id) {
+    for (int i = 0; i < query->count; i++) {
+        if (query->tag_ids[i] != tag_id) continue;
+
+        query->matches[i] = (query->matches[i] + 1) % TAG_MATCH_COUNT;
+        if (query->matches[i] == TAG_MATCH_OFF) {
+            query->count--;
+            query->tag_ids[i] = query->tag_ids[query->count];
+            query->matches[i] = query->matches[query->count];
+        }
+        return 0;
+    }
+    if (query->count == TAG_QUERY_MAX) return 1;
+    query->tag_ids[query->count] = tag_id;
+    query->matches[query->count] = TAG_MATCH_ALL;
+    query->count++;
+    return 0;
+}
+
+int tag_query_active(const TagQuery* query) {
+    return query->count > 0 || query->completion != TASK_FILTER_ALL;
+}
+
+int tag_index_query(const TagIndex* index, const TagQuery* query, Bitmap* out) {
+    static const Bitmap empty = {0};
+
+    // Start from the union of the "any" tags, or from every task
+    int any = 0;
+    int failed = 0;
+    bitmap_clear(out);
+    for (int i = 0; i < query->count; i++) {
+        if (query->matches[i] != TAG_MATCH_ANY) continue;
+        const TagEntry* entry = tag_index_find(index, query->tag_ids[i]);
+        failed |= entry && bitmap_or(out, &entry->tasks);
+        any = 1;
+    }
+    if (!any) {
+        failed |= bitmap_copy(out, &index->all);
+    }
+
+    // Then narrow it down; each pass only visits the containers left
+    for (int i = 0; i < query->count; i++) {
+        const TagEntry* entry = tag_index_find(index, query->tag_ids[i]);
+        const Bitmap* tasks = entry ? &entry->tasks : &empty;
+        if (query->matches[i] == TAG_MATCH_ALL) {
+            bitmap_and(out, tasks);
+        }
+        else if (query->matches[i] == TAG_MATCH_NONE) {
+            bitmap_andnot(out, tasks);
+        }
+    }
+    if (query->completion == TASK_FILTER_COMPLETED) {
+        bitmap_and(out, &index->completed);
+    }
+    else if (query->completion == TASK_FILTER_UNCOMPLETED) {
+        bitmap_andnot(out, &index->completed);
+    }
+    return failed;
+}
@@ -0,0 +1,155 @@
+#include "task_events.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "database.h"
+
+// Runs inside sqlite3_step; it may only record, not touch the database
+static void on_update(void* user_data, int op, const char* db_name, const char* table,
+                      sqlite3_int64 rowid) {
+    TaskEventCapture* capture = user_data;
+    if (strcmp(table, "tasks") != 0 || strcmp(db_name, "main") != 0) return;
+
+    if (capture->count == capture->capacity) {
+        int capacity = capture->capacity ? capture->capacity * 2 : 64;
+        TaskChange* grown = realloc(capture->changes, capacity * sizeof(TaskChange));
+        if (!grown) {
+            capture->overflow = 1;
+            return;
+        }
+        capture->changes = grown;
+        capture->capacity = capacity;
+    }
+    capture->changes[capture->count] = (TaskChange){op, capture->count, rowid};
+    capture->count++;
+}
+
+static void on_rollback(void* user_data) {
+    TaskEventCapture* capture = user_data;
+    capture->count = 0;
+    capture->overflow = 0;
+}
+
+void task_events_attach(TaskEventCapture* capture, sqlite3* db) {
+    memset(capture, 0, sizeof(TaskEventCapture));
+    sqlite3_update_hook(db, on_update, capture);
+    sqlite3_rollback_hook(db, on_rollback, capture);
+}
+
+void task_events_detach(TaskEventCapture* capture, sqlite3* db) {
+    sqlite3_update_hook(db, NULL, NULL);
+    sqlite3_rollback_hook(db, NULL, NULL);
+    free(capture->changes);
+    memset(capture, 0, sizeof(TaskEventCapture));
+}
+
+static int compare_changes(const void* a, const void* b) {
+    const TaskChange* left = a;
+    const TaskChange* right = b;
+    if (left->rowid != right->rowid) return left->rowid < right->rowid ? -1 : 1;
+    return left->seq - right->seq;
+}
+
+int task_events_collect(TaskEventCapture* capture, sqlite3* db, TaskDelta** deltas, int* count) {
+    *deltas = NULL;
+    *count = 0;
+    if (capture->overflow) {
+        capture->count = 0;
+        capture->overflow = 0;
+        return 1;
+    }
+    if (capture->count == 0) return 0;
+
+    // A row inserted and then stamped by a trigger is one insert; a row
+    // that ends deleted is a delete whatever happened before
+    qsort(capture->changes, capture->count, sizeof(TaskChange), compare_changes);
+    TaskDelta* out = malloc(capture->count * sizeof(TaskDelta));
+    int* ids = malloc(capture->count * sizeof(int));
+    Task* rows = malloc(capture->count * sizeof(Task));
+    if (!out || !ids || !rows) {
+        free(out);
+        free(ids);
+        free(rows);
+        capture->count = 0;
+        return 1;
+    }
+
+    int n = 0;
+    for (int i = 0; i < capture->count; ) {
+        int first = i;
+        while (i + 1 < capture->count && capture->changes[i + 1].rowid == capture->changes[first].rowid) i++;
+        int last_op = capture->changes[i].op;
+        i++;
+
+        out[n].type = last_op == SQLITE_DELETE ? TASK_DELTA_DELETE :
+                      capture->changes[first].op == SQLITE_INSERT ? TASK_DELTA_INSERT : TASK_DELTA_UPDATE;
+        memset(&out[n].task, 0, sizeof(Task));
+        out[n].task.id = (int)capture->changes[first].rowid;
+        ids[n] = out[n].task.id;
+        n++;
+    }
+    capture->count = 0;
+
+    // Read the surviving rows as committed. A savepoint rollback does not
+    // reach the rollback hook, so what it undid shows up here instead: a
+    // row that has gone becomes a delete, and a deleted row that is still
+    // there (ids are never reused) an update.
+    int rc = db_get_tasks_by_id(db, ids, n, rows);
+    for (int i = 0; rc == 0 && i < n; i++) {
+        if (rows[i].id == 0) {
+            out[i].type = TASK_DELTA_DELETE;
+        }
+        else {
+            if (out[i].type == TASK_DELTA_DELETE) out[i].type = TASK_DELTA_UPDATE;
+            out[i].task = rows[i];
+        }
+    }
+    free(ids);
+    free(rows);
+
+    if (rc != 0) {
+        free(out);
+        return 1;
+    }
+    *deltas = out;
+    *count = n;
+    return 0;
+}
+
+int task_events_since(sqlite3* db, sqlite3_int64 since, TaskDelta** deltas, int* count) {
+    *deltas = NULL;
+    *count = 0;
+
+    Task* changed;
+    int changed_count;
+    int* deleted;
+    int deleted_count;
+    if (db_get_task_changes(db, since, &changed, &changed_count, &deleted, &deleted_count) != 0) {
+        return 1;
+    }
+
+    int total = changed_count + deleted_count;
+    TaskDelta* out = total > 0 ? malloc(total * sizeof(TaskDelta)) : NULL;
+    if (total > 0 && !out) {
+        free(changed);
+        free(deleted);
+        return 1;
+    }
+
+    // Deletes first: a tombstone is final, ids are never reused
+    for (int i = 0; i < deleted_count; i++) {
+        out[i].type = TASK_DELTA_DELETE;
+        memset(&out[i].task, 0, sizeof(Task));
+        out[i].task.id = deleted[i];
+    }
+    for (int i = 0; i < changed_count; i++) {
+        out[deleted_count + i].type = TASK_DELTA_UPDATE;
+        out[deleted_count + i].task = changed[i];
+    }
+    free(changed);
+    free(deleted);
+
+    *deltas = out;
+    *count = total;
+    return 0;
+}
@@ -0,0 +1,359 @@
+#include "task_list.h"
+#include <stdlib.h>
+#include <string.h>
+#include "tasks.h"
+
+void task_list_init(TaskList* list) {
+    memset(list, 0, sizeof(TaskList));
+}
+
+static void release_tasks(TaskList* list) {
+    if (list->snapshot.mapping) {
+        snapshot_unmap(&list->snapshot);
+    }
+    else {
+        free(list->tasks);
+    }
+    list->tasks = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+void task_list_free(TaskList* list) {
+    release_tasks(list);
+    free(list->slots);
+    free(list->selected);
+    memset(list, 0, sizeof(TaskList));
+}
+
+// Doubles the capacity of the list. A list still backed by a snapshot
+// mapping is copied to the heap first, since the mapping cannot grow.
+static int grow(TaskList* list) {
+    int new_capacity = list->capacity == 0 ? 10 : list->capacity * 2;
+
+    if (list->snapshot.mapping) {
+        Task* new_tasks = malloc(new_capacity * sizeof(Task));
+        if (!new_tasks) return 1;
+        memcpy(new_tasks, list->tasks, list->count * sizeof(Task));
+        snapshot_unmap(&list->snapshot);
+        list->tasks = new_tasks;
+        list->capacity = new_capacity;
+        return 0;
+    }
+
+    Task* new_tasks = realloc(list->tasks, new_capacity * sizeof(Task));
+    if (!new_tasks) return 1;
+    list->tasks = new_tasks;
+    list->capacity = new_capacity;
+    return 0;
+}
+
+// Ids are assigned in increasing order from 1, so a flat table indexed by
+// id stays about as large as the number of tasks ever created
+static int reserve_slot(TaskList* list, int task_id) {
+    if (task_id < list->slot_capacity) return 0;
+
+    int capacity = list->slot_capacity ? list->slot_capacity : 64;
+    while (capacity <= task_id) capacity *= 2;
+    int* grown = realloc(list->slots, capacity * sizeof(int));
+    if (!grown) return 1;
+    for (int i = list->slot_capacity; i < capacity; i++) {
+        grown[i] = -1;
+    }
+    list->slots = grown;
+
+    Uint8* selected = realloc(list->selected, capacity);
+    if (!selected) return 1;
+    memset(selected + list->slot_capacity, 0, capacity - list->slot_capacity);
+    list->selected = selected;
+    list->slot_capacity = capacity;
+    return 0;
+}
+
+static void deselect(TaskList* list, int task_id) {
+    if (list->selected[task_id]) {
+        list->selected[task_id] = 0;
+        list->selected_count--;
+    }
+}
+
+static void reindex(TaskList* list, int from, int to) {
+    for (int i = from; i < to; i++) {
+        list->slots[list->tasks[i].id] = i;
+    }
+}
+
+static int compare_order(const Task* left, const Task* right) {
+    if (left->position != right->position) return left->position < right->position ? -1 : 1;
+    return (left->id > right->id) - (left->id < right->id);
+}
+
+static int compare_task_order(const void* a, const void* b) {
+    return compare_order(a, b);
+}
+
+int task_list_find(const TaskList* list, int task_id) {
+    if (task_id <= 0 || task_id >= list->slot_capacity) return -1;
+    return list->slots[task_id];
+}
+
+int task_list_replace(TaskList* list, Task* tasks, int count, const TaskSnapshot* snapshot) {
+    for (int i = 0; i < list->count; i++) {
+        if (list->tasks[i].id > 0 && list->tasks[i].id < list->slot_capacity) {
+            list->slots[list->tasks[i].id] = -1;
+        }
+    }
+    release_tasks(list);
+    task_list_clear_selection(list);
+    list->version++;
+
+    list->tasks = tasks;
+    list->count = count;
+    list->capacity = count;
+    if (snapshot) {
+        list->snapshot = *snapshot;
+    }
+    else {
+        memset(&list->snapshot, 0, sizeof(TaskSnapshot));
+    }
+
+    list->completed = 0;
+    for (int i = 0; i < count; i++) {
+        if (tasks[i].id <= 0 || reserve_slot(list, tasks[i].id) != 0) return 1;
+        list->slots[tasks[i].id] = i;
+        list->completed += tasks[i].completed != 0;
+    }
+    return 0;
+}
+
+static void remove_at(TaskList* list, int index) {
+    list->slots[list->tasks[index].id] = -1;
+    list->completed -= list->tasks[index].completed != 0;
+    memmove(&list->tasks[index], &list->tasks[index + 1], (list->count - index - 1) * sizeof(Task));
+    list->count--;
+    reindex(list, index, list->count);
+}
+
+static int insert_sorted(TaskList* list, const Task* task) {
+    if (task->id <= 0 || reserve_slot(list, task->id) != 0) return 1;
+    if (list->count >= list->capacity && grow(list) != 0) return 1;
+
+    int low = 0;
+    int high = list->count;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (compare_order(&list->tasks[mid], task) < 0) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+
+    // New tasks go to the end of the manual order, so this is usually
+    // an append
+    memmove(&list->tasks[low + 1], &list->tasks[low], (list->count - low) * sizeof(Task));
+    list->tasks[low] = *task;
+    list->count++;
+    list->completed += task->completed != 0;
+    reindex(list, low, list->count);
+    return 0;
+}
+
+static int apply_one(TaskList* list, const TaskDelta* delta) {
+    const Task* task = &delta->task;
+    int index = task_list_find(list, task->id);
+
+    if (delta->type == TASK_DELTA_DELETE) {
+        if (index < 0) return 0;
+        deselect(list, task->id);
+        remove_at(list, index);
+        return 1;
+    }
+
+    if (index >= 0) {
+        // Most updates leave the row between the same neighbours
+        if ((index == 0 || compare_order(&list->tasks[index - 1], task) < 0) &&
+            (index == list->count - 1 || compare_order(task, &list->tasks[index + 1]) < 0)) {
+            list->completed += (task->completed != 0) - (list->tasks[index].completed != 0);
+            list->tasks[index] = *task;
+            return 1;
+        }
+        remove_at(list, index);
+    }
+    return insert_sorted(list, task) == 0 ? 1 : -1;
+}
+
+// Updates rows in place, appends new ones and marks deleted ones, then
+// compacts in one pass. Sorts only if a row was added or moved.
+static int apply_batch(TaskList* list, const TaskDelta* deltas, int count) {
+    int touched = 0;
+    int first_removed = list->count;
+    int removed = 0;
+    int reorder = 0;
+
+    for (int i = 0; i < count; i++) {
+        const Task* task = &deltas[i].task;
+        int index = task_list_find(list, task->id);
+
+        if (deltas[i].type == TASK_DELTA_DELETE) {
+            if (index < 0) continue;
+            deselect(list, task->id);
+            list->slots[task->id] = -1;
+            list->completed -= list->tasks[index].completed != 0;
+            list->tasks[index].id = 0;
+            if (index < first_removed) first_removed = index;
+            removed++;
+            touched++;
+            continue;
+        }
+
+        if (index >= 0) {
+            list->completed += (task->completed != 0) - (list->tasks[index].completed != 0);
+            reorder |= task->position != list->tasks[index].position;
+            list->tasks[index] = *task;
+        }
+        else {
+            if (task->id <= 0 || reserve_slot(list, task->id) != 0) return -1;
+            if (list->count >= list->capacity && grow(list) != 0) return -1;
+            list->slots[task->id] = list->count;
+            list->tasks[list->count++] = *task;
+            list->completed += task->completed != 0;
+            reorder = 1;
+        }
+        touched++;
+    }
+
+    if (removed > 0) {
+        int kept = first_removed;
+        for (int i = first_removed + 1; i < list->count; i++) {
+            if (list->tasks[i].id != 0) {
+                list->tasks[kept++] = list->tasks[i];
+            }
+        }
+        list->count = kept;
+    }
+    if (reorder) {
+        qsort(list->tasks, list->count, sizeof(Task), compare_task_order);
+        first_removed = 0;
+    }
+    reindex(list, first_removed < list->count ? first_removed : list->count, list->count);
+    return touched;
+}
+
+int task_list_apply(TaskList* list, const TaskDelta* deltas, int count) {
+    // Conservatively: a failed apply may still have changed some rows
+    if (count > 0) list->version++;
+
+    // Each single delete shifts the rows after it; with several, one
+    // compaction pass is cheaper
+    int deletes = 0;
+    for (int i = 0; i < count && deletes < 2; i++) {
+        deletes += deltas[i].type == TASK_DELTA_DELETE;
+    }
+    if (count > TASK_LIST_RESORT_BATCH || deletes > 1) {
+        return apply_batch(list, deltas, count);
+    }
+
+    int touched = 0;
+    for (int i = 0; i < count; i++) {
+        int rc = apply_one(list, &deltas[i]);
+        if (rc < 0) return -1;
+        touched += rc;
+    }
+    return touched;
+}
+
+// Index one past the last subtask of the task at index
+static int subtree_end(const TaskList* list, int index) {
+    int end = index + 1 + list->tasks[index].subtasks;
+    return end < list->count ? end : list->count;
+}
+
+int task_list_move_position(const TaskList* list, int from, int to, int* parent_id, double* position) {
+    int end = subtree_end(list, from);
+    if (to >= from && to < end) return -1;
+
+    const Task* before;
+    const Task* after;
+    if (to > from) {
+        int last = subtree_end(list, to) - 1;
+        before = &list->tasks[last];
+        after = last + 1 < list->count ? &list->tasks[last + 1] : NULL;
+    }
+    else {
+        before = to > 0 ? &list->tasks[to - 1] : NULL;
+        after = &list->tasks[to];
+    }
+    *parent_id = list->tasks[to].parent_id;
+
+    // The subtasks are spread over the gap after the task
+    int crowded = task_position_between(before, after, position);
+    int rows = end - from;
+    return crowded || (after && (after->position - *position) / rows < TASK_POSITION_MIN_GAP);
+}
+
+int task_list_next_visible(const TaskList* list, int index) {
+    return list->tasks[index].collapsed ? subtree_end(list, index) : index + 1;
+}
+
+int task_list_depth(const TaskList* list, int index) {
+    int depth = 0;
+    int parent = list->tasks[index].parent_id;
+    while (parent != 0 && depth < list->count) {
+        int at = task_list_find(list, parent);
+        if (at < 0) break;
+        parent = list->tasks[at].parent_id;
+        depth++;
+    }
+    return depth;
+}
+
+void task_list_select(TaskList* list, int task_id, int selected) {
+    if (task_list_find(list, task_id) < 0) return;
+    selected = selected != 0;
+    if (list->selected[task_id] != selected) {
+        list->selected[task_id] = (Uint8)selected;
+        list->selected_count += selected ? 1 : -1;
+        list->version++;
+    }
+}
+
+int task_list_is_selected(const TaskList* list, int task_id) {
+    return task_id > 0 && task_id < list->slot_capacity && list->selected[task_id];
+}
+
+void task_list_select_range(TaskList* list, int from, int to) {
+    if (from > to) {
+        int swap = from;
+        from = to;
+        to = swap;
+    }
+    for (int i = from < 0 ? 0 : from; i <= to && i < list->count; i++) {
+        task_list_select(list, list->tasks[i].id, 1);
+    }
+}
+
+void task_list_clear_selection(TaskList* list) {
+    if (list->selected_count == 0) return;
+    memset(list->selected, 0, list->slot_capacity);
+    list->selected_count = 0;
+    list->version++;
+}
+
+int task_list_first_selected(const TaskList* list) {
+    for (int i = 0; i < list->count && list->selected_count > 0; i++) {
+        if (list->selected[list->tasks[i].id]) return i;
+    }
+    return -1;
+}
+
+int task_list_selected_ids(const TaskList* list, int* ids) {
+    int count = 0;
+    for (int i = 0; i < list->count && count < list->selected_count; i++) {
+        if (list->selected[list->tasks[i].id]) {
+            ids[count++] = list->tasks[i].id;
+        }
+    }
+    return count;
+}
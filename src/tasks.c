@@ -21,6 +21,31 @@ void task_init(Task* task, const char* title, const char* description, int diffi
     task->completed = 0;
     task->streak = 0;
     task->last_completed = 0;
+    task->position = 0;
+    task->parent_id = 0;
+    task->subtasks = 0;
+    task->subtasks_completed = 0;
+    task->collapsed = 0;
+    memset(task->tags, 0, sizeof(task->tags));
+    task->tag_count = 0;
+    task->due_at = 0;
+}
+
+int task_position_between(const Task* before, const Task* after, double* position) {
+    if (before && after) {
+        *position = before->position + (after->position - before->position) / 2;
+        return after->position - before->position < TASK_POSITION_MIN_GAP * 2;
+    }
+    if (before) {
+        *position = before->position + 1;
+    }
+    else if (after) {
+        *position = after->position - 1;
+    }
+    else {
+        *position = 1;
+    }
+    return 0;
 }
 
 void task_complete(Task* task) {
@@ -58,4 +83,97 @@ int task_get_reward(const Task* task) {
     int streak_bonus = (base_reward * task->streak) / 10;
     
     return base_reward + streak_bonus;
-} 
\ No newline at end of file
+}
+
+int task_parse_due(const char* text, time_t* due_at) {
+    while (*text == ' ') text++;
+    if (*text == '\0') {
+        *due_at = 0;
+        return 0;
+    }
+
+    int year, month, day, used;
+    int hour = TASK_DUE_DEFAULT_HOUR;
+    int minute = 0;
+    if (sscanf(text, "%d-%d-%d%n", &year, &month, &day, &used) != 3) return 1;
+    text += used;
+    if (sscanf(text, " %d:%d%n", &hour, &minute, &used) == 2) text += used;
+    while (*text == ' ') text++;
+    if (*text != '\0' || hour < 0 || hour > 23 || minute < 0 || minute > 59) return 1;
+
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = day;
+    tm.tm_hour = hour;
+    tm.tm_min = minute;
+    tm.tm_isdst = -1;
+    time_t parsed = mktime(&tm);
+
+    // mktime rolls days like February 30 over into the next month
+    if (parsed == (time_t)-1 || tm.tm_mon != month - 1 || tm.tm_mday != day) return 1;
+    *due_at = parsed;
+    return 0;
+}
+
+void task_format_due(time_t due_at, char* out, size_t size) {
+    out[0] = '\0';
+    if (due_at != 0) {
+        strftime(out, size, "%Y-%m-%d %H:%M", localtime(&due_at));
+    }
+}
+
+int task_parse_tags(const char* text, char names[][TAG_NAME_MAX]) {
+    int count = 0;
+    while (text && *text) {
+        const char* end = strchr(text, ',');
+        if (!end) end = text + strlen(text);
+
+        const char* start = text;
+        const char* stop = end;
+        while (start < stop && (*start == ' ' || *start == '\t')) start++;
+        while (stop > start && (stop[-1] == ' ' || stop[-1] == '\t')) stop--;
+        size_t length = stop - start;
+        if (length > 0) {
+            if (count == TASK_MAX_TAGS || length >= TAG_NAME_MAX) return -1;
+            memcpy(names[count], start, length);
+            names[count][length] = '\0';
+            count++;
+        }
+        text = *end ? end + 1 : end;
+    }
+    return count;
+}
+
+int task_apply_json(Task* task, const JsonField* fields, int count) {
+    if (!task || !fields) return 1;
+
+    const JsonField* f;
+    if ((f = json_find(fields, count, "title")) && json_field_string(f, task->title, sizeof(task->title)) != 0) return 1;
+    if ((f = json_find(fields, count, "description")) &&
+        json_field_string(f, task->description, sizeof(task->description)) != 0) return 1;
+    if ((f = json_find(fields, count, "difficulty")) && json_field_int(f, &task->difficulty) != 0) return 1;
+    if ((f = json_find(fields, count, "type")) && json_field_int(f, &task->type) != 0) return 1;
+    if ((f = json_find(fields, count, "completed")) && json_field_int(f, &task->completed) != 0) return 1;
+    if ((f = json_find(fields, count, "parent_id")) && json_field_int(f, &task->parent_id) != 0) return 1;
+
+    if (task->difficulty < 0 || task->difficulty > 4) return 1;
+    if (task->type < 0 || task->type > 2) return 1;
+    if (task->parent_id < 0) return 1;
+    return 0;
+}
+
+int task_append_json(JsonBuffer* out, const Task* task) {
+    if (!out || !task) return 1;
+
+    int rc = json_buffer_printf(out, "{\"id\":%d,\"title\":", task->id);
+    rc |= json_buffer_append_string(out, task->title);
+    rc |= json_buffer_append(out, ",\"description\":", 15);
+    rc |= json_buffer_append_string(out, task->description);
+    rc |= json_buffer_printf(out, ",\"difficulty\":%d,\"type\":%d,\"completed\":%s,"
+                             "\"parent_id\":%d,\"subtasks\":%d,\"subtasks_completed\":%d}",
+                             task->difficulty, task->type, task->completed ? "true" : "false",
+                             task->parent_id, task->subtasks, task->subtasks_completed);
+    return rc;
+}
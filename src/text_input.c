@@ -0,0 +1,265 @@
+#include "text_input.h"
+#include <string.h>
+
+static int utf8_sequence_length(unsigned char lead) {
+    if (lead < 0x80) return 1;
+    if ((lead & 0xE0) == 0xC0) return 2;
+    if ((lead & 0xF0) == 0xE0) return 3;
+    if ((lead & 0xF8) == 0xF0) return 4;
+    return 0;
+}
+
+static int utf8_is_continuation(unsigned char byte) {
+    return (byte & 0xC0) == 0x80;
+}
+
+static Uint32 utf8_decode(const char* s, int len) {
+    const unsigned char* p = (const unsigned char*)s;
+    switch (len) {
+        case 1: return p[0];
+        case 2: return ((Uint32)(p[0] & 0x1F) << 6) | (p[1] & 0x3F);
+        case 3: return ((Uint32)(p[0] & 0x0F) << 12) | ((Uint32)(p[1] & 0x3F) << 6) | (p[2] & 0x3F);
+        case 4: return ((Uint32)(p[0] & 0x07) << 18) | ((Uint32)(p[1] & 0x3F) << 12) |
+                       ((Uint32)(p[2] & 0x3F) << 6) | (p[3] & 0x3F);
+        default: return 0;
+    }
+}
+
+// Measures a single glyph once, when it enters the buffer
+static int glyph_advance(Font* font, const char* glyph, int len) {
+    if (!font) return 0;
+
+    Uint32 codepoint = utf8_decode(glyph, len);
+    int advance = 0;
+    if (font_glyph_advance(font, codepoint, &advance) == 0) {
+        return advance;
+    }
+
+    char temp[5] = {0};
+    memcpy(temp, glyph, len);
+    int w, h;
+    if (font_size_utf8(font, temp, &w, &h) == 0) {
+        return w;
+    }
+    return 0;
+}
+
+static int content_bytes(const TextInput* input) {
+    return input->gap_start + (TEXT_INPUT_CAPACITY - input->gap_end);
+}
+
+void text_input_init(TextInput* input, Font* font, int max_bytes) {
+    if (!input) return;
+
+    memset(input, 0, sizeof(TextInput));
+    input->font = font;
+    if (max_bytes <= 0 || max_bytes > TEXT_INPUT_CAPACITY - 1) {
+        max_bytes = TEXT_INPUT_CAPACITY - 1;
+    }
+    input->max_bytes = max_bytes;
+    input->gap_end = TEXT_INPUT_CAPACITY;
+    input->adv_gap_end = TEXT_INPUT_CAPACITY;
+}
+
+void text_input_set(TextInput* input, const char* text) {
+    if (!input) return;
+
+    text_input_init(input, input->font, input->max_bytes);
+    if (text) {
+        text_input_insert(input, text);
+    }
+}
+
+void text_input_set_font(TextInput* input, Font* font) {
+    if (!input) return;
+
+    char text[TEXT_INPUT_CAPACITY];
+    int caret = input->gap_start;
+    strcpy(text, text_input_get(input));
+
+    input->font = font;
+    text_input_set(input, text);
+    while (input->gap_start > caret) {
+        text_input_move_left(input);
+    }
+}
+
+const char* text_input_get(TextInput* input) {
+    if (!input) return "";
+
+    if (input->text_dirty) {
+        int tail = TEXT_INPUT_CAPACITY - input->gap_end;
+        memcpy(input->text, input->buf, input->gap_start);
+        memcpy(input->text + input->gap_start, input->buf + input->gap_end, tail);
+        input->text[input->gap_start + tail] = '\0';
+        input->text_dirty = 0;
+    }
+    return input->text;
+}
+
+int text_input_length(const TextInput* input) {
+    return input ? content_bytes(input) : 0;
+}
+
+int text_input_caret_x(const TextInput* input) {
+    return input ? input->caret_x : 0;
+}
+
+int text_input_insert(TextInput* input, const char* utf8) {
+    if (!input || !utf8) return 0;
+
+    int inserted = 0;
+    const char* p = utf8;
+    while (*p) {
+        int len = utf8_sequence_length((unsigned char)*p);
+        int valid = len > 0;
+        for (int i = 1; valid && i < len; i++) {
+            valid = utf8_is_continuation((unsigned char)p[i]);
+        }
+        if (!valid) {
+            // Skip a malformed byte rather than corrupting the buffer
+            p++;
+            continue;
+        }
+
+        unsigned char lead = (unsigned char)*p;
+        if (lead < 32 || lead == 127) {
+            p += len;
+            continue;
+        }
+
+        if (content_bytes(input) + len > input->max_bytes) {
+            break;
+        }
+
+        memcpy(input->buf + input->gap_start, p, len);
+        input->gap_start += len;
+
+        int advance = glyph_advance(input->font, p, len);
+        input->adv[input->adv_gap_start++] = advance;
+        input->caret_x += advance;
+        input->width += advance;
+
+        inserted++;
+        p += len;
+    }
+
+    if (inserted) {
+        input->text_dirty = 1;
+    }
+    return inserted;
+}
+
+void text_input_backspace(TextInput* input) {
+    if (!input || input->gap_start == 0) return;
+
+    do {
+        input->gap_start--;
+    } while (input->gap_start > 0 && utf8_is_continuation((unsigned char)input->buf[input->gap_start]));
+
+    int advance = input->adv[--input->adv_gap_start];
+    input->caret_x -= advance;
+    input->width -= advance;
+    input->text_dirty = 1;
+}
+
+void text_input_delete(TextInput* input) {
+    if (!input || input->gap_end == TEXT_INPUT_CAPACITY) return;
+
+    int len = utf8_sequence_length((unsigned char)input->buf[input->gap_end]);
+    if (len == 0) len = 1;
+    input->gap_end += len;
+
+    input->width -= input->adv[input->adv_gap_end++];
+    input->text_dirty = 1;
+}
+
+void text_input_move_left(TextInput* input) {
+    if (!input || input->gap_start == 0) return;
+
+    int len = 1;
+    while (len < input->gap_start &&
+           utf8_is_continuation((unsigned char)input->buf[input->gap_start - len])) {
+        len++;
+    }
+
+    input->gap_start -= len;
+    input->gap_end -= len;
+    memmove(input->buf + input->gap_end, input->buf + input->gap_start, len);
+
+    int advance = input->adv[--input->adv_gap_start];
+    input->adv[--input->adv_gap_end] = advance;
+    input->caret_x -= advance;
+}
+
+void text_input_move_right(TextInput* input) {
+    if (!input || input->gap_end == TEXT_INPUT_CAPACITY) return;
+
+    int len = utf8_sequence_length((unsigned char)input->buf[input->gap_end]);
+    if (len == 0) len = 1;
+
+    memmove(input->buf + input->gap_start, input->buf + input->gap_end, len);
+    input->gap_start += len;
+    input->gap_end += len;
+
+    int advance = input->adv[input->adv_gap_end++];
+    input->adv[input->adv_gap_start++] = advance;
+    input->caret_x += advance;
+}
+
+void text_input_move_home(TextInput* input) {
+    if (!input || input->gap_start == 0) return;
+
+    int len = input->gap_start;
+    memmove(input->buf + input->gap_end - len, input->buf, len);
+    input->gap_start = 0;
+    input->gap_end -= len;
+
+    int glyphs = input->adv_gap_start;
+    memmove(input->adv + input->adv_gap_end - glyphs, input->adv, glyphs * sizeof(int));
+    input->adv_gap_start = 0;
+    input->adv_gap_end -= glyphs;
+    input->caret_x = 0;
+}
+
+void text_input_move_end(TextInput* input) {
+    if (!input || input->gap_end == TEXT_INPUT_CAPACITY) return;
+
+    int len = TEXT_INPUT_CAPACITY - input->gap_end;
+    memmove(input->buf + input->gap_start, input->buf + input->gap_end, len);
+    input->gap_start += len;
+    input->gap_end = TEXT_INPUT_CAPACITY;
+
+    int glyphs = TEXT_INPUT_CAPACITY - input->adv_gap_end;
+    memmove(input->adv + input->adv_gap_start, input->adv + input->adv_gap_end, glyphs * sizeof(int));
+    input->adv_gap_start += glyphs;
+    input->adv_gap_end = TEXT_INPUT_CAPACITY;
+    input->caret_x = input->width;
+}
+
+int text_input_handle_key(TextInput* input, SDL_Keycode key) {
+    if (!input) return 0;
+
+    switch (key) {
+        case SDLK_BACKSPACE:
+            text_input_backspace(input);
+            return 1;
+        case SDLK_DELETE:
+            text_input_delete(input);
+            return 1;
+        case SDLK_LEFT:
+            text_input_move_left(input);
+            return 1;
+        case SDLK_RIGHT:
+            text_input_move_right(input);
+            return 1;
+        case SDLK_HOME:
+            text_input_move_home(input);
+            return 1;
+        case SDLK_END:
+            text_input_move_end(input);
+            return 1;
+        default:
+            return 0;
+    }
+}
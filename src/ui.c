@@ -1,37 +1,157 @@
 #include "ui.h"
 #include <SDL2/SDL.h>
-#include <SDL2/SDL_ttf.h>
 #include <stdio.h>
+#include <string.h>
+#include "metrics.h"
 
-void ui_init(UI* ui, SDL_Renderer* renderer, TTF_Font* font) {
+void ui_init(UI* ui, SDL_Renderer* renderer, Font* font) {
     if (!ui || !renderer || !font) return;
-    
+
+    memset(ui->text_cache, 0, sizeof(ui->text_cache));
     ui->renderer = renderer;
     ui->font = font;
+    ui->frame = 0;
+    ui->text_cache_ways = UI_TEXT_CACHE_WAYS;
 }
 
-void ui_draw_text(UI* ui, const char* text, int x, int y) {
-    if (!ui || !text || !*text) return;  // Skip empty strings
+void ui_cleanup(UI* ui) {
+    if (!ui) return;
+
+    for (int set = 0; set < UI_TEXT_CACHE_SETS; set++) {
+        for (int way = 0; way < UI_TEXT_CACHE_WAYS; way++) {
+            UITextCacheEntry* entry = &ui->text_cache[set][way];
+            if (entry->texture) {
+                SDL_DestroyTexture(entry->texture);
+                entry->texture = NULL;
+            }
+        }
+    }
+}
+
+void ui_set_font(UI* ui, Font* font) {
+    if (!ui || !font) return;
+
+    ui_cleanup(ui);
+    ui->font = font;
+}
+
+void ui_set_text_cache_ways(UI* ui, int ways) {
+    if (!ui) return;
+    if (ways < 1) ways = 1;
+    if (ways > UI_TEXT_CACHE_WAYS) ways = UI_TEXT_CACHE_WAYS;
+
+    for (int set = 0; set < UI_TEXT_CACHE_SETS; set++) {
+        for (int way = ways; way < UI_TEXT_CACHE_WAYS; way++) {
+            UITextCacheEntry* entry = &ui->text_cache[set][way];
+            if (entry->texture) {
+                SDL_DestroyTexture(entry->texture);
+                entry->texture = NULL;
+            }
+        }
+    }
+    ui->text_cache_ways = ways;
+}
+
+void ui_begin_frame(UI* ui) {
+    if (!ui) return;
+    ui->frame++;
+}
+
+static Uint32 hash_text(const char* text, size_t* length) {
+    Uint32 hash = 2166136261u;
+    const char* p = text;
+    for (; *p; p++) {
+        hash = (hash ^ (unsigned char)*p) * 16777619u;
+    }
+    *length = (size_t)(p - text);
+    return hash;
+}
 
+static SDL_Texture* render_text_texture(UI* ui, const char* text, int* width, int* height) {
     SDL_Color color = {0, 0, 0, 255};  // Black color
-    SDL_Surface* surface = TTF_RenderText_Solid(ui->font, text, color);
+    SDL_Surface* surface = font_render(ui->font, text, color);
     if (!surface) {
-        printf("Failed to render text: %s\n", TTF_GetError());
-        return;
+        printf("Failed to render text: %s\n", SDL_GetError());
+        return NULL;
     }
 
     SDL_Texture* texture = SDL_CreateTextureFromSurface(ui->renderer, surface);
     if (!texture) {
         printf("Failed to create texture: %s\n", SDL_GetError());
         SDL_FreeSurface(surface);
+        return NULL;
+    }
+    metrics_add(METRIC_TEXTURES_CREATED, 1);
+
+    *width = surface->w;
+    *height = surface->h;
+    SDL_FreeSurface(surface);
+    return texture;
+}
+
+// Returns the cached texture for text, rendering it on a miss. Strings too
+// long to use as a key return NULL and are drawn uncached.
+static UITextCacheEntry* lookup_text(UI* ui, const char* text) {
+    size_t length;
+    Uint32 hash = hash_text(text, &length);
+    if (length >= UI_TEXT_CACHE_KEY) return NULL;
+
+    UITextCacheEntry* set = ui->text_cache[hash % UI_TEXT_CACHE_SETS];
+    UITextCacheEntry* victim = &set[0];
+    for (int way = 0; way < ui->text_cache_ways; way++) {
+        UITextCacheEntry* entry = &set[way];
+        if (entry->texture && entry->hash == hash && strcmp(entry->text, text) == 0) {
+            entry->last_used = ui->frame;
+            return entry;
+        }
+        if (!entry->texture || (victim->texture && entry->last_used < victim->last_used)) {
+            victim = entry;
+        }
+    }
+
+    int width, height;
+    SDL_Texture* texture = render_text_texture(ui, text, &width, &height);
+    if (!texture) return NULL;
+
+    if (victim->texture) {
+        SDL_DestroyTexture(victim->texture);
+    }
+    memcpy(victim->text, text, length + 1);
+    victim->hash = hash;
+    victim->texture = texture;
+    victim->width = width;
+    victim->height = height;
+    victim->last_used = ui->frame;
+    return victim;
+}
+
+// Draws text with its top-left corner at (x, y), or centered in the box
+// when width and height are positive
+static void draw_text_at(UI* ui, const char* text, int x, int y, int width, int height) {
+    UITextCacheEntry* entry = lookup_text(ui, text);
+    if (entry) {
+        int text_x = width > 0 ? x + (width - entry->width) / 2 : x;
+        int text_y = height > 0 ? y + (height - entry->height) / 2 : y;
+        SDL_Rect rect = {text_x, text_y, entry->width, entry->height};
+        SDL_RenderCopy(ui->renderer, entry->texture, NULL, &rect);
         return;
     }
 
-    SDL_Rect rect = {x, y, surface->w, surface->h};
-    SDL_RenderCopy(ui->renderer, texture, NULL, &rect);
+    int text_w, text_h;
+    SDL_Texture* texture = render_text_texture(ui, text, &text_w, &text_h);
+    if (!texture) return;
 
+    int text_x = width > 0 ? x + (width - text_w) / 2 : x;
+    int text_y = height > 0 ? y + (height - text_h) / 2 : y;
+    SDL_Rect rect = {text_x, text_y, text_w, text_h};
+    SDL_RenderCopy(ui->renderer, texture, NULL, &rect);
     SDL_DestroyTexture(texture);
-    SDL_FreeSurface(surface);
+}
+
+void ui_draw_text(UI* ui, const char* text, int x, int y) {
+    if (!ui || !text || !*text) return;  // Skip empty strings
+
+    draw_text_at(ui, text, x, y, 0, 0);
 }
 
 void ui_draw_button(UI* ui, const char* text, int x, int y, int width, int height) {
@@ -44,34 +164,81 @@ void ui_draw_button(UI* ui, const char* text, int x, int y, int width, int heigh
     SDL_SetRenderDrawColor(ui->renderer, 0, 0, 0, 255);
     SDL_RenderDrawRect(ui->renderer, &rect);
 
-    // Draw button text
+    // Draw button text centered in button
     if (text && *text) {  // Only draw if text is not empty
-        SDL_Color color = {0, 0, 0, 255};  // Black color
-        SDL_Surface* surface = TTF_RenderText_Solid(ui->font, text, color);
-        if (!surface) {
-            printf("Failed to render text: %s\n", TTF_GetError());
-            return;
-        }
-
-        SDL_Texture* texture = SDL_CreateTextureFromSurface(ui->renderer, surface);
-        if (!texture) {
-            printf("Failed to create texture: %s\n", SDL_GetError());
-            SDL_FreeSurface(surface);
-            return;
-        }
+        draw_text_at(ui, text, x, y, width, height);
+    }
+}
 
-        // Center text in button
-        int text_x = x + (width - surface->w) / 2;
-        int text_y = y + (height - surface->h) / 2;
-        SDL_Rect text_rect = {text_x, text_y, surface->w, surface->h};
-        SDL_RenderCopy(ui->renderer, texture, NULL, &text_rect);
+// Draws text centered in rect
+void ui_draw_label(UI* ui, const char* text, const SDL_Rect* rect) {
+    if (!ui || !text || !*text || !rect) return;
 
-        SDL_DestroyTexture(texture);
-        SDL_FreeSurface(surface);
-    }
+    draw_text_at(ui, text, rect->x, rect->y, rect->w, rect->h);
 }
 
 int ui_is_button_clicked(UI* ui, int x, int y, int width, int height, int mouse_x, int mouse_y) {
     return (mouse_x >= x && mouse_x <= x + width &&
             mouse_y >= y && mouse_y <= y + height);
-} 
\ No newline at end of file
+}
+
+int ui_layer_begin(UI* ui, UILayer* layer, int width, int height) {
+    if (!ui || !layer) return 0;
+    if (layer->direct) return 1;
+
+    if (layer->texture && (layer->width != width || layer->height != height)) {
+        ui_layer_destroy(layer);
+    }
+    if (!layer->texture) {
+        layer->texture = SDL_CreateTexture(ui->renderer, SDL_PIXELFORMAT_RGBA8888,
+                                           SDL_TEXTUREACCESS_TARGET, width, height);
+        if (!layer->texture) {
+            printf("Failed to create layer: %s\n", SDL_GetError());
+            layer->direct = 1;
+            return 1;
+        }
+        metrics_add(METRIC_TEXTURES_CREATED, 1);
+        layer->width = width;
+        layer->height = height;
+        layer->dirty = 1;
+    }
+    if (!layer->dirty) return 0;
+
+    if (SDL_SetRenderTarget(ui->renderer, layer->texture) != 0) {
+        printf("Failed to render into layer: %s\n", SDL_GetError());
+        ui_layer_destroy(layer);
+        layer->direct = 1;
+        return 1;
+    }
+    SDL_SetRenderDrawColor(ui->renderer, 0, 0, 0, 255);
+    SDL_RenderClear(ui->renderer);
+    return 1;
+}
+
+void ui_layer_end(UI* ui, UILayer* layer) {
+    if (!ui || !layer || !layer->texture || !layer->dirty) return;
+
+    SDL_SetRenderTarget(ui->renderer, NULL);
+    layer->dirty = 0;
+}
+
+void ui_layer_draw(UI* ui, UILayer* layer, int x, int y) {
+    if (!ui || !layer || !layer->texture) return;
+
+    SDL_Rect rect = {x, y, layer->width, layer->height};
+    SDL_RenderCopy(ui->renderer, layer->texture, NULL, &rect);
+}
+
+void ui_layer_invalidate(UILayer* layer) {
+    if (layer) layer->dirty = 1;
+}
+
+void ui_layer_destroy(UILayer* layer) {
+    if (!layer) return;
+
+    if (layer->texture) {
+        SDL_DestroyTexture(layer->texture);
+    }
+    layer->texture = NULL;
+    layer->dirty = 1;
+}
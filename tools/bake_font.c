@@ -0,0 +1,212 @@
+// Bakes a TrueType font at one size into the atlas file the game maps at
+// startup (see include/font.h).
+//
+//   heroman_bake_font <font.ttf> <size> <out.bin>
+//
+// Glyphs are rendered the way the game renders text (SDL_ttf, solid), so
+// text drawn from the atlas matches text drawn live. Run by the bake_font
+// build target.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "font.h"
+
+#define ATLAS_WIDTH 256
+
+// Printable ASCII and Latin-1
+static const Uint16 ranges[][2] = {
+    {0x20, 0x7E},
+    {0xA0, 0xFF},
+};
+
+typedef struct {
+    FontAtlasGlyph glyph;
+    Uint8* pixels;       // width * height coverage bytes
+} BakedGlyph;
+
+// Renders one character as a string and trims it to its inked box
+static int bake_glyph(TTF_Font* font, Uint16 codepoint, BakedGlyph* baked) {
+    int min_x, advance;
+    if (TTF_GlyphMetrics(font, codepoint, &min_x, NULL, NULL, NULL, &advance) != 0) return 1;
+
+    char text[4];
+    if (codepoint < 0x80) {
+        text[0] = (char)codepoint;
+        text[1] = '\0';
+    }
+    else {
+        text[0] = (char)(0xC0 | (codepoint >> 6));
+        text[1] = (char)(0x80 | (codepoint & 0x3F));
+        text[2] = '\0';
+    }
+
+    SDL_Color white = {255, 255, 255, 255};
+    SDL_Surface* surface = TTF_RenderUTF8_Solid(font, text, white);
+    if (!surface) return 1;
+
+    // Solid surfaces are 8-bit palettized: index 0 is background
+    int left = surface->w, right = -1, top = surface->h, bottom = -1;
+    SDL_LockSurface(surface);
+    for (int y = 0; y < surface->h; y++) {
+        const Uint8* row = (const Uint8*)surface->pixels + y * surface->pitch;
+        for (int x = 0; x < surface->w; x++) {
+            if (!row[x]) continue;
+            if (x < left) left = x;
+            if (x > right) right = x;
+            if (y < top) top = y;
+            if (y > bottom) bottom = y;
+        }
+    }
+
+    memset(baked, 0, sizeof(BakedGlyph));
+    baked->glyph.codepoint = codepoint;
+    baked->glyph.advance = (int16_t)advance;
+    if (right >= 0) {
+        int width = right - left + 1;
+        int height = bottom - top + 1;
+        baked->pixels = malloc((size_t)width * height);
+        if (!baked->pixels) {
+            SDL_UnlockSurface(surface);
+            SDL_FreeSurface(surface);
+            return 1;
+        }
+        for (int y = 0; y < height; y++) {
+            const Uint8* row = (const Uint8*)surface->pixels + (top + y) * surface->pitch + left;
+            for (int x = 0; x < width; x++) {
+                baked->pixels[y * width + x] = row[x] ? 255 : 0;
+            }
+        }
+        baked->glyph.width = (uint16_t)width;
+        baked->glyph.height = (uint16_t)height;
+        // SDL_ttf starts a string further right when its first glyph
+        // reaches left of the pen
+        baked->glyph.offset_x = (int16_t)(left + (min_x < 0 ? min_x : 0));
+        baked->glyph.offset_y = (int16_t)top;
+    }
+    SDL_UnlockSurface(surface);
+    SDL_FreeSurface(surface);
+    return 0;
+}
+
+// Shelf packing in codepoint order; returns the atlas height
+static int pack_glyphs(BakedGlyph* glyphs, int count) {
+    int x = 0, y = 0, shelf = 0;
+    for (int i = 0; i < count; i++) {
+        FontAtlasGlyph* glyph = &glyphs[i].glyph;
+        if (x + glyph->width > ATLAS_WIDTH) {
+            x = 0;
+            y += shelf;
+            shelf = 0;
+        }
+        glyph->atlas_x = (uint16_t)x;
+        glyph->atlas_y = (uint16_t)y;
+        x += glyph->width;
+        if (glyph->height > shelf) shelf = glyph->height;
+    }
+    return y + shelf;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 4) {
+        fprintf(stderr, "usage: %s <font.ttf> <size> <out.bin>\n", argv[0]);
+        return 2;
+    }
+    int size = atoi(argv[2]);
+
+    if (TTF_Init() < 0) {
+        fprintf(stderr, "SDL_ttf could not initialize: %s\n", TTF_GetError());
+        return 1;
+    }
+    TTF_Font* font = TTF_OpenFont(argv[1], size);
+    if (!font) {
+        fprintf(stderr, "Failed to load font %s: %s\n", argv[1], TTF_GetError());
+        TTF_Quit();
+        return 1;
+    }
+
+    BakedGlyph glyphs[0x100];
+    int count = 0;
+    for (size_t r = 0; r < sizeof(ranges) / sizeof(ranges[0]); r++) {
+        for (Uint16 c = ranges[r][0]; c <= ranges[r][1]; c++) {
+            if (!TTF_GlyphIsProvided(font, c)) continue;
+            if (bake_glyph(font, c, &glyphs[count]) != 0) {
+                fprintf(stderr, "Failed to render U+%04X: %s\n", c, TTF_GetError());
+                continue;
+            }
+            count++;
+        }
+    }
+
+    // Only pairs that actually kern, sorted by (left, right) index
+    FontAtlasKern* kerning = malloc(sizeof(FontAtlasKern) * count * count);
+    int kern_count = 0;
+    for (int left = 0; kerning && left < count; left++) {
+        for (int right = 0; right < count; right++) {
+            int amount = TTF_GetFontKerningSizeGlyphs(font, (Uint16)glyphs[left].glyph.codepoint,
+                                                      (Uint16)glyphs[right].glyph.codepoint);
+            if (amount != 0) {
+                kerning[kern_count++] = (FontAtlasKern){(uint16_t)left, (uint16_t)right, (int16_t)amount, 0};
+            }
+        }
+    }
+
+    int atlas_height = pack_glyphs(glyphs, count);
+    Uint8* atlas = calloc((size_t)ATLAS_WIDTH * (atlas_height > 0 ? atlas_height : 1), 1);
+
+    FontAtlasHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FONT_ATLAS_MAGIC, sizeof(header.magic));
+    header.version = FONT_ATLAS_VERSION;
+    header.size = (uint32_t)size;
+    header.height = TTF_FontHeight(font);
+    header.ascent = TTF_FontAscent(font);
+    header.line_skip = TTF_FontLineSkip(font);
+    header.glyph_count = (uint32_t)count;
+    header.kern_count = (uint32_t)kern_count;
+    header.atlas_width = ATLAS_WIDTH;
+    header.atlas_height = (uint32_t)atlas_height;
+
+    int ok = kerning && atlas;
+    for (int i = 0; ok && i < count; i++) {
+        const FontAtlasGlyph* glyph = &glyphs[i].glyph;
+        for (int y = 0; y < glyph->height; y++) {
+            memcpy(atlas + (size_t)(glyph->atlas_y + y) * ATLAS_WIDTH + glyph->atlas_x,
+                   glyphs[i].pixels + y * glyph->width, glyph->width);
+        }
+    }
+
+    FILE* file = ok ? fopen(argv[3], "wb") : NULL;
+    if (file) {
+        unsigned char header_block[FONT_ATLAS_HEADER_SIZE] = {0};
+        memcpy(header_block, &header, sizeof(header));
+        ok = fwrite(header_block, 1, sizeof(header_block), file) == sizeof(header_block);
+        for (int i = 0; ok && i < count; i++) {
+            ok = fwrite(&glyphs[i].glyph, sizeof(FontAtlasGlyph), 1, file) == 1;
+        }
+        ok = ok && (kern_count == 0 || fwrite(kerning, sizeof(FontAtlasKern), kern_count, file) == (size_t)kern_count);
+        ok = ok && fwrite(atlas, ATLAS_WIDTH, atlas_height, file) == (size_t)atlas_height;
+        ok = (fclose(file) == 0) && ok;
+    }
+    else {
+        ok = 0;
+    }
+
+    if (ok) {
+        printf("Baked %d glyphs and %d kerning pairs at size %d into %s (%dx%d atlas)\n",
+               count, kern_count, size, argv[3], ATLAS_WIDTH, atlas_height);
+    }
+    else {
+        fprintf(stderr, "Failed to write %s\n", argv[3]);
+        remove(argv[3]);
+    }
+
+    for (int i = 0; i < count; i++) {
+        free(glyphs[i].pixels);
+    }
+    free(kerning);
+    free(atlas);
+    TTF_CloseFont(font);
+    TTF_Quit();
+    return ok ? 0 : 1;
+}
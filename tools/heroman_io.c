@@ -0,0 +1,465 @@
+// Bulk task import/export.
+//
+//   heroman_io import <file.csv|file.jsonl|-> [--db path] [--format csv|jsonl] [--chunk rows]
+//   heroman_io export <file.csv|file.jsonl|-> [--db path] [--format csv|jsonl]
+//
+// Input is parsed as a stream through a fixed-size read buffer and inserted
+// in chunked transactions through two reused prepared statements: a
+// DB_BULK_ROWS-row INSERT for full batches and a single-row one for the
+// rows left over at the end. Export streams rows straight from the
+// cursor, so memory use does not grow with the size of the table.
+//
+// Only title, description, difficulty, type and completed are carried.
+// Parents, manual order, tags and due dates are left out of the CSV and
+// dropped on import.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "database.h"
+#include "json.h"
+#include "tasks.h"
+
+#define IO_READ_BUFFER (1 << 20)
+#define IO_MAX_RECORD (64 * 1024)
+#define IO_MAX_COLUMNS 16
+
+typedef enum {
+    FORMAT_UNKNOWN,
+    FORMAT_CSV,
+    FORMAT_JSONL
+} Format;
+
+typedef enum {
+    COLUMN_IGNORED,
+    COLUMN_TITLE,
+    COLUMN_DESCRIPTION,
+    COLUMN_DIFFICULTY,
+    COLUMN_TYPE,
+    COLUMN_COMPLETED
+} Column;
+
+typedef struct {
+    FILE* file;
+    char* data;
+    size_t pos;
+    size_t len;
+    int eof;
+} Reader;
+
+typedef struct {
+    char data[IO_MAX_RECORD];
+    size_t len;
+    int offsets[IO_MAX_COLUMNS];
+    int count;
+} Record;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int reader_fill(Reader* r) {
+    if (r->eof) return 0;
+
+    r->len = fread(r->data, 1, IO_READ_BUFFER, r->file);
+    r->pos = 0;
+    if (r->len == 0) {
+        r->eof = 1;
+        return 0;
+    }
+    return 1;
+}
+
+// Returns the next byte or EOF
+static int reader_next(Reader* r) {
+    if (r->pos == r->len && !reader_fill(r)) return EOF;
+    return (unsigned char)r->data[r->pos++];
+}
+
+static int reader_peek(Reader* r) {
+    if (r->pos == r->len && !reader_fill(r)) return EOF;
+    return (unsigned char)r->data[r->pos];
+}
+
+static int record_push(Record* rec, char c) {
+    if (rec->len + 1 >= sizeof(rec->data)) return 1;
+    rec->data[rec->len++] = c;
+    return 0;
+}
+
+static int record_end_field(Record* rec) {
+    if (record_push(rec, '\0') != 0) return 1;
+    if (rec->count < IO_MAX_COLUMNS) {
+        rec->count++;
+    }
+    if (rec->count < IO_MAX_COLUMNS) {
+        rec->offsets[rec->count] = (int)rec->len;
+    }
+    return 0;
+}
+
+// Reads one RFC 4180 record. Returns 1 on success, 0 at end of input and
+// -1 if the record is malformed or too long.
+static int csv_read_record(Reader* r, Record* rec) {
+    rec->len = 0;
+    rec->count = 0;
+    rec->offsets[0] = 0;
+
+    int c = reader_next(r);
+    while (c == '\r' || c == '\n') {
+        c = reader_next(r);
+    }
+    if (c == EOF) return 0;
+
+    int quoted = 0;
+    int at_field_start = 1;
+    for (;; c = reader_next(r)) {
+        if (quoted) {
+            if (c == EOF) return -1;
+            if (c == '"') {
+                if (reader_peek(r) == '"') {
+                    reader_next(r);
+                    if (record_push(rec, '"') != 0) return -1;
+                } else {
+                    quoted = 0;
+                }
+                continue;
+            }
+            if (record_push(rec, (char)c) != 0) return -1;
+            continue;
+        }
+
+        if (c == '"' && at_field_start) {
+            quoted = 1;
+            at_field_start = 0;
+            continue;
+        }
+        if (c == ',') {
+            if (record_end_field(rec) != 0) return -1;
+            at_field_start = 1;
+            continue;
+        }
+        if (c == '\n' || c == EOF) {
+            if (record_end_field(rec) != 0) return -1;
+            return 1;
+        }
+        if (c == '\r') continue;
+
+        at_field_start = 0;
+        if (record_push(rec, (char)c) != 0) return -1;
+    }
+}
+
+// Reads one line into the record buffer. Same return values as above.
+static int jsonl_read_line(Reader* r, Record* rec) {
+    rec->len = 0;
+    for (;;) {
+        if (r->pos == r->len && !reader_fill(r)) {
+            rec->data[rec->len] = '\0';
+            return rec->len > 0 ? 1 : 0;
+        }
+
+        char* start = r->data + r->pos;
+        char* newline = memchr(start, '\n', r->len - r->pos);
+        size_t n = newline ? (size_t)(newline - start) : r->len - r->pos;
+        if (rec->len + n + 1 > sizeof(rec->data)) return -1;
+
+        memcpy(rec->data + rec->len, start, n);
+        rec->len += n;
+        r->pos += n;
+        if (newline) {
+            r->pos++;
+            if (rec->len == 0) continue;  // Skip blank lines
+            rec->data[rec->len] = '\0';
+            return 1;
+        }
+    }
+}
+
+static Column column_from_name(const char* name) {
+    if (strcmp(name, "title") == 0) return COLUMN_TITLE;
+    if (strcmp(name, "description") == 0) return COLUMN_DESCRIPTION;
+    if (strcmp(name, "difficulty") == 0) return COLUMN_DIFFICULTY;
+    if (strcmp(name, "type") == 0) return COLUMN_TYPE;
+    if (strcmp(name, "completed") == 0) return COLUMN_COMPLETED;
+    return COLUMN_IGNORED;
+}
+
+static int parse_flag(const char* value) {
+    return strcmp(value, "1") == 0 || strcmp(value, "true") == 0 || strcmp(value, "yes") == 0;
+}
+
+static int task_from_csv(const Record* rec, const Column* columns, int column_count, Task* task) {
+    task_init(task, "", NULL, 2, 0);
+    int has_title = 0;
+    for (int i = 0; i < rec->count && i < column_count; i++) {
+        const char* value = rec->data + rec->offsets[i];
+        switch (columns[i]) {
+            case COLUMN_TITLE:
+                strncpy(task->title, value, sizeof(task->title) - 1);
+                has_title = 1;
+                break;
+            case COLUMN_DESCRIPTION:
+                strncpy(task->description, value, sizeof(task->description) - 1);
+                break;
+            case COLUMN_DIFFICULTY:
+                task->difficulty = atoi(value);
+                break;
+            case COLUMN_TYPE:
+                task->type = atoi(value);
+                break;
+            case COLUMN_COMPLETED:
+                task->completed = parse_flag(value);
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (!has_title || task->difficulty < 0 || task->difficulty > 4 || task->type < 0 || task->type > 2) {
+        return 1;
+    }
+    return 0;
+}
+
+static int import_tasks(sqlite3* db, FILE* in, Format format, int chunk_size) {
+    Reader reader = {in, malloc(IO_READ_BUFFER), 0, 0, 0};
+    Record* rec = malloc(sizeof(Record));
+    if (!reader.data || !rec) {
+        fprintf(stderr, "Out of memory\n");
+        free(reader.data);
+        free(rec);
+        return 1;
+    }
+
+    Column columns[IO_MAX_COLUMNS];
+    int column_count = 0;
+    if (format == FORMAT_CSV) {
+        if (csv_read_record(&reader, rec) != 1) {
+            fprintf(stderr, "Missing CSV header\n");
+            free(reader.data);
+            free(rec);
+            return 1;
+        }
+        column_count = rec->count;
+        for (int i = 0; i < column_count; i++) {
+            columns[i] = column_from_name(rec->data + rec->offsets[i]);
+        }
+    }
+
+    DbBulkInsert bulk;
+    if (db_bulk_begin(db, &bulk, chunk_size) != 0) {
+        free(reader.data);
+        free(rec);
+        return 1;
+    }
+
+    double start = now_seconds();
+    long long line = format == FORMAT_CSV ? 1 : 0;
+    long long skipped = 0;
+    int rc = 0;
+    Task task;
+    JsonField fields[IO_MAX_COLUMNS];
+    for (;;) {
+        int status = format == FORMAT_CSV ? csv_read_record(&reader, rec) : jsonl_read_line(&reader, rec);
+        if (status == 0) break;
+        line++;
+        if (status < 0) {
+            fprintf(stderr, "Record %lld: malformed or too long, stopping\n", line);
+            rc = 1;
+            break;
+        }
+
+        int invalid;
+        if (format == FORMAT_CSV) {
+            invalid = task_from_csv(rec, columns, column_count, &task);
+        } else {
+            int count = json_parse_object(rec->data, (int)rec->len, fields, IO_MAX_COLUMNS);
+            task_init(&task, "", NULL, 2, 0);
+            invalid = count < 0 || !json_find(fields, count, "title") ||
+                      task_apply_json(&task, fields, count) != 0;
+        }
+        if (invalid) {
+            if (skipped++ < 10) {
+                fprintf(stderr, "Record %lld: invalid task, skipped\n", line);
+            }
+            continue;
+        }
+
+        if (db_bulk_insert(&bulk, &task) != 0) {
+            rc = 1;
+            break;
+        }
+    }
+
+    // A failed import leaves the database as it was, earlier chunks included
+    if (rc != 0 || db_bulk_end(&bulk) != 0) {
+        if (db_bulk_abort(&bulk) == 0) {
+            fprintf(stderr, "Import failed, no tasks imported\n");
+        } else {
+            fprintf(stderr, "Import failed, and some imported tasks could not be removed\n");
+        }
+        free(reader.data);
+        free(rec);
+        return 1;
+    }
+    double elapsed = now_seconds() - start;
+    fprintf(stderr, "Imported %lld tasks (%lld skipped) in %.3f s, %.0f rows/s\n",
+            bulk.total, skipped, elapsed, elapsed > 0 ? bulk.total / elapsed : 0.0);
+
+    free(reader.data);
+    free(rec);
+    return rc;
+}
+
+typedef struct {
+    FILE* out;
+    Format format;
+    JsonBuffer line;
+    long long count;
+} ExportState;
+
+static void write_csv_field(FILE* out, const char* value) {
+    if (!strpbrk(value, ",\"\r\n")) {
+        fputs(value, out);
+        return;
+    }
+
+    fputc('"', out);
+    for (const char* p = value; *p; p++) {
+        if (*p == '"') fputc('"', out);
+        fputc(*p, out);
+    }
+    fputc('"', out);
+}
+
+static int export_task(const Task* task, void* user_data) {
+    ExportState* state = user_data;
+
+    if (state->format == FORMAT_CSV) {
+        fprintf(state->out, "%d,", task->id);
+        write_csv_field(state->out, task->title);
+        fputc(',', state->out);
+        write_csv_field(state->out, task->description);
+        fprintf(state->out, ",%d,%d,%d\n", task->difficulty, task->type, task->completed);
+    } else {
+        state->line.len = 0;
+        if (task_append_json(&state->line, task) != 0 || json_buffer_append(&state->line, "\n", 1) != 0) {
+            return 1;
+        }
+        fwrite(state->line.data, 1, state->line.len, state->out);
+    }
+
+    state->count++;
+    return ferror(state->out) ? 1 : 0;
+}
+
+static int export_tasks(sqlite3* db, FILE* out, Format format) {
+    ExportState state = {out, format, {NULL, 0, 0}, 0};
+    setvbuf(out, NULL, _IOFBF, IO_READ_BUFFER);
+
+    if (format == FORMAT_CSV) {
+        fputs("id,title,description,difficulty,type,completed\n", out);
+    }
+
+    double start = now_seconds();
+    int rc = db_for_each_task(db, export_task, &state);
+    if (fflush(out) != 0) {
+        rc = 1;
+    }
+    double elapsed = now_seconds() - start;
+    fprintf(stderr, "Exported %lld tasks in %.3f s, %.0f rows/s\n",
+            state.count, elapsed, elapsed > 0 ? state.count / elapsed : 0.0);
+
+    json_buffer_free(&state.line);
+    return rc;
+}
+
+static Format format_from_name(const char* name) {
+    if (!name) return FORMAT_UNKNOWN;
+    if (strcmp(name, "csv") == 0) return FORMAT_CSV;
+    if (strcmp(name, "jsonl") == 0 || strcmp(name, "ndjson") == 0) return FORMAT_JSONL;
+    return FORMAT_UNKNOWN;
+}
+
+static Format format_from_path(const char* path) {
+    const char* dot = strrchr(path, '.');
+    return dot ? format_from_name(dot + 1) : FORMAT_UNKNOWN;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s import <file|-> [--db path] [--format csv|jsonl] [--chunk rows]\n"
+            "       %s export <file|-> [--db path] [--format csv|jsonl]\n",
+            prog, prog);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const char* command = argv[1];
+    const char* path = argv[2];
+    Config config;
+    config_load(&config, config_default_path());
+    const char* db_path = config.db_path;
+    Format format = FORMAT_UNKNOWN;
+    int chunk_size = 50000;
+
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--db") == 0 && i + 1 < argc) {
+            db_path = argv[++i];
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            format = format_from_name(argv[++i]);
+        } else if (strcmp(argv[i], "--chunk") == 0 && i + 1 < argc) {
+            chunk_size = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    int is_stdio = strcmp(path, "-") == 0;
+    if (format == FORMAT_UNKNOWN && !is_stdio) {
+        format = format_from_path(path);
+    }
+    if (format == FORMAT_UNKNOWN) {
+        fprintf(stderr, "Cannot determine format of %s; use --format\n", path);
+        return 1;
+    }
+
+    int importing = strcmp(command, "import") == 0;
+    if (!importing && strcmp(command, "export") != 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    sqlite3* db;
+    if (db_init(db_path, &db) != 0) {
+        return 1;
+    }
+    if (db_configure(db, &config) != 0 || db_create_schema(db) != 0) {
+        db_close(db);
+        return 1;
+    }
+
+    FILE* file = is_stdio ? (importing ? stdin : stdout) : fopen(path, importing ? "rb" : "wb");
+    if (!file) {
+        perror(path);
+        db_close(db);
+        return 1;
+    }
+
+    int rc = importing ? import_tasks(db, file, format, chunk_size) : export_tasks(db, file, format);
+
+    if (!is_stdio) {
+        fclose(file);
+    }
+    db_close(db);
+    return rc;
+}
@@ -0,0 +1,181 @@
+// Load generator for the task service (heroman_project --serve).
+// Sends pipelined JSON-RPC requests over the Unix socket and reports
+// throughput and latency percentiles.
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_SOCKET "heroman.sock"
+#define DEFAULT_REQUESTS 10000
+#define DEFAULT_DEPTH 32
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static int connect_socket(const char* path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        perror("connect");
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int format_request(char* out, size_t size, const char* method, int id) {
+    if (strcmp(method, "list") == 0) {
+        return snprintf(out, size, "{\"jsonrpc\":\"2.0\",\"id\":%d,\"method\":\"list\"}\n", id);
+    }
+    return snprintf(out, size,
+                    "{\"jsonrpc\":\"2.0\",\"id\":%d,\"method\":\"create\","
+                    "\"params\":{\"title\":\"Load test task %d\",\"difficulty\":2,\"type\":2}}\n",
+                    id, id);
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-s socket] [-n requests] [-d pipeline_depth] [-m create|list]\n", prog);
+}
+
+int main(int argc, char* argv[]) {
+    const char* socket_path = DEFAULT_SOCKET;
+    const char* method = "create";
+    int total = DEFAULT_REQUESTS;
+    int depth = DEFAULT_DEPTH;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:n:d:m:")) != -1) {
+        switch (opt) {
+            case 's': socket_path = optarg; break;
+            case 'n': total = atoi(optarg); break;
+            case 'd': depth = atoi(optarg); break;
+            case 'm': method = optarg; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (total <= 0 || depth <= 0 || (strcmp(method, "create") != 0 && strcmp(method, "list") != 0)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int fd = connect_socket(socket_path);
+    if (fd < 0) return 1;
+
+    double* sent_at = malloc(sizeof(double) * total);
+    double* latency = malloc(sizeof(double) * total);
+    size_t out_cap = (size_t)depth * 256;
+    char* out = malloc(out_cap);
+    size_t in_cap = 1 << 20;
+    char* in = malloc(in_cap);
+    if (!sent_at || !latency || !out || !in) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    size_t out_len = 0;
+    size_t in_len = 0;
+    int sent = 0;
+    int received = 0;
+    int errors = 0;
+    double start = now_us();
+
+    while (received < total) {
+        while (sent < total && sent - received < depth && out_len + 256 <= out_cap) {
+            out_len += (size_t)format_request(out + out_len, out_cap - out_len, method, sent + 1);
+            sent_at[sent++] = now_us();
+        }
+
+        struct pollfd pfd = {fd, POLLIN | (out_len > 0 ? POLLOUT : 0), 0};
+        if (poll(&pfd, 1, 5000) <= 0) {
+            fprintf(stderr, "Timed out waiting for the service\n");
+            break;
+        }
+
+        if ((pfd.revents & POLLOUT) && out_len > 0) {
+            ssize_t n = send(fd, out, out_len, MSG_NOSIGNAL);
+            if (n < 0 && errno != EINTR && errno != EAGAIN) {
+                perror("send");
+                break;
+            }
+            if (n > 0) {
+                memmove(out, out + n, out_len - (size_t)n);
+                out_len -= (size_t)n;
+            }
+        }
+
+        if (pfd.revents & (POLLIN | POLLHUP)) {
+            if (in_len == in_cap) {
+                in_cap *= 2;
+                in = realloc(in, in_cap);
+                if (!in) break;
+            }
+            ssize_t n = read(fd, in + in_len, in_cap - in_len);
+            if (n <= 0) {
+                fprintf(stderr, "Service closed the connection\n");
+                break;
+            }
+            in_len += (size_t)n;
+
+            // Responses arrive in request order
+            size_t line_start = 0;
+            char* newline;
+            while ((newline = memchr(in + line_start, '\n', in_len - line_start)) != NULL) {
+                double t = now_us();
+                if (memmem(in + line_start, newline - (in + line_start), "\"error\"", 7)) {
+                    errors++;
+                }
+                latency[received] = t - sent_at[received];
+                received++;
+                line_start = (size_t)(newline - in) + 1;
+            }
+            memmove(in, in + line_start, in_len - line_start);
+            in_len -= line_start;
+        }
+    }
+
+    double elapsed = (now_us() - start) / 1e6;
+    close(fd);
+
+    if (received > 0) {
+        qsort(latency, received, sizeof(double), compare_doubles);
+        printf("method:      %s\n", method);
+        printf("requests:    %d (%d errors)\n", received, errors);
+        printf("pipeline:    %d\n", depth);
+        printf("elapsed:     %.3f s\n", elapsed);
+        printf("throughput:  %.0f req/s\n", received / elapsed);
+        printf("latency p50: %.1f us\n", latency[received / 2]);
+        printf("latency p99: %.1f us\n", latency[(int)(received * 0.99)]);
+        printf("latency max: %.1f us\n", latency[received - 1]);
+    }
+
+    free(sent_at);
+    free(latency);
+    free(out);
+    free(in);
+    return received == total ? 0 : 1;
+}